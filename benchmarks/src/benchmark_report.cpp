@@ -0,0 +1,401 @@
+#include "benchmark_report.hpp"
+
+#include <charconv>
+#include <cstddef>
+#include <format>
+#include <fstream>
+#include <iterator>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+namespace pensieve {
+namespace {
+auto constexpr kReportVersion{1};
+
+// Writes the string as a JSON string literal.
+auto WriteJsonString(std::ofstream& out, std::string_view const str) -> void {
+  out << '"';
+
+  for (auto const c : str) {
+    if (c == '"' || c == '\\') {
+      out << '\\' << c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      out << std::format("\\u{:04x}", static_cast<unsigned>(c));
+    } else {
+      out << c;
+    }
+  }
+
+  out << '"';
+}
+
+// Reads the subset of JSON that reports are made of. Escaped code points
+// outside of ASCII are not supported.
+class JsonReader {
+public:
+  explicit JsonReader(std::string text) : text_{std::move(text)} {}
+
+  [[nodiscard]] auto Consume(char const c) -> bool {
+    SkipWhitespace();
+
+    if (pos_ < text_.size() && text_[pos_] == c) {
+      pos_ += 1;
+      return true;
+    }
+
+    return false;
+  }
+
+  [[nodiscard]] auto IsAtEnd() -> bool {
+    SkipWhitespace();
+    return pos_ == text_.size();
+  }
+
+  [[nodiscard]] auto Error(std::string_view const msg) const ->
+    std::unexpected<std::string> {
+    return std::unexpected{std::format("{} (offset {})", msg, pos_)};
+  }
+
+  [[nodiscard]] auto ReadString() -> std::expected<std::string, std::string> {
+    if (!Consume('"')) {
+      return Error("Expected a string.");
+    }
+
+    std::string ret;
+
+    while (pos_ < text_.size() && text_[pos_] != '"') {
+      auto const c{text_[pos_++]};
+
+      if (c != '\\') {
+        ret += c;
+        continue;
+      }
+
+      if (pos_ == text_.size()) {
+        break;
+      }
+
+      switch (auto const escaped{text_[pos_++]}) {
+      case 'b': ret += '\b';
+        break;
+      case 'f': ret += '\f';
+        break;
+      case 'n': ret += '\n';
+        break;
+      case 'r': ret += '\r';
+        break;
+      case 't': ret += '\t';
+        break;
+      case 'u': {
+        unsigned code_point;
+
+        if (auto const [ptr, ec]{
+          std::from_chars(text_.data() + pos_,
+                          text_.data() + std::min(pos_ + 4, text_.size()),
+                          code_point, 16)
+        }; ec != std::errc{} || ptr != text_.data() + pos_ + 4 ||
+          code_point >= 0x80) {
+          return Error("Unsupported escape sequence.");
+        }
+
+        pos_ += 4;
+        ret += static_cast<char>(code_point);
+        break;
+      }
+      default: ret += escaped;
+        break;
+      }
+    }
+
+    if (pos_ == text_.size()) {
+      return Error("Unterminated string.");
+    }
+
+    pos_ += 1;
+    return ret;
+  }
+
+  [[nodiscard]] auto ReadNumber() -> std::expected<double, std::string> {
+    SkipWhitespace();
+
+    double ret;
+    auto const [ptr, ec]{
+      std::from_chars(text_.data() + pos_, text_.data() + text_.size(), ret)
+    };
+
+    if (ec != std::errc{}) {
+      return Error("Expected a number.");
+    }
+
+    pos_ = static_cast<std::size_t>(ptr - text_.data());
+    return ret;
+  }
+
+  // Reads the members of an object, calling read_member after every key.
+  template<typename F>
+  [[nodiscard]] auto ReadObject(
+    F&& read_member) -> std::expected<void, std::string> {
+    if (!Consume('{')) {
+      return Error("Expected an object.");
+    }
+
+    if (Consume('}')) {
+      return {};
+    }
+
+    do {
+      auto const key{ReadString()};
+
+      if (!key) {
+        return std::unexpected{key.error()};
+      }
+
+      if (!Consume(':')) {
+        return Error("Expected a colon.");
+      }
+
+      if (auto const exp{read_member(*key)}; !exp) {
+        return exp;
+      }
+    } while (Consume(','));
+
+    if (!Consume('}')) {
+      return Error("Expected the end of the object.");
+    }
+
+    return {};
+  }
+
+  template<typename F>
+  [[nodiscard]] auto ReadArray(
+    F&& read_element) -> std::expected<void, std::string> {
+    if (!Consume('[')) {
+      return Error("Expected an array.");
+    }
+
+    if (Consume(']')) {
+      return {};
+    }
+
+    do {
+      if (auto const exp{read_element()}; !exp) {
+        return exp;
+      }
+    } while (Consume(','));
+
+    if (!Consume(']')) {
+      return Error("Expected the end of the array.");
+    }
+
+    return {};
+  }
+
+  [[nodiscard]] auto SkipValue() -> std::expected<void, std::string> {
+    SkipWhitespace();
+
+    if (pos_ == text_.size()) {
+      return Error("Expected a value.");
+    }
+
+    switch (text_[pos_]) {
+    case '{':
+      return ReadObject([this](std::string const&) { return SkipValue(); });
+    case '[':
+      return ReadArray([this] { return SkipValue(); });
+    case '"':
+      if (auto const exp{ReadString()}; !exp) {
+        return std::unexpected{exp.error()};
+      }
+
+      return {};
+    default:
+      break;
+    }
+
+    for (std::string_view const literal : {"true", "false", "null"}) {
+      if (std::string_view{text_}.substr(pos_).starts_with(literal)) {
+        pos_ += literal.size();
+        return {};
+      }
+    }
+
+    if (auto const exp{ReadNumber()}; !exp) {
+      return std::unexpected{exp.error()};
+    }
+
+    return {};
+  }
+
+private:
+  auto SkipWhitespace() -> void {
+    while (pos_ < text_.size() && (text_[pos_] == ' ' || text_[pos_] == '\n' ||
+      text_[pos_] == '\r' || text_[pos_] == '\t')) {
+      pos_ += 1;
+    }
+  }
+
+  std::string text_;
+  std::size_t pos_{0};
+};
+
+[[nodiscard]] auto ReadBenchmark(
+  JsonReader& reader) -> std::expected<BenchmarkResult, std::string> {
+  std::optional<std::string> name;
+  std::optional<std::string> unit;
+  std::optional<double> throughput;
+  BenchmarkResult ret{{}, {}, 0.0, 0.0, 0.0, 0};
+
+  if (auto const exp{
+    reader.ReadObject([&](std::string const& key) ->
+    std::expected<void, std::string> {
+        if (key == "name" || key == "unit") {
+          auto str{reader.ReadString()};
+
+          if (!str) {
+            return std::unexpected{str.error()};
+          }
+
+          (key == "name" ? name : unit) = std::move(*str);
+          return {};
+        }
+
+        if (key != "throughput" && key != "median_ms" && key != "min_ms" && key
+          != "repetitions") {
+          return reader.SkipValue();
+        }
+
+        auto const number{reader.ReadNumber()};
+
+        if (!number) {
+          return std::unexpected{number.error()};
+        }
+
+        if (key == "throughput") {
+          throughput = *number;
+        } else if (key == "median_ms") {
+          ret.median_ms = *number;
+        } else if (key == "min_ms") {
+          ret.min_ms = *number;
+        } else {
+          ret.repetition_count = static_cast<std::uint32_t>(*number);
+        }
+
+        return {};
+      })
+  }; !exp) {
+    return std::unexpected{exp.error()};
+  }
+
+  if (!name || !unit || !throughput) {
+    return reader.Error("Benchmark without name, unit or throughput.");
+  }
+
+  ret.name = std::move(*name);
+  ret.unit = std::move(*unit);
+  ret.throughput = *throughput;
+  return ret;
+}
+}
+
+auto WriteBenchmarkReport(std::filesystem::path const& path,
+                          std::span<BenchmarkResult const> const results) ->
+  std::expected<void, std::string> {
+  std::ofstream out{path, std::ios::out | std::ios::trunc};
+
+  if (!out.is_open()) {
+    return std::unexpected{
+      std::format("Failed to open {} for writing.", path.string())
+    };
+  }
+
+  out << std::format("{{\n  \"version\": {},\n  \"benchmarks\": [",
+                     kReportVersion);
+  auto is_first{true};
+
+  for (auto const& result : results) {
+    out << (is_first ? "\n    {\"name\": " : ",\n    {\"name\": ");
+    WriteJsonString(out, result.name);
+    out << ", \"unit\": ";
+    WriteJsonString(out, result.unit);
+    out << std::format(
+      R"(, "throughput": {:.6f}, "median_ms": {:.6f}, "min_ms": {:.6f}, )"
+      R"("repetitions": {}}})", result.throughput, result.median_ms,
+      result.min_ms, result.repetition_count);
+    is_first = false;
+  }
+
+  out << (is_first ? "]\n}\n" : "\n  ]\n}\n");
+
+  if (!out) {
+    return std::unexpected{std::format("Failed to write {}.", path.string())};
+  }
+
+  return {};
+}
+
+auto ReadBenchmarkReport(std::filesystem::path const& path) -> std::expected<
+  std::vector<BenchmarkResult>, std::string> {
+  std::ifstream in{path, std::ios::in | std::ios::binary};
+
+  if (!in.is_open()) {
+    return std::unexpected{std::format("Failed to open {}.", path.string())};
+  }
+
+  JsonReader reader{std::string{std::istreambuf_iterator{in}, {}}};
+  std::optional<double> version;
+  std::vector<BenchmarkResult> results;
+
+  auto const exp{
+    reader.ReadObject([&](std::string const& key) ->
+    std::expected<void, std::string> {
+        if (key == "version") {
+          auto const number{reader.ReadNumber()};
+
+          if (!number) {
+            return std::unexpected{number.error()};
+          }
+
+          version = *number;
+          return {};
+        }
+
+        if (key != "benchmarks") {
+          return reader.SkipValue();
+        }
+
+        return reader.ReadArray([&]() -> std::expected<void, std::string> {
+          auto result{ReadBenchmark(reader)};
+
+          if (!result) {
+            return std::unexpected{result.error()};
+          }
+
+          results.emplace_back(std::move(*result));
+          return {};
+        });
+      })
+  };
+
+  if (!exp) {
+    return std::unexpected{
+      std::format("Failed to parse {}: {}", path.string(), exp.error())
+    };
+  }
+
+  if (!reader.IsAtEnd()) {
+    return std::unexpected{
+      std::format("Failed to parse {}: trailing characters.", path.string())
+    };
+  }
+
+  if (version != kReportVersion) {
+    return std::unexpected{
+      std::format("{} is not a version {} benchmark report.", path.string(),
+                  kReportVersion)
+    };
+  }
+
+  return results;
+}
+}
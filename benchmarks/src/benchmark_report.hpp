@@ -0,0 +1,91 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <expected>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace pensieve {
+struct BenchmarkResult {
+  std::string name;
+  // Higher is better, e.g. GB/s.
+  std::string unit;
+  // Work per second at the median time.
+  double throughput;
+  double median_ms;
+  double min_ms;
+  std::uint32_t repetition_count;
+};
+
+// Writes one benchmark per line in the order given. The report holds no
+// timestamps or machine names, so reports of equal results are identical.
+[[nodiscard]] auto WriteBenchmarkReport(
+  std::filesystem::path const& path,
+  std::span<BenchmarkResult const> results) -> std::expected<
+  void, std::string>;
+
+// Reads reports written by WriteBenchmarkReport. Unknown keys are skipped.
+[[nodiscard]] auto ReadBenchmarkReport(
+  std::filesystem::path const& path) -> std::expected<
+  std::vector<BenchmarkResult>, std::string>;
+
+struct BenchmarkComparison {
+  std::string name;
+  std::string unit;
+  // Empty if the benchmark is missing from the report.
+  std::optional<double> baseline_throughput;
+  std::optional<double> current_throughput;
+  // Relative to the baseline, e.g. -10 for a 10% slowdown.
+  std::optional<double> change_percent;
+  bool is_regression;
+};
+
+// Pairs the benchmarks by name in the order of the baseline, followed by the
+// ones that are only in the current report. A benchmark regressed if its
+// throughput dropped by more than the threshold.
+[[nodiscard]] constexpr auto CompareBenchmarkResults(
+  std::span<BenchmarkResult const> const baseline,
+  std::span<BenchmarkResult const> const current,
+  double const threshold_percent) -> std::vector<BenchmarkComparison> {
+  std::vector<BenchmarkComparison> ret;
+  ret.reserve(baseline.size() + current.size());
+
+  for (auto const& base : baseline) {
+    auto& comparison{
+      ret.emplace_back(base.name, base.unit, base.throughput, std::nullopt,
+                       std::nullopt, false)
+    };
+
+    auto const cur{
+      std::ranges::find(current, base.name, &BenchmarkResult::name)
+    };
+
+    if (cur == current.end()) {
+      continue;
+    }
+
+    comparison.current_throughput = cur->throughput;
+
+    if (base.throughput > 0.0) {
+      comparison.change_percent = (cur->throughput - base.throughput) / base.
+        throughput * 100.0;
+      comparison.is_regression = *comparison.change_percent < -
+        threshold_percent;
+    }
+  }
+
+  for (auto const& cur : current) {
+    if (std::ranges::find(baseline, cur.name, &BenchmarkResult::name) ==
+      baseline.end()) {
+      ret.emplace_back(cur.name, cur.unit, std::nullopt, cur.throughput,
+                       std::nullopt, false);
+    }
+  }
+
+  return ret;
+}
+}
@@ -0,0 +1,1117 @@
+#include "benchmark_suite.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <concepts>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <numbers>
+#include <numeric>
+#include <span>
+#include <string_view>
+#include <system_error>
+#include <tuple>
+#include <utility>
+
+#include <assimp/mesh.h>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
+#include "bvh.hpp"
+#include "bvh_builder.hpp"
+#include "descriptor_allocator.hpp"
+#include "draw_partitioning.hpp"
+#include "frame_telemetry.hpp"
+#include "frustum_culling.hpp"
+#include "mesh_conversion.hpp"
+#include "occlusion_culling.hpp"
+#include "scene_loading.hpp"
+#include "scene_synthesis.hpp"
+#include "scene_writing.hpp"
+#include "staging_ring.hpp"
+#include "texture_decoding.hpp"
+#include "shaders/common.hlsli"
+
+namespace pensieve {
+namespace {
+// Large enough that a run takes tens of milliseconds, so timer resolution
+// and scheduling noise stay small against it.
+auto constexpr kSceneParams{
+  SceneSynthesisParams{256, 16384, 16, 0.5f, true, 64, 64, 256, 1}
+};
+auto constexpr kMeshParams{
+  SceneSynthesisParams{1, 1, 256, 1.0f, false, 1, 0, 0, 1}
+};
+auto constexpr kTextureParams{
+  SceneSynthesisParams{1, 1, 1, 0.0f, false, 1, 1, 1024, 1}
+};
+auto constexpr kInstanceParams{
+  SceneSynthesisParams{1, 262144, 1, 0.0f, false, 1, 0, 0, 1}
+};
+// From the cubes screenshot to far beyond it.
+auto constexpr kBvhInstanceCounts{
+  std::to_array<std::pair<std::string_view, std::uint32_t>>({
+    {"400k", 400'000}, {"1M", 1'000'000}, {"10M", 10'000'000}
+  })
+};
+auto constexpr kCullingInstanceCounts{
+  std::to_array<std::pair<std::string_view, std::uint32_t>>({
+    {"100k", 100'000}, {"1M", 1'000'000}, {"10M", 10'000'000}
+  })
+};
+auto constexpr kOcclusionInstanceCounts{
+  std::to_array<std::pair<std::string_view, std::uint32_t>>({
+    {"100k", 100'000}, {"1M", 1'000'000}
+  })
+};
+// As many as the renderer rasterizes.
+auto constexpr kOccluderCount{64u};
+// Meshes whose draws are built in a frame, each with the same number of
+// instances.
+auto constexpr kDrawMeshCounts{
+  std::to_array<std::pair<std::string_view, std::uint32_t>>({
+    {"1k", 1'000}, {"10k", 10'000}
+  })
+};
+auto constexpr kDrawInstancesPerMesh{100u};
+// The partitioning limits of the renderer.
+auto constexpr kMaxDrawPartitionCount{16u};
+auto constexpr kMinDrawPartitionCommandCount{2048u};
+// Empty jobs, so that the scheduling is all that is timed.
+auto constexpr kSchedulingJobCount{1u << 16};
+// The size of the renderer's shader visible descriptor heap.
+auto constexpr kDescriptorHeapSize{1'000'000u};
+auto constexpr kDescriptorChurnOpCount{1u << 20};
+
+// Looks from the center of the lattice of a synthesized scene along +z with
+// a 60 degree vertical field of view and reversed depth like the renderer, so
+// the frustum cuts through the instances.
+[[nodiscard]] auto MakeInteriorViewProjMatrix() -> std::array<float, 16> {
+  auto constexpr aspect_ratio{16.0f / 9.0f};
+  auto constexpr near_clip_plane{0.1f};
+  auto constexpr far_clip_plane{1000.0f};
+  auto const height{1.0f / std::tan(std::numbers::pi_v<float> / 6.0f)};
+  auto constexpr range{near_clip_plane / (near_clip_plane - far_clip_plane)};
+
+  return std::array{
+    height / aspect_ratio, 0.0f, 0.0f, 0.0f, 0.0f, height, 0.0f, 0.0f, 0.0f,
+    0.0f, range, 1.0f, 0.0f, 0.0f, -range * far_clip_plane, 0.0f
+  };
+}
+
+// Calls fn once to warm up caches and allocators and then times the given
+// number of calls. setup runs untimed before every call. work_amount is what
+// one call processes in the unit of the throughput, e.g. gigabytes for GB/s.
+template<std::invocable S, std::invocable F>
+[[nodiscard]] auto RunBenchmark(std::string name, std::string unit,
+                                double const work_amount,
+                                std::uint32_t const repetition_count,
+                                S&& setup, F&& fn) -> BenchmarkResult {
+  setup();
+  fn();
+
+  std::vector<std::chrono::nanoseconds> durations;
+  durations.reserve(repetition_count);
+
+  for (std::uint32_t i{0}; i < repetition_count; i++) {
+    setup();
+    auto const begin{std::chrono::steady_clock::now()};
+    fn();
+    durations.emplace_back(std::chrono::steady_clock::now() - begin);
+  }
+
+  auto const percentiles{CalculatePercentiles(durations)};
+  std::chrono::duration<double, std::milli> const median{percentiles.p50};
+  std::chrono::duration<double, std::milli> const min{durations.front()};
+
+  return BenchmarkResult{
+    std::move(name), std::move(unit), work_amount / (median.count() / 1000.0),
+    median.count(), min.count(), repetition_count
+  };
+}
+
+template<std::invocable F>
+[[nodiscard]] auto RunBenchmark(std::string name, std::string unit,
+                                double const work_amount,
+                                std::uint32_t const repetition_count,
+                                F&& fn) -> BenchmarkResult {
+  return RunBenchmark(std::move(name), std::move(unit), work_amount,
+                      repetition_count, [] {}, std::forward<F>(fn));
+}
+
+auto PrintResult(BenchmarkResult const& result) -> void {
+  std::cout << std::format("{:<28} {:>12.3f} {:<8} median {:>10.3f} ms, "
+                           "min {:>10.3f} ms\n", result.name, result.throughput,
+                           result.unit, result.median_ms, result.min_ms);
+}
+
+// Expands the meshlets of the mesh back into a triangle list.
+[[nodiscard]] auto GetTriangleList(
+  MeshData const& mesh) -> std::vector<std::uint32_t> {
+  std::vector<std::uint32_t> ret;
+  ret.reserve(mesh.triangle_indices.size() * 3);
+
+  for (auto const& meshlet : mesh.meshlets) {
+    for (auto i{meshlet.prim_offset};
+         i < meshlet.prim_offset + meshlet.prim_count; i++) {
+      auto const& tri{mesh.triangle_indices[i]};
+
+      for (auto const idx : std::array{
+             static_cast<std::uint32_t>(tri.idx0),
+             static_cast<std::uint32_t>(tri.idx1),
+             static_cast<std::uint32_t>(tri.idx2)
+           }) {
+        std::uint32_t vertex_idx;
+        std::memcpy(&vertex_idx, mesh.vertex_indices.data() + (meshlet.
+                      vert_offset + idx) * sizeof(std::uint32_t),
+                    sizeof(std::uint32_t));
+        ret.emplace_back(vertex_idx);
+      }
+    }
+  }
+
+  return ret;
+}
+
+// The mesh as the meshlet generator receives it from Assimp.
+[[nodiscard]] auto MakeAssimpMesh(
+  MeshData const& mesh) -> std::unique_ptr<aiMesh> {
+  auto ret{std::make_unique<aiMesh>()};
+  auto const vertex_count{static_cast<unsigned>(mesh.positions.size())};
+  ret->mPrimitiveTypes = aiPrimitiveType_TRIANGLE;
+  ret->mNumVertices = vertex_count;
+  ret->mVertices = new aiVector3D[vertex_count];
+  ret->mNormals = new aiVector3D[vertex_count];
+  ret->mTangents = new aiVector3D[vertex_count];
+  ret->mBitangents = new aiVector3D[vertex_count];
+  ret->mTextureCoords[0] = new aiVector3D[vertex_count];
+  ret->mNumUVComponents[0] = 2;
+
+  for (unsigned i{0}; i < vertex_count; i++) {
+    auto const& pos{mesh.positions[i]};
+    auto const& normal{mesh.normals[i]};
+    auto const& tangent{(*mesh.tangents)[i]};
+    auto const& uv{(*mesh.uvs)[i]};
+    ret->mVertices[i] = aiVector3D{pos[0], pos[1], pos[2]};
+    ret->mNormals[i] = aiVector3D{normal[0], normal[1], normal[2]};
+    ret->mTangents[i] = aiVector3D{tangent[0], tangent[1], tangent[2]};
+    ret->mBitangents[i] = ret->mNormals[i] ^ ret->mTangents[i];
+    ret->mTextureCoords[0][i] = aiVector3D{uv[0], uv[1], 0.0f};
+  }
+
+  auto const indices{GetTriangleList(mesh)};
+  ret->mNumFaces = static_cast<unsigned>(indices.size() / 3);
+  ret->mFaces = new aiFace[ret->mNumFaces];
+
+  for (unsigned i{0}; i < ret->mNumFaces; i++) {
+    ret->mFaces[i].mNumIndices = 3;
+    ret->mFaces[i].mIndices = new unsigned[3];
+    std::memcpy(ret->mFaces[i].mIndices, indices.data() + i * 3,
+                3 * sizeof(unsigned));
+  }
+
+  return ret;
+}
+
+enum class ImageEncoding {
+  kPng,
+  kJpeg
+};
+
+[[nodiscard]] auto EncodeImage(TextureData const& tex,
+                               ImageEncoding const encoding) -> std::vector<
+  std::uint8_t> {
+  std::vector<std::uint8_t> ret;
+  auto const append{
+    [](void* const context, void* const data, int const size) {
+      auto const bytes{static_cast<std::uint8_t const*>(data)};
+      static_cast<std::vector<std::uint8_t>*>(context)->insert(
+        static_cast<std::vector<std::uint8_t>*>(context)->end(), bytes,
+        bytes + size);
+    }
+  };
+
+  auto const width{static_cast<int>(tex.width)};
+  auto const height{static_cast<int>(tex.height)};
+
+  if (encoding == ImageEncoding::kPng) {
+    stbi_write_png_to_func(append, &ret, width, height, 4, tex.bytes.get(),
+                           width * 4);
+  } else {
+    stbi_write_jpg_to_func(append, &ret, width, height, 4, tex.bytes.get(),
+                           90);
+  }
+
+  return ret;
+}
+
+struct NamedLoadOptions {
+  std::string_view name;
+  SceneLoadOptions options;
+};
+
+#ifdef __linux__
+auto constexpr kLoadOptions{
+  std::array{
+    NamedLoadOptions{
+      "Stream", {SceneReadBackend::kStream, kDefaultFileReadOptions}
+    },
+    NamedLoadOptions{
+      "MemoryMap", {SceneReadBackend::kMemoryMap, kDefaultFileReadOptions}
+    },
+    NamedLoadOptions{
+      "Pread", {SceneReadBackend::kPread, kDefaultFileReadOptions}
+    },
+    NamedLoadOptions{
+      "IoUring", {SceneReadBackend::kIoUring, kDefaultFileReadOptions}
+    },
+    NamedLoadOptions{
+      "IoUringDirect", {SceneReadBackend::kIoUring, {1u << 20, 32, true}}
+    },
+  }
+};
+#else
+auto constexpr kLoadOptions{
+  std::array{
+    NamedLoadOptions{
+      "Stream", {SceneReadBackend::kStream, kDefaultFileReadOptions}
+    },
+  }
+};
+#endif
+
+// Stages every section through a StagingRing sized like the renderer's
+// uploader, as if the copies of a batch completed as soon as it is submitted,
+// so StreamScene is timed without materializing the scene. Rows are tightly
+// packed, unlike the pitched texture rows of the renderer.
+class StagingSink final : public SceneSink {
+public:
+  [[nodiscard]] auto Begin([[maybe_unused]] SceneLayout const& layout) ->
+    std::expected<void, std::string> override {
+    uploaded_byte_count_ = 0;
+    batch_count_ = 0;
+    return {};
+  }
+
+  [[nodiscard]] auto AcquireRows(
+    SceneSection const& section,
+    std::uint64_t const first_row) -> std::expected<SceneSectionDestination,
+                                                    std::string> override {
+    auto const row_count{
+      std::min(section.row_count - first_row,
+               max_batch_byte_count_ / section.row_byte_count)
+    };
+    auto const byte_count{row_count * section.row_byte_count};
+    auto offset{ring_.Allocate(byte_count, 16)};
+
+    if (!offset) {
+      SubmitBatch();
+      offset = ring_.Allocate(byte_count, 16);
+    }
+
+    if (!offset) {
+      return std::unexpected{
+        std::format("{} bytes do not fit into the staging ring.", byte_count)
+      };
+    }
+
+    return SceneSectionDestination{
+      staging_.get() + *offset, row_count, section.row_byte_count
+    };
+  }
+
+  [[nodiscard]] auto CommitRows(
+    SceneSection const& section,
+    [[maybe_unused]] std::uint64_t const first_row,
+    SceneSectionDestination const& dst) -> std::expected<
+    void, std::string> override {
+    uploaded_byte_count_ += dst.row_count * section.row_byte_count;
+
+    if (ring_.IsBatchFull()) {
+      SubmitBatch();
+    }
+
+    return {};
+  }
+
+  [[nodiscard]] auto EndMesh([[maybe_unused]] std::size_t const mesh_idx) ->
+    std::expected<void, std::string> override {
+    return {};
+  }
+
+  [[nodiscard]] auto Finish() -> std::expected<void, std::string> override {
+    SubmitBatch();
+    return {};
+  }
+
+  [[nodiscard]] auto GetUploadedByteCount() const -> std::uint64_t {
+    return uploaded_byte_count_;
+  }
+
+  [[nodiscard]] auto GetBatchCount() const -> std::uint64_t {
+    return batch_count_;
+  }
+
+private:
+  static auto constexpr ring_capacity_{std::uint64_t{256} << 20};
+  static auto constexpr max_batch_byte_count_{std::uint64_t{32} << 20};
+
+  auto SubmitBatch() -> void {
+    if (ring_.GetOpenBatchByteCount() != 0) {
+      ++batch_count_;
+    }
+
+    ring_.CloseBatch(batch_count_);
+    ring_.Reclaim(batch_count_);
+  }
+
+  std::unique_ptr<std::byte[]> staging_{
+    std::make_unique_for_overwrite<std::byte[]>(ring_capacity_)
+  };
+  StagingRing ring_{ring_capacity_, max_batch_byte_count_};
+  std::uint64_t uploaded_byte_count_{0};
+  std::uint64_t batch_count_{0};
+};
+
+// Copies the commands into the frame's argument buffer like
+// D3D12CommandRecorder, which leaves the API calls as the only difference.
+class ArgumentBufferRecorder final : public CommandRecorder {
+public:
+  ArgumentBufferRecorder(std::span<IndirectDrawCommand> const arguments,
+                         std::size_t const first_cmd_idx) :
+    arguments_{arguments}, next_cmd_idx_{first_cmd_idx} {}
+
+  auto SetDrawParams([[maybe_unused]] std::uint32_t const dword_offset,
+                     [[maybe_unused]] std::span<std::uint32_t const> const
+                     values) -> void override {}
+
+  auto DrawIndirect(
+    std::span<IndirectDrawCommand const> const commands) -> void override {
+    std::ranges::copy(commands, arguments_.begin() + next_cmd_idx_);
+    next_cmd_idx_ += commands.size();
+  }
+
+private:
+  std::span<IndirectDrawCommand> arguments_;
+  std::size_t next_cmd_idx_;
+};
+
+// The command layout before draw records, in which every command carried the
+// ten buffer indices of its mesh.
+struct InlineBindingsDrawCommand {
+  std::array<std::uint32_t, 4> dispatch_constants;
+  std::array<std::uint32_t, 10> bindings;
+  DispatchMeshArguments dispatch;
+};
+
+static_assert(sizeof(InlineBindingsDrawCommand) == 17 * sizeof(
+  std::uint32_t));
+
+// Drops the cached pages of the file so the next read goes to the drive.
+// The scratch directory must be on a drive, tmpfs cannot evict its pages.
+[[nodiscard]] auto EvictFromPageCache(
+  [[maybe_unused]] std::filesystem::path const& path) -> bool {
+#ifdef __linux__
+  auto const fd{open(path.c_str(), O_RDONLY | O_CLOEXEC)};
+
+  if (fd < 0) {
+    return false;
+  }
+
+  auto const is_evicted{
+    fdatasync(fd) == 0 && posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0
+  };
+  close(fd);
+  return is_evicted;
+#else
+  return false;
+#endif
+}
+
+[[nodiscard]] auto WriteSceneFile(std::filesystem::path const& path,
+                                  SceneData const& scene) -> bool {
+  std::ofstream out{path, std::ios::binary | std::ios::out | std::ios::trunc};
+
+  if (!out.is_open()) {
+    return false;
+  }
+
+  WriteScene(out, scene);
+  return static_cast<bool>(out);
+}
+}
+
+auto RunBenchmarkSuite(BenchmarkSuiteOptions const& options,
+                       JobSystem& job_system) -> std::expected<
+  std::vector<BenchmarkResult>, std::string> {
+  std::vector<BenchmarkResult> results;
+  auto const reps{options.repetition_count};
+
+  auto const is_selected{
+    [&options](std::string_view const name) {
+      return name.find(options.filter) != std::string_view::npos;
+    }
+  };
+
+  auto const add_result{
+    [&results](BenchmarkResult result) {
+      PrintResult(result);
+      results.emplace_back(std::move(result));
+    }
+  };
+
+  struct LoadBenchmark {
+    std::string name;
+    SceneLoadOptions options;
+    bool is_cold;
+    // Streams into a StagingSink instead of loading the scene.
+    bool is_streamed;
+  };
+
+  std::vector<LoadBenchmark> load_benchmarks;
+
+  for (auto const is_streamed : {false, true}) {
+    for (auto const& [backend_name, load_options] : kLoadOptions) {
+      for (auto const is_cold : {false, true}) {
+        auto name{
+          std::format("{}/{}/{}", is_streamed ? "StreamScene" : "LoadScene",
+                      backend_name, is_cold ? "Cold" : "Warm")
+        };
+
+        if (is_selected(name)) {
+          load_benchmarks.emplace_back(std::move(name), load_options, is_cold,
+                                       is_streamed);
+        }
+      }
+    }
+  }
+
+  if (is_selected("WriteScene") || !load_benchmarks.empty()) {
+    auto const scene{SynthesizeScene(kSceneParams, job_system)};
+
+    if (!scene) {
+      return std::unexpected{scene.error()};
+    }
+
+    auto const path{options.scratch_dir / "pensieve-benchmark.pensieve"};
+
+    if (!WriteSceneFile(path, *scene)) {
+      return std::unexpected{
+        std::format("Failed to write {}.", path.string())
+      };
+    }
+
+    auto const gigabytes{
+      static_cast<double>(std::filesystem::file_size(path)) / 1e9
+    };
+
+    if (is_selected("WriteScene")) {
+      auto is_written{true};
+      add_result(RunBenchmark("WriteScene", "GB/s", gigabytes, reps, [&] {
+        is_written = is_written && WriteSceneFile(path, *scene);
+      }));
+
+      if (!is_written) {
+        return std::unexpected{
+          std::format("Failed to write {}.", path.string())
+        };
+      }
+    }
+
+    for (auto const& [name, load_options, is_cold, is_streamed] :
+         load_benchmarks) {
+      auto is_evicted{true};
+      // Reused like the staging ring, whose pages stay committed.
+      StagingSink sink;
+      std::expected<void, std::string> loaded;
+      add_result(RunBenchmark(name, "GB/s", gigabytes, reps, [&] {
+        is_evicted = is_evicted && (!is_cold || EvictFromPageCache(path));
+      }, [&] {
+        if (is_streamed) {
+          loaded = StreamScene(path, sink, load_options);
+        } else if (auto const scene_data{LoadScene(path, load_options)}) {
+          loaded = {};
+        } else {
+          loaded = std::unexpected{scene_data.error()};
+        }
+      }));
+
+      if (!is_evicted) {
+        return std::unexpected{
+          std::format("Failed to evict {} from the page cache.", path.string())
+        };
+      }
+
+      if (!loaded) {
+        return std::unexpected{loaded.error()};
+      }
+
+      if (is_streamed) {
+        std::cout << std::format(
+          "{:<28} {:>12} bytes uploaded in {} staging batches\n", name,
+          sink.GetUploadedByteCount(), sink.GetBatchCount());
+      }
+    }
+
+    std::error_code ec;
+    std::filesystem::remove(path, ec);
+  }
+
+  if (is_selected("ConvertMeshAttributes") ||
+    is_selected("GenerateMeshlets")) {
+    auto const scene{SynthesizeScene(kMeshParams, job_system)};
+
+    if (!scene) {
+      return std::unexpected{scene.error()};
+    }
+
+    auto const& mesh{scene->meshes.front()};
+
+    if (is_selected("ConvertMeshAttributes")) {
+      auto const ai_mesh{MakeAssimpMesh(mesh)};
+      std::expected<MeshData, std::string> converted;
+      add_result(RunBenchmark(
+        "ConvertMeshAttributes", "Mvert/s",
+        static_cast<double>(mesh.positions.size()) / 1e6, reps, [&] {
+          std::vector<std::uint32_t> indices;
+          converted = ConvertMeshAttributes(*ai_mesh, indices);
+        }));
+
+      if (!converted) {
+        return std::unexpected{converted.error()};
+      }
+    }
+
+    if (is_selected("GenerateMeshlets")) {
+      auto const indices{GetTriangleList(mesh)};
+      MeshData meshletized{mesh.positions, {}, {}, {}, {}, {}, {}, 0, {}};
+      std::expected<void, std::string> generated;
+      add_result(RunBenchmark(
+        "GenerateMeshlets", "Mtri/s",
+        static_cast<double>(indices.size() / 3) / 1e6, reps, [&] {
+          generated = GenerateMeshlets(indices, meshletized);
+        }));
+
+      if (!generated) {
+        return std::unexpected{generated.error()};
+      }
+    }
+  }
+
+  if (is_selected("DecodeTexture")) {
+    auto const scene{SynthesizeScene(kTextureParams, job_system)};
+
+    if (!scene) {
+      return std::unexpected{scene.error()};
+    }
+
+    auto const& tex{scene->textures.front()};
+    auto const megapixels{
+      static_cast<double>(tex.width) * static_cast<double>(tex.height) / 1e6
+    };
+
+    for (auto const& [name, encoding] : {
+           std::pair{"DecodeTexture/PNG", ImageEncoding::kPng},
+           std::pair{"DecodeTexture/JPEG", ImageEncoding::kJpeg}
+         }) {
+      if (!is_selected(name)) {
+        continue;
+      }
+
+      auto const encoded{EncodeImage(tex, encoding)};
+      std::expected<TextureData, std::string> decoded;
+      add_result(RunBenchmark(name, "Mpixel/s", megapixels, reps, [&] {
+        decoded = DecodeEncodedTexture(encoded);
+      }));
+
+      if (!decoded) {
+        return std::unexpected{decoded.error()};
+      }
+    }
+  }
+
+  if (is_selected("MakeInstanceCullingBounds")) {
+    auto const scene{SynthesizeScene(kInstanceParams, job_system)};
+
+    if (!scene) {
+      return std::unexpected{scene.error()};
+    }
+
+    // As done for every mesh in CreateGpuScene.
+    auto const& mesh{scene->meshes.front()};
+    InstanceCullingBounds bounds;
+    add_result(RunBenchmark(
+      "MakeInstanceCullingBounds", "Minst/s",
+      static_cast<double>(mesh.instances.size()) / 1e6, reps, [&] {
+        bounds = MakeInstanceCullingBounds(CalculateAabb(mesh.positions),
+                                           mesh.instances);
+      }));
+  }
+
+  for (auto const& [count_name, instance_count] : kCullingInstanceCounts) {
+    auto const name{std::format("CullInstances/{}", count_name)};
+
+    if (!is_selected(name)) {
+      continue;
+    }
+
+    auto const scene{
+      SynthesizeScene(
+        SceneSynthesisParams{1, instance_count, 1, 0.0f, false, 1, 0, 0, 1},
+        job_system)
+    };
+
+    if (!scene) {
+      return std::unexpected{scene.error()};
+    }
+
+    auto const& mesh{scene->meshes.front()};
+    auto const bounds{
+      MakeInstanceCullingBounds(CalculateAabb(mesh.positions), mesh.instances)
+    };
+    auto const frustum{ExtractFrustum(MakeInteriorViewProjMatrix())};
+    std::vector<std::uint32_t> visible_indices(instance_count);
+
+    // On the job system like in the renderer.
+    add_result(RunBenchmark(name, "Minst/s",
+                            static_cast<double>(instance_count) / 1e6, reps,
+                            [&] {
+                              std::ignore = CullInstances(
+                                job_system, frustum, bounds, visible_indices);
+                            }));
+  }
+
+  for (auto const& [count_name, instance_count] : kOcclusionInstanceCounts) {
+    auto const name{std::format("CullOccludedInstances/{}", count_name)};
+
+    if (!is_selected(name)) {
+      continue;
+    }
+
+    auto const scene{
+      SynthesizeScene(
+        SceneSynthesisParams{1, instance_count, 1, 0.0f, false, 1, 0, 0, 1},
+        job_system)
+    };
+
+    if (!scene) {
+      return std::unexpected{scene.error()};
+    }
+
+    auto const& mesh{scene->meshes.front()};
+    auto const bounds{
+      MakeInstanceCullingBounds(CalculateAabb(mesh.positions), mesh.instances)
+    };
+    auto const view_proj_mtx{MakeInteriorViewProjMatrix()};
+    std::vector<std::uint32_t> visible_indices(instance_count);
+    visible_indices.resize(CullInstances(job_system,
+                                         ExtractFrustum(view_proj_mtx), bounds,
+                                         visible_indices));
+
+    // The occluders are picked by the solid angle of their bounds as seen
+    // from the camera at the origin, like the renderer does.
+    auto const score{
+      [&bounds](std::uint32_t const idx) {
+        auto const ex{bounds.extent_x[idx]};
+        auto const ey{bounds.extent_y[idx]};
+        auto const ez{bounds.extent_z[idx]};
+        auto const cx{bounds.center_x[idx]};
+        auto const cy{bounds.center_y[idx]};
+        auto const cz{bounds.center_z[idx]};
+        return (ex * ex + ey * ey + ez * ez) / std::max(
+          cx * cx + cy * cy + cz * cz, 1e-6f);
+      }
+    };
+
+    auto occluder_indices{visible_indices};
+    auto const occluder_count{
+      std::min<std::size_t>(occluder_indices.size(), kOccluderCount)
+    };
+    std::ranges::partial_sort(occluder_indices,
+                              occluder_indices.begin() + occluder_count,
+                              std::ranges::greater{}, score);
+    occluder_indices.resize(occluder_count);
+
+    auto const triangle_indices{GetTriangleList(mesh)};
+    OcclusionBuffer occlusion_buffer;
+    std::size_t occluded_count{0};
+
+    add_result(RunBenchmark(
+      name, "Minst/s", static_cast<double>(visible_indices.size()) / 1e6,
+      reps, [&] {
+        occlusion_buffer.Clear(view_proj_mtx);
+
+        for (auto const idx : occluder_indices) {
+          occlusion_buffer.RasterizeOccluder(mesh.positions, triangle_indices,
+                                             mesh.instances[idx].model_mtx);
+        }
+
+        occlusion_buffer.BuildHierarchy();
+        occluded_count = 0;
+
+        for (auto const idx : visible_indices) {
+          occluded_count += !occlusion_buffer.IsVisible(
+            Float3{
+              bounds.center_x[idx], bounds.center_y[idx], bounds.center_z[idx]
+            },
+            Float3{
+              bounds.extent_x[idx], bounds.extent_y[idx], bounds.extent_z[idx]
+            });
+        }
+      }));
+
+    std::cout << std::format(
+      "{:<28} {:>12.1f} % of the instances in the frustum are occluded\n",
+      name, static_cast<double>(occluded_count) * 100.0 / static_cast<double>(
+        std::max<std::size_t>(visible_indices.size(), 1)));
+  }
+
+  for (auto const& [count_name, mesh_count] : kDrawMeshCounts) {
+    auto const plan_name{std::format("PlanDraws/{}", count_name)};
+    auto const record_name{
+      std::format("RecordDraws/DrawRecord/{}", count_name)
+    };
+    auto const inline_name{std::format("RecordDraws/Inline/{}", count_name)};
+    auto const build_name{std::format("BuildFrameDraws/{}", count_name)};
+
+    if (!is_selected(plan_name) && !is_selected(record_name) && !is_selected(
+      inline_name) && !is_selected(build_name)) {
+      continue;
+    }
+
+    // Varied resolutions give the meshes differently sized meshlets and so
+    // several dispatch chunks.
+    auto scene{
+      SynthesizeScene(
+        SceneSynthesisParams{
+          mesh_count, mesh_count * kDrawInstancesPerMesh, 24, 0.5f, true, 1, 0,
+          0, 1
+        }, job_system)
+    };
+
+    if (!scene) {
+      return std::unexpected{scene.error()};
+    }
+
+    // The dispatch chunks are planned at load time and the visible counts
+    // come from culling, as in the renderer.
+    auto const frustum{ExtractFrustum(MakeInteriorViewProjMatrix())};
+    std::vector<std::vector<MeshletDispatchChunk>> dispatch_chunks;
+    dispatch_chunks.reserve(mesh_count);
+    std::vector<MeshDrawSource> sources;
+    std::vector<std::uint32_t> visible_indices;
+    std::uint64_t command_count{0};
+
+    for (std::uint32_t i{0}; i < mesh_count; i++) {
+      auto& mesh{scene->meshes[i]};
+      SortMeshletsForPacking(mesh.meshlets, MESHLET_MAX_VERTS,
+                             MESHLET_MAX_PRIMS);
+      auto const& chunks{
+        dispatch_chunks.emplace_back(PlanMeshletDispatches(
+          mesh.meshlets, MESHLET_MAX_VERTS, MESHLET_MAX_PRIMS))
+      };
+
+      visible_indices.resize(mesh.instances.size());
+      auto const visible_count{
+        CullInstances(job_system, frustum,
+                      MakeInstanceCullingBounds(CalculateAabb(mesh.positions),
+                                                mesh.instances),
+                      visible_indices)
+      };
+      sources.emplace_back(chunks, visible_count, i);
+      command_count += CalculateMaxIndirectDrawCommandCount(
+        chunks, visible_count);
+    }
+
+    auto const command_millions{static_cast<double>(command_count) / 1e6};
+    auto const view_proj_mtx{MakeInteriorViewProjMatrix()};
+    std::array constexpr camera_pos{0.0f, 0.0f, 0.0f};
+    std::vector<DrawPartition> partitions;
+    std::vector<std::vector<IndirectDrawCommand>> partition_commands(
+      kMaxDrawPartitionCount);
+
+    if (is_selected(plan_name)) {
+      // Everything RecordDrawPartition does before recording, on one thread.
+      add_result(RunBenchmark(
+        plan_name, "Mcmd/s", command_millions, reps, [&] {
+          PartitionDraws(sources, kMaxDrawPartitionCount,
+                         kMinDrawPartitionCommandCount, partitions);
+
+          for (std::size_t i{0}; i < partitions.size(); i++) {
+            auto const& partition{partitions[i]};
+            auto& commands{partition_commands[i]};
+            commands.clear();
+
+            for (auto j{partition.first_mesh};
+                 j < partition.first_mesh + partition.mesh_count; j++) {
+              AppendIndirectDrawCommands(sources[j].draw_record_idx,
+                                         sources[j].dispatch_chunks,
+                                         sources[j].visible_instance_count,
+                                         commands);
+            }
+          }
+        }));
+
+      std::cout << std::format("{:<28} {:>12} commands in {} partitions\n",
+                               plan_name, command_count, partitions.size());
+    }
+
+    // The commands pass a draw record index, the frame wide DrawParams are set
+    // once per partition.
+    if (is_selected(record_name)) {
+      std::vector<IndirectDrawCommand> arguments(command_count);
+
+      add_result(RunBenchmark(
+        record_name, "Mcmd/s", command_millions, reps, [&] {
+          PartitionDraws(sources, kMaxDrawPartitionCount,
+                         kMinDrawPartitionCommandCount, partitions);
+
+          for (std::size_t i{0}; i < partitions.size(); i++) {
+            ArgumentBufferRecorder recorder{
+              arguments, partitions[i].first_command
+            };
+            RecordDrawPartition(recorder, view_proj_mtx, camera_pos,
+                                SceneDrawBindings{0, {}}, sources,
+                                partitions[i], partition_commands[i]);
+          }
+        }));
+
+      std::cout << std::format("{:<28} {:>12} argument bytes\n", record_name,
+                               command_count * sizeof(IndirectDrawCommand));
+    }
+
+    // Partitions are recorded on the job system like in the renderer, into
+    // recorders that keep the commands in memory instead of a command list.
+    if (is_selected(build_name)) {
+      std::vector<RecordingCommandRecorder> recorders(kMaxDrawPartitionCount);
+
+      add_result(RunBenchmark(
+        build_name, "Mcmd/s", command_millions, reps, [&] {
+          PartitionDraws(sources, kMaxDrawPartitionCount,
+                         kMinDrawPartitionCommandCount, partitions);
+          job_system.ParallelFor(
+            partitions.size(), 1,
+            [&](std::size_t const begin, std::size_t const end) {
+              for (auto i{begin}; i < end; i++) {
+                recorders[i].Reset();
+                RecordDrawPartition(recorders[i], view_proj_mtx, camera_pos,
+                                    SceneDrawBindings{0, {}}, sources,
+                                    partitions[i], partition_commands[i]);
+              }
+            });
+        }));
+
+      RecordedCommandStats frame_stats{0, 0, 0, 0, 0};
+
+      for (std::size_t i{0}; i < partitions.size(); i++) {
+        auto const stats{recorders[i].GetStats()};
+        frame_stats.command_count += stats.command_count;
+        frame_stats.dispatch_count += stats.dispatch_count;
+        frame_stats.thread_group_count += stats.thread_group_count;
+        frame_stats.argument_byte_count += stats.argument_byte_count;
+      }
+
+      std::cout << std::format(
+        "{:<28} {:>12} recorded commands, {} dispatches, {} thread groups, "
+        "{} argument bytes\n", build_name, frame_stats.command_count,
+        frame_stats.dispatch_count, frame_stats.thread_group_count,
+        frame_stats.argument_byte_count);
+    }
+
+    // The commands carry the buffer indices of their mesh.
+    if (is_selected(inline_name)) {
+      std::vector<std::array<std::uint32_t, 10>> mesh_bindings(mesh_count);
+
+      for (std::uint32_t i{0}; i < mesh_count; i++) {
+        std::iota(mesh_bindings[i].begin(), mesh_bindings[i].end(), i * 10);
+      }
+
+      std::vector<InlineBindingsDrawCommand> arguments(command_count);
+      std::vector<InlineBindingsDrawCommand> commands;
+
+      add_result(RunBenchmark(
+        inline_name, "Mcmd/s", command_millions, reps, [&] {
+          PartitionDraws(sources, kMaxDrawPartitionCount,
+                         kMinDrawPartitionCommandCount, partitions);
+
+          for (auto const& partition : partitions) {
+            commands.clear();
+
+            for (auto j{partition.first_mesh};
+                 j < partition.first_mesh + partition.mesh_count; j++) {
+              auto const instance_count{sources[j].visible_instance_count};
+
+              for (auto const& chunk : sources[j].dispatch_chunks) {
+                for (std::uint32_t k{0};
+                     k < GetDispatchCount(chunk, instance_count); k++) {
+                  auto const [instance_offset, dispatch_instance_count,
+                    group_count]{
+                    PlanInstanceDispatch(chunk, instance_count, k)
+                  };
+                  commands.emplace_back(
+                    std::array{
+                      chunk.instances_per_group, chunk.meshlet_offset,
+                      dispatch_instance_count, instance_offset
+                    }, mesh_bindings[j],
+                    DispatchMeshArguments{group_count, 1, 1});
+                }
+              }
+            }
+
+            std::ranges::copy(commands,
+                              arguments.begin() + partition.first_command);
+          }
+        }));
+
+      std::cout << std::format("{:<28} {:>12} argument bytes\n", inline_name,
+                               command_count * sizeof(
+                                 InlineBindingsDrawCommand));
+    }
+  }
+
+  for (auto const& [count_name, instance_count] : kBvhInstanceCounts) {
+    auto const build_name{std::format("BuildBvh/{}", count_name)};
+    auto const query_name{std::format("QueryBvh/{}", count_name)};
+
+    if (!is_selected(build_name) && !is_selected(query_name)) {
+      continue;
+    }
+
+    auto const scene{
+      SynthesizeScene(
+        SceneSynthesisParams{1, instance_count, 1, 0.0f, false, 1, 0, 0, 1},
+        job_system)
+    };
+
+    if (!scene) {
+      return std::unexpected{scene.error()};
+    }
+
+    auto const instance_millions{static_cast<double>(instance_count) / 1e6};
+
+    if (is_selected(build_name)) {
+      BvhData bvh;
+      add_result(RunBenchmark(build_name, "Minst/s", instance_millions, reps,
+                              [&] {
+                                bvh = BuildBvh(*scene);
+                              }));
+    }
+
+    if (is_selected(query_name)) {
+      auto const frustum{ExtractFrustum(MakeInteriorViewProjMatrix())};
+      std::vector<BvhInstanceRef> refs;
+      refs.reserve(instance_count);
+      add_result(RunBenchmark(query_name, "Minst/s", instance_millions, reps,
+                              [&] {
+                                refs.clear();
+                                QueryBvh(scene->bvh, frustum,
+                                         [&refs](BvhInstanceRef const& ref) {
+                                           refs.emplace_back(ref);
+                                         });
+                              }));
+    }
+  }
+
+  auto const job_millions{static_cast<double>(kSchedulingJobCount) / 1e6};
+
+  if (is_selected("JobSystem/Run")) {
+    add_result(RunBenchmark("JobSystem/Run", "Mjob/s", job_millions, reps,
+                            [&] {
+                              JobCounter counter;
+
+                              for (std::uint32_t i{0}; i < kSchedulingJobCount;
+                                   i++) {
+                                job_system.Run([] {}, &counter);
+                              }
+
+                              job_system.Wait(counter);
+                            }));
+  }
+
+  if (is_selected("JobSystem/ParallelFor")) {
+    add_result(RunBenchmark("JobSystem/ParallelFor", "Mjob/s", job_millions,
+                            reps, [&] {
+                              job_system.ParallelFor(
+                                kSchedulingJobCount, 1,
+                                []([[maybe_unused]] std::size_t const begin,
+                                   [[maybe_unused]] std::size_t const end) {});
+                            }));
+  }
+
+  // Every job is queued by the one before it as it finishes.
+  if (is_selected("JobSystem/Chain")) {
+    std::vector<JobHandle> handles(kSchedulingJobCount);
+    add_result(RunBenchmark("JobSystem/Chain", "Mjob/s", job_millions, reps,
+                            [&] {
+                              JobCounter counter;
+
+                              for (std::uint32_t i{0}; i < kSchedulingJobCount;
+                                   i++) {
+                                handles[i] = job_system.Run(
+                                  [] {}, &counter,
+                                  std::span{handles}.subspan(i == 0 ? 0 : i - 1,
+                                                             i == 0 ? 0 : 1));
+                              }
+
+                              job_system.Wait(counter);
+                            }));
+  }
+
+  if (is_selected("DescriptorChurn")) {
+    // Mostly single descriptors with the occasional table, half of the heap
+    // in use so that the free ranges are fragmented.
+    DescriptorAllocator allocator{kDescriptorHeapSize};
+    std::vector<std::uint32_t> allocations;
+    std::uint32_t rng{12345};
+
+    auto const next_random{
+      [&rng] {
+        rng = rng * 1664525u + 1013904223u;
+        return rng >> 8;
+      }
+    };
+
+    auto const churn{
+      [&](std::uint32_t const op_count, bool const is_filling) {
+        for (std::uint32_t i{0}; i < op_count; i++) {
+          if (allocations.empty() || is_filling || next_random() % 2 == 0) {
+            auto const count{next_random() % 16 == 0 ? 64 : 1};
+
+            if (auto const first{allocator.Allocate(count)}) {
+              allocations.emplace_back(*first);
+            }
+          } else {
+            auto const idx{next_random() % allocations.size()};
+            allocator.Free(allocations[idx]);
+            allocations[idx] = allocations.back();
+            allocations.pop_back();
+          }
+        }
+      }
+    };
+
+    churn(kDescriptorHeapSize / 10, true);
+    churn(kDescriptorChurnOpCount, false);
+
+    add_result(RunBenchmark(
+      "DescriptorChurn", "Mop/s",
+      static_cast<double>(kDescriptorChurnOpCount) / 1e6, reps, [&] {
+        churn(kDescriptorChurnOpCount, false);
+      }));
+  }
+
+  return results;
+}
+}
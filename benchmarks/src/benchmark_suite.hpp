@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+#include <expected>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "benchmark_report.hpp"
+#include "job_system.hpp"
+
+namespace pensieve {
+struct BenchmarkSuiteOptions {
+  // Timed calls of every benchmark after an untimed warm up call.
+  std::uint32_t repetition_count;
+  // Only the benchmarks whose name contains the filter are run.
+  std::string filter;
+  // Where the scene file of the loading benchmarks is written.
+  std::filesystem::path scratch_dir;
+};
+
+// Runs the benchmarks on synthesized scenes in a fixed order and prints every
+// result as it completes. The job system synthesizes the scenes, culls the
+// instances and records the draw partitions as in the renderer and runs the
+// empty jobs of the scheduling benchmarks, the other benchmarked functions run
+// on the calling thread.
+[[nodiscard]] auto RunBenchmarkSuite(BenchmarkSuiteOptions const& options,
+                                     JobSystem& job_system) -> std::expected<
+  std::vector<BenchmarkResult>, std::string>;
+}
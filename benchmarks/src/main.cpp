@@ -0,0 +1,212 @@
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <cstdlib>
+#include <expected>
+#include <filesystem>
+#include <format>
+#include <iostream>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+#include "benchmark_report.hpp"
+#include "benchmark_suite.hpp"
+#include "job_system.hpp"
+
+namespace pensieve {
+namespace {
+struct ReportPaths {
+  std::filesystem::path baseline;
+  std::filesystem::path current;
+};
+
+struct Options {
+  BenchmarkSuiteOptions suite;
+  std::optional<std::filesystem::path> output_path;
+  // Compares the two reports instead of running the benchmarks.
+  std::optional<ReportPaths> compare_paths;
+  // Drop in throughput, in percent, above which a benchmark regressed.
+  double threshold_percent;
+};
+
+template<typename T>
+[[nodiscard]] auto ParseNumber(std::string_view const arg,
+                               std::string_view const value) ->
+  std::expected<T, std::string> {
+  T ret;
+
+  if (auto const [ptr, ec]{
+    std::from_chars(value.data(), value.data() + value.size(), ret)
+  }; ec != std::errc{} || ptr != value.data() + value.size()) {
+    return std::unexpected{std::format("Invalid value {} for {}.", value, arg)};
+  }
+
+  return ret;
+}
+
+[[nodiscard]] auto ParseOptions(
+  std::span<char* const> const args) -> std::expected<Options, std::string> {
+  Options opts{
+    {5, {}, std::filesystem::temp_directory_path()}, std::nullopt,
+    std::nullopt, 5.0
+  };
+
+  for (std::size_t i{1}; i < args.size(); i++) {
+    std::string_view const arg{args[i]};
+
+    if (i + 1 >= args.size()) {
+      return std::unexpected{std::format("Missing value for {}.", arg)};
+    }
+
+    std::string_view const value{args[++i]};
+
+    if (arg == "--compare") {
+      if (i + 1 >= args.size()) {
+        return std::unexpected{"--compare takes two reports."};
+      }
+
+      opts.compare_paths = ReportPaths{value, args[++i]};
+    } else if (arg == "--repetitions") {
+      auto const count{ParseNumber<std::uint32_t>(arg, value)};
+
+      if (!count) {
+        return std::unexpected{count.error()};
+      }
+
+      if (*count == 0) {
+        return std::unexpected{"--repetitions must be positive."};
+      }
+
+      opts.suite.repetition_count = *count;
+    } else if (arg == "--threshold") {
+      auto const threshold{ParseNumber<double>(arg, value)};
+
+      if (!threshold) {
+        return std::unexpected{threshold.error()};
+      }
+
+      opts.threshold_percent = *threshold;
+    } else if (arg == "--filter") {
+      opts.suite.filter = value;
+    } else if (arg == "--output") {
+      opts.output_path = value;
+    } else if (arg == "--scratch-dir") {
+      opts.suite.scratch_dir = value;
+    } else {
+      return std::unexpected{std::format("Unknown option {}.", arg)};
+    }
+  }
+
+  return opts;
+}
+
+[[nodiscard]] auto FormatThroughput(
+  std::optional<double> const throughput) -> std::string {
+  return throughput ? std::format("{:.3f}", *throughput) : "-";
+}
+
+// Prints a table of the comparisons and returns the number of regressions.
+[[nodiscard]] auto CompareReports(ReportPaths const& paths,
+                                  double const threshold_percent) ->
+  std::expected<std::size_t, std::string> {
+  auto const baseline{ReadBenchmarkReport(paths.baseline)};
+
+  if (!baseline) {
+    return std::unexpected{baseline.error()};
+  }
+
+  auto const current{ReadBenchmarkReport(paths.current)};
+
+  if (!current) {
+    return std::unexpected{current.error()};
+  }
+
+  auto const comparisons{
+    CompareBenchmarkResults(*baseline, *current, threshold_percent)
+  };
+
+  std::size_t name_width{9};
+
+  for (auto const& comparison : comparisons) {
+    name_width = std::max(name_width, comparison.name.size());
+  }
+
+  std::cout << std::format("{:<{}} {:>12} {:>12} {:<8} {:>9}\n", "Benchmark",
+                           name_width, "Baseline", "Current", "Unit",
+                           "Change");
+  std::size_t regression_count{0};
+
+  for (auto const& [name, unit, baseline_throughput, current_throughput,
+         change_percent, is_regression] : comparisons) {
+    std::cout << std::format(
+      "{:<{}} {:>12} {:>12} {:<8} {:>9}{}\n", name, name_width,
+      FormatThroughput(baseline_throughput),
+      FormatThroughput(current_throughput), unit,
+      change_percent ? std::format("{:+.1f}%", *change_percent) : "-",
+      is_regression ? "  REGRESSION" : "");
+    regression_count += is_regression ? 1 : 0;
+  }
+
+  return regression_count;
+}
+}
+}
+
+auto main(int const argc, char** const argv) -> int {
+  if (argc == 2) {
+    std::cout << "Usage: benchmarks [--repetitions N] [--filter <name-part>] "
+      "[--output <report-file>] [--scratch-dir <dir>]\n"
+      "       benchmarks --compare <baseline-report> <current-report> "
+      "[--threshold <percent>]\n";
+    return EXIT_SUCCESS;
+  }
+
+  auto const opts{pensieve::ParseOptions(std::span{argv, argv + argc})};
+
+  if (!opts) {
+    std::cerr << "Error: " << opts.error() << '\n';
+    return EXIT_FAILURE;
+  }
+
+  if (opts->compare_paths) {
+    auto const regression_count{
+      pensieve::CompareReports(*opts->compare_paths, opts->threshold_percent)
+    };
+
+    if (!regression_count) {
+      std::cerr << "Error: " << regression_count.error() << '\n';
+      return EXIT_FAILURE;
+    }
+
+    if (*regression_count != 0) {
+      std::cout << std::format("Regressions over {}%: {}\n",
+                               opts->threshold_percent, *regression_count);
+      return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+  }
+
+  pensieve::JobSystem job_system;
+  auto const results{pensieve::RunBenchmarkSuite(opts->suite, job_system)};
+
+  if (!results) {
+    std::cerr << "Error: " << results.error() << '\n';
+    return EXIT_FAILURE;
+  }
+
+  if (opts->output_path) {
+    if (auto const exp{
+      pensieve::WriteBenchmarkReport(*opts->output_path, *results)
+    }; !exp) {
+      std::cerr << "Error: " << exp.error() << '\n';
+      return EXIT_FAILURE;
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
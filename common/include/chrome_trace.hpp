@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <expected>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+namespace pensieve {
+// A span of time on a thread, written as a complete event.
+struct ChromeTraceEvent {
+  std::string_view name;
+  std::string_view category;
+  std::uint32_t thread_id;
+  // Nanoseconds on any clock shared by all events of the trace.
+  std::uint64_t begin_ns;
+  std::uint64_t duration_ns;
+  std::optional<std::uint64_t> frame_idx;
+};
+
+struct ChromeTraceThread {
+  std::uint32_t id;
+  std::string_view name;
+};
+
+// Writes the events in the Chrome trace event format that chrome://tracing
+// and Perfetto open. Timestamps are shifted to start at the earliest event.
+[[nodiscard]] auto WriteChromeTrace(std::filesystem::path const& path,
+                                    std::span<ChromeTraceEvent const> events,
+                                    std::span<ChromeTraceThread const> threads)
+  -> std::expected<void, std::string>;
+}
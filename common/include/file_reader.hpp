@@ -0,0 +1,113 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <filesystem>
+#include <memory>
+#include <new>
+#include <span>
+#include <string>
+
+namespace pensieve {
+// Direct I/O transfers whole blocks between block aligned memory and block
+// aligned file offsets. 4 KiB covers both 512 byte and 4 KiB sector drives.
+inline constexpr std::size_t kFileReadAlignment{4096};
+
+[[nodiscard]] constexpr auto GetFileReadBufferSize(
+  std::uint64_t const file_size) -> std::uint64_t {
+  return (file_size + kFileReadAlignment - 1) / kFileReadAlignment *
+    kFileReadAlignment;
+}
+
+static_assert(GetFileReadBufferSize(0) == 0);
+static_assert(GetFileReadBufferSize(1) == kFileReadAlignment);
+static_assert(GetFileReadBufferSize(kFileReadAlignment + 1) ==
+  2 * kFileReadAlignment);
+
+// Lets large buffers be backed by 2 MiB pages, so faulting in a freshly
+// allocated buffer takes one fault per 2 MiB instead of one per 4 KiB.
+inline constexpr std::size_t kFileReadBufferAlignment{2u << 20};
+
+struct AlignedBufferDeleter {
+  auto operator()(std::byte* const ptr) const -> void {
+    ::operator delete[](ptr, std::align_val_t{kFileReadBufferAlignment});
+  }
+};
+
+using FileReadBuffer = std::unique_ptr<std::byte[], AlignedBufferDeleter>;
+
+// Holds a file of the given size. The memory is not touched, so pages are
+// only committed once reads land in them.
+[[nodiscard]] auto AllocateFileReadBuffer(
+  std::uint64_t file_size) -> FileReadBuffer;
+
+enum class FileReadBackend {
+  // Synchronous reads of one chunk at a time.
+  kPread,
+  // Keeps up to the queue depth of chunk reads in flight. Falls back to
+  // pread if the kernel does not support io_uring or it is disabled.
+  kIoUring,
+};
+
+struct FileReadOptions {
+  // Bytes per read. Must be a multiple of kFileReadAlignment.
+  std::uint32_t chunk_size;
+  std::uint32_t queue_depth;
+  // Bypasses the page cache with O_DIRECT. File systems without direct I/O
+  // support, e.g. tmpfs, are read through the cache instead.
+  bool direct_io;
+};
+
+inline constexpr FileReadOptions kDefaultFileReadOptions{1u << 20, 32, false};
+
+// Reads a whole file into a caller provided buffer. Reads may complete in any
+// order, the reader publishes the prefix of the file whose reads have all
+// completed, so decoding can start before the file has arrived.
+class FileReader {
+public:
+  virtual ~FileReader() = default;
+
+  [[nodiscard]] virtual auto GetSize() const -> std::uint64_t = 0;
+
+  // Starts reading into the buffer, which must be aligned to
+  // kFileReadAlignment, hold GetFileReadBufferSize(GetSize()) bytes and
+  // outlive the reader. Must be called once.
+  [[nodiscard]] virtual auto Start(
+    std::span<std::byte> buffer) -> std::expected<void, std::string> = 0;
+
+  // Blocks until at least the first byte_count bytes of the file, or the
+  // whole file if it is shorter, are in the buffer. Returns the number of
+  // bytes at the start of the buffer that are ready.
+  [[nodiscard]] virtual auto WaitForPrefix(
+    std::uint64_t byte_count) -> std::expected<std::uint64_t, std::string> = 0;
+};
+
+// Only available on Linux.
+[[nodiscard]] auto OpenFileReader(std::filesystem::path const& path,
+                                  FileReadBackend backend,
+                                  FileReadOptions const& options) ->
+  std::expected<std::unique_ptr<FileReader>, std::string>;
+
+// A read only private mapping of a whole file. Only available on Linux.
+class MappedFile {
+public:
+  [[nodiscard]] static auto Open(
+    std::filesystem::path const& path) -> std::expected<MappedFile, std::string>;
+
+  MappedFile(MappedFile const& other) = delete;
+  MappedFile(MappedFile&& other) noexcept;
+
+  ~MappedFile();
+
+  auto operator=(MappedFile const& other) -> void = delete;
+  auto operator=(MappedFile&& other) -> void = delete;
+
+  [[nodiscard]] auto GetBytes() const -> std::span<std::byte const>;
+
+private:
+  explicit MappedFile(std::span<std::byte const> bytes);
+
+  std::span<std::byte const> bytes_;
+};
+}
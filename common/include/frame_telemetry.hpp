@@ -0,0 +1,141 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace pensieve {
+enum class FrameStage : std::uint8_t {
+  kRecord,
+  kSubmit,
+  kPresent,
+  kFenceWait,
+  kGpu
+};
+
+inline constexpr std::size_t kFrameStageCount{5};
+
+inline constexpr std::array<std::string_view, kFrameStageCount>
+kFrameStageNames{"Record", "Submit", "Present", "Fence wait", "GPU"};
+
+struct FrameStageSample {
+  std::uint64_t frame_idx;
+  FrameStage stage;
+  std::chrono::steady_clock::time_point begin;
+  std::chrono::nanoseconds duration;
+};
+
+// The span of a frame's GPU work on the CPU clock.
+struct GpuFrameSpan {
+  std::chrono::steady_clock::time_point begin;
+  std::chrono::nanoseconds duration;
+};
+
+// Reports when the GPU executed the work of a frame, e.g. from timestamp
+// queries of a graphics API.
+class GpuTimestampSource {
+public:
+  virtual ~GpuTimestampSource() = default;
+
+  // Called once the GPU work of the frame completed. Returns nothing if the
+  // frame has no timestamps.
+  [[nodiscard]] virtual auto ReadFrameSpan(
+    std::uint64_t frame_idx) -> std::optional<GpuFrameSpan> = 0;
+};
+
+struct DurationPercentiles {
+  std::uint64_t sample_count;
+  std::chrono::nanoseconds p50;
+  std::chrono::nanoseconds p95;
+  std::chrono::nanoseconds p99;
+};
+
+// Nearest rank percentiles. Sorts the durations.
+[[nodiscard]] constexpr auto CalculatePercentiles(
+  std::span<std::chrono::nanoseconds> const durations) -> DurationPercentiles {
+  if (durations.empty()) {
+    return DurationPercentiles{0, {}, {}, {}};
+  }
+
+  std::ranges::sort(durations);
+
+  auto const at_percentile{
+    [durations](std::size_t const percentile) {
+      auto const rank{(percentile * durations.size() + 99) / 100};
+      return durations[std::max<std::size_t>(rank, 1) - 1];
+    }
+  };
+
+  return DurationPercentiles{
+    durations.size(), at_percentile(50), at_percentile(95), at_percentile(99)
+  };
+}
+
+// Single producer ring that other threads can copy without blocking the
+// producer. Every slot is guarded by a sequence number, samples overwritten
+// while being copied are left out.
+class FrameStageSampleRing {
+public:
+  explicit FrameStageSampleRing(std::size_t capacity);
+
+  // Must only be called by one thread at a time.
+  auto Push(FrameStageSample const& sample) -> void;
+
+  // Appends the retained samples oldest first.
+  auto CopySamples(std::vector<FrameStageSample>& samples) const -> void;
+
+private:
+  struct Slot {
+    // Odd while the slot is being written.
+    std::atomic<std::uint64_t> sequence{0};
+    std::atomic<std::uint64_t> frame_idx{0};
+    std::atomic<std::int64_t> begin_ns{0};
+    std::atomic<std::int64_t> duration_ns{0};
+    std::atomic<FrameStage> stage{FrameStage::kRecord};
+  };
+
+  std::unique_ptr<Slot[]> slots_;
+  std::size_t capacity_;
+  std::atomic<std::uint64_t> push_count_{0};
+};
+
+// Collects the CPU stage timings of the recent frames and the GPU timings
+// reported by a timestamp source.
+class FrameTelemetry {
+public:
+  explicit FrameTelemetry(std::size_t sample_capacity);
+
+  // Must only be called by the thread drawing the frames.
+  auto RecordStage(std::uint64_t frame_idx, FrameStage stage,
+                   std::chrono::steady_clock::time_point begin,
+                   std::chrono::steady_clock::time_point end) -> void;
+
+  // Records the GPU span of a completed frame if the source has one. Must
+  // only be called by the thread drawing the frames.
+  auto RecordGpuFrame(GpuTimestampSource& source,
+                      std::uint64_t frame_idx) -> void;
+
+  // Percentiles of every stage over the retained samples, indexed by stage.
+  [[nodiscard]] auto CalculateStatistics() const -> std::array<
+    DurationPercentiles, kFrameStageCount>;
+
+  // The CPU stages are on one track and the GPU on another.
+  [[nodiscard]] auto WriteChromeTrace(
+    std::filesystem::path const& path) const -> std::expected<
+    void, std::string>;
+
+private:
+  FrameStageSampleRing samples_;
+};
+}
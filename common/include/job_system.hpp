@@ -0,0 +1,133 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+namespace pensieve {
+namespace detail {
+struct Job;
+}
+
+// Counts the unfinished jobs it was passed to. Must outlive them.
+class JobCounter {
+public:
+  [[nodiscard]] auto IsDone() const -> bool;
+
+private:
+  friend class JobSystem;
+
+  std::atomic<std::uint32_t> count_{0};
+};
+
+// Refers to a scheduled job so that other jobs can depend on it.
+class JobHandle {
+public:
+  JobHandle() = default;
+
+private:
+  friend class JobSystem;
+
+  explicit JobHandle(std::shared_ptr<detail::Job> job);
+
+  std::shared_ptr<detail::Job> job_;
+};
+
+// Runs jobs on worker threads that each own a deque. Workers take their own
+// newest jobs first and steal the oldest jobs of the others when they run
+// out. Threads waiting for jobs run queued jobs instead of blocking, so
+// waits can be nested in jobs. Jobs must not throw.
+class JobSystem {
+public:
+  // Uses one thread less than the hardware has, as the thread creating the
+  // jobs usually waits for them.
+  JobSystem();
+  explicit JobSystem(unsigned worker_count);
+
+  JobSystem(JobSystem const& other) = delete;
+  JobSystem(JobSystem&& other) = delete;
+
+  // Every job must have finished.
+  ~JobSystem();
+
+  auto operator=(JobSystem const& other) -> void = delete;
+  auto operator=(JobSystem&& other) -> void = delete;
+
+  // Queues the job once every dependency has finished. The counter is
+  // incremented right away and decremented once the job finished.
+  auto Run(std::function<void()> job, JobCounter* counter = nullptr,
+           std::span<JobHandle const> dependencies = {}) -> JobHandle;
+
+  // Runs queued jobs until the counter reaches zero.
+  auto Wait(JobCounter const& counter) -> void;
+
+  // Calls fn(begin, end) for consecutive ranges of at most grain_size indices
+  // covering [0, count) and waits for all of them. The calling thread takes
+  // the last range.
+  template <typename Fn>
+  auto ParallelFor(std::size_t count, std::size_t grain_size,
+                   Fn const& fn) -> void;
+
+  [[nodiscard]] auto GetWorkerCount() const -> unsigned;
+
+private:
+  struct WorkerQueue {
+    std::mutex mutex;
+    std::deque<std::shared_ptr<detail::Job>> jobs;
+  };
+
+  auto WorkerMain(std::size_t queue_idx) -> void;
+  auto Enqueue(std::shared_ptr<detail::Job> job) -> void;
+  // Pops from the queue of the calling worker, then steals from the others.
+  [[nodiscard]] auto TryRunJob() -> bool;
+  auto Execute(detail::Job& job) -> void;
+
+  // The last queue takes the jobs of threads that are not workers.
+  std::vector<std::unique_ptr<WorkerQueue>> queues_;
+  std::vector<std::thread> workers_;
+  std::atomic<std::uint32_t> queued_job_count_{0};
+  // Lets Enqueue skip the lock and notification while every worker is busy.
+  std::atomic<std::uint32_t> sleeping_worker_count_{0};
+  std::mutex sleep_mutex_;
+  std::condition_variable wake_cv_;
+  bool is_stopping_{false};
+};
+
+template <typename Fn>
+auto JobSystem::ParallelFor(std::size_t const count,
+                            std::size_t const grain_size,
+                            Fn const& fn) -> void {
+  if (count == 0) {
+    return;
+  }
+
+  struct Range {
+    Fn const* fn;
+    std::size_t size;
+  };
+
+  Range const range{&fn, std::max<std::size_t>(grain_size, 1)};
+  auto const last_begin{(count - 1) / range.size * range.size};
+  JobCounter counter;
+
+  // Two pointers fit into the small buffer of std::function, so the jobs do
+  // not allocate their callables.
+  for (std::size_t begin{0}; begin < last_begin; begin += range.size) {
+    Run([&range, begin] {
+      (*range.fn)(begin, begin + range.size);
+    }, &counter);
+  }
+
+  fn(last_begin, count);
+  Wait(counter);
+}
+}
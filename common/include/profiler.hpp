@@ -0,0 +1,62 @@
+#pragma once
+
+#include <chrono>
+#include <expected>
+#include <filesystem>
+#include <string>
+#include <string_view>
+
+namespace pensieve {
+// Zones are only recorded if PENSIEVE_ENABLE_PROFILER is defined for the
+// translation unit that opens them.
+inline constexpr bool kProfilerEnabled{
+#ifdef PENSIEVE_ENABLE_PROFILER
+  true
+#else
+  false
+#endif
+};
+
+// Records the time between construction and destruction into the buffer of
+// the current thread. The name must outlive the process, e.g. a literal.
+class ProfileZone {
+public:
+  explicit ProfileZone(std::string_view name);
+  ~ProfileZone();
+
+  ProfileZone(ProfileZone const& other) = delete;
+  ProfileZone(ProfileZone&& other) = delete;
+
+  auto operator=(ProfileZone const& other) -> void = delete;
+  auto operator=(ProfileZone&& other) -> void = delete;
+
+private:
+  std::string_view name_;
+  std::chrono::steady_clock::time_point begin_;
+};
+
+// Names the track of the current thread in the trace.
+auto SetProfilerThreadName(std::string name) -> void;
+
+// Writes the zones of all threads recorded so far. Zones that are still open
+// are left out.
+[[nodiscard]] auto WriteProfilerTrace(
+  std::filesystem::path const& path) -> std::expected<void, std::string>;
+
+// A table of the call count, total, mean and maximum time of every zone name,
+// sorted by total time. Nested zones are included in the time of their
+// parents.
+[[nodiscard]] auto FormatProfilerSummary() -> std::string;
+}
+
+#define PENSIEVE_PROFILE_CONCAT_IMPL(a, b) a##b
+#define PENSIEVE_PROFILE_CONCAT(a, b) PENSIEVE_PROFILE_CONCAT_IMPL(a, b)
+
+#ifdef PENSIEVE_ENABLE_PROFILER
+// Profiles the rest of the enclosing scope.
+#define PENSIEVE_PROFILE_ZONE(name) \
+  ::pensieve::ProfileZone const PENSIEVE_PROFILE_CONCAT( \
+    pensieve_profile_zone_, __LINE__){name}
+#else
+#define PENSIEVE_PROFILE_ZONE(name) static_cast<void>(0)
+#endif
@@ -0,0 +1,90 @@
+#include "chrome_trace.hpp"
+
+#include <algorithm>
+#include <format>
+#include <fstream>
+
+namespace pensieve {
+namespace {
+// Writes the string as a JSON string literal.
+auto WriteJsonString(std::ofstream& out, std::string_view const str) -> void {
+  out << '"';
+
+  for (auto const c : str) {
+    if (c == '"' || c == '\\') {
+      out << '\\' << c;
+    } else if (static_cast<unsigned char>(c) < 0x20) {
+      out << std::format("\\u{:04x}", static_cast<unsigned>(c));
+    } else {
+      out << c;
+    }
+  }
+
+  out << '"';
+}
+
+// Trace timestamps are microseconds.
+[[nodiscard]] auto FormatMicroseconds(std::uint64_t const ns) -> std::string {
+  return std::format("{}.{:03}", ns / 1000, ns % 1000);
+}
+}
+
+auto WriteChromeTrace(std::filesystem::path const& path,
+                      std::span<ChromeTraceEvent const> const events,
+                      std::span<ChromeTraceThread const> const threads) ->
+  std::expected<void, std::string> {
+  std::ofstream out{path, std::ios::out | std::ios::trunc};
+
+  if (!out.is_open()) {
+    return std::unexpected{
+      std::format("Failed to open {} for writing.", path.string())
+    };
+  }
+
+  auto const trace_begin_ns{
+    events.empty()
+      ? 0
+      : std::ranges::min(events, {}, &ChromeTraceEvent::begin_ns).begin_ns
+  };
+
+  out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  auto is_first{true};
+
+  for (auto const& [id, name] : threads) {
+    out << (is_first ? "\n" : ",\n");
+    out << std::format(
+      R"({{"name":"thread_name","ph":"M","pid":0,"tid":{},"args":{{"name":)",
+      id);
+    WriteJsonString(out, name);
+    out << "}}";
+    is_first = false;
+  }
+
+  for (auto const& event : events) {
+    out << (is_first ? "\n" : ",\n");
+    out << "{\"name\":";
+    WriteJsonString(out, event.name);
+    out << ",\"cat\":";
+    WriteJsonString(out, event.category);
+    out << std::format(R"(,"ph":"X","pid":0,"tid":{},"ts":{},"dur":{})",
+                       event.thread_id,
+                       FormatMicroseconds(event.begin_ns - trace_begin_ns),
+                       FormatMicroseconds(event.duration_ns));
+
+    if (event.frame_idx) {
+      out << std::format(R"(,"args":{{"frame":{}}})", *event.frame_idx);
+    }
+
+    out << '}';
+    is_first = false;
+  }
+
+  out << "\n]}\n";
+
+  if (!out) {
+    return std::unexpected{std::format("Failed to write {}.", path.string())};
+  }
+
+  return {};
+}
+}
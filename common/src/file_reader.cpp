@@ -0,0 +1,613 @@
+#include "file_reader.hpp"
+
+#include <algorithm>
+#include <format>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace pensieve {
+#ifdef __linux__
+namespace {
+[[nodiscard]] auto FormatErrno(int const err) -> std::string {
+  return std::error_code{err, std::system_category()}.message();
+}
+
+// Owns a file descriptor.
+class FileDescriptor {
+public:
+  explicit FileDescriptor(int const fd) : fd_{fd} {}
+
+  FileDescriptor(FileDescriptor const& other) = delete;
+
+  FileDescriptor(FileDescriptor&& other) noexcept :
+    fd_{std::exchange(other.fd_, -1)} {}
+
+  ~FileDescriptor() {
+    if (fd_ >= 0) {
+      close(fd_);
+    }
+  }
+
+  auto operator=(FileDescriptor const& other) -> void = delete;
+  auto operator=(FileDescriptor&& other) -> void = delete;
+
+  [[nodiscard]] auto Get() const -> int {
+    return fd_;
+  }
+
+private:
+  int fd_;
+};
+
+struct OpenedFile {
+  FileDescriptor fd;
+  std::uint64_t size;
+  bool is_direct;
+};
+
+[[nodiscard]] auto OpenForReading(std::filesystem::path const& path,
+                                  bool const direct_io) -> std::expected<
+  OpenedFile, std::string> {
+  auto fd{direct_io ? open(path.c_str(), O_RDONLY | O_CLOEXEC | O_DIRECT) : -1};
+  auto const is_direct{fd >= 0};
+
+  // File systems without direct I/O reject the flag with EINVAL.
+  if (!is_direct) {
+    fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  }
+
+  if (fd < 0) {
+    return std::unexpected{
+      std::format("Failed to open file {}: {}", path.string(),
+                  FormatErrno(errno))
+    };
+  }
+
+  FileDescriptor file{fd};
+  struct stat stats;
+
+  if (fstat(fd, &stats) != 0) {
+    return std::unexpected{
+      std::format("Failed to query the size of {}: {}", path.string(),
+                  FormatErrno(errno))
+    };
+  }
+
+  if (!is_direct) {
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+  }
+
+  return OpenedFile{
+    std::move(file), static_cast<std::uint64_t>(stats.st_size), is_direct
+  };
+}
+
+[[nodiscard]] auto ValidateBuffer(std::span<std::byte> const buffer,
+                                  std::uint64_t const file_size) ->
+  std::expected<void, std::string> {
+  if (reinterpret_cast<std::uintptr_t>(buffer.data()) % kFileReadAlignment !=
+    0 || buffer.size() < GetFileReadBufferSize(file_size)) {
+    return std::unexpected{"File read buffer is misaligned or too small."};
+  }
+
+  return {};
+}
+
+// Reads one chunk after the other on the calling thread.
+class PreadFileReader final : public FileReader {
+public:
+  PreadFileReader(OpenedFile file, std::uint32_t const chunk_size) :
+    file_{std::move(file)}, chunk_size_{chunk_size} {}
+
+  [[nodiscard]] auto GetSize() const -> std::uint64_t override {
+    return file_.size;
+  }
+
+  [[nodiscard]] auto Start(
+    std::span<std::byte> const buffer) -> std::expected<
+    void, std::string> override {
+    if (auto const exp{ValidateBuffer(buffer, file_.size)}; !exp) {
+      return exp;
+    }
+
+    buffer_ = buffer;
+    return {};
+  }
+
+  [[nodiscard]] auto WaitForPrefix(
+    std::uint64_t const byte_count) -> std::expected<
+    std::uint64_t, std::string> override {
+    auto const target{std::min(byte_count, file_.size)};
+
+    while (ready_byte_count_ < target) {
+      // Direct reads of the last block may go past the end of the file.
+      auto const chunk_end{
+        std::min(ready_byte_count_ + chunk_size_,
+                 GetFileReadBufferSize(file_.size))
+      };
+      auto const result{
+        pread(file_.fd.Get(), buffer_.data() + ready_byte_count_,
+              chunk_end - ready_byte_count_,
+              static_cast<off_t>(ready_byte_count_))
+      };
+
+      if (result < 0 && errno == EINTR) {
+        continue;
+      }
+
+      if (result < 0) {
+        return std::unexpected{
+          std::format("Failed to read at offset {}: {}", ready_byte_count_,
+                      FormatErrno(errno))
+        };
+      }
+
+      if (result == 0) {
+        return std::unexpected{
+          std::format("Unexpected end of file at offset {}.",
+                      ready_byte_count_)
+        };
+      }
+
+      ready_byte_count_ = std::min(
+        ready_byte_count_ + static_cast<std::uint64_t>(result), file_.size);
+    }
+
+    return ready_byte_count_;
+  }
+
+private:
+  OpenedFile file_;
+  std::uint32_t chunk_size_;
+  std::span<std::byte> buffer_;
+  std::uint64_t ready_byte_count_{0};
+};
+
+// Submits chunk reads through an io_uring instance set up with raw system
+// calls, so no liburing is needed. The submission queue holds the queue
+// depth and completions are reaped by the thread waiting for the prefix.
+class IoUringFileReader final : public FileReader {
+public:
+  [[nodiscard]] static auto Create(
+    OpenedFile file,
+    FileReadOptions const& options) -> std::expected<
+    std::unique_ptr<IoUringFileReader>, std::string> {
+    io_uring_params params{};
+    auto const ring_fd{
+      static_cast<int>(syscall(__NR_io_uring_setup, options.queue_depth,
+                               &params))
+    };
+
+    if (ring_fd < 0) {
+      return std::unexpected{
+        std::format("Failed to set up io_uring: {}", FormatErrno(errno))
+      };
+    }
+
+    std::unique_ptr<IoUringFileReader> reader{
+      new IoUringFileReader{std::move(file), FileDescriptor{ring_fd}, options}
+    };
+
+    if (auto const exp{reader->MapRings(params)}; !exp) {
+      return std::unexpected{exp.error()};
+    }
+
+    if (!reader->IsReadSupported()) {
+      return std::unexpected{"The kernel does not support io_uring reads."};
+    }
+
+    return reader;
+  }
+
+  IoUringFileReader(IoUringFileReader const& other) = delete;
+  IoUringFileReader(IoUringFileReader&& other) = delete;
+
+  // The kernel writes to the buffer until every read has completed.
+  ~IoUringFileReader() override {
+    while (in_flight_count_ > 0) {
+      auto const result{
+        syscall(__NR_io_uring_enter, ring_fd_.Get(), unsubmitted_count_, 1,
+                IORING_ENTER_GETEVENTS, nullptr, 0)
+      };
+
+      if (result < 0 && errno != EINTR) {
+        break;
+      }
+
+      if (result > 0) {
+        unsubmitted_count_ -= static_cast<unsigned>(result);
+      }
+
+      ReapCompletions();
+    }
+
+    if (sqes_ != MAP_FAILED) {
+      munmap(sqes_, sqes_size_);
+    }
+
+    if (cq_ring_ != MAP_FAILED && cq_ring_ != sq_ring_) {
+      munmap(cq_ring_, cq_ring_size_);
+    }
+
+    if (sq_ring_ != MAP_FAILED) {
+      munmap(sq_ring_, sq_ring_size_);
+    }
+  }
+
+  auto operator=(IoUringFileReader const& other) -> void = delete;
+  auto operator=(IoUringFileReader&& other) -> void = delete;
+
+  [[nodiscard]] auto GetSize() const -> std::uint64_t override {
+    return file_.size;
+  }
+
+  [[nodiscard]] auto Start(
+    std::span<std::byte> const buffer) -> std::expected<
+    void, std::string> override {
+    if (auto const exp{ValidateBuffer(buffer, file_.size)}; !exp) {
+      return exp;
+    }
+
+    buffer_ = buffer;
+    auto const chunk_count{
+      (GetFileReadBufferSize(file_.size) + chunk_size_ - 1) / chunk_size_
+    };
+    chunk_read_byte_counts_.assign(chunk_count, 0);
+    return SubmitReads();
+  }
+
+  [[nodiscard]] auto WaitForPrefix(
+    std::uint64_t const byte_count) -> std::expected<
+    std::uint64_t, std::string> override {
+    auto const target{std::min(byte_count, file_.size)};
+
+    while (GetReadyByteCount() < target) {
+      if (!error_.empty()) {
+        return std::unexpected{error_};
+      }
+
+      if (auto const exp{SubmitReads(1)}; !exp) {
+        return std::unexpected{exp.error()};
+      }
+
+      ReapCompletions();
+    }
+
+    return GetReadyByteCount();
+  }
+
+private:
+  IoUringFileReader(OpenedFile file, FileDescriptor ring_fd,
+                    FileReadOptions const& options) :
+    file_{std::move(file)}, ring_fd_{std::move(ring_fd)},
+    chunk_size_{options.chunk_size}, queue_depth_{options.queue_depth} {}
+
+  [[nodiscard]] auto MapRings(
+    io_uring_params const& params) -> std::expected<void, std::string> {
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(
+      io_uring_cqe);
+    auto const is_single_mmap{(params.features & IORING_FEAT_SINGLE_MMAP) != 0};
+
+    if (is_single_mmap) {
+      sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+    }
+
+    sq_ring_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, ring_fd_.Get(),
+                    IORING_OFF_SQ_RING);
+    cq_ring_ = is_single_mmap
+                 ? sq_ring_
+                 : mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, ring_fd_.Get(),
+                        IORING_OFF_CQ_RING);
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    sqes_ = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_POPULATE, ring_fd_.Get(), IORING_OFF_SQES);
+
+    if (sq_ring_ == MAP_FAILED || cq_ring_ == MAP_FAILED ||
+      sqes_ == MAP_FAILED) {
+      return std::unexpected{
+        std::format("Failed to map the io_uring queues: {}", FormatErrno(errno))
+      };
+    }
+
+    auto const at{
+      [](void* const ring, std::uint32_t const offset) {
+        return reinterpret_cast<unsigned*>(static_cast<std::byte*>(ring) +
+                                           offset);
+      }
+    };
+
+    sq_tail_ = at(sq_ring_, params.sq_off.tail);
+    sq_mask_ = *at(sq_ring_, params.sq_off.ring_mask);
+    sq_array_ = at(sq_ring_, params.sq_off.array);
+    cq_head_ = at(cq_ring_, params.cq_off.head);
+    cq_tail_ = at(cq_ring_, params.cq_off.tail);
+    cq_mask_ = *at(cq_ring_, params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe*>(static_cast<std::byte*>(cq_ring_) +
+                                            params.cq_off.cqes);
+    queue_depth_ = std::min(queue_depth_, params.sq_entries);
+    return {};
+  }
+
+  // IORING_OP_READ needs Linux 5.6, older kernels fail every read.
+  [[nodiscard]] auto IsReadSupported() const -> bool {
+    auto constexpr op_count{256};
+    std::vector<std::byte> probe_bytes(
+      sizeof(io_uring_probe) + op_count * sizeof(io_uring_probe_op));
+    auto const probe{reinterpret_cast<io_uring_probe*>(probe_bytes.data())};
+
+    if (syscall(__NR_io_uring_register, ring_fd_.Get(),
+                IORING_REGISTER_PROBE, probe, op_count) < 0) {
+      return false;
+    }
+
+    return probe->last_op >= IORING_OP_READ && (probe->ops[IORING_OP_READ].
+      flags & IO_URING_OP_SUPPORTED) != 0;
+  }
+
+  [[nodiscard]] auto GetReadyByteCount() const -> std::uint64_t {
+    return std::min(static_cast<std::uint64_t>(ready_chunk_count_) *
+                    chunk_size_, file_.size);
+  }
+
+  [[nodiscard]] auto GetChunkEnd(std::size_t const chunk_idx) const ->
+    std::uint64_t {
+    return std::min(static_cast<std::uint64_t>(chunk_idx + 1) * chunk_size_,
+                    GetFileReadBufferSize(file_.size));
+  }
+
+  // Queues the read of the rest of the chunk.
+  auto QueueRead(std::size_t const chunk_idx) -> void {
+    auto const offset{
+      static_cast<std::uint64_t>(chunk_idx) * chunk_size_ +
+      chunk_read_byte_counts_[chunk_idx]
+    };
+    auto const tail{*sq_tail_};
+    auto const idx{tail & sq_mask_};
+    auto& sqe{static_cast<io_uring_sqe*>(sqes_)[idx]};
+    std::memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = IORING_OP_READ;
+    sqe.fd = file_.fd.Get();
+    sqe.off = offset;
+    sqe.addr = reinterpret_cast<std::uint64_t>(buffer_.data() + offset);
+    sqe.len = static_cast<std::uint32_t>(GetChunkEnd(chunk_idx) - offset);
+    sqe.user_data = chunk_idx;
+    sq_array_[idx] = idx;
+    std::atomic_ref{*sq_tail_}.store(tail + 1, std::memory_order_release);
+    in_flight_count_ += 1;
+    unsubmitted_count_ += 1;
+  }
+
+  // Fills the queue with the next chunks, submits them and waits for at
+  // least min_complete completions.
+  [[nodiscard]] auto SubmitReads(
+    unsigned const min_complete = 0) -> std::expected<void, std::string> {
+    while (in_flight_count_ < queue_depth_ && next_chunk_idx_ <
+      chunk_read_byte_counts_.size()) {
+      QueueRead(next_chunk_idx_++);
+    }
+
+    if (unsubmitted_count_ == 0 && min_complete == 0) {
+      return {};
+    }
+
+    auto const result{
+      syscall(__NR_io_uring_enter, ring_fd_.Get(), unsubmitted_count_,
+              min_complete, min_complete > 0 ? IORING_ENTER_GETEVENTS : 0,
+              nullptr, 0)
+    };
+
+    if (result < 0 && errno != EINTR) {
+      return std::unexpected{
+        std::format("Failed to submit reads: {}", FormatErrno(errno))
+      };
+    }
+
+    if (result > 0) {
+      unsubmitted_count_ -= static_cast<unsigned>(result);
+    }
+
+    return {};
+  }
+
+  auto ReapCompletions() -> void {
+    auto head{*cq_head_};
+    auto const tail{std::atomic_ref{*cq_tail_}.load(std::memory_order_acquire)};
+
+    for (; head != tail; head++) {
+      auto const& cqe{cqes_[head & cq_mask_]};
+      auto const chunk_idx{static_cast<std::size_t>(cqe.user_data)};
+      in_flight_count_ -= 1;
+
+      if (cqe.res == -EAGAIN || cqe.res == -EINTR) {
+        QueueRead(chunk_idx);
+        continue;
+      }
+
+      if (cqe.res < 0) {
+        error_ = std::format("Failed to read chunk {}: {}", chunk_idx,
+                             FormatErrno(-cqe.res));
+        continue;
+      }
+
+      auto& read_byte_count{chunk_read_byte_counts_[chunk_idx]};
+      read_byte_count += static_cast<std::uint32_t>(cqe.res);
+      auto const read_end{
+        static_cast<std::uint64_t>(chunk_idx) * chunk_size_ + read_byte_count
+      };
+
+      if (read_end < std::min(GetChunkEnd(chunk_idx), file_.size)) {
+        if (cqe.res == 0) {
+          error_ = std::format("Unexpected end of file at offset {}.",
+                               read_end);
+        } else {
+          QueueRead(chunk_idx);
+        }
+      }
+    }
+
+    std::atomic_ref{*cq_head_}.store(head, std::memory_order_release);
+
+    while (ready_chunk_count_ < chunk_read_byte_counts_.size() && static_cast<
+      std::uint64_t>(ready_chunk_count_) * chunk_size_ +
+      chunk_read_byte_counts_[ready_chunk_count_] >= std::min(
+        GetChunkEnd(ready_chunk_count_), file_.size)) {
+      ready_chunk_count_ += 1;
+    }
+  }
+
+  OpenedFile file_;
+  FileDescriptor ring_fd_;
+  std::uint32_t chunk_size_;
+  std::uint32_t queue_depth_;
+  std::span<std::byte> buffer_;
+
+  void* sq_ring_{MAP_FAILED};
+  void* cq_ring_{MAP_FAILED};
+  void* sqes_{MAP_FAILED};
+  std::size_t sq_ring_size_{0};
+  std::size_t cq_ring_size_{0};
+  std::size_t sqes_size_{0};
+  unsigned* sq_tail_{nullptr};
+  unsigned sq_mask_{0};
+  unsigned* sq_array_{nullptr};
+  unsigned* cq_head_{nullptr};
+  unsigned* cq_tail_{nullptr};
+  unsigned cq_mask_{0};
+  io_uring_cqe* cqes_{nullptr};
+
+  // Bytes read so far from the start of every chunk. A chunk is done once
+  // it reaches its end or the end of the file.
+  std::vector<std::uint32_t> chunk_read_byte_counts_;
+  std::size_t next_chunk_idx_{0};
+  std::size_t ready_chunk_count_{0};
+  unsigned in_flight_count_{0};
+  unsigned unsubmitted_count_{0};
+  std::string error_;
+};
+}
+#endif
+
+auto AllocateFileReadBuffer(std::uint64_t const file_size) -> FileReadBuffer {
+  auto const size{static_cast<std::size_t>(GetFileReadBufferSize(file_size))};
+  FileReadBuffer ret{
+    static_cast<std::byte*>(::operator new[](
+      size, std::align_val_t{kFileReadBufferAlignment}))
+  };
+#ifdef __linux__
+  madvise(ret.get(), size, MADV_HUGEPAGE);
+#endif
+  return ret;
+}
+
+auto OpenFileReader(std::filesystem::path const& path,
+                    FileReadBackend const backend,
+                    FileReadOptions const& options) -> std::expected<
+  std::unique_ptr<FileReader>, std::string> {
+  if (options.chunk_size == 0 || options.chunk_size % kFileReadAlignment != 0
+    || options.queue_depth == 0) {
+    return std::unexpected{
+      std::format("Chunk size must be a positive multiple of {} and the queue "
+                  "depth positive.", kFileReadAlignment)
+    };
+  }
+
+#ifdef __linux__
+  if (backend == FileReadBackend::kIoUring) {
+    auto file{OpenForReading(path, options.direct_io)};
+
+    if (!file) {
+      return std::unexpected{file.error()};
+    }
+
+    // Only the setup falls back, as reads may already be in flight later.
+    if (auto reader{IoUringFileReader::Create(std::move(*file), options)}) {
+      return std::move(*reader);
+    }
+  }
+
+  auto file{OpenForReading(path, options.direct_io)};
+
+  if (!file) {
+    return std::unexpected{file.error()};
+  }
+
+  return std::make_unique<PreadFileReader>(std::move(*file),
+                                           options.chunk_size);
+#else
+  static_cast<void>(path);
+  static_cast<void>(backend);
+  return std::unexpected{"Chunked file reading is only available on Linux."};
+#endif
+}
+
+auto MappedFile::Open(
+  std::filesystem::path const& path) -> std::expected<MappedFile, std::string> {
+#ifdef __linux__
+  auto const file{OpenForReading(path, false)};
+
+  if (!file) {
+    return std::unexpected{file.error()};
+  }
+
+  if (file->size == 0) {
+    return MappedFile{{}};
+  }
+
+  auto const bytes{
+    mmap(nullptr, file->size, PROT_READ, MAP_PRIVATE, file->fd.Get(), 0)
+  };
+
+  if (bytes == MAP_FAILED) {
+    return std::unexpected{
+      std::format("Failed to map file {}: {}", path.string(),
+                  FormatErrno(errno))
+    };
+  }
+
+  madvise(bytes, file->size, MADV_SEQUENTIAL);
+  return MappedFile{
+    {static_cast<std::byte const*>(bytes), static_cast<std::size_t>(file->size)}
+  };
+#else
+  return std::unexpected{
+    std::format("Failed to map file {}: only available on Linux.",
+                path.string())
+  };
+#endif
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept :
+  bytes_{std::exchange(other.bytes_, {})} {}
+
+MappedFile::~MappedFile() {
+#ifdef __linux__
+  if (!bytes_.empty()) {
+    munmap(const_cast<std::byte*>(bytes_.data()), bytes_.size());
+  }
+#endif
+}
+
+auto MappedFile::GetBytes() const -> std::span<std::byte const> {
+  return bytes_;
+}
+
+MappedFile::MappedFile(std::span<std::byte const> const bytes) :
+  bytes_{bytes} {}
+}
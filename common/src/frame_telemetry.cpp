@@ -0,0 +1,141 @@
+#include "frame_telemetry.hpp"
+
+#include "chrome_trace.hpp"
+
+namespace pensieve {
+namespace {
+auto constexpr kCpuTrackId{0u};
+auto constexpr kGpuTrackId{1u};
+}
+
+FrameStageSampleRing::FrameStageSampleRing(std::size_t const capacity) :
+  slots_{std::make_unique<Slot[]>(std::max<std::size_t>(capacity, 1))},
+  capacity_{std::max<std::size_t>(capacity, 1)} {}
+
+auto FrameStageSampleRing::Push(FrameStageSample const& sample) -> void {
+  auto const idx{push_count_.load(std::memory_order_relaxed)};
+  auto& slot{slots_[idx % capacity_]};
+
+  // Readers that see the odd sequence, or a different one after copying,
+  // drop the slot.
+  slot.sequence.store(2 * idx + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+
+  slot.frame_idx.store(sample.frame_idx, std::memory_order_relaxed);
+  slot.begin_ns.store(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        sample.begin.time_since_epoch()).count(),
+                      std::memory_order_relaxed);
+  slot.duration_ns.store(sample.duration.count(), std::memory_order_relaxed);
+  slot.stage.store(sample.stage, std::memory_order_relaxed);
+
+  slot.sequence.store(2 * idx + 2, std::memory_order_release);
+  push_count_.store(idx + 1, std::memory_order_release);
+}
+
+auto FrameStageSampleRing::CopySamples(
+  std::vector<FrameStageSample>& samples) const -> void {
+  auto const push_count{push_count_.load(std::memory_order_acquire)};
+  auto const first{push_count > capacity_ ? push_count - capacity_ : 0};
+
+  for (auto idx{first}; idx < push_count; idx++) {
+    auto const& slot{slots_[idx % capacity_]};
+    auto const sequence{slot.sequence.load(std::memory_order_acquire)};
+
+    if (sequence != 2 * idx + 2) {
+      continue;
+    }
+
+    FrameStageSample const sample{
+      slot.frame_idx.load(std::memory_order_relaxed),
+      slot.stage.load(std::memory_order_relaxed),
+      std::chrono::steady_clock::time_point{
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+          std::chrono::nanoseconds{
+            slot.begin_ns.load(std::memory_order_relaxed)
+          })
+      },
+      std::chrono::nanoseconds{slot.duration_ns.load(std::memory_order_relaxed)}
+    };
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+
+    if (slot.sequence.load(std::memory_order_relaxed) == sequence) {
+      samples.emplace_back(sample);
+    }
+  }
+}
+
+FrameTelemetry::FrameTelemetry(std::size_t const sample_capacity) :
+  samples_{sample_capacity} {}
+
+auto FrameTelemetry::RecordStage(std::uint64_t const frame_idx,
+                                 FrameStage const stage,
+                                 std::chrono::steady_clock::time_point const
+                                 begin,
+                                 std::chrono::steady_clock::time_point const
+                                 end) -> void {
+  samples_.Push(FrameStageSample{
+    frame_idx, stage, begin,
+    std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin)
+  });
+}
+
+auto FrameTelemetry::RecordGpuFrame(GpuTimestampSource& source,
+                                    std::uint64_t const frame_idx) -> void {
+  if (auto const span{source.ReadFrameSpan(frame_idx)}) {
+    samples_.Push(FrameStageSample{
+      frame_idx, FrameStage::kGpu, span->begin, span->duration
+    });
+  }
+}
+
+auto FrameTelemetry::CalculateStatistics() const -> std::array<
+  DurationPercentiles, kFrameStageCount> {
+  std::vector<FrameStageSample> samples;
+  samples_.CopySamples(samples);
+
+  std::array<std::vector<std::chrono::nanoseconds>, kFrameStageCount>
+    durations;
+
+  for (auto const& sample : samples) {
+    durations[static_cast<std::size_t>(sample.stage)].emplace_back(
+      sample.duration);
+  }
+
+  std::array<DurationPercentiles, kFrameStageCount> ret;
+
+  for (std::size_t i{0}; i < kFrameStageCount; i++) {
+    ret[i] = CalculatePercentiles(durations[i]);
+  }
+
+  return ret;
+}
+
+auto FrameTelemetry::WriteChromeTrace(
+  std::filesystem::path const& path) const -> std::expected<
+  void, std::string> {
+  std::vector<FrameStageSample> samples;
+  samples_.CopySamples(samples);
+
+  std::vector<ChromeTraceEvent> events;
+  events.reserve(samples.size());
+
+  for (auto const& [frame_idx, stage, begin, duration] : samples) {
+    events.emplace_back(kFrameStageNames[static_cast<std::size_t>(stage)],
+                        "frame",
+                        stage == FrameStage::kGpu ? kGpuTrackId : kCpuTrackId,
+                        static_cast<std::uint64_t>(
+                          std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            begin.time_since_epoch()).count()),
+                        static_cast<std::uint64_t>(duration.count()),
+                        frame_idx);
+  }
+
+  std::array const threads{
+    ChromeTraceThread{kCpuTrackId, "Render thread"},
+    ChromeTraceThread{kGpuTrackId, "GPU"}
+  };
+
+  return pensieve::WriteChromeTrace(path, events, threads);
+}
+}
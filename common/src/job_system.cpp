@@ -0,0 +1,217 @@
+#include "job_system.hpp"
+
+#include <format>
+#include <utility>
+
+#include "profiler.hpp"
+
+namespace pensieve {
+namespace detail {
+struct Job {
+  std::function<void()> fn;
+  JobCounter* counter{nullptr};
+  // Unfinished dependencies, plus one while the job is being set up.
+  std::atomic<std::uint32_t> pending_count{1};
+  std::mutex continuation_mutex;
+  std::vector<std::shared_ptr<Job>> continuations;
+  bool is_finished{false};
+};
+}
+
+namespace {
+// Lets workers push to their own queue.
+thread_local JobSystem const* tls_job_system{nullptr};
+thread_local std::size_t tls_queue_idx{0};
+}
+
+auto JobCounter::IsDone() const -> bool {
+  return count_.load(std::memory_order_acquire) == 0;
+}
+
+JobHandle::JobHandle(std::shared_ptr<detail::Job> job) :
+  job_{std::move(job)} {}
+
+JobSystem::JobSystem() :
+  JobSystem{std::max(std::thread::hardware_concurrency(), 1u) - 1} {}
+
+JobSystem::JobSystem(unsigned const worker_count) {
+  for (unsigned i{0}; i <= worker_count; i++) {
+    queues_.emplace_back(std::make_unique<WorkerQueue>());
+  }
+
+  for (unsigned i{0}; i < worker_count; i++) {
+    workers_.emplace_back(&JobSystem::WorkerMain, this, i);
+  }
+}
+
+JobSystem::~JobSystem() {
+  {
+    std::scoped_lock const lock{sleep_mutex_};
+    is_stopping_ = true;
+  }
+
+  wake_cv_.notify_all();
+
+  for (auto& worker : workers_) {
+    worker.join();
+  }
+}
+
+auto JobSystem::Run(std::function<void()> job, JobCounter* const counter,
+                    std::span<JobHandle const> const dependencies) ->
+  JobHandle {
+  if (counter) {
+    counter->count_.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  auto const ret{std::make_shared<detail::Job>()};
+  ret->fn = std::move(job);
+  ret->counter = counter;
+
+  for (auto const& dependency : dependencies) {
+    if (!dependency.job_) {
+      continue;
+    }
+
+    std::scoped_lock const lock{dependency.job_->continuation_mutex};
+
+    if (!dependency.job_->is_finished) {
+      ret->pending_count.fetch_add(1, std::memory_order_relaxed);
+      dependency.job_->continuations.emplace_back(ret);
+    }
+  }
+
+  if (ret->pending_count.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+    Enqueue(ret);
+  }
+
+  return JobHandle{ret};
+}
+
+auto JobSystem::Wait(JobCounter const& counter) -> void {
+  while (!counter.IsDone()) {
+    if (!TryRunJob()) {
+      std::this_thread::yield();
+    }
+  }
+}
+
+auto JobSystem::GetWorkerCount() const -> unsigned {
+  return static_cast<unsigned>(workers_.size());
+}
+
+auto JobSystem::WorkerMain(std::size_t const queue_idx) -> void {
+  tls_job_system = this;
+  tls_queue_idx = queue_idx;
+  SetProfilerThreadName(std::format("Worker {}", queue_idx));
+
+  while (true) {
+    if (TryRunJob()) {
+      continue;
+    }
+
+    std::unique_lock lock{sleep_mutex_};
+    // Announced before the count is checked, Enqueue counts the job before
+    // checking for sleepers, so one of them sees the other.
+    sleeping_worker_count_.fetch_add(1, std::memory_order_seq_cst);
+    wake_cv_.wait(lock, [this] {
+      return is_stopping_ || queued_job_count_.load(std::memory_order_seq_cst)
+             != 0;
+    });
+    sleeping_worker_count_.fetch_sub(1, std::memory_order_relaxed);
+
+    if (is_stopping_) {
+      return;
+    }
+  }
+}
+
+auto JobSystem::Enqueue(std::shared_ptr<detail::Job> job) -> void {
+  auto const queue_idx{
+    tls_job_system == this ? tls_queue_idx : queues_.size() - 1
+  };
+
+  // Counted before it is queued so that the count never drops below zero.
+  queued_job_count_.fetch_add(1, std::memory_order_seq_cst);
+
+  {
+    auto& queue{*queues_[queue_idx]};
+    std::scoped_lock const lock{queue.mutex};
+    queue.jobs.emplace_back(std::move(job));
+  }
+
+  if (sleeping_worker_count_.load(std::memory_order_seq_cst) == 0) {
+    return;
+  }
+
+  // Sleeping workers check the count with the lock held, taking it here
+  // makes sure none of them misses the notification.
+  { std::scoped_lock const lock{sleep_mutex_}; }
+  wake_cv_.notify_one();
+}
+
+auto JobSystem::TryRunJob() -> bool {
+  if (queued_job_count_.load(std::memory_order_acquire) == 0) {
+    return false;
+  }
+
+  auto const own_queue_idx{
+    tls_job_system == this ? tls_queue_idx : queues_.size() - 1
+  };
+
+  std::shared_ptr<detail::Job> job;
+
+  for (std::size_t i{0}; i < queues_.size() && !job; i++) {
+    auto const queue_idx{(own_queue_idx + i) % queues_.size()};
+    auto& queue{*queues_[queue_idx]};
+    std::scoped_lock const lock{queue.mutex};
+
+    if (queue.jobs.empty()) {
+      continue;
+    }
+
+    // The newest job of the own queue is the most likely to be in cache, the
+    // oldest job of another is the most likely to spawn more work.
+    if (queue_idx == own_queue_idx) {
+      job = std::move(queue.jobs.back());
+      queue.jobs.pop_back();
+    } else {
+      job = std::move(queue.jobs.front());
+      queue.jobs.pop_front();
+    }
+  }
+
+  if (!job) {
+    return false;
+  }
+
+  queued_job_count_.fetch_sub(1, std::memory_order_relaxed);
+  Execute(*job);
+  return true;
+}
+
+auto JobSystem::Execute(detail::Job& job) -> void {
+  job.fn();
+  job.fn = nullptr;
+
+  std::vector<std::shared_ptr<detail::Job>> continuations;
+
+  {
+    std::scoped_lock const lock{job.continuation_mutex};
+    job.is_finished = true;
+    continuations = std::move(job.continuations);
+  }
+
+  for (auto& continuation : continuations) {
+    if (continuation->pending_count.fetch_sub(1, std::memory_order_acq_rel) ==
+      1) {
+      Enqueue(std::move(continuation));
+    }
+  }
+
+  // Waiters may destroy the counter as soon as it reaches zero.
+  if (job.counter) {
+    job.counter->count_.fetch_sub(1, std::memory_order_release);
+  }
+}
+}
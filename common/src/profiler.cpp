@@ -0,0 +1,244 @@
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <memory>
+#include <mutex>
+#include <ranges>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "chrome_trace.hpp"
+
+namespace pensieve {
+namespace {
+struct ZoneRecord {
+  std::string_view name;
+  std::int64_t begin_ns;
+  std::int64_t duration_ns;
+};
+
+struct ZoneChunk {
+  static auto constexpr capacity_{std::size_t{4096}};
+
+  std::array<ZoneRecord, capacity_> records;
+  // Records below the count are complete.
+  std::atomic<std::size_t> count{0};
+  std::atomic<ZoneChunk*> next{nullptr};
+};
+
+// Only the owning thread appends. Chunks are never moved, so other threads
+// can copy the published records at any time. The first chunk is allocated
+// with the first record, naming a thread costs no memory.
+class ThreadBuffer {
+public:
+  ThreadBuffer(std::uint32_t const id, std::string name) :
+    id_{id}, name_{std::move(name)} {}
+
+  auto Append(ZoneRecord const& record) -> void {
+    if (chunks_.empty()) {
+      first_chunk_.store(
+        chunks_.emplace_back(std::make_unique<ZoneChunk>()).get(),
+        std::memory_order_release);
+    }
+
+    auto* chunk{chunks_.back().get()};
+
+    if (chunk->count.load(std::memory_order_relaxed) == ZoneChunk::capacity_) {
+      auto* const next_chunk{
+        chunks_.emplace_back(std::make_unique<ZoneChunk>()).get()
+      };
+      chunk->next.store(next_chunk, std::memory_order_release);
+      chunk = next_chunk;
+    }
+
+    auto const idx{chunk->count.load(std::memory_order_relaxed)};
+    chunk->records[idx] = record;
+    chunk->count.store(idx + 1, std::memory_order_release);
+  }
+
+  auto CopyRecords(std::vector<ZoneRecord>& records) const -> void {
+    for (auto const* chunk{first_chunk_.load(std::memory_order_acquire)}; chunk;
+         chunk = chunk->next.load(std::memory_order_acquire)) {
+      auto const count{chunk->count.load(std::memory_order_acquire)};
+      records.insert(records.end(), chunk->records.begin(),
+                     chunk->records.begin() + static_cast<std::ptrdiff_t>(
+                       count));
+    }
+  }
+
+  [[nodiscard]] auto GetId() const -> std::uint32_t {
+    return id_;
+  }
+
+  // The name is guarded by the registry mutex.
+  [[nodiscard]] auto GetName() const -> std::string const& {
+    return name_;
+  }
+
+  auto SetName(std::string name) -> void {
+    name_ = std::move(name);
+  }
+
+private:
+  std::uint32_t id_;
+  std::string name_;
+  std::atomic<ZoneChunk const*> first_chunk_{nullptr};
+  std::vector<std::unique_ptr<ZoneChunk>> chunks_;
+};
+
+// Buffers outlive their threads so the zones of finished threads remain.
+struct ThreadBufferRegistry {
+  std::mutex mutex;
+  std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+};
+
+thread_local ThreadBuffer* tls_buffer{nullptr};
+
+auto GetRegistry() -> ThreadBufferRegistry& {
+  static ThreadBufferRegistry registry;
+  return registry;
+}
+
+auto GetThreadBuffer() -> ThreadBuffer& {
+  if (!tls_buffer) {
+    auto& registry{GetRegistry()};
+    std::scoped_lock const lock{registry.mutex};
+    auto const id{static_cast<std::uint32_t>(registry.buffers.size())};
+    tls_buffer = registry.buffers.emplace_back(
+      std::make_unique<ThreadBuffer>(id, std::format("Thread {}", id))).get();
+  }
+
+  return *tls_buffer;
+}
+
+[[nodiscard]] auto ToNanoseconds(
+  std::chrono::steady_clock::duration const duration) -> std::int64_t {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(duration).
+    count();
+}
+
+struct ThreadRecords {
+  std::uint32_t id;
+  std::string name;
+  std::vector<ZoneRecord> records;
+};
+
+[[nodiscard]] auto CollectRecords() -> std::vector<ThreadRecords> {
+  auto& registry{GetRegistry()};
+  std::scoped_lock const lock{registry.mutex};
+
+  std::vector<ThreadRecords> ret;
+  ret.reserve(registry.buffers.size());
+
+  for (auto const& buffer : registry.buffers) {
+    auto& thread{ret.emplace_back(buffer->GetId(), buffer->GetName())};
+    buffer->CopyRecords(thread.records);
+  }
+
+  return ret;
+}
+}
+
+ProfileZone::ProfileZone(std::string_view const name) :
+  name_{name}, begin_{std::chrono::steady_clock::now()} {}
+
+ProfileZone::~ProfileZone() {
+  auto const end{std::chrono::steady_clock::now()};
+  GetThreadBuffer().Append(ZoneRecord{
+    name_, ToNanoseconds(begin_.time_since_epoch()),
+    ToNanoseconds(end - begin_)
+  });
+}
+
+auto SetProfilerThreadName(std::string name) -> void {
+  auto& buffer{GetThreadBuffer()};
+  std::scoped_lock const lock{GetRegistry().mutex};
+  buffer.SetName(std::move(name));
+}
+
+auto WriteProfilerTrace(
+  std::filesystem::path const& path) -> std::expected<void, std::string> {
+  auto const threads{CollectRecords()};
+
+  std::vector<ChromeTraceEvent> events;
+  std::vector<ChromeTraceThread> trace_threads;
+  trace_threads.reserve(threads.size());
+
+  for (auto const& [id, name, records] : threads) {
+    trace_threads.emplace_back(id, name);
+
+    for (auto const& [zone_name, begin_ns, duration_ns] : records) {
+      events.emplace_back(zone_name, "zone", id,
+                          static_cast<std::uint64_t>(begin_ns),
+                          static_cast<std::uint64_t>(duration_ns),
+                          std::nullopt);
+    }
+  }
+
+  return WriteChromeTrace(path, events, trace_threads);
+}
+
+auto FormatProfilerSummary() -> std::string {
+  struct ZoneStats {
+    std::string_view name;
+    std::uint64_t call_count;
+    std::int64_t total_ns;
+    std::int64_t max_ns;
+  };
+
+  std::unordered_map<std::string_view, ZoneStats> stats_by_name;
+
+  for (auto const& thread : CollectRecords()) {
+    for (auto const& [name, begin_ns, duration_ns] : thread.records) {
+      auto& stats{
+        stats_by_name.try_emplace(name, ZoneStats{name, 0, 0, 0}).first->second
+      };
+      stats.call_count += 1;
+      stats.total_ns += duration_ns;
+      stats.max_ns = std::max(stats.max_ns, duration_ns);
+    }
+  }
+
+  std::vector<ZoneStats> sorted_stats;
+  sorted_stats.reserve(stats_by_name.size());
+
+  for (auto const& stats : stats_by_name | std::views::values) {
+    sorted_stats.emplace_back(stats);
+  }
+
+  std::ranges::sort(sorted_stats, std::ranges::greater{},
+                    &ZoneStats::total_ns);
+
+  std::size_t name_width{4};
+
+  for (auto const& stats : sorted_stats) {
+    name_width = std::max(name_width, stats.name.size());
+  }
+
+  auto const to_ms{
+    [](std::int64_t const ns) {
+      return static_cast<double>(ns) / 1'000'000.0;
+    }
+  };
+
+  auto ret{
+    std::format("{:<{}} {:>8} {:>12} {:>12} {:>12}\n", "Zone", name_width,
+                "Calls", "Total ms", "Mean ms", "Max ms")
+  };
+
+  for (auto const& [name, call_count, total_ns, max_ns] : sorted_stats) {
+    ret += std::format("{:<{}} {:>8} {:>12.3f} {:>12.3f} {:>12.3f}\n", name,
+                       name_width, call_count, to_ms(total_ns),
+                       to_ms(total_ns) / static_cast<double>(call_count),
+                       to_ms(max_ns));
+  }
+
+  return ret;
+}
+}
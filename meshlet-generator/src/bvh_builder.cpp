@@ -0,0 +1,254 @@
+#include "bvh_builder.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <optional>
+#include <vector>
+
+#include "bvh.hpp"
+#include "profiler.hpp"
+
+namespace pensieve {
+namespace {
+auto constexpr kBinCount{16};
+auto constexpr kMaxLeafInstanceCount{8};
+// Cost of visiting a node relative to testing an instance.
+auto constexpr kTraversalCost{1.0f};
+
+Aabb constexpr kEmptyAabb{
+  {
+    std::numeric_limits<float>::max(), std::numeric_limits<float>::max(),
+    std::numeric_limits<float>::max()
+  },
+  {
+    std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest(),
+    std::numeric_limits<float>::lowest()
+  }
+};
+
+struct Primitive {
+  Aabb bounds;
+  Float3 centroid;
+  BvhInstanceRef ref;
+};
+
+struct Bin {
+  Aabb bounds{kEmptyAabb};
+  std::uint32_t count{0};
+};
+
+struct BuildTask {
+  std::uint32_t node_idx;
+  std::uint32_t first;
+  std::uint32_t count;
+  int depth;
+};
+
+struct Split {
+  int axis;
+  int bin;
+  float cost;
+};
+
+auto Grow(Aabb& aabb, Float3 const& min, Float3 const& max) -> void {
+  for (auto i{0}; i < 3; i++) {
+    aabb.min[i] = std::min(aabb.min[i], min[i]);
+    aabb.max[i] = std::max(aabb.max[i], max[i]);
+  }
+}
+
+[[nodiscard]] auto CalculateHalfArea(Aabb const& aabb) -> float {
+  auto const dx{aabb.max[0] - aabb.min[0]};
+  auto const dy{aabb.max[1] - aabb.min[1]};
+  auto const dz{aabb.max[2] - aabb.min[2]};
+  return dx * dy + dy * dz + dz * dx;
+}
+
+[[nodiscard]] auto CalculateBin(float const centroid, float const min,
+                                float const extent) -> int {
+  return std::min(kBinCount - 1,
+                  static_cast<int>((centroid - min) * kBinCount / extent));
+}
+
+// Returns the cheapest split between two bins along any axis, or nothing if
+// the centroids cannot be told apart.
+[[nodiscard]] auto FindBestSplit(std::vector<Primitive> const& prims,
+                                 std::vector<std::uint32_t> const& prim_indices,
+                                 BuildTask const& task,
+                                 Aabb const& centroid_bounds) -> std::optional<
+  Split> {
+  std::optional<Split> best_split;
+
+  for (auto axis{0}; axis < 3; axis++) {
+    auto const min{centroid_bounds.min[axis]};
+    auto const extent{centroid_bounds.max[axis] - min};
+
+    if (extent <= 0) {
+      continue;
+    }
+
+    std::array<Bin, kBinCount> bins{};
+
+    for (auto i{task.first}; i < task.first + task.count; i++) {
+      auto const& prim{prims[prim_indices[i]]};
+      auto& bin{bins[CalculateBin(prim.centroid[axis], min, extent)]};
+      Grow(bin.bounds, prim.bounds.min, prim.bounds.max);
+      ++bin.count;
+    }
+
+    // Costs of the left sides of the splits, swept from the left.
+    std::array<float, kBinCount - 1> left_costs;
+    auto left_bounds{kEmptyAabb};
+    std::uint32_t left_count{0};
+
+    for (auto i{0}; i < kBinCount - 1; i++) {
+      Grow(left_bounds, bins[i].bounds.min, bins[i].bounds.max);
+      left_count += bins[i].count;
+      left_costs[i] = left_count == 0
+                        ? 0
+                        : CalculateHalfArea(left_bounds) * left_count;
+    }
+
+    auto right_bounds{kEmptyAabb};
+    std::uint32_t right_count{0};
+
+    for (auto i{kBinCount - 1}; i > 0; i--) {
+      Grow(right_bounds, bins[i].bounds.min, bins[i].bounds.max);
+      right_count += bins[i].count;
+
+      if (right_count == 0 || right_count == task.count) {
+        continue;
+      }
+
+      auto const cost{
+        left_costs[i - 1] + CalculateHalfArea(right_bounds) * right_count
+      };
+
+      if (!best_split || cost < best_split->cost) {
+        best_split = Split{axis, i - 1, cost};
+      }
+    }
+  }
+
+  return best_split;
+}
+}
+
+auto BuildBvh(SceneData const& scene) -> BvhData {
+  PENSIEVE_PROFILE_ZONE("BuildBvh");
+
+  std::vector<Primitive> prims;
+
+  for (std::uint32_t mesh_idx{0}; mesh_idx < scene.meshes.size(); mesh_idx++) {
+    auto const& mesh{scene.meshes[mesh_idx]};
+    auto const mesh_bounds{CalculateAabb(mesh.positions)};
+
+    for (std::uint32_t instance_idx{0}; instance_idx < mesh.instances.size();
+         instance_idx++) {
+      auto const bounds{
+        TransformAabb(mesh_bounds, mesh.instances[instance_idx].model_mtx)
+      };
+      prims.emplace_back(bounds,
+                         Float3{
+                           (bounds.min[0] + bounds.max[0]) * 0.5f,
+                           (bounds.min[1] + bounds.max[1]) * 0.5f,
+                           (bounds.min[2] + bounds.max[2]) * 0.5f
+                         }, BvhInstanceRef{mesh_idx, instance_idx});
+    }
+  }
+
+  BvhData bvh;
+
+  if (prims.empty()) {
+    return bvh;
+  }
+
+  std::vector<std::uint32_t> prim_indices(prims.size());
+  std::iota(prim_indices.begin(), prim_indices.end(), 0);
+
+  bvh.nodes.reserve(prims.size() * 2 - 1);
+  bvh.nodes.emplace_back();
+
+  std::vector<BuildTask> tasks;
+  tasks.emplace_back(0, 0, static_cast<std::uint32_t>(prims.size()), 0);
+
+  while (!tasks.empty()) {
+    auto const task{tasks.back()};
+    tasks.pop_back();
+
+    auto bounds{kEmptyAabb};
+    auto centroid_bounds{kEmptyAabb};
+
+    for (auto i{task.first}; i < task.first + task.count; i++) {
+      auto const& prim{prims[prim_indices[i]]};
+      Grow(bounds, prim.bounds.min, prim.bounds.max);
+      Grow(centroid_bounds, prim.centroid, prim.centroid);
+    }
+
+    bvh.nodes[task.node_idx].aabb_min = bounds.min;
+    bvh.nodes[task.node_idx].aabb_max = bounds.max;
+
+    auto const make_leaf{
+      [&bvh, &task] {
+        bvh.nodes[task.node_idx].left_or_first = task.first;
+        bvh.nodes[task.node_idx].instance_count = task.count;
+      }
+    };
+
+    if (task.count == 1 || task.depth == kBvhMaxDepth) {
+      make_leaf();
+      continue;
+    }
+
+    auto const split{
+      FindBestSplit(prims, prim_indices, task, centroid_bounds)
+    };
+
+    // Splitting pays off if the expected cost of visiting the children is
+    // lower than testing every instance of the leaf.
+    if (task.count <= kMaxLeafInstanceCount && (!split || kTraversalCost +
+      split->cost / CalculateHalfArea(bounds) >= static_cast<float>(task.
+        count))) {
+      make_leaf();
+      continue;
+    }
+
+    auto mid{task.first + task.count / 2};
+
+    if (split) {
+      auto const min{centroid_bounds.min[split->axis]};
+      auto const extent{centroid_bounds.max[split->axis] - min};
+      auto const it{
+        std::partition(prim_indices.begin() + task.first,
+                       prim_indices.begin() + task.first + task.count,
+                       [&prims, &split, min, extent](std::uint32_t const idx) {
+                         return CalculateBin(
+                           prims[idx].centroid[split->axis], min,
+                           extent) <= split->bin;
+                       })
+      };
+      mid = static_cast<std::uint32_t>(it - prim_indices.begin());
+    }
+
+    auto const left_idx{static_cast<std::uint32_t>(bvh.nodes.size())};
+    bvh.nodes.resize(bvh.nodes.size() + 2);
+    bvh.nodes[task.node_idx].left_or_first = left_idx;
+    bvh.nodes[task.node_idx].instance_count = 0;
+
+    tasks.emplace_back(left_idx + 1, mid, task.first + task.count - mid,
+                       task.depth + 1);
+    tasks.emplace_back(left_idx, task.first, mid - task.first, task.depth + 1);
+  }
+
+  bvh.instance_refs.reserve(prims.size());
+
+  for (auto const idx : prim_indices) {
+    bvh.instance_refs.emplace_back(prims[idx].ref);
+  }
+
+  return bvh;
+}
+}
@@ -0,0 +1,9 @@
+#pragma once
+
+#include "scene_data.hpp"
+
+namespace pensieve {
+// Builds a binned SAH BVH over the world space bounds of every instance of
+// every mesh in the scene.
+[[nodiscard]] auto BuildBvh(SceneData const& scene) -> BvhData;
+}
@@ -1,5 +1,7 @@
 #include <algorithm>
+#include <array>
 #include <bit>
+#include <chrono>
 #include <cstdint>
 #include <cstdlib>
 #include <cstring>
@@ -9,33 +11,116 @@
 #include <fstream>
 #include <iostream>
 #include <iterator>
-#include <ranges>
+#include <optional>
 #include <span>
 #include <stack>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include <assimp/Importer.hpp>
 #include <assimp/postprocess.h>
 #include <assimp/scene.h>
 
-#define STB_IMAGE_IMPLEMENTATION
-#include <stb_image.h>
-
-#include <DirectXMath.h>
-#include <DirectXMesh.h>
-
+#include "bvh_builder.hpp"
+#include "instance_transform.hpp"
+#include "job_system.hpp"
+#include "mesh_conversion.hpp"
+#include "profiler.hpp"
 #include "scene_data.hpp"
+#include "scene_writing.hpp"
+#include "texture_decoding.hpp"
+#include "texture_packing.hpp"
 
 namespace pensieve {
 namespace {
-constexpr auto kMeshletMaxVerts{128};
-constexpr auto kMeshletMaxPrims{256};
+struct DecodedTexture {
+  std::expected<TextureData, std::string> tex;
+  std::chrono::duration<double, std::milli> decode_time;
+};
+
+auto DecodeTexture(aiScene const& scene,
+                   std::filesystem::path const& scene_dir,
+                   std::string const& tex_path) -> std::expected<
+  TextureData, std::string> {
+  if (auto const tex{scene.GetEmbeddedTexture(tex_path.c_str())}) {
+    if (tex->mHeight == 0) {
+      auto tex_data{
+        DecodeEncodedTexture({
+          std::bit_cast<std::uint8_t const*>(tex->pcData), tex->mWidth
+        })
+      };
+
+      if (!tex_data) {
+        return std::unexpected{
+          std::format("Failed to load compressed embedded texture \"{}\": {}",
+                      tex_path.c_str(), tex_data.error())
+        };
+      }
+
+      return tex_data;
+    }
+
+    TextureData tex_data{
+      tex->mWidth, tex->mHeight, 1, TextureFormat::kR8G8B8A8Unorm,
+      std::make_unique_for_overwrite<std::uint8_t[]>(
+        tex->mWidth * tex->mHeight * 4)
+    };
+    std::memcpy(tex_data.bytes.get(), tex->pcData,
+                tex->mWidth * tex->mHeight * 4);
+    return tex_data;
+  }
+
+  std::ifstream tex_file{
+    scene_dir / tex_path.c_str(), std::ios::in | std::ios::binary
+  };
+
+  if (!tex_file.is_open()) {
+    return std::unexpected{
+      std::format("Failed to open texture at {}.", tex_path.c_str())
+    };
+  }
+
+  std::vector<std::uint8_t> const tex_file_bytes{
+    std::istreambuf_iterator{tex_file}, {}
+  };
+
+  auto tex_data{DecodeEncodedTexture(tex_file_bytes)};
+
+  if (!tex_data) {
+    return std::unexpected{
+      std::format("Failed to load texture at {}: {}", tex_path.c_str(),
+                  tex_data.error())
+    };
+  }
+
+  return tex_data;
+}
+
+// Decodes every texture in a job of its own. The arguments must outlive the
+// jobs.
+auto ScheduleTextureDecodes(JobSystem& job_system, aiScene const& scene,
+                            std::filesystem::path const& scene_dir,
+                            std::span<std::string const> const tex_paths,
+                            std::span<DecodedTexture> const decoded,
+                            JobCounter& counter) -> void {
+  for (std::size_t idx{0}; idx < tex_paths.size(); idx++) {
+    job_system.Run([&scene, &scene_dir, tex_paths, decoded, idx] {
+      PENSIEVE_PROFILE_ZONE("DecodeTexture");
+      auto const begin{std::chrono::steady_clock::now()};
+      decoded[idx].tex = DecodeTexture(scene, scene_dir, tex_paths[idx]);
+      decoded[idx].decode_time = std::chrono::steady_clock::now() - begin;
+    }, &counter);
+  }
+}
 }
 
-auto LoadScene(
-  std::filesystem::path const& path) -> std::expected<SceneData, std::string> {
+auto LoadScene(std::filesystem::path const& path,
+               JobSystem& job_system) -> std::expected<SceneData, std::string> {
+  PENSIEVE_PROFILE_ZONE("LoadScene");
+
   Assimp::Importer importer;
   importer.SetPropertyInteger(
     AI_CONFIG_PP_RVC_FLAGS,
@@ -44,14 +129,22 @@ auto LoadScene(
   importer.SetPropertyInteger(
     AI_CONFIG_PP_SBP_REMOVE, aiPrimitiveType_POINT | aiPrimitiveType_LINE);
   auto const scene{
-    importer.ReadFile(path.string().c_str(), aiProcess_CalcTangentSpace |
-                      aiProcess_JoinIdenticalVertices | aiProcess_Triangulate |
-                      aiProcess_RemoveComponent | aiProcess_GenNormals |
-                      aiProcess_ValidateDataStructure |
-                      aiProcess_RemoveRedundantMaterials | aiProcess_SortByPType
-                      | aiProcess_GenUVCoords | aiProcess_FindInstances |
-                      aiProcess_OptimizeMeshes | aiProcess_OptimizeGraph |
-                      aiProcess_GlobalScale | aiProcess_ConvertToLeftHanded)
+    [&importer, &path] {
+      PENSIEVE_PROFILE_ZONE("ReadFile");
+      return importer.ReadFile(path.string().c_str(),
+                               aiProcess_CalcTangentSpace |
+                               aiProcess_JoinIdenticalVertices |
+                               aiProcess_Triangulate |
+                               aiProcess_RemoveComponent |
+                               aiProcess_GenNormals |
+                               aiProcess_ValidateDataStructure |
+                               aiProcess_RemoveRedundantMaterials |
+                               aiProcess_SortByPType | aiProcess_GenUVCoords |
+                               aiProcess_FindInstances |
+                               aiProcess_OptimizeMeshes |
+                               aiProcess_OptimizeGraph | aiProcess_GlobalScale
+                               | aiProcess_ConvertToLeftHanded);
+    }()
   };
 
   if (!scene) {
@@ -124,164 +217,38 @@ auto LoadScene(
     }
   }
 
-  for (auto const& tex_path : tex_paths_to_idx | std::views::keys) {
-    if (auto const tex{scene->GetEmbeddedTexture(tex_path.c_str())}) {
-      if (tex->mHeight == 0) {
-        int width;
-        int height;
-        int channels;
-        auto const bytes{
-          stbi_load_from_memory(std::bit_cast<std::uint8_t*>(tex->pcData),
-                                tex->mWidth, &width, &height, &channels, 4)
-        };
-
-        if (!bytes) {
-          return std::unexpected{
-            std::format("Failed to load compressed embedded texture \"{}\".",
-                        tex_path.c_str())
-          };
-        }
-
-        scene_data.textures.emplace_back(static_cast<unsigned>(width),
-                                         static_cast<unsigned>(height),
-                                         std::unique_ptr<std::uint8_t[]>{
-                                           bytes
-                                         });
-      } else {
-        auto& tex_data{
-          scene_data.textures.emplace_back(tex->mWidth, tex->mHeight,
-                                           std::make_unique_for_overwrite<
-                                             std::uint8_t []>(
-                                             tex->mWidth * tex->mHeight * 4))
-        };
-        std::memcpy(tex_data.bytes.get(), tex->pcData,
-                    tex->mWidth * tex->mHeight * 4);
-      }
-    } else {
-      auto const tex_path_abs{path.parent_path() / tex_path.c_str()};
-
-      int width;
-      int height;
-      int channels;
-      auto const bytes{
-        stbi_load(tex_path_abs.string().c_str(), &width, &height, &channels, 4)
-      };
-
-      if (!bytes) {
-        return std::unexpected{
-          std::format("Failed to load texture at {}.", tex_path.c_str())
-        };
-      }
-
-      scene_data.textures.emplace_back(static_cast<unsigned>(width),
-                                       static_cast<unsigned>(height),
-                                       std::unique_ptr<std::uint8_t[]>{bytes});
-    }
+  std::vector<std::string> tex_paths(tex_paths_to_idx.size());
+  for (auto const& [tex_path, idx] : tex_paths_to_idx) {
+    tex_paths[idx] = tex_path;
   }
 
-  for (unsigned i{0}; i < scene->mNumMeshes; i++) {
-    auto const mesh{scene->mMeshes[i]};
-
-    if (!mesh->HasPositions()) {
-      return std::unexpected{
-        std::format("Mesh {} contains no vertex positions.",
-                    mesh->mName.C_Str())
-      };
-    }
-
-    std::vector<DirectX::XMFLOAT3> positions;
-    positions.reserve(mesh->mNumVertices);
-    std::ranges::transform(mesh->mVertices,
-                           mesh->mVertices + mesh->mNumVertices,
-                           std::back_inserter(positions),
-                           [](aiVector3D const& pos) {
-                             return DirectX::XMFLOAT3{pos.x, pos.y, pos.z};
-                           });
-
-    std::optional<std::vector<Float2>> uvs;
-
-    if (mesh->HasTextureCoords(0)) {
-      uvs.emplace();
-      uvs->reserve(mesh->mNumVertices);
-      std::ranges::transform(mesh->mTextureCoords[0],
-                             mesh->mTextureCoords[0] + mesh->mNumVertices,
-                             std::back_inserter(*uvs),
-                             [](aiVector3D const& uv) {
-                               return Float2{uv.x, uv.y};
-                             });
-    }
-
-    if (!mesh->HasNormals()) {
-      return std::unexpected{
-        std::format("Mesh {} contains no vertex normals.", mesh->mName.C_Str())
-      };
-    }
-
-    std::vector<Float4> normals;
-    normals.reserve(mesh->mNumVertices);
-    std::ranges::transform(mesh->mNormals, mesh->mNormals + mesh->mNumVertices,
-                           std::back_inserter(normals),
-                           [](aiVector3D const& normal) {
-                             return Float4{normal.x, normal.y, normal.z, 0.0f};
-                           });
-
-    std::optional<std::vector<Float4>> tangents;
-
-    if (mesh->HasTangentsAndBitangents()) {
-      tangents.emplace();
-      tangents->reserve(mesh->mNumVertices);
-      std::ranges::transform(mesh->mTangents,
-                             mesh->mTangents + mesh->mNumVertices,
-                             std::back_inserter(*tangents),
-                             [](aiVector3D const& tangent) {
-                               return Float4{
-                                 tangent.x, tangent.y, tangent.z, 0.0f
-                               };
-                             });
-    }
-
-    if (!mesh->HasFaces()) {
-      return std::unexpected{
-        std::format("Mesh {} contains no vertex indices.", mesh->mName.C_Str())
-      };
+  // Textures are decoded by jobs while the meshes are converted. Results are
+  // stored by index so the output stays deterministic.
+  auto const scene_dir{path.parent_path()};
+  std::vector<DecodedTexture> decoded_textures(tex_paths.size());
+  JobCounter tex_counter;
+  ScheduleTextureDecodes(job_system, *scene, scene_dir, tex_paths,
+                         decoded_textures, tex_counter);
+
+  std::vector<std::expected<MeshData, std::string>> meshes(scene->mNumMeshes);
+  job_system.ParallelFor(scene->mNumMeshes, 1,
+                         [scene, &meshes](std::size_t const begin,
+                                          std::size_t const end) {
+                           for (auto i{begin}; i < end; i++) {
+                             meshes[i] = ConvertMesh(*scene->mMeshes[i]);
+                           }
+                         });
+
+  scene_data.meshes.reserve(meshes.size());
+
+  for (auto& mesh : meshes) {
+    if (!mesh) {
+      // The texture jobs reference locals.
+      job_system.Wait(tex_counter);
+      return std::unexpected{mesh.error()};
     }
 
-    std::vector<std::uint32_t> indices;
-    indices.reserve(mesh->mNumFaces * 3);
-    for (unsigned j{0}; j < mesh->mNumFaces; j++) {
-      std::ranges::copy_n(mesh->mFaces[j].mIndices, mesh->mFaces[j].mNumIndices,
-                          std::back_inserter(indices));
-    }
-
-    std::vector<MeshletData> meshlets;
-    std::vector<std::uint8_t> vertex_indices;
-    std::vector<MeshletTriangleIndexData> primitive_indices;
-
-    if (FAILED(
-      ComputeMeshlets(indices.data(), indices.size() / 3, positions.data(),
-        positions.size(), nullptr, reinterpret_cast<std::vector<DirectX::Meshlet
-        >&>(meshlets), vertex_indices, reinterpret_cast<std::vector<DirectX::
-        MeshletTriangle>&>(primitive_indices), kMeshletMaxVerts,
-        kMeshletMaxPrims))) {
-      return std::unexpected{
-        std::format("Failed to generate meshlets for mesh {}.",
-                    mesh->mName.C_Str())
-      };
-    }
-
-    std::vector<Float4> positions4;
-    positions4.reserve(positions.size());
-    std::ranges::transform(positions, std::back_inserter(positions4),
-                           [](DirectX::XMFLOAT3 const& pos) {
-                             return Float4{pos.x, pos.y, pos.z, 1.0f};
-                           });
-
-    scene_data.meshes.emplace_back(std::move(positions4), std::move(normals),
-                                   std::move(tangents), std::move(uvs),
-                                   std::move(meshlets),
-                                   std::move(vertex_indices),
-                                   std::move(primitive_indices),
-                                   mesh->mMaterialIndex);
+    scene_data.meshes.emplace_back(std::move(*mesh));
   }
 
   std::stack<std::pair<aiNode const*, aiMatrix4x4>> nodes;
@@ -296,186 +263,96 @@ auto LoadScene(
       nodes.emplace(node->mChildren[i], node_global_transform);
     }
 
-    std::vector<unsigned> mesh_indices;
-    mesh_indices.reserve(node->mNumMeshes);
-    std::ranges::copy_n(node->mMeshes, node->mNumMeshes,
-                        std::back_inserter(mesh_indices));
-
-    scene_data.nodes.emplace_back(std::move(mesh_indices), Float4X4{
-                                    node_global_transform.a1,
-                                    node_global_transform.b1,
-                                    node_global_transform.c1,
-                                    node_global_transform.d1,
-                                    node_global_transform.a2,
-                                    node_global_transform.b2,
-                                    node_global_transform.c2,
-                                    node_global_transform.d2,
-                                    node_global_transform.a3,
-                                    node_global_transform.b3,
-                                    node_global_transform.c3,
-                                    node_global_transform.d3,
-                                    node_global_transform.a4,
-                                    node_global_transform.b4,
-                                    node_global_transform.c4,
-                                    node_global_transform.d4,
-                                  });
-  }
-
-  return scene_data;
-}
-
-auto WriteScene(std::ofstream& out, SceneData const& scene) -> void {
-  std::span constexpr header{"pensieve"};
-  out.write(header.data(), header.size());
-
-  auto const texture_count{scene.textures.size()};
-  out.write(std::bit_cast<char const*>(&texture_count), sizeof(texture_count));
-
-  for (auto const& tex : scene.textures) {
-    out.write(std::bit_cast<char const*>(&tex.width), sizeof(tex.width));
-    out.write(std::bit_cast<char const*>(&tex.height), sizeof(tex.height));
-    out.write(std::bit_cast<char const*>(tex.bytes.get()),
-              4 * tex.width * tex.height);
-  }
-
-  auto const material_count{scene.materials.size()};
-  out.write(std::bit_cast<char const*>(&material_count),
-            sizeof(material_count));
-
-  for (auto const& mtl : scene.materials) {
-    out.write(std::bit_cast<char const*>(&mtl.base_color),
-              sizeof(mtl.base_color));
-    out.write(std::bit_cast<char const*>(&mtl.metallic), sizeof(mtl.metallic));
-    out.write(std::bit_cast<char const*>(&mtl.roughness),
-              sizeof(mtl.roughness));
-    out.write(std::bit_cast<char const*>(&mtl.emission_color),
-              sizeof(mtl.emission_color));
-
-    int const has_base_color_map{mtl.base_color_map_idx.has_value()};
-    out.write(std::bit_cast<char const*>(&has_base_color_map),
-              sizeof(has_base_color_map));
-
-    if (has_base_color_map) {
-      out.write(std::bit_cast<char const*>(&*mtl.base_color_map_idx),
-                sizeof(*mtl.base_color_map_idx));
-    }
-
-    int const has_metallic_map{mtl.metallic_map_idx.has_value()};
-    out.write(std::bit_cast<char const*>(&has_metallic_map),
-              sizeof(has_metallic_map));
-
-    if (has_metallic_map) {
-      out.write(std::bit_cast<char const*>(&*mtl.metallic_map_idx),
-                sizeof(*mtl.metallic_map_idx));
-    }
-
-    int const has_roughness_map{mtl.roughness_map_idx.has_value()};
-    out.write(std::bit_cast<char const*>(&has_roughness_map),
-              sizeof(has_roughness_map));
-
-    if (has_roughness_map) {
-      out.write(std::bit_cast<char const*>(&*mtl.roughness_map_idx),
-                sizeof(*mtl.roughness_map_idx));
+    if (node->mNumMeshes == 0) {
+      continue;
     }
 
-    int const has_emission_map{mtl.emission_map_idx.has_value()};
-    out.write(std::bit_cast<char const*>(&has_emission_map),
-              sizeof(has_emission_map));
-
-    if (has_emission_map) {
-      out.write(std::bit_cast<char const*>(&*mtl.emission_map_idx),
-                sizeof(*mtl.emission_map_idx));
-    }
-
-    int const has_normal_map{mtl.normal_map_idx.has_value()};
-    out.write(std::bit_cast<char const*>(&has_normal_map),
-              sizeof(has_normal_map));
-
-    if (has_normal_map) {
-      out.write(std::bit_cast<char const*>(&*mtl.normal_map_idx),
-                sizeof(*mtl.normal_map_idx));
+    // Transposed into a row vector matrix, Assimp uses column vectors.
+    std::array<float, 16> const model_mtx{
+      node_global_transform.a1, node_global_transform.b1,
+      node_global_transform.c1, node_global_transform.d1,
+      node_global_transform.a2, node_global_transform.b2,
+      node_global_transform.c2, node_global_transform.d2,
+      node_global_transform.a3, node_global_transform.b3,
+      node_global_transform.c3, node_global_transform.d3,
+      node_global_transform.a4, node_global_transform.b4,
+      node_global_transform.c4, node_global_transform.d4
+    };
+
+    InstanceData const instance{PackModelMatrix(model_mtx)};
+
+    for (unsigned i{0}; i < node->mNumMeshes; i++) {
+      scene_data.meshes[node->mMeshes[i]].instances.emplace_back(instance);
     }
   }
 
-  auto const mesh_count{scene.meshes.size()};
-  out.write(std::bit_cast<char const*>(&mesh_count), sizeof(mesh_count));
+  auto const bvh_build_start{std::chrono::steady_clock::now()};
+  scene_data.bvh = BuildBvh(scene_data);
+  std::chrono::duration<double, std::milli> const bvh_build_time{
+    std::chrono::steady_clock::now() - bvh_build_start
+  };
+  std::cout << std::format(
+    "Built BVH with {} nodes over {} instances in {:.2f} ms.\n",
+    scene_data.bvh.nodes.size(), scene_data.bvh.instance_refs.size(),
+    bvh_build_time.count());
 
-  for (auto const& mesh : scene.meshes) {
-    auto const vertex_count{mesh.positions.size()};
-    out.write(std::bit_cast<char const*>(&vertex_count), sizeof(vertex_count));
-    out.write(std::bit_cast<char const*>(mesh.positions.data()),
-              vertex_count * sizeof(decltype(mesh.positions)::value_type));
-    out.write(std::bit_cast<char const*>(mesh.normals.data()),
-              vertex_count * sizeof(decltype(mesh.normals)::value_type));
+  job_system.Wait(tex_counter);
 
-    int const has_tangents{mesh.tangents.has_value()};
-    out.write(std::bit_cast<char const*>(&has_tangents), sizeof(has_tangents));
+  std::chrono::duration<double, std::milli> total_decode_time{0};
 
-    if (has_tangents) {
-      out.write(std::bit_cast<char const*>(mesh.tangents->data()),
-                vertex_count * sizeof(decltype(mesh.tangents
-                )::value_type::value_type));
+  for (std::size_t i{0}; i < decoded_textures.size(); i++) {
+    if (!decoded_textures[i].tex) {
+      return std::unexpected{decoded_textures[i].tex.error()};
     }
 
-    int const has_uvs{mesh.uvs.has_value()};
-    out.write(std::bit_cast<char const*>(&has_uvs), sizeof(has_uvs));
-
-    if (has_uvs) {
-      out.write(std::bit_cast<char const*>(mesh.uvs->data()),
-                vertex_count * sizeof(decltype(mesh.uvs
-                )::value_type::value_type));
-    }
+    total_decode_time += decoded_textures[i].decode_time;
+    std::cout << std::format("Decoded texture {} ({}x{}) in {:.2f} ms.\n",
+                             tex_paths[i], decoded_textures[i].tex->width,
+                             decoded_textures[i].tex->height,
+                             decoded_textures[i].decode_time.count());
+    scene_data.textures.emplace_back(std::move(*decoded_textures[i].tex));
+  }
 
-    auto const meshlet_count{mesh.meshlets.size()};
-    out.write(std::bit_cast<char const*>(&meshlet_count),
-              sizeof(meshlet_count));
-    out.write(std::bit_cast<char const*>(mesh.meshlets.data()),
-              meshlet_count * sizeof(decltype(mesh.meshlets)::value_type));
-
-    auto const vertex_index_count{mesh.vertex_indices.size()};
-    out.write(std::bit_cast<char const*>(&vertex_index_count),
-              sizeof(vertex_index_count));
-    out.write(std::bit_cast<char const*>(mesh.vertex_indices.data()),
-              vertex_index_count * sizeof(decltype(mesh.vertex_indices
-              )::value_type));
-
-    auto const triangle_index_count{mesh.triangle_indices.size()};
-    out.write(std::bit_cast<char const*>(&triangle_index_count),
-              sizeof(triangle_index_count));
-    out.write(std::bit_cast<char const*>(mesh.triangle_indices.data()),
-              triangle_index_count * sizeof(decltype(mesh.triangle_indices
-              )::value_type));
-
-    out.write(std::bit_cast<char const*>(&mesh.material_idx),
-              sizeof(mesh.material_idx));
+  if (!decoded_textures.empty()) {
+    std::cout << std::format(
+      "Decoded {} textures, {:.2f} ms total decode time.\n",
+      decoded_textures.size(), total_decode_time.count());
   }
 
-  auto const node_count{scene.nodes.size()};
-  out.write(std::bit_cast<char const*>(&node_count), sizeof(node_count));
-
-  for (auto const& node : scene.nodes) {
-    auto const mesh_index_count{node.mesh_indices.size()};
-    out.write(std::bit_cast<char const*>(&mesh_index_count),
-              sizeof(mesh_index_count));
-    out.write(std::bit_cast<char const*>(node.mesh_indices.data()),
-              mesh_index_count * sizeof(decltype(node.mesh_indices
-              )::value_type));
-    out.write(std::bit_cast<char const*>(&node.transform),
-              sizeof(node.transform));
+  if (auto const [byte_count_before, byte_count_after]{
+    PackSingleChannelTextures(scene_data)
+  }; byte_count_before != byte_count_after) {
+    std::cout << std::format(
+      "Packed single channel textures from {} to {} bytes.\n",
+      byte_count_before, byte_count_after);
   }
+
+  return scene_data;
 }
 }
 
 auto main(int const argc, char** const argv) -> int {
-  if (argc < 3) {
-    std::cout <<
-      "Usage: meshlet-generator <source-model-file> <destination-file>\n";
+  if (argc != 3 && !(argc == 5 && std::string_view{argv[3]} == "--profile")) {
+    std::cout << "Usage: meshlet-generator <source-model-file> "
+      "<destination-file> [--profile <trace-file>]\n";
     return EXIT_SUCCESS;
   }
 
+  std::optional<std::string_view> const profile_path{
+    argc == 5 ? std::optional{std::string_view{argv[4]}} : std::nullopt
+  };
+
+  if (profile_path && !pensieve::kProfilerEnabled) {
+    std::cerr << "Warning: built without PENSIEVE_ENABLE_PROFILER, the trace "
+      "will be empty.\n";
+  }
+
+  pensieve::SetProfilerThreadName("Main thread");
+
   std::cout << "Processing mesh...\n";
 
-  auto const scene{pensieve::LoadScene(argv[1])};
+  pensieve::JobSystem job_system;
+  auto const scene{pensieve::LoadScene(argv[1], job_system)};
 
   if (!scene) {
     std::cerr << "Error: " << scene.error() << '\n';
@@ -493,5 +370,14 @@ auto main(int const argc, char** const argv) -> int {
 
   WriteScene(out, *scene);
 
+  if (profile_path) {
+    std::cout << pensieve::FormatProfilerSummary();
+
+    if (auto const exp{pensieve::WriteProfilerTrace(*profile_path)}; !exp) {
+      std::cerr << "Error: " << exp.error() << '\n';
+      return EXIT_FAILURE;
+    }
+  }
+
   return EXIT_SUCCESS;
 }
@@ -0,0 +1,149 @@
+#include "mesh_conversion.hpp"
+
+#include <algorithm>
+#include <format>
+#include <iterator>
+#include <optional>
+#include <utility>
+
+#include <DirectXMath.h>
+#include <DirectXMesh.h>
+
+#include "profiler.hpp"
+
+namespace pensieve {
+namespace {
+constexpr auto kMeshletMaxVerts{128};
+constexpr auto kMeshletMaxPrims{256};
+}
+
+auto ConvertMeshAttributes(aiMesh const& mesh,
+                           std::vector<std::uint32_t>& indices) ->
+  std::expected<MeshData, std::string> {
+  PENSIEVE_PROFILE_ZONE("ConvertMeshAttributes");
+
+  if (!mesh.HasPositions()) {
+    return std::unexpected{
+      std::format("Mesh {} contains no vertex positions.",
+                  mesh.mName.C_Str())
+    };
+  }
+
+  std::vector<Float4> positions;
+  positions.reserve(mesh.mNumVertices);
+  std::ranges::transform(mesh.mVertices,
+                         mesh.mVertices + mesh.mNumVertices,
+                         std::back_inserter(positions),
+                         [](aiVector3D const& pos) {
+                           return Float4{pos.x, pos.y, pos.z, 1.0f};
+                         });
+
+  std::optional<std::vector<Float2>> uvs;
+
+  if (mesh.HasTextureCoords(0)) {
+    uvs.emplace();
+    uvs->reserve(mesh.mNumVertices);
+    std::ranges::transform(mesh.mTextureCoords[0],
+                           mesh.mTextureCoords[0] + mesh.mNumVertices,
+                           std::back_inserter(*uvs),
+                           [](aiVector3D const& uv) {
+                             return Float2{uv.x, uv.y};
+                           });
+  }
+
+  if (!mesh.HasNormals()) {
+    return std::unexpected{
+      std::format("Mesh {} contains no vertex normals.", mesh.mName.C_Str())
+    };
+  }
+
+  std::vector<Float4> normals;
+  normals.reserve(mesh.mNumVertices);
+  std::ranges::transform(mesh.mNormals, mesh.mNormals + mesh.mNumVertices,
+                         std::back_inserter(normals),
+                         [](aiVector3D const& normal) {
+                           return Float4{normal.x, normal.y, normal.z, 0.0f};
+                         });
+
+  std::optional<std::vector<Float4>> tangents;
+
+  if (mesh.HasTangentsAndBitangents()) {
+    tangents.emplace();
+    tangents->reserve(mesh.mNumVertices);
+    std::ranges::transform(mesh.mTangents,
+                           mesh.mTangents + mesh.mNumVertices,
+                           std::back_inserter(*tangents),
+                           [](aiVector3D const& tangent) {
+                             return Float4{
+                               tangent.x, tangent.y, tangent.z, 0.0f
+                             };
+                           });
+  }
+
+  if (!mesh.HasFaces()) {
+    return std::unexpected{
+      std::format("Mesh {} contains no vertex indices.", mesh.mName.C_Str())
+    };
+  }
+
+  indices.reserve(indices.size() + mesh.mNumFaces * 3);
+  for (unsigned j{0}; j < mesh.mNumFaces; j++) {
+    std::ranges::copy_n(mesh.mFaces[j].mIndices, mesh.mFaces[j].mNumIndices,
+                        std::back_inserter(indices));
+  }
+
+  return MeshData{
+    std::move(positions), std::move(normals), std::move(tangents),
+    std::move(uvs), {}, {}, {}, mesh.mMaterialIndex, {}
+  };
+}
+
+auto GenerateMeshlets(std::span<std::uint32_t const> const indices,
+                      MeshData& mesh) -> std::expected<void, std::string> {
+  PENSIEVE_PROFILE_ZONE("ComputeMeshlets");
+
+  std::vector<DirectX::XMFLOAT3> positions;
+  positions.reserve(mesh.positions.size());
+  std::ranges::transform(mesh.positions, std::back_inserter(positions),
+                         [](Float4 const& pos) {
+                           return DirectX::XMFLOAT3{pos[0], pos[1], pos[2]};
+                         });
+
+  mesh.meshlets.clear();
+  mesh.vertex_indices.clear();
+  mesh.triangle_indices.clear();
+
+  if (FAILED(
+    ComputeMeshlets(indices.data(), indices.size() / 3, positions.data(),
+                    positions.size(), nullptr,
+                    reinterpret_cast<std::vector<DirectX::Meshlet>&>(
+                      mesh.meshlets), mesh.vertex_indices,
+                    reinterpret_cast<std::vector<DirectX::MeshletTriangle>&>(
+                      mesh.triangle_indices), kMeshletMaxVerts,
+                    kMeshletMaxPrims))) {
+    return std::unexpected{"ComputeMeshlets failed."};
+  }
+
+  return {};
+}
+
+auto ConvertMesh(aiMesh const& mesh) -> std::expected<MeshData, std::string> {
+  PENSIEVE_PROFILE_ZONE("ConvertMesh");
+
+  std::vector<std::uint32_t> indices;
+  auto mesh_data{ConvertMeshAttributes(mesh, indices)};
+
+  if (!mesh_data) {
+    return std::unexpected{mesh_data.error()};
+  }
+
+  if (!GenerateMeshlets(indices, *mesh_data)) {
+    return std::unexpected{
+      std::format("Failed to generate meshlets for mesh {}.",
+                  mesh.mName.C_Str())
+    };
+  }
+
+  return mesh_data;
+}
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <expected>
+#include <span>
+#include <string>
+#include <vector>
+
+#include <assimp/mesh.h>
+
+#include "scene_data.hpp"
+
+namespace pensieve {
+// Copies the vertex attributes of a triangulated mesh and appends its
+// triangle list to indices. The meshlets are left empty.
+[[nodiscard]] auto ConvertMeshAttributes(
+  aiMesh const& mesh,
+  std::vector<std::uint32_t>& indices) -> std::expected<MeshData, std::string>;
+
+// Splits the triangle list into the meshlets of the mesh.
+[[nodiscard]] auto GenerateMeshlets(std::span<std::uint32_t const> indices,
+                                    MeshData& mesh) -> std::expected<
+  void, std::string>;
+
+// Meshlets are generated with the mesh positions, instances are added later
+// from the node hierarchy.
+[[nodiscard]] auto ConvertMesh(
+  aiMesh const& mesh) -> std::expected<MeshData, std::string>;
+}
@@ -0,0 +1,349 @@
+#include "precompressed_texture.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <format>
+#include <memory>
+#include <optional>
+
+namespace pensieve {
+namespace {
+constexpr std::array<std::uint8_t, 4> kDdsMagic{'D', 'D', 'S', ' '};
+constexpr std::array<std::uint8_t, 12> kKtx2Identifier{
+  0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n'
+};
+
+constexpr std::size_t kDdsHeaderEnd{128};
+constexpr std::size_t kDdsDx10HeaderEnd{148};
+constexpr std::uint32_t kDdsFlagMipMapCount{0x20000};
+constexpr std::uint32_t kDdsPixelFormatFlagFourCc{0x4};
+constexpr std::uint32_t kDdsCaps2CubeMap{0x200};
+constexpr std::uint32_t kDdsCaps2Volume{0x200000};
+constexpr std::uint32_t kDdsDx10ResourceDimensionTexture2D{3};
+constexpr std::uint32_t kDdsDx10MiscFlagTextureCube{0x4};
+
+constexpr std::size_t kKtx2LevelIndexOffset{80};
+constexpr std::size_t kKtx2LevelIndexEntrySize{24};
+
+constexpr std::uint32_t kMaxMipCount{15};
+
+[[nodiscard]] constexpr auto MakeFourCc(char const a, char const b,
+                                        char const c,
+                                        char const d) -> std::uint32_t {
+  return static_cast<std::uint32_t>(a) | static_cast<std::uint32_t>(b) << 8 |
+    static_cast<std::uint32_t>(c) << 16 | static_cast<std::uint32_t>(d) << 24;
+}
+
+template <std::size_t N>
+[[nodiscard]] auto StartsWith(std::span<std::uint8_t const> const bytes,
+                              std::array<std::uint8_t, N> const& prefix) ->
+  bool {
+  return bytes.size() >= N && std::ranges::equal(bytes.first(N), prefix);
+}
+
+template <typename T>
+[[nodiscard]] auto ReadLittleEndian(std::span<std::uint8_t const> const bytes,
+                                    std::size_t const offset) -> T {
+  T ret;
+  std::memcpy(&ret, bytes.data() + offset, sizeof(T));
+  return ret;
+}
+
+// sRGB variants map to their UNORM counterparts because the pixel shader
+// applies gamma itself.
+[[nodiscard]] auto FourCcToTextureFormat(
+  std::uint32_t const four_cc) -> std::optional<TextureFormat> {
+  switch (four_cc) {
+  case MakeFourCc('D', 'X', 'T', '1'):
+    return TextureFormat::kBc1Unorm;
+  case MakeFourCc('D', 'X', 'T', '2'):
+  case MakeFourCc('D', 'X', 'T', '3'):
+    return TextureFormat::kBc2Unorm;
+  case MakeFourCc('D', 'X', 'T', '4'):
+  case MakeFourCc('D', 'X', 'T', '5'):
+    return TextureFormat::kBc3Unorm;
+  case MakeFourCc('A', 'T', 'I', '1'):
+  case MakeFourCc('B', 'C', '4', 'U'):
+    return TextureFormat::kBc4Unorm;
+  case MakeFourCc('A', 'T', 'I', '2'):
+  case MakeFourCc('B', 'C', '5', 'U'):
+    return TextureFormat::kBc5Unorm;
+  default:
+    return std::nullopt;
+  }
+}
+
+[[nodiscard]] auto DxgiFormatToTextureFormat(
+  std::uint32_t const dxgi_format) -> std::optional<TextureFormat> {
+  switch (dxgi_format) {
+  case 28: // DXGI_FORMAT_R8G8B8A8_UNORM
+  case 29: // DXGI_FORMAT_R8G8B8A8_UNORM_SRGB
+    return TextureFormat::kR8G8B8A8Unorm;
+  case 71: // DXGI_FORMAT_BC1_UNORM
+  case 72: // DXGI_FORMAT_BC1_UNORM_SRGB
+    return TextureFormat::kBc1Unorm;
+  case 74: // DXGI_FORMAT_BC2_UNORM
+  case 75: // DXGI_FORMAT_BC2_UNORM_SRGB
+    return TextureFormat::kBc2Unorm;
+  case 77: // DXGI_FORMAT_BC3_UNORM
+  case 78: // DXGI_FORMAT_BC3_UNORM_SRGB
+    return TextureFormat::kBc3Unorm;
+  case 80: // DXGI_FORMAT_BC4_UNORM
+    return TextureFormat::kBc4Unorm;
+  case 83: // DXGI_FORMAT_BC5_UNORM
+    return TextureFormat::kBc5Unorm;
+  case 98: // DXGI_FORMAT_BC7_UNORM
+  case 99: // DXGI_FORMAT_BC7_UNORM_SRGB
+    return TextureFormat::kBc7Unorm;
+  default:
+    return std::nullopt;
+  }
+}
+
+[[nodiscard]] auto VkFormatToTextureFormat(
+  std::uint32_t const vk_format) -> std::optional<TextureFormat> {
+  switch (vk_format) {
+  case 37: // VK_FORMAT_R8G8B8A8_UNORM
+  case 43: // VK_FORMAT_R8G8B8A8_SRGB
+    return TextureFormat::kR8G8B8A8Unorm;
+  case 131: // VK_FORMAT_BC1_RGB_UNORM_BLOCK
+  case 132: // VK_FORMAT_BC1_RGB_SRGB_BLOCK
+  case 133: // VK_FORMAT_BC1_RGBA_UNORM_BLOCK
+  case 134: // VK_FORMAT_BC1_RGBA_SRGB_BLOCK
+    return TextureFormat::kBc1Unorm;
+  case 135: // VK_FORMAT_BC2_UNORM_BLOCK
+  case 136: // VK_FORMAT_BC2_SRGB_BLOCK
+    return TextureFormat::kBc2Unorm;
+  case 137: // VK_FORMAT_BC3_UNORM_BLOCK
+  case 138: // VK_FORMAT_BC3_SRGB_BLOCK
+    return TextureFormat::kBc3Unorm;
+  case 139: // VK_FORMAT_BC4_UNORM_BLOCK
+    return TextureFormat::kBc4Unorm;
+  case 141: // VK_FORMAT_BC5_UNORM_BLOCK
+    return TextureFormat::kBc5Unorm;
+  case 145: // VK_FORMAT_BC7_UNORM_BLOCK
+  case 146: // VK_FORMAT_BC7_SRGB_BLOCK
+    return TextureFormat::kBc7Unorm;
+  default:
+    return std::nullopt;
+  }
+}
+
+[[nodiscard]] auto ValidateDimensions(TextureFormat const format,
+                                      std::uint32_t const width,
+                                      std::uint32_t const height,
+                                      std::uint32_t const mip_count) ->
+  std::expected<void, std::string> {
+  if (width == 0 || height == 0) {
+    return std::unexpected{"Texture has zero extent."};
+  }
+
+  if (mip_count == 0 || mip_count > kMaxMipCount) {
+    return std::unexpected{
+      std::format("Texture has unsupported mip count {}.", mip_count)
+    };
+  }
+
+  if (IsBlockCompressed(format) && (width % 4 != 0 || height % 4 != 0)) {
+    return std::unexpected{
+      std::format(
+        "Block compressed texture dimensions {}x{} are not multiples of 4.",
+        width, height)
+    };
+  }
+
+  return {};
+}
+
+[[nodiscard]] auto LoadDdsTexture(
+  std::span<std::uint8_t const> const bytes) -> std::expected<
+  TextureData, std::string> {
+  if (bytes.size() < kDdsHeaderEnd) {
+    return std::unexpected{"DDS file is truncated."};
+  }
+
+  auto const flags{ReadLittleEndian<std::uint32_t>(bytes, 8)};
+  auto const height{ReadLittleEndian<std::uint32_t>(bytes, 12)};
+  auto const width{ReadLittleEndian<std::uint32_t>(bytes, 16)};
+  auto const mip_count{
+    flags & kDdsFlagMipMapCount
+      ? std::max(ReadLittleEndian<std::uint32_t>(bytes, 28), 1u)
+      : 1u
+  };
+  auto const pixel_format_flags{ReadLittleEndian<std::uint32_t>(bytes, 80)};
+  auto const four_cc{ReadLittleEndian<std::uint32_t>(bytes, 84)};
+  auto const caps2{ReadLittleEndian<std::uint32_t>(bytes, 112)};
+
+  if (caps2 & (kDdsCaps2CubeMap | kDdsCaps2Volume)) {
+    return std::unexpected{"DDS cube maps and volume textures are unsupported."};
+  }
+
+  if (!(pixel_format_flags & kDdsPixelFormatFlagFourCc)) {
+    return std::unexpected{"Uncompressed legacy DDS formats are unsupported."};
+  }
+
+  std::optional<TextureFormat> format;
+  auto data_offset{kDdsHeaderEnd};
+
+  if (four_cc == MakeFourCc('D', 'X', '1', '0')) {
+    if (bytes.size() < kDdsDx10HeaderEnd) {
+      return std::unexpected{"DDS file is truncated."};
+    }
+
+    auto const dxgi_format{ReadLittleEndian<std::uint32_t>(bytes, 128)};
+    auto const resource_dimension{ReadLittleEndian<std::uint32_t>(bytes, 132)};
+    auto const misc_flag{ReadLittleEndian<std::uint32_t>(bytes, 136)};
+    auto const array_size{ReadLittleEndian<std::uint32_t>(bytes, 140)};
+
+    if (resource_dimension != kDdsDx10ResourceDimensionTexture2D ||
+      array_size != 1 || misc_flag & kDdsDx10MiscFlagTextureCube) {
+      return std::unexpected{"Only single 2D DDS textures are supported."};
+    }
+
+    format = DxgiFormatToTextureFormat(dxgi_format);
+
+    if (!format) {
+      return std::unexpected{
+        std::format("Unsupported DDS DXGI format {}.", dxgi_format)
+      };
+    }
+
+    data_offset = kDdsDx10HeaderEnd;
+  } else {
+    format = FourCcToTextureFormat(four_cc);
+
+    if (!format) {
+      return std::unexpected{
+        std::format("Unsupported DDS FourCC 0x{:08X}.", four_cc)
+      };
+    }
+  }
+
+  if (auto const exp{ValidateDimensions(*format, width, height, mip_count)}; !
+    exp) {
+    return std::unexpected{exp.error()};
+  }
+
+  auto const byte_count{
+    CalculateTextureByteCount(*format, width, height, mip_count)
+  };
+
+  if (bytes.size() - data_offset < byte_count) {
+    return std::unexpected{"DDS file is truncated."};
+  }
+
+  TextureData tex{
+    width, height, mip_count, *format,
+    std::make_unique_for_overwrite<std::uint8_t[]>(byte_count)
+  };
+  std::memcpy(tex.bytes.get(), bytes.data() + data_offset, byte_count);
+  return tex;
+}
+
+[[nodiscard]] auto LoadKtx2Texture(
+  std::span<std::uint8_t const> const bytes) -> std::expected<
+  TextureData, std::string> {
+  if (bytes.size() < kKtx2LevelIndexOffset) {
+    return std::unexpected{"KTX2 file is truncated."};
+  }
+
+  auto const vk_format{ReadLittleEndian<std::uint32_t>(bytes, 12)};
+  auto const width{ReadLittleEndian<std::uint32_t>(bytes, 20)};
+  auto const height{ReadLittleEndian<std::uint32_t>(bytes, 24)};
+  auto const depth{ReadLittleEndian<std::uint32_t>(bytes, 28)};
+  auto const layer_count{ReadLittleEndian<std::uint32_t>(bytes, 32)};
+  auto const face_count{ReadLittleEndian<std::uint32_t>(bytes, 36)};
+  auto const mip_count{
+    std::max(ReadLittleEndian<std::uint32_t>(bytes, 40), 1u)
+  };
+  auto const supercompression_scheme{
+    ReadLittleEndian<std::uint32_t>(bytes, 44)
+  };
+
+  if (depth > 1 || layer_count > 1 || face_count != 1) {
+    return std::unexpected{"Only single 2D KTX2 textures are supported."};
+  }
+
+  if (supercompression_scheme != 0) {
+    return std::unexpected{"Supercompressed KTX2 textures are unsupported."};
+  }
+
+  auto const format{VkFormatToTextureFormat(vk_format)};
+
+  if (!format) {
+    return std::unexpected{
+      std::format("Unsupported KTX2 Vulkan format {}.", vk_format)
+    };
+  }
+
+  if (auto const exp{ValidateDimensions(*format, width, height, mip_count)}; !
+    exp) {
+    return std::unexpected{exp.error()};
+  }
+
+  if (bytes.size() < kKtx2LevelIndexOffset + mip_count *
+    kKtx2LevelIndexEntrySize) {
+    return std::unexpected{"KTX2 file is truncated."};
+  }
+
+  TextureData tex{
+    width, height, mip_count, *format,
+    std::make_unique_for_overwrite<std::uint8_t[]>(
+      CalculateTextureByteCount(*format, width, height, mip_count))
+  };
+
+  std::size_t dst_offset{0};
+
+  for (std::uint32_t mip{0}; mip < mip_count; mip++) {
+    auto const entry_offset{
+      kKtx2LevelIndexOffset + mip * kKtx2LevelIndexEntrySize
+    };
+    auto const src_offset{ReadLittleEndian<std::uint64_t>(bytes, entry_offset)};
+    auto const src_size{
+      ReadLittleEndian<std::uint64_t>(bytes, entry_offset + 8)
+    };
+    auto const [row_pitch, row_count]{
+      GetTextureMipLayout(*format, width, height, mip)
+    };
+    auto const mip_size{static_cast<std::size_t>(row_pitch) * row_count};
+
+    if (src_size != mip_size) {
+      return std::unexpected{
+        std::format("KTX2 mip {} has unexpected size {}.", mip, src_size)
+      };
+    }
+
+    if (src_offset > bytes.size() || bytes.size() - src_offset < mip_size) {
+      return std::unexpected{"KTX2 file is truncated."};
+    }
+
+    std::memcpy(tex.bytes.get() + dst_offset, bytes.data() + src_offset,
+                mip_size);
+    dst_offset += mip_size;
+  }
+
+  return tex;
+}
+}
+
+auto IsPrecompressedTexture(std::span<std::uint8_t const> const bytes) -> bool {
+  return StartsWith(bytes, kDdsMagic) ||
+    StartsWith(bytes, kKtx2Identifier);
+}
+
+auto LoadPrecompressedTexture(
+  std::span<std::uint8_t const> const bytes) -> std::expected<
+  TextureData, std::string> {
+  if (StartsWith(bytes, kDdsMagic)) {
+    return LoadDdsTexture(bytes);
+  }
+
+  if (StartsWith(bytes, kKtx2Identifier)) {
+    return LoadKtx2Texture(bytes);
+  }
+
+  return std::unexpected{"Texture is neither a DDS nor a KTX2 file."};
+}
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+#include <expected>
+#include <span>
+#include <string>
+
+#include "scene_data.hpp"
+
+namespace pensieve {
+// Returns whether the bytes hold a DDS or KTX2 container whose blocks can be
+// copied into the scene file without decoding.
+[[nodiscard]] auto IsPrecompressedTexture(
+  std::span<std::uint8_t const> bytes) -> bool;
+
+// Copies the mip chain of a DDS or KTX2 container as is.
+[[nodiscard]] auto LoadPrecompressedTexture(
+  std::span<std::uint8_t const> bytes) -> std::expected<
+  TextureData, std::string>;
+}
@@ -0,0 +1,35 @@
+#include "texture_decoding.hpp"
+
+#include <memory>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+#include "precompressed_texture.hpp"
+
+namespace pensieve {
+auto DecodeEncodedTexture(
+  std::span<std::uint8_t const> const bytes) -> std::expected<
+  TextureData, std::string> {
+  if (IsPrecompressedTexture(bytes)) {
+    return LoadPrecompressedTexture(bytes);
+  }
+
+  int width;
+  int height;
+  int channels;
+  auto const texels{
+    stbi_load_from_memory(bytes.data(), static_cast<int>(bytes.size()), &width,
+                          &height, &channels, 4)
+  };
+
+  if (!texels) {
+    return std::unexpected{std::string{stbi_failure_reason()}};
+  }
+
+  return TextureData{
+    static_cast<unsigned>(width), static_cast<unsigned>(height), 1,
+    TextureFormat::kR8G8B8A8Unorm, std::unique_ptr<std::uint8_t[]>{texels}
+  };
+}
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstdint>
+#include <expected>
+#include <span>
+#include <string>
+
+#include "scene_data.hpp"
+
+namespace pensieve {
+// Precompressed DDS and KTX2 containers are copied as is, everything else is
+// decoded to RGBA8.
+[[nodiscard]] auto DecodeEncodedTexture(
+  std::span<std::uint8_t const> bytes) -> std::expected<
+  TextureData, std::string>;
+}
@@ -0,0 +1,169 @@
+#include "texture_packing.hpp"
+
+#include <cstdint>
+#include <initializer_list>
+#include <map>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace pensieve {
+namespace {
+enum TextureUsage : std::uint8_t {
+  kTextureUsageColor = 1 << 0,
+  kTextureUsageMetallic = 1 << 1,
+  kTextureUsageRoughness = 1 << 2,
+};
+
+[[nodiscard]] auto CalculateByteCount(TextureData const& tex) -> std::size_t {
+  return CalculateTextureByteCount(tex.format, tex.width, tex.height,
+                                   tex.mip_count);
+}
+
+// Builds a texture whose nth channel is the red channel of the nth source.
+[[nodiscard]] auto MakeRedChannelTexture(
+  std::initializer_list<TextureData const*> const sources) -> TextureData {
+  auto const& first{**sources.begin()};
+  auto const channel_count{sources.size()};
+  auto const texel_count{
+    static_cast<std::size_t>(first.width) * first.height
+  };
+
+  TextureData ret{
+    first.width, first.height, 1,
+    channel_count == 1 ? TextureFormat::kR8Unorm : TextureFormat::kR8G8Unorm,
+    std::make_unique_for_overwrite<std::uint8_t[]>(texel_count * channel_count)
+  };
+
+  std::size_t channel{0};
+  for (auto const src : sources) {
+    for (std::size_t i{0}; i < texel_count; i++) {
+      ret.bytes[i * channel_count + channel] = src->bytes[i * 4];
+    }
+    ++channel;
+  }
+
+  return ret;
+}
+}
+
+auto PackSingleChannelTextures(SceneData& scene) -> TexturePackingStats {
+  TexturePackingStats stats{0, 0};
+
+  for (auto const& tex : scene.textures) {
+    stats.byte_count_before += CalculateByteCount(tex);
+  }
+
+  std::vector<std::uint8_t> usages(scene.textures.size(), 0);
+
+  for (auto const& mtl : scene.materials) {
+    for (auto const& idx : {
+           mtl.base_color_map_idx, mtl.emission_map_idx, mtl.normal_map_idx
+         }) {
+      if (idx) {
+        usages[*idx] |= kTextureUsageColor;
+      }
+    }
+
+    if (mtl.metallic_map_idx) {
+      usages[*mtl.metallic_map_idx] |= kTextureUsageMetallic;
+    }
+
+    if (mtl.roughness_map_idx) {
+      usages[*mtl.roughness_map_idx] |= kTextureUsageRoughness;
+    }
+  }
+
+  auto const is_narrowable{
+    [&scene, &usages](std::uint32_t const idx) {
+      return !(usages[idx] & kTextureUsageColor) && scene.textures[idx].format
+        == TextureFormat::kR8G8B8A8Unorm && scene.textures[idx].mip_count == 1;
+    }
+  };
+
+  std::vector<TextureData> packed_textures;
+  std::vector<std::optional<std::uint32_t>> remapped_indices(
+    scene.textures.size());
+  std::map<std::pair<std::uint32_t, std::uint32_t>, std::uint32_t>
+    merged_indices;
+
+  // Narrowable textures are copied because a merged texture may still need
+  // them; all other textures are moved.
+  auto const remap{
+    [&scene, &packed_textures, &remapped_indices, &is_narrowable](
+    std::uint32_t const idx) {
+      if (!remapped_indices[idx]) {
+        remapped_indices[idx] = static_cast<std::uint32_t>(packed_textures.
+          size());
+
+        if (is_narrowable(idx)) {
+          packed_textures.emplace_back(
+            MakeRedChannelTexture({&scene.textures[idx]}));
+        } else {
+          packed_textures.emplace_back(std::move(scene.textures[idx]));
+        }
+      }
+
+      return *remapped_indices[idx];
+    }
+  };
+
+  for (auto& mtl : scene.materials) {
+    if (mtl.metallic_map_idx && mtl.roughness_map_idx && *mtl.metallic_map_idx
+      != *mtl.roughness_map_idx && is_narrowable(*mtl.metallic_map_idx) &&
+      is_narrowable(*mtl.roughness_map_idx)) {
+      auto const& metallic_map{scene.textures[*mtl.metallic_map_idx]};
+      auto const& roughness_map{scene.textures[*mtl.roughness_map_idx]};
+
+      if (metallic_map.width == roughness_map.width && metallic_map.height ==
+        roughness_map.height) {
+        auto const [it, inserted]{
+          merged_indices.try_emplace(
+            {*mtl.metallic_map_idx, *mtl.roughness_map_idx},
+            static_cast<std::uint32_t>(packed_textures.size()))
+        };
+
+        if (inserted) {
+          packed_textures.emplace_back(
+            MakeRedChannelTexture({&metallic_map, &roughness_map}));
+        }
+
+        mtl.metallic_map_idx = it->second;
+        mtl.metallic_map_channel = 0;
+        mtl.roughness_map_idx = it->second;
+        mtl.roughness_map_channel = 1;
+        continue;
+      }
+    }
+
+    if (mtl.metallic_map_idx) {
+      mtl.metallic_map_idx = remap(*mtl.metallic_map_idx);
+      mtl.metallic_map_channel = 0;
+    }
+
+    if (mtl.roughness_map_idx) {
+      mtl.roughness_map_idx = remap(*mtl.roughness_map_idx);
+      mtl.roughness_map_channel = 0;
+    }
+  }
+
+  for (auto& mtl : scene.materials) {
+    for (auto* const idx : {
+           &mtl.base_color_map_idx, &mtl.emission_map_idx, &mtl.normal_map_idx
+         }) {
+      if (*idx) {
+        *idx = remap(**idx);
+      }
+    }
+  }
+
+  scene.textures = std::move(packed_textures);
+
+  for (auto const& tex : scene.textures) {
+    stats.byte_count_after += CalculateByteCount(tex);
+  }
+
+  return stats;
+}
+}
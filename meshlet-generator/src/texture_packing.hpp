@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+
+#include "scene_data.hpp"
+
+namespace pensieve {
+struct TexturePackingStats {
+  std::size_t byte_count_before;
+  std::size_t byte_count_after;
+};
+
+// Stores RGBA8 textures that are only sampled as metallic or roughness maps
+// as R8, and merges the metallic and roughness maps of a material into a
+// single RG8 texture when they have matching dimensions. Material texture
+// indices and channels are rewritten to match, and textures that are no
+// longer referenced are dropped.
+auto PackSingleChannelTextures(SceneData& scene) -> TexturePackingStats;
+}
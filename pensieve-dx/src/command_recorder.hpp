@@ -0,0 +1,147 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "indirect_draw.hpp"
+#include "mega_buffer.hpp"
+
+namespace pensieve {
+// DWORD offsets of the frame wide DrawParams fields.
+inline constexpr std::uint32_t kDrawParamsViewProjMtxOffset{0};
+inline constexpr std::uint32_t kDrawParamsCameraPosOffset{16};
+inline constexpr std::uint32_t kDrawParamsDrawRecordBufIdxOffset{19};
+inline constexpr std::uint32_t kDrawParamsGeometryBufIdxOffset{20};
+inline constexpr std::uint32_t kDrawParamsDwordCount{
+  kDrawParamsGeometryBufIdxOffset + kGeometryStreamCount + sizeof(
+    IndirectDrawConstants) / sizeof(std::uint32_t)
+};
+
+// The commands a frame is built from, independent of the graphics API.
+class CommandRecorder {
+public:
+  constexpr virtual ~CommandRecorder() = default;
+
+  // Sets consecutive DWORDs of the DrawParams root constants.
+  constexpr virtual auto SetDrawParams(std::uint32_t dword_offset,
+                                       std::span<std::uint32_t const> values)
+    -> void = 0;
+
+  // Each command sets the per draw DrawParams fields and dispatches the mesh
+  // shader.
+  constexpr virtual auto DrawIndirect(
+    std::span<IndirectDrawCommand const> commands) -> void = 0;
+};
+
+// The buffer indices shared by every draw of a scene.
+struct SceneDrawBindings {
+  std::uint32_t draw_record_buf_idx;
+  std::array<std::uint32_t, kGeometryStreamCount> geometry_buf_indices;
+};
+
+// Records the draws of a frame whose commands were built by
+// AppendIndirectDrawCommands.
+constexpr auto RecordSceneDraws(CommandRecorder& recorder,
+                                std::span<float const, 16> const view_proj_mtx,
+                                std::span<float const, 3> const camera_pos,
+                                SceneDrawBindings const& bindings,
+                                std::span<IndirectDrawCommand const> const
+                                commands) -> void {
+  std::array<std::uint32_t, 16> view_proj_mtx_bits;
+  std::ranges::transform(view_proj_mtx, view_proj_mtx_bits.begin(),
+                         std::bit_cast<std::uint32_t, float>);
+  recorder.SetDrawParams(kDrawParamsViewProjMtxOffset, view_proj_mtx_bits);
+
+  std::array<std::uint32_t, 3> camera_pos_bits;
+  std::ranges::transform(camera_pos, camera_pos_bits.begin(),
+                         std::bit_cast<std::uint32_t, float>);
+  recorder.SetDrawParams(kDrawParamsCameraPosOffset, camera_pos_bits);
+
+  if (commands.empty()) {
+    return;
+  }
+
+  recorder.SetDrawParams(kDrawParamsDrawRecordBufIdxOffset,
+                         std::array{bindings.draw_record_buf_idx});
+  recorder.SetDrawParams(kDrawParamsGeometryBufIdxOffset,
+                         bindings.geometry_buf_indices);
+  recorder.DrawIndirect(commands);
+}
+
+struct RecordedCommandStats {
+  std::uint64_t command_count;
+  std::uint64_t draw_params_dword_count;
+  std::uint64_t dispatch_count;
+  std::uint64_t thread_group_count;
+  // Written to the indirect argument buffer.
+  std::uint64_t argument_byte_count;
+};
+
+// Backend that keeps the commands in memory instead of submitting them, so
+// frame building can run and be measured without a GPU.
+class RecordingCommandRecorder final : public CommandRecorder {
+public:
+  // A dispatch with the DrawParams it would see.
+  struct RecordedDispatch {
+    std::array<std::uint32_t, kDrawParamsDwordCount> draw_params;
+    DispatchMeshArguments args;
+  };
+
+  constexpr ~RecordingCommandRecorder() override {}
+
+  constexpr auto SetDrawParams(std::uint32_t const dword_offset,
+                               std::span<std::uint32_t const> const values) ->
+    void override {
+    std::ranges::copy(values, draw_params_.begin() + dword_offset);
+    ++stats_.command_count;
+    stats_.draw_params_dword_count += values.size();
+  }
+
+  constexpr auto DrawIndirect(
+    std::span<IndirectDrawCommand const> const commands) -> void override {
+    ++stats_.command_count;
+    stats_.argument_byte_count += commands.size_bytes();
+
+    for (auto const& [constants, args] : commands) {
+      auto draw_params{draw_params_};
+      std::ranges::copy(std::array{
+                          constants.instances_per_group,
+                          constants.meshlet_offset, constants.instance_count,
+                          constants.instance_offset, constants.draw_record_idx
+                        },
+                        draw_params.end() - sizeof(IndirectDrawConstants) /
+                        sizeof(std::uint32_t));
+      dispatches_.emplace_back(draw_params, args);
+
+      ++stats_.dispatch_count;
+      stats_.thread_group_count += std::uint64_t{args.thread_group_count_x} *
+        args.thread_group_count_y * args.thread_group_count_z;
+    }
+  }
+
+  [[nodiscard]] constexpr auto GetDispatches() const -> std::span<
+    RecordedDispatch const> {
+    return dispatches_;
+  }
+
+  [[nodiscard]] constexpr auto GetStats() const -> RecordedCommandStats {
+    return stats_;
+  }
+
+  // Starts over like a reset command list, whose root constants are unset.
+  constexpr auto Reset() -> void {
+    draw_params_ = {};
+    dispatches_.clear();
+    stats_ = {0, 0, 0, 0, 0};
+  }
+
+private:
+  std::array<std::uint32_t, kDrawParamsDwordCount> draw_params_{};
+  std::vector<RecordedDispatch> dispatches_;
+  RecordedCommandStats stats_{0, 0, 0, 0, 0};
+};
+}
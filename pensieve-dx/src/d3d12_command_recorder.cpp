@@ -0,0 +1,33 @@
+#include "d3d12_command_recorder.hpp"
+
+#include <algorithm>
+
+namespace pensieve {
+D3D12CommandRecorder::D3D12CommandRecorder(
+  ID3D12GraphicsCommandList7* const cmd_list,
+  ID3D12CommandSignature* const draw_cmd_sig,
+  GpuIndirectDrawBuffer const& indirect_draw_buf,
+  std::size_t const first_cmd_idx) :
+  cmd_list_{cmd_list}, draw_cmd_sig_{draw_cmd_sig},
+  indirect_draw_buf_{&indirect_draw_buf},
+  next_indirect_draw_cmd_idx_{first_cmd_idx} {}
+
+auto D3D12CommandRecorder::SetDrawParams(std::uint32_t const dword_offset,
+                                         std::span<std::uint32_t const> const
+                                         values) -> void {
+  cmd_list_->SetGraphicsRoot32BitConstants(
+    0, static_cast<UINT>(values.size()), values.data(), dword_offset);
+}
+
+auto D3D12CommandRecorder::DrawIndirect(
+  std::span<IndirectDrawCommand const> const commands) -> void {
+  std::ranges::copy(commands,
+                    indirect_draw_buf_->commands.begin() +
+                    next_indirect_draw_cmd_idx_);
+  cmd_list_->ExecuteIndirect(draw_cmd_sig_, static_cast<UINT>(commands.size()),
+                             indirect_draw_buf_->buf->GetResource(),
+                             next_indirect_draw_cmd_idx_ * sizeof(
+                               IndirectDrawCommand), nullptr, 0);
+  next_indirect_draw_cmd_idx_ += commands.size();
+}
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#include <d3d12.h>
+
+#include "command_recorder.hpp"
+#include "gpu_scene.hpp"
+
+namespace pensieve {
+// Records into a direct command list whose root signature has the DrawParams
+// as its first parameter.
+class D3D12CommandRecorder final : public CommandRecorder {
+public:
+  // Indirect commands are written to the persistently mapped buffer one after
+  // the other starting at first_cmd_idx, so that recorders of different
+  // command lists can share the buffer. It must have room for all of them.
+  D3D12CommandRecorder(ID3D12GraphicsCommandList7* cmd_list,
+                       ID3D12CommandSignature* draw_cmd_sig,
+                       GpuIndirectDrawBuffer const& indirect_draw_buf,
+                       std::size_t first_cmd_idx);
+
+  auto SetDrawParams(std::uint32_t dword_offset,
+                     std::span<std::uint32_t const> values) -> void override;
+
+  auto DrawIndirect(
+    std::span<IndirectDrawCommand const> commands) -> void override;
+
+private:
+  ID3D12GraphicsCommandList7* cmd_list_;
+  ID3D12CommandSignature* draw_cmd_sig_;
+  GpuIndirectDrawBuffer const* indirect_draw_buf_;
+  std::size_t next_indirect_draw_cmd_idx_;
+};
+}
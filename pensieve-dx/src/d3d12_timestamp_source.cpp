@@ -0,0 +1,133 @@
+#include "d3d12_timestamp_source.hpp"
+
+#include <format>
+#include <utility>
+
+#include <d3dx12.h>
+
+using Microsoft::WRL::ComPtr;
+
+namespace pensieve {
+auto D3D12TimestampSource::Create(ID3D12Device10* const device,
+                                  D3D12MA::Allocator* const mem_allocator,
+                                  ID3D12CommandQueue* const queue,
+                                  UINT const frame_slot_count) ->
+  std::expected<D3D12TimestampSource, std::string> {
+  D3D12_QUERY_HEAP_DESC const query_heap_desc{
+    D3D12_QUERY_HEAP_TYPE_TIMESTAMP, 2 * frame_slot_count, 0
+  };
+
+  ComPtr<ID3D12QueryHeap> query_heap;
+  if (FAILED(
+    device->CreateQueryHeap(&query_heap_desc, IID_PPV_ARGS(&query_heap)))) {
+    return std::unexpected{"Failed to create timestamp query heap."};
+  }
+
+  D3D12MA::ALLOCATION_DESC constexpr readback_alloc_desc{
+    D3D12MA::ALLOCATION_FLAG_NONE, D3D12_HEAP_TYPE_READBACK,
+    D3D12_HEAP_FLAG_NONE, nullptr, nullptr
+  };
+
+  auto const readback_buf_desc{
+    CD3DX12_RESOURCE_DESC1::Buffer(2 * frame_slot_count * sizeof(UINT64))
+  };
+
+  ComPtr<D3D12MA::Allocation> readback_buf;
+  if (FAILED(
+    mem_allocator->CreateResource3(&readback_alloc_desc, &readback_buf_desc,
+      D3D12_BARRIER_LAYOUT_UNDEFINED, nullptr, 0, nullptr, &readback_buf,
+      IID_NULL, nullptr))) {
+    return std::unexpected{"Failed to create timestamp readback buffer."};
+  }
+
+  // Stays mapped, slots are only read once the GPU finished writing them.
+  D3D12_RANGE const read_range{0, readback_buf_desc.Width};
+  void* mapped;
+  if (FAILED(readback_buf->GetResource()->Map(0, &read_range, &mapped))) {
+    return std::unexpected{"Failed to map timestamp readback buffer."};
+  }
+
+  UINT64 timestamp_frequency;
+  if (FAILED(queue->GetTimestampFrequency(&timestamp_frequency))) {
+    return std::unexpected{"Failed to get timestamp frequency."};
+  }
+
+  UINT64 calibration_timestamp;
+  UINT64 calibration_cpu_timestamp;
+  if (FAILED(
+    queue->GetClockCalibration(&calibration_timestamp, &
+      calibration_cpu_timestamp))) {
+    return std::unexpected{"Failed to calibrate timestamps."};
+  }
+
+  return D3D12TimestampSource{
+    std::move(query_heap), std::move(readback_buf),
+    std::span{static_cast<std::uint64_t const*>(mapped), 2 * frame_slot_count},
+    timestamp_frequency, calibration_timestamp,
+    std::chrono::steady_clock::now()
+  };
+}
+
+auto D3D12TimestampSource::BeginFrame(
+  ID3D12GraphicsCommandList7* const cmd_list,
+  std::uint64_t const frame_idx) -> void {
+  auto const slot{frame_idx % slot_frame_indices_.size()};
+  slot_frame_indices_[slot].reset();
+  cmd_list->EndQuery(query_heap_.Get(), D3D12_QUERY_TYPE_TIMESTAMP,
+                     static_cast<UINT>(2 * slot));
+}
+
+auto D3D12TimestampSource::EndFrame(ID3D12GraphicsCommandList7* const cmd_list,
+                                    std::uint64_t const frame_idx) -> void {
+  auto const slot{frame_idx % slot_frame_indices_.size()};
+  cmd_list->EndQuery(query_heap_.Get(), D3D12_QUERY_TYPE_TIMESTAMP,
+                     static_cast<UINT>(2 * slot + 1));
+  cmd_list->ResolveQueryData(query_heap_.Get(), D3D12_QUERY_TYPE_TIMESTAMP,
+                             static_cast<UINT>(2 * slot), 2,
+                             readback_buf_->GetResource(),
+                             2 * slot * sizeof(UINT64));
+  slot_frame_indices_[slot] = frame_idx;
+}
+
+auto D3D12TimestampSource::ReadFrameSpan(
+  std::uint64_t const frame_idx) -> std::optional<GpuFrameSpan> {
+  auto const slot{frame_idx % slot_frame_indices_.size()};
+
+  if (slot_frame_indices_[slot] != frame_idx) {
+    return std::nullopt;
+  }
+
+  auto const begin{timestamps_[2 * slot]};
+  auto const end{timestamps_[2 * slot + 1]};
+
+  if (end < begin) {
+    return std::nullopt;
+  }
+
+  return GpuFrameSpan{
+    ToSteadyClock(begin), ToSteadyClock(end) - ToSteadyClock(begin)
+  };
+}
+
+D3D12TimestampSource::D3D12TimestampSource(
+  ComPtr<ID3D12QueryHeap> query_heap, ComPtr<D3D12MA::Allocation> readback_buf,
+  std::span<std::uint64_t const> const timestamps,
+  UINT64 const timestamp_frequency, UINT64 const calibration_timestamp,
+  std::chrono::steady_clock::time_point const calibration_time) :
+  query_heap_{std::move(query_heap)}, readback_buf_{std::move(readback_buf)},
+  timestamps_{timestamps}, slot_frame_indices_(timestamps.size() / 2),
+  timestamp_frequency_{timestamp_frequency},
+  calibration_timestamp_{calibration_timestamp},
+  calibration_time_{calibration_time} {}
+
+auto D3D12TimestampSource::ToSteadyClock(
+  UINT64 const timestamp) const -> std::chrono::steady_clock::time_point {
+  // Signed, as the calibration can be taken after the timestamp.
+  std::chrono::duration<double> const since_calibration{
+    (static_cast<double>(timestamp) - static_cast<double>(
+      calibration_timestamp_)) / static_cast<double>(timestamp_frequency_)
+  };
+  return calibration_time_ + std::chrono::duration_cast<
+    std::chrono::steady_clock::duration>(since_calibration);
+}
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <expected>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
+
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#include <d3d12.h>
+#include <D3D12MemAlloc.h>
+#include <wrl/client.h>
+
+#include "frame_telemetry.hpp"
+
+namespace pensieve {
+// Measures the GPU work of frames with timestamp queries at the start of the
+// frame's first command list and the end of its last one. Every frame in
+// flight has its own slot in the query heap and the readback buffer.
+class D3D12TimestampSource final : public GpuTimestampSource {
+public:
+  [[nodiscard]] static auto Create(ID3D12Device10* device,
+                                   D3D12MA::Allocator* mem_allocator,
+                                   ID3D12CommandQueue* queue,
+                                   UINT frame_slot_count) -> std::expected<
+    D3D12TimestampSource, std::string>;
+
+  auto BeginFrame(ID3D12GraphicsCommandList7* cmd_list,
+                  std::uint64_t frame_idx) -> void;
+  // Also resolves the timestamps of the frame to the readback buffer.
+  auto EndFrame(ID3D12GraphicsCommandList7* cmd_list,
+                std::uint64_t frame_idx) -> void;
+
+  [[nodiscard]] auto ReadFrameSpan(
+    std::uint64_t frame_idx) -> std::optional<GpuFrameSpan> override;
+
+private:
+  D3D12TimestampSource(Microsoft::WRL::ComPtr<ID3D12QueryHeap> query_heap,
+                       Microsoft::WRL::ComPtr<D3D12MA::Allocation> readback_buf,
+                       std::span<std::uint64_t const> timestamps,
+                       UINT64 timestamp_frequency,
+                       UINT64 calibration_timestamp,
+                       std::chrono::steady_clock::time_point calibration_time);
+
+  // Converts a timestamp to the CPU clock through the calibration point.
+  [[nodiscard]] auto ToSteadyClock(
+    UINT64 timestamp) const -> std::chrono::steady_clock::time_point;
+
+  Microsoft::WRL::ComPtr<ID3D12QueryHeap> query_heap_;
+  Microsoft::WRL::ComPtr<D3D12MA::Allocation> readback_buf_;
+  // Begin and end timestamps of every slot.
+  std::span<std::uint64_t const> timestamps_;
+  // The frame whose timestamps each slot holds.
+  std::vector<std::optional<std::uint64_t>> slot_frame_indices_;
+  UINT64 timestamp_frequency_;
+  UINT64 calibration_timestamp_;
+  std::chrono::steady_clock::time_point calibration_time_;
+};
+}
@@ -0,0 +1,17 @@
+#include "descriptor_allocator.hpp"
+
+namespace pensieve {
+DescriptorAllocator::DescriptorAllocator(std::uint32_t const capacity) :
+  mutex_{std::make_unique<std::mutex>()}, allocator_{capacity} {}
+
+auto DescriptorAllocator::Allocate(
+  std::uint32_t const count) -> std::optional<std::uint32_t> {
+  std::scoped_lock const lock{*mutex_};
+  return allocator_.Allocate(count);
+}
+
+auto DescriptorAllocator::Free(std::uint32_t const first) -> void {
+  std::scoped_lock const lock{*mutex_};
+  allocator_.Free(first);
+}
+}
@@ -0,0 +1,298 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+namespace pensieve {
+// Two level segregated fit allocator of contiguous index ranges. Free ranges
+// are kept in size classes found through bitmaps, so allocating and freeing
+// take constant time and adjacent free ranges are merged immediately. Only
+// when no larger class has a free range is the class of the requested size
+// itself searched.
+class IndexRangeAllocator {
+public:
+  static auto constexpr invalid_idx_{
+    std::numeric_limits<std::uint32_t>::max()
+  };
+
+  explicit constexpr IndexRangeAllocator(std::uint32_t const capacity) :
+    range_at_(capacity, invalid_idx_), free_count_{capacity} {
+    if (capacity != 0) {
+      InsertFreeRange(CreateRange(0, capacity, invalid_idx_, invalid_idx_));
+    }
+  }
+
+  // Returns the first index of the range or nothing if there is no free range
+  // of the requested size.
+  [[nodiscard]] constexpr auto Allocate(
+    std::uint32_t const count) -> std::optional<std::uint32_t> {
+    if (count == 0 || count > free_count_) {
+      return std::nullopt;
+    }
+
+    auto const range_idx{FindFreeRange(count)};
+
+    if (range_idx == invalid_idx_) {
+      return std::nullopt;
+    }
+
+    RemoveFreeRange(range_idx);
+
+    if (auto const& range{ranges_[range_idx]}; range.count > count) {
+      auto const rest_idx{
+        CreateRange(range.first + count, range.count - count, range_idx,
+                    range.next_adjacent)
+      };
+
+      if (ranges_[rest_idx].next_adjacent != invalid_idx_) {
+        ranges_[ranges_[rest_idx].next_adjacent].prev_adjacent = rest_idx;
+      }
+
+      ranges_[range_idx].count = count;
+      ranges_[range_idx].next_adjacent = rest_idx;
+      InsertFreeRange(rest_idx);
+    }
+
+    free_count_ -= count;
+    return ranges_[range_idx].first;
+  }
+
+  // Takes the first index of a range returned by Allocate.
+  constexpr auto Free(std::uint32_t const first) -> void {
+    auto range_idx{range_at_[first]};
+    free_count_ += ranges_[range_idx].count;
+
+    if (auto const next_idx{ranges_[range_idx].next_adjacent}; next_idx !=
+      invalid_idx_ && ranges_[next_idx].is_free) {
+      RemoveFreeRange(next_idx);
+      MergeWithNext(range_idx);
+    }
+
+    if (auto const prev_idx{ranges_[range_idx].prev_adjacent}; prev_idx !=
+      invalid_idx_ && ranges_[prev_idx].is_free) {
+      RemoveFreeRange(prev_idx);
+      MergeWithNext(prev_idx);
+      range_idx = prev_idx;
+    }
+
+    InsertFreeRange(range_idx);
+  }
+
+  [[nodiscard]] constexpr auto GetCapacity() const -> std::uint32_t {
+    return static_cast<std::uint32_t>(range_at_.size());
+  }
+
+  [[nodiscard]] constexpr auto GetFreeCount() const -> std::uint32_t {
+    return free_count_;
+  }
+
+  // Number of separate free ranges, one when nothing is fragmented.
+  [[nodiscard]] constexpr auto GetFreeRangeCount() const -> std::uint32_t {
+    return free_range_count_;
+  }
+
+private:
+  static auto constexpr sl_count_log2_{4};
+  static auto constexpr sl_count_{1u << sl_count_log2_};
+  static auto constexpr fl_count_{32 - sl_count_log2_ + 1};
+
+  struct Range {
+    std::uint32_t first;
+    std::uint32_t count;
+    std::uint32_t prev_adjacent;
+    std::uint32_t next_adjacent;
+    std::uint32_t prev_free;
+    std::uint32_t next_free;
+    bool is_free;
+  };
+
+  struct SizeClass {
+    std::uint32_t fl;
+    std::uint32_t sl;
+  };
+
+  // Counts below the second level count get a class of their own, larger ones
+  // split each power of two into second level count classes.
+  [[nodiscard]] static constexpr auto GetSizeClass(
+    std::uint32_t const count) -> SizeClass {
+    if (count < sl_count_) {
+      return {0, count};
+    }
+
+    auto const width{static_cast<std::uint32_t>(std::bit_width(count))};
+    return {
+      width - sl_count_log2_,
+      (count >> (width - 1 - sl_count_log2_)) - sl_count_
+    };
+  }
+
+  // Returns a free range of at least count indices or the invalid index.
+  [[nodiscard]] constexpr auto FindFreeRange(
+    std::uint32_t const count) const -> std::uint32_t {
+    // Rounding up to the next class makes every range in it large enough.
+    auto const round{
+      count < sl_count_
+        ? 0
+        : (1u << (std::bit_width(count) - 1 - sl_count_log2_)) - 1
+    };
+
+    if (count <= std::numeric_limits<std::uint32_t>::max() - round) {
+      auto [fl, sl]{GetSizeClass(count + round)};
+      auto sl_map{sl_bitmaps_[fl] & (~0u << sl)};
+
+      if (sl_map == 0 && fl + 1 < fl_count_) {
+        if (auto const fl_map{fl_bitmap_ & (~0u << (fl + 1))}; fl_map != 0) {
+          fl = static_cast<std::uint32_t>(std::countr_zero(fl_map));
+          sl_map = sl_bitmaps_[fl];
+        }
+      }
+
+      if (sl_map != 0) {
+        sl = static_cast<std::uint32_t>(std::countr_zero(sl_map));
+        return free_heads_[fl][sl];
+      }
+    }
+
+    // Only the class of the count itself can still have a large enough range,
+    // e.g. when allocating all indices at once.
+    auto const [fl, sl]{GetSizeClass(count)};
+
+    for (auto range_idx{free_heads_[fl][sl]}; range_idx != invalid_idx_;
+         range_idx = ranges_[range_idx].next_free) {
+      if (ranges_[range_idx].count >= count) {
+        return range_idx;
+      }
+    }
+
+    return invalid_idx_;
+  }
+
+  [[nodiscard]] constexpr auto CreateRange(std::uint32_t const first,
+                                           std::uint32_t const count,
+                                           std::uint32_t const prev_adjacent,
+                                           std::uint32_t const next_adjacent)
+    -> std::uint32_t {
+    std::uint32_t range_idx;
+
+    if (unused_range_indices_.empty()) {
+      range_idx = static_cast<std::uint32_t>(ranges_.size());
+      ranges_.emplace_back();
+    } else {
+      range_idx = unused_range_indices_.back();
+      unused_range_indices_.pop_back();
+    }
+
+    ranges_[range_idx] = Range{
+      first, count, prev_adjacent, next_adjacent, invalid_idx_, invalid_idx_,
+      false
+    };
+    range_at_[first] = range_idx;
+    return range_idx;
+  }
+
+  // The next adjacent range must not be in a free list.
+  constexpr auto MergeWithNext(std::uint32_t const range_idx) -> void {
+    auto& range{ranges_[range_idx]};
+    auto const next_idx{range.next_adjacent};
+    auto const& next{ranges_[next_idx]};
+
+    range.count += next.count;
+    range.next_adjacent = next.next_adjacent;
+
+    if (range.next_adjacent != invalid_idx_) {
+      ranges_[range.next_adjacent].prev_adjacent = range_idx;
+    }
+
+    range_at_[next.first] = invalid_idx_;
+    unused_range_indices_.emplace_back(next_idx);
+  }
+
+  constexpr auto InsertFreeRange(std::uint32_t const range_idx) -> void {
+    auto& range{ranges_[range_idx]};
+    auto const [fl, sl]{GetSizeClass(range.count)};
+    auto& head{free_heads_[fl][sl]};
+
+    range.is_free = true;
+    range.prev_free = invalid_idx_;
+    range.next_free = head;
+
+    if (head != invalid_idx_) {
+      ranges_[head].prev_free = range_idx;
+    }
+
+    head = range_idx;
+    fl_bitmap_ |= 1u << fl;
+    sl_bitmaps_[fl] |= 1u << sl;
+    ++free_range_count_;
+  }
+
+  constexpr auto RemoveFreeRange(std::uint32_t const range_idx) -> void {
+    auto& range{ranges_[range_idx]};
+    auto const [fl, sl]{GetSizeClass(range.count)};
+
+    if (range.prev_free != invalid_idx_) {
+      ranges_[range.prev_free].next_free = range.next_free;
+    } else {
+      free_heads_[fl][sl] = range.next_free;
+    }
+
+    if (range.next_free != invalid_idx_) {
+      ranges_[range.next_free].prev_free = range.prev_free;
+    }
+
+    if (free_heads_[fl][sl] == invalid_idx_) {
+      sl_bitmaps_[fl] &= ~(1u << sl);
+
+      if (sl_bitmaps_[fl] == 0) {
+        fl_bitmap_ &= ~(1u << fl);
+      }
+    }
+
+    range.is_free = false;
+    --free_range_count_;
+  }
+
+  std::vector<Range> ranges_;
+  std::vector<std::uint32_t> unused_range_indices_;
+  // Index of the range starting at each index, only valid at range starts.
+  std::vector<std::uint32_t> range_at_;
+  std::array<std::array<std::uint32_t, sl_count_>, fl_count_> free_heads_{
+    [] {
+      std::array<std::array<std::uint32_t, sl_count_>, fl_count_> ret{};
+
+      for (auto& sl_heads : ret) {
+        sl_heads.fill(invalid_idx_);
+      }
+
+      return ret;
+    }()
+  };
+  std::array<std::uint32_t, fl_count_> sl_bitmaps_{};
+  std::uint32_t fl_bitmap_{0};
+  std::uint32_t free_count_;
+  std::uint32_t free_range_count_{0};
+};
+
+// Indices of a shader visible descriptor heap that can be allocated from
+// several threads.
+class DescriptorAllocator {
+public:
+  explicit DescriptorAllocator(std::uint32_t capacity);
+
+  [[nodiscard]] auto Allocate(
+    std::uint32_t count) -> std::optional<std::uint32_t>;
+
+  auto Free(std::uint32_t first) -> void;
+
+private:
+  // Behind a pointer to keep the allocator movable.
+  std::unique_ptr<std::mutex> mutex_;
+  IndexRangeAllocator allocator_;
+};
+}
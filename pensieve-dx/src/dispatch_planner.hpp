@@ -0,0 +1,177 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "scene_data.hpp"
+#include "util.hpp"
+
+namespace pensieve {
+auto constexpr kMaxDispatchGroupCount{65535u};
+
+// A range of meshlets that pack the same number of instances into a group
+// and that is small enough to be dispatched at once. Every meshlet gets the
+// same number of groups, each drawing up to instances_per_group instances.
+struct MeshletDispatchChunk {
+  std::uint32_t meshlet_offset;
+  std::uint32_t meshlet_count;
+  std::uint32_t instances_per_group;
+  std::uint32_t max_instance_count_per_dispatch;
+};
+
+struct InstanceDispatch {
+  std::uint32_t instance_offset;
+  std::uint32_t instance_count;
+  std::uint32_t group_count;
+};
+
+// The meshlet and instance range a group of a dispatch draws.
+struct GroupAssignment {
+  std::uint32_t meshlet_idx;
+  std::uint32_t start_instance;
+  std::uint32_t instance_count;
+};
+
+// Thread slots written with vertices versus all vertex thread slots of the
+// dispatched groups.
+struct DispatchOccupancy {
+  std::uint64_t used_vertex_slot_count;
+  std::uint64_t vertex_slot_count;
+};
+
+// Expects a meshlet with at least one vertex and primitive that fits into a
+// group, which the scene loader checks.
+[[nodiscard]] constexpr auto GetInstancesPerGroup(
+  MeshletData const& meshlet, std::uint32_t const max_verts_per_group,
+  std::uint32_t const max_prims_per_group) -> std::uint32_t {
+  return std::min(max_verts_per_group / meshlet.vert_count,
+                  max_prims_per_group / meshlet.prim_count);
+}
+
+// Orders the meshlets so that the ones packing the same number of instances
+// into a group are next to each other. Meshlets reference their vertices and
+// primitives by offset, so their order is otherwise free.
+constexpr auto SortMeshletsForPacking(std::span<MeshletData> const meshlets,
+                                      std::uint32_t const max_verts_per_group,
+                                      std::uint32_t const max_prims_per_group)
+  -> void {
+  std::ranges::sort(meshlets, std::ranges::greater{},
+                    [max_verts_per_group, max_prims_per_group](
+                    MeshletData const& meshlet) {
+                      return GetInstancesPerGroup(
+                        meshlet, max_verts_per_group, max_prims_per_group);
+                    });
+}
+
+[[nodiscard]] constexpr auto CalculateDispatchGroupCount(
+  std::uint32_t const meshlet_count, std::uint32_t const instances_per_group,
+  std::uint32_t const instance_count) -> std::uint64_t {
+  return static_cast<std::uint64_t>(meshlet_count) * DivRoundUp(
+           instance_count, instances_per_group);
+}
+
+// Returns the largest instance count whose group count fits in a dispatch.
+[[nodiscard]] constexpr auto CalculateMaxInstanceCountPerDispatch(
+  std::uint32_t const meshlet_count,
+  std::uint32_t const instances_per_group) -> std::uint32_t {
+  return kMaxDispatchGroupCount / meshlet_count * instances_per_group;
+}
+
+// Expects meshlets sorted with SortMeshletsForPacking.
+[[nodiscard]] constexpr auto PlanMeshletDispatches(
+  std::span<MeshletData const> const meshlets,
+  std::uint32_t const max_verts_per_group,
+  std::uint32_t const max_prims_per_group) -> std::vector<
+  MeshletDispatchChunk> {
+  std::vector<MeshletDispatchChunk> chunks;
+
+  for (std::uint32_t meshlet_offset{0}; meshlet_offset < meshlets.size();) {
+    auto const instances_per_group{
+      GetInstancesPerGroup(meshlets[meshlet_offset], max_verts_per_group,
+                           max_prims_per_group)
+    };
+
+    std::uint32_t meshlet_count{1};
+
+    while (meshlet_count < kMaxDispatchGroupCount && meshlet_offset +
+      meshlet_count < meshlets.size() && GetInstancesPerGroup(
+        meshlets[meshlet_offset + meshlet_count], max_verts_per_group,
+        max_prims_per_group) == instances_per_group) {
+      ++meshlet_count;
+    }
+
+    chunks.emplace_back(meshlet_offset, meshlet_count, instances_per_group,
+                        CalculateMaxInstanceCountPerDispatch(
+                          meshlet_count, instances_per_group));
+    meshlet_offset += meshlet_count;
+  }
+
+  return chunks;
+}
+
+[[nodiscard]] constexpr auto GetDispatchCount(
+  MeshletDispatchChunk const& chunk,
+  std::uint32_t const instance_count) -> std::uint32_t {
+  return DivRoundUp(instance_count, chunk.max_instance_count_per_dispatch);
+}
+
+[[nodiscard]] constexpr auto PlanInstanceDispatch(
+  MeshletDispatchChunk const& chunk, std::uint32_t const instance_count,
+  std::uint32_t const dispatch_idx) -> InstanceDispatch {
+  auto const instance_offset{
+    dispatch_idx * chunk.max_instance_count_per_dispatch
+  };
+  auto const dispatch_instance_count{
+    std::min(instance_count - instance_offset,
+             chunk.max_instance_count_per_dispatch)
+  };
+
+  return InstanceDispatch{
+    instance_offset, dispatch_instance_count,
+    static_cast<std::uint32_t>(CalculateDispatchGroupCount(
+      chunk.meshlet_count, chunk.instances_per_group, dispatch_instance_count))
+  };
+}
+
+// CPU model of the group to instance mapping in mesh_shader.hlsl. The meshlet
+// index is relative to the chunk, and instances are relative to the dispatch.
+[[nodiscard]] constexpr auto MapGroupToInstances(
+  MeshletDispatchChunk const& chunk, std::uint32_t const instance_count,
+  std::uint32_t const group_idx) -> GroupAssignment {
+  auto const groups_per_meshlet{
+    DivRoundUp(instance_count, chunk.instances_per_group)
+  };
+  auto const start_instance{
+    group_idx % groups_per_meshlet * chunk.instances_per_group
+  };
+
+  return GroupAssignment{
+    group_idx / groups_per_meshlet, start_instance,
+    std::min(instance_count - start_instance, chunk.instances_per_group)
+  };
+}
+
+[[nodiscard]] constexpr auto CalculateDispatchOccupancy(
+  std::span<MeshletData const> const meshlets,
+  std::span<MeshletDispatchChunk const> const chunks,
+  std::uint32_t const instance_count,
+  std::uint32_t const max_verts_per_group) -> DispatchOccupancy {
+  DispatchOccupancy ret{0, 0};
+
+  for (auto const& chunk : chunks) {
+    for (auto i{chunk.meshlet_offset}; i < chunk.meshlet_offset + chunk.
+         meshlet_count; i++) {
+      ret.used_vertex_slot_count += static_cast<std::uint64_t>(meshlets[i].
+        vert_count) * instance_count;
+    }
+
+    ret.vertex_slot_count += CalculateDispatchGroupCount(
+      chunk.meshlet_count, chunk.instances_per_group, instance_count) *
+      max_verts_per_group;
+  }
+
+  return ret;
+}
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "command_recorder.hpp"
+#include "dispatch_planner.hpp"
+#include "indirect_draw.hpp"
+
+namespace pensieve {
+// Consecutive meshes whose draws are recorded into one command list.
+// Submitting the lists of the partitions in order draws the meshes in the
+// same order as a single list would.
+struct DrawPartition {
+  std::uint32_t first_mesh;
+  std::uint32_t mesh_count;
+  // Of the partition's commands in the frame's indirect draw buffer.
+  std::uint32_t first_command;
+  std::uint32_t command_count;
+};
+
+// What the draw commands of a mesh are built from in a frame.
+struct MeshDrawSource {
+  std::span<MeshletDispatchChunk const> dispatch_chunks;
+  std::uint32_t visible_instance_count;
+  std::uint32_t draw_record_idx;
+};
+
+// Splits the meshes into at most max_partition_count partitions with similar
+// dispatch counts, the estimated cost of recording them. Every partition but
+// the last gets at least min_partition_command_count dispatches, so small
+// frames stay in a single partition.
+constexpr auto PartitionDraws(std::span<MeshDrawSource const> const meshes,
+                              std::uint32_t const max_partition_count,
+                              std::uint32_t const min_partition_command_count,
+                              std::vector<DrawPartition>& partitions) -> void {
+  partitions.clear();
+
+  std::uint64_t total_command_count{0};
+
+  for (auto const& mesh : meshes) {
+    total_command_count += CalculateMaxIndirectDrawCommandCount(
+      mesh.dispatch_chunks, mesh.visible_instance_count);
+  }
+
+  auto const partition_count{
+    std::clamp<std::uint64_t>(
+      total_command_count / std::max(min_partition_command_count, 1u), 1,
+      std::max(max_partition_count, 1u))
+  };
+
+  partitions.emplace_back(0, 0, 0, 0);
+  std::uint64_t command_count{0};
+
+  for (std::uint32_t i{0}; i < meshes.size(); i++) {
+    // A partition ends once the prefix reaches its share, so large meshes
+    // shorten the partitions after them instead of growing them.
+    if (partitions.size() < partition_count && partitions.back().
+      command_count >= std::max(min_partition_command_count, 1u) &&
+      command_count * partition_count >= partitions.size() *
+      total_command_count) {
+      partitions.emplace_back(i, 0, static_cast<std::uint32_t>(command_count),
+                              0);
+    }
+
+    auto const mesh_command_count{
+      CalculateMaxIndirectDrawCommandCount(meshes[i].dispatch_chunks,
+                                           meshes[i].visible_instance_count)
+    };
+    ++partitions.back().mesh_count;
+    partitions.back().command_count += mesh_command_count;
+    command_count += mesh_command_count;
+  }
+}
+
+// Builds the commands of the partition's meshes into commands and records
+// them with the frame wide DrawParams, as every partition starts with unset
+// root constants. Partitions can be recorded concurrently with their own
+// recorders and command vectors.
+constexpr auto RecordDrawPartition(CommandRecorder& recorder,
+                                   std::span<float const, 16> const
+                                   view_proj_mtx,
+                                   std::span<float const, 3> const camera_pos,
+                                   SceneDrawBindings const& bindings,
+                                   std::span<MeshDrawSource const> const meshes,
+                                   DrawPartition const& partition,
+                                   std::vector<IndirectDrawCommand>& commands)
+  -> void {
+  commands.clear();
+
+  for (auto i{partition.first_mesh};
+       i < partition.first_mesh + partition.mesh_count; i++) {
+    AppendIndirectDrawCommands(meshes[i].draw_record_idx,
+                               meshes[i].dispatch_chunks,
+                               meshes[i].visible_instance_count, commands);
+  }
+
+  RecordSceneDraws(recorder, view_proj_mtx, camera_pos, bindings, commands);
+}
+}
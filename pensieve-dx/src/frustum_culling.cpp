@@ -0,0 +1,192 @@
+#include "frustum_culling.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include "profiler.hpp"
+#include "util.hpp"
+
+namespace pensieve {
+namespace {
+// Instance count above which lists are split between threads.
+auto constexpr kCullingBatchSize{16384u};
+
+[[nodiscard]] auto IsOutside(Frustum const& frustum,
+                             InstanceCullingBounds const& bounds,
+                             std::uint32_t const idx) -> bool {
+  for (auto const& [a, b, c, d] : frustum.planes) {
+    auto const dist{
+      a * bounds.center_x[idx] + b * bounds.center_y[idx] + c * bounds.
+      center_z[idx] + d
+    };
+    auto const radius{
+      std::abs(a) * bounds.extent_x[idx] + std::abs(b) * bounds.extent_y[idx] +
+      std::abs(c) * bounds.extent_z[idx]
+    };
+
+    if (dist + radius < 0) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+[[nodiscard]] auto CullRange(Frustum const& frustum,
+                             InstanceCullingBounds const& bounds,
+                             std::uint32_t first, std::uint32_t const last,
+                             std::uint32_t* const visible_indices) ->
+  std::uint32_t {
+  std::uint32_t visible_count{0};
+
+#ifdef __AVX2__
+  auto constexpr simd_width{8u};
+
+  struct SimdPlane {
+    __m256 a;
+    __m256 b;
+    __m256 c;
+    __m256 d;
+    __m256 abs_a;
+    __m256 abs_b;
+    __m256 abs_c;
+  };
+
+  std::array<SimdPlane, std::tuple_size_v<decltype(frustum.planes)>> planes;
+
+  for (std::size_t i{0}; i < planes.size(); i++) {
+    auto const& [a, b, c, d]{frustum.planes[i]};
+    planes[i] = {
+      _mm256_set1_ps(a), _mm256_set1_ps(b), _mm256_set1_ps(c),
+      _mm256_set1_ps(d), _mm256_set1_ps(std::abs(a)),
+      _mm256_set1_ps(std::abs(b)), _mm256_set1_ps(std::abs(c))
+    };
+  }
+
+  auto const zero{_mm256_setzero_ps()};
+
+  for (; first + simd_width <= last; first += simd_width) {
+    auto const cx{_mm256_loadu_ps(&bounds.center_x[first])};
+    auto const cy{_mm256_loadu_ps(&bounds.center_y[first])};
+    auto const cz{_mm256_loadu_ps(&bounds.center_z[first])};
+    auto const ex{_mm256_loadu_ps(&bounds.extent_x[first])};
+    auto const ey{_mm256_loadu_ps(&bounds.extent_y[first])};
+    auto const ez{_mm256_loadu_ps(&bounds.extent_z[first])};
+
+    auto outside{zero};
+
+    for (auto const& plane : planes) {
+      auto const dist{
+        _mm256_add_ps(
+          _mm256_add_ps(_mm256_mul_ps(plane.a, cx), _mm256_mul_ps(plane.b, cy)),
+          _mm256_add_ps(_mm256_mul_ps(plane.c, cz), plane.d))
+      };
+      auto const radius{
+        _mm256_add_ps(
+          _mm256_add_ps(_mm256_mul_ps(plane.abs_a, ex),
+                        _mm256_mul_ps(plane.abs_b, ey)),
+          _mm256_mul_ps(plane.abs_c, ez))
+      };
+      outside = _mm256_or_ps(
+        outside, _mm256_cmp_ps(_mm256_add_ps(dist, radius), zero, _CMP_LT_OQ));
+    }
+
+    auto visible_mask{
+      static_cast<unsigned>(~_mm256_movemask_ps(outside)) & 0xFFu
+    };
+
+    while (visible_mask != 0) {
+      visible_indices[visible_count++] = first + std::countr_zero(visible_mask);
+      visible_mask &= visible_mask - 1;
+    }
+  }
+#endif
+
+  for (; first < last; first++) {
+    if (!IsOutside(frustum, bounds, first)) {
+      visible_indices[visible_count++] = first;
+    }
+  }
+
+  return visible_count;
+}
+}
+
+auto MakeInstanceCullingBounds(Aabb const& mesh_bounds,
+                               std::span<InstanceData const> const instances) ->
+  InstanceCullingBounds {
+  InstanceCullingBounds ret;
+
+  for (auto* const vec : {
+         &ret.center_x, &ret.center_y, &ret.center_z, &ret.extent_x,
+         &ret.extent_y, &ret.extent_z
+       }) {
+    vec->reserve(instances.size());
+  }
+
+  for (auto const& instance : instances) {
+    auto const [min, max]{TransformAabb(mesh_bounds, instance.model_mtx)};
+    ret.center_x.emplace_back((min[0] + max[0]) * 0.5f);
+    ret.center_y.emplace_back((min[1] + max[1]) * 0.5f);
+    ret.center_z.emplace_back((min[2] + max[2]) * 0.5f);
+    ret.extent_x.emplace_back((max[0] - min[0]) * 0.5f);
+    ret.extent_y.emplace_back((max[1] - min[1]) * 0.5f);
+    ret.extent_z.emplace_back((max[2] - min[2]) * 0.5f);
+  }
+
+  return ret;
+}
+
+auto CullInstances(JobSystem& job_system, Frustum const& frustum,
+                   InstanceCullingBounds const& bounds,
+                   std::span<std::uint32_t> const visible_indices) ->
+  std::uint32_t {
+  PENSIEVE_PROFILE_ZONE("CullInstances");
+
+  auto const instance_count{static_cast<std::uint32_t>(bounds.center_x.size())};
+
+  if (instance_count <= kCullingBatchSize) {
+    return CullRange(frustum, bounds, 0, instance_count,
+                     visible_indices.data());
+  }
+
+  // Every batch writes to the part of the output matching its input range,
+  // the results are compacted afterwards.
+  std::vector<std::uint32_t> batch_visible_counts(
+    DivRoundUp(instance_count, kCullingBatchSize));
+
+  job_system.ParallelFor(batch_visible_counts.size(), 1,
+                         [&frustum, &bounds, visible_indices, instance_count,
+                           &batch_visible_counts](std::size_t const begin,
+                                                  std::size_t const end) {
+                           for (auto i{begin}; i < end; i++) {
+                             auto const first{
+                               static_cast<std::uint32_t>(i) *
+                               kCullingBatchSize
+                             };
+                             batch_visible_counts[i] = CullRange(
+                               frustum, bounds, first,
+                               std::min(first + kCullingBatchSize,
+                                        instance_count),
+                               visible_indices.data() + first);
+                           }
+                         });
+
+  auto visible_count{batch_visible_counts[0]};
+
+  for (std::size_t i{1}; i < batch_visible_counts.size(); i++) {
+    auto const src{visible_indices.begin() + i * kCullingBatchSize};
+    std::copy(src, src + batch_visible_counts[i],
+              visible_indices.begin() + visible_count);
+    visible_count += batch_visible_counts[i];
+  }
+
+  return visible_count;
+}
+}
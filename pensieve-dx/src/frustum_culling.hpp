@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "bvh.hpp"
+#include "job_system.hpp"
+#include "scene_data.hpp"
+
+namespace pensieve {
+// World space centers and half extents of instance bounds in structure of
+// arrays layout so that they can be tested in SIMD batches.
+struct InstanceCullingBounds {
+  std::vector<float> center_x;
+  std::vector<float> center_y;
+  std::vector<float> center_z;
+  std::vector<float> extent_x;
+  std::vector<float> extent_y;
+  std::vector<float> extent_z;
+};
+
+[[nodiscard]] auto MakeInstanceCullingBounds(
+  Aabb const& mesh_bounds,
+  std::span<InstanceData const> instances) -> InstanceCullingBounds;
+
+// Writes the indices of the instances that are not fully outside the frustum
+// to the start of visible_indices in increasing order and returns their
+// count. Large instance lists are culled in batches on the job system.
+// visible_indices must have room for every instance.
+[[nodiscard]] auto CullInstances(JobSystem& job_system, Frustum const& frustum,
+                                 InstanceCullingBounds const& bounds,
+                                 std::span<std::uint32_t> visible_indices) ->
+  std::uint32_t;
+}
@@ -1,11 +1,19 @@
 #pragma once
 
+#include <array>
+#include <cstdint>
 #include <optional>
+#include <span>
 #include <vector>
 
 #include <D3D12MemAlloc.h>
 #include <wrl/client.h>
 
+#include "dispatch_planner.hpp"
+#include "frustum_culling.hpp"
+#include "indirect_draw.hpp"
+#include "mega_buffer.hpp"
+#include "occlusion_culling.hpp"
 #include "scene_data.hpp"
 
 namespace pensieve {
@@ -19,38 +27,52 @@ struct GpuMaterial {
   UINT cbv_idx;
 };
 
-struct GpuMesh {
-  Microsoft::WRL::ComPtr<D3D12MA::Allocation> pos_buf;
-  Microsoft::WRL::ComPtr<D3D12MA::Allocation> norm_buf;
-  Microsoft::WRL::ComPtr<D3D12MA::Allocation> tan_buf;
-  std::optional<Microsoft::WRL::ComPtr<D3D12MA::Allocation>> uv_buf;
-
-  Microsoft::WRL::ComPtr<D3D12MA::Allocation> vertex_idx_buf;
-  Microsoft::WRL::ComPtr<D3D12MA::Allocation> prim_idx_buf;
-  Microsoft::WRL::ComPtr<D3D12MA::Allocation> meshlet_buf;
+// Persistently mapped list of the instances that survived culling.
+struct GpuVisibleInstanceList {
+  Microsoft::WRL::ComPtr<D3D12MA::Allocation> buf;
+  std::span<std::uint32_t> indices;
+  UINT srv_idx;
+};
 
-  Microsoft::WRL::ComPtr<D3D12MA::Allocation> inst_buf;
+// Persistently mapped indirect draw commands of a frame.
+struct GpuIndirectDrawBuffer {
+  Microsoft::WRL::ComPtr<D3D12MA::Allocation> buf;
+  std::span<IndirectDrawCommand> commands;
+};
 
-  std::vector<MeshletData> meshlets;
+struct GpuMesh {
+  // Element offsets of the mesh's ranges in the geometry buffers, indexed by
+  // GeometryStream. Absent tangents and uvs have INVALID_GEOMETRY_BASE.
+  std::array<UINT, kGeometryStreamCount> geometry_bases;
 
-  UINT pos_buf_srv_idx;
-  UINT norm_buf_srv_idx;
-  std::optional<UINT> tan_buf_srv_idx;
-  std::optional<UINT> uv_buf_srv_idx;
-  UINT vertex_idx_buf_srv_idx;
-  UINT prim_idx_buf_srv_idx;
-  UINT meshlet_buf_srv_idx;
+  std::vector<MeshletDispatchChunk> dispatch_chunks;
 
   UINT mtl_idx;
   UINT meshlet_count;
-
-  UINT inst_buf_srv_idx;
   UINT instance_count;
+
+  InstanceCullingBounds instance_bounds;
+  std::optional<OccluderMesh> occluder;
+  // One per frame in flight.
+  std::vector<GpuVisibleInstanceList> visible_instance_lists;
 };
 
 struct GpuScene {
   std::vector<GpuTexture> textures;
   std::vector<GpuMaterial> materials;
   std::vector<GpuMesh> meshes;
+  // Shared by all meshes and indexed by GeometryStream, streams no mesh has
+  // get no buffer.
+  std::array<Microsoft::WRL::ComPtr<D3D12MA::Allocation>, kGeometryStreamCount>
+  geometry_bufs;
+  std::array<UINT, kGeometryStreamCount> geometry_buf_srv_indices;
+  MegaBufferStats geometry_buffer_stats;
+  // A DrawRecord per mesh per frame in flight, grouped by frame.
+  Microsoft::WRL::ComPtr<D3D12MA::Allocation> draw_record_buf;
+  UINT draw_record_buf_srv_idx;
+  // One per frame in flight, large enough to draw every instance.
+  std::vector<GpuIndirectDrawBuffer> indirect_draw_buffers;
+  // Of drawing every instance of every mesh.
+  DispatchOccupancy dispatch_occupancy{0, 0};
 };
 }
\ No newline at end of file
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "dispatch_planner.hpp"
+
+namespace pensieve {
+// The root constants an indirect command sets, laid out like the per draw
+// fields at the end of DrawParams.
+struct IndirectDrawConstants {
+  std::uint32_t instances_per_group;
+  std::uint32_t meshlet_offset;
+  std::uint32_t instance_count;
+  std::uint32_t instance_offset;
+  std::uint32_t draw_record_idx;
+};
+
+// Same layout as D3D12_DISPATCH_MESH_ARGUMENTS.
+struct DispatchMeshArguments {
+  std::uint32_t thread_group_count_x;
+  std::uint32_t thread_group_count_y;
+  std::uint32_t thread_group_count_z;
+};
+
+// One command of the draw command signature.
+struct IndirectDrawCommand {
+  IndirectDrawConstants constants;
+  DispatchMeshArguments dispatch;
+};
+
+static_assert(sizeof(IndirectDrawConstants) == 5 * sizeof(std::uint32_t));
+static_assert(offsetof(IndirectDrawCommand, dispatch) == sizeof(
+  IndirectDrawConstants));
+static_assert(sizeof(IndirectDrawCommand) == 8 * sizeof(std::uint32_t));
+
+// Upper bound of the commands drawing a mesh, reached when all of its
+// instances are visible.
+[[nodiscard]] constexpr auto CalculateMaxIndirectDrawCommandCount(
+  std::span<MeshletDispatchChunk const> const chunks,
+  std::uint32_t const instance_count) -> std::uint32_t {
+  std::uint32_t ret{0};
+
+  for (auto const& chunk : chunks) {
+    ret += GetDispatchCount(chunk, instance_count);
+  }
+
+  return ret;
+}
+
+// Appends the commands drawing the first instance_count visible instances of
+// the mesh whose bindings are in the given draw record.
+constexpr auto AppendIndirectDrawCommands(
+  std::uint32_t const draw_record_idx,
+  std::span<MeshletDispatchChunk const> const chunks,
+  std::uint32_t const instance_count,
+  std::vector<IndirectDrawCommand>& commands) -> void {
+  for (auto const& chunk : chunks) {
+    for (std::uint32_t i{0}; i < GetDispatchCount(chunk, instance_count); i++) {
+      auto const [instance_offset, dispatch_instance_count, group_count]{
+        PlanInstanceDispatch(chunk, instance_count, i)
+      };
+
+      commands.emplace_back(
+        IndirectDrawConstants{
+          chunk.instances_per_group, chunk.meshlet_offset,
+          dispatch_instance_count, instance_offset, draw_record_idx
+        }, DispatchMeshArguments{group_count, 1, 1});
+    }
+  }
+}
+}
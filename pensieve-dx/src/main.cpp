@@ -1,19 +1,75 @@
+#include <chrono>
 #include <iostream>
 #include <cstdlib>
+#include <expected>
+#include <filesystem>
+#include <format>
 #include <limits>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
 
 #include "camera.hpp"
 #include "error.hpp"
-#include "scene_loading.hpp"
+#include "frame_telemetry.hpp"
+#include "job_system.hpp"
+#include "profiler.hpp"
 #include "renderer.hpp"
 #include "window.hpp"
 
+namespace {
+// About 15 seconds of samples at 60 FPS.
+auto constexpr kTelemetrySampleCapacity{std::size_t{4096}};
+
+struct Options {
+  std::filesystem::path scene_path;
+  std::optional<std::filesystem::path> trace_path;
+  std::optional<std::filesystem::path> profile_path;
+};
+
+[[nodiscard]] auto ParseOptions(
+  std::span<char* const> const args) -> std::expected<Options, std::string> {
+  Options opts{args[1], std::nullopt, std::nullopt};
+
+  for (std::size_t i{2}; i < args.size(); i++) {
+    std::string_view const arg{args[i]};
+
+    if (i + 1 >= args.size()) {
+      return std::unexpected{std::format("Missing value for {}.", arg)};
+    }
+
+    std::string_view const value{args[++i]};
+
+    if (arg == "--trace") {
+      opts.trace_path = value;
+    } else if (arg == "--profile") {
+      opts.profile_path = value;
+    } else {
+      return std::unexpected{std::format("Unknown option {}.", arg)};
+    }
+  }
+
+  return opts;
+}
+}
+
 auto main(int const argc, char* argv[]) -> int {
   if (argc < 2) {
-    std::cout << "Usage: pensieve-dx <path-to-model-file>\n";
+    std::cout << "Usage: pensieve-dx <path-to-model-file> "
+      "[--trace <trace-file>] [--profile <trace-file>]\n";
     return EXIT_SUCCESS;
   }
 
+  auto const opts{ParseOptions(std::span{argv, argv + argc})};
+
+  if (!opts) {
+    pensieve::HandleError(opts.error());
+    return EXIT_FAILURE;
+  }
+
+  pensieve::SetProfilerThreadName("Main thread");
+
   auto window{pensieve::Window::Create()};
 
   if (!window) {
@@ -21,29 +77,47 @@ auto main(int const argc, char* argv[]) -> int {
     return EXIT_FAILURE;
   }
 
-  auto renderer{pensieve::Renderer::Create(window->ToHwnd())};
+  pensieve::JobSystem job_system;
+  pensieve::FrameTelemetry telemetry{kTelemetrySampleCapacity};
+  auto renderer{
+    pensieve::Renderer::Create(window->ToHwnd(), job_system, telemetry)
+  };
 
   if (!renderer) {
     pensieve::HandleError(renderer.error());
     return EXIT_FAILURE;
   }
 
-  auto const scene_data{pensieve::LoadScene(argv[1])};
+  auto const gpu_scene{renderer->CreateGpuScene(opts->scene_path)};
 
-  if (!scene_data) {
-    pensieve::HandleError(scene_data.error());
+  if (!gpu_scene) {
+    pensieve::HandleError(gpu_scene.error());
     return EXIT_FAILURE;
   }
 
-  auto const gpu_scene{renderer->CreateGpuScene(*scene_data)};
+  if (auto const [used_vertex_slot_count, vertex_slot_count]{
+    gpu_scene->dispatch_occupancy
+  }; vertex_slot_count != 0) {
+    std::cout << std::format(
+      "Mesh shader vertex slot occupancy with every instance drawn: {:.1f}%\n",
+      100.0 * static_cast<double>(used_vertex_slot_count) / static_cast<double>(
+        vertex_slot_count));
+  }
 
-  if (!gpu_scene) {
-    pensieve::HandleError(gpu_scene.error());
-    return EXIT_FAILURE;
+  if (auto const [range_count, buffer_count, byte_count, padding_byte_count]{
+    gpu_scene->geometry_buffer_stats
+  }; byte_count != 0) {
+    std::cout << std::format(
+      "Geometry: {} mesh streams in {} buffers, {} allocations saved, {:.2f}% padding\n",
+      range_count, buffer_count, range_count - buffer_count,
+      100.0 * static_cast<double>(padding_byte_count) / static_cast<double>(
+        byte_count));
   }
 
   pensieve::Camera cam{60, 0.1f, 10'000.0f, 5.0f};
 
+  auto last_stats_print_time{std::chrono::steady_clock::now()};
+
   while (!window->ShouldClose()) {
     window->PollEvents();
 
@@ -62,6 +136,44 @@ auto main(int const argc, char* argv[]) -> int {
       pensieve::HandleError(exp.error());
       return EXIT_FAILURE;
     }
+
+    if (auto const now{std::chrono::steady_clock::now()}; now -
+      last_stats_print_time >= std::chrono::seconds{1}) {
+      auto const [instance_count, frustum_visible_count,
+        occlusion_visible_count]{renderer->GetCullingStats()};
+      auto const to_percent{
+        [instance_count](std::size_t const count) {
+          return instance_count == 0
+                   ? 0.0
+                   : 100.0 * static_cast<double>(count) / static_cast<double>(
+                       instance_count);
+        }
+      };
+      std::cout << std::format(
+        "Instances: {}, after frustum culling: {} ({:.1f}%), after occlusion culling: {} ({:.1f}%)\n",
+        instance_count, frustum_visible_count,
+        to_percent(frustum_visible_count), occlusion_visible_count,
+        to_percent(occlusion_visible_count));
+
+      auto const frame_stats{telemetry.CalculateStatistics()};
+      std::cout << "Frame stages p50/p95/p99 ms:";
+
+      for (std::size_t i{0}; i < pensieve::kFrameStageCount; i++) {
+        auto const to_ms{
+          [](std::chrono::nanoseconds const duration) {
+            return std::chrono::duration<double, std::milli>{duration}.count();
+          }
+        };
+        std::cout << std::format(" {} {:.2f}/{:.2f}/{:.2f}",
+                                 pensieve::kFrameStageNames[i],
+                                 to_ms(frame_stats[i].p50),
+                                 to_ms(frame_stats[i].p95),
+                                 to_ms(frame_stats[i].p99));
+      }
+
+      std::cout << '\n';
+      last_stats_print_time = now;
+    }
   }
 
   if (auto const exp{renderer->WaitForDeviceIdle()}; !exp) {
@@ -69,5 +181,22 @@ auto main(int const argc, char* argv[]) -> int {
     return EXIT_FAILURE;
   }
 
+  if (opts->trace_path) {
+    if (auto const exp{telemetry.WriteChromeTrace(*opts->trace_path)}; !exp) {
+      pensieve::HandleError(exp.error());
+      return EXIT_FAILURE;
+    }
+  }
+
+  if (opts->profile_path) {
+    std::cout << pensieve::FormatProfilerSummary();
+
+    if (auto const exp{pensieve::WriteProfilerTrace(*opts->profile_path)};
+      !exp) {
+      pensieve::HandleError(exp.error());
+      return EXIT_FAILURE;
+    }
+  }
+
   return EXIT_SUCCESS;
 }
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdint>
+#include <span>
+
+namespace pensieve {
+// The per mesh streams that live in shared buffers, in the order of their
+// buffer indices in DrawParams.
+enum GeometryStream : std::uint8_t {
+  kGeometryStreamPosition,
+  kGeometryStreamNormal,
+  kGeometryStreamTangent,
+  kGeometryStreamUv,
+  kGeometryStreamVertexIndex,
+  kGeometryStreamPrimitiveIndex,
+  kGeometryStreamMeshlet,
+  kGeometryStreamInstance,
+  kGeometryStreamCount
+};
+
+struct MegaBufferStats {
+  // Each range would have been a buffer of its own.
+  std::uint64_t range_count;
+  std::uint64_t buffer_count;
+  std::uint64_t byte_count;
+  std::uint64_t padding_byte_count;
+};
+
+// Plans the ranges of a buffer that is created once all of them are known.
+// Ranges are placed one after the other and are never freed.
+class MegaBufferLayout {
+public:
+  // Returns the byte offset of the range. The alignment does not need to be a
+  // power of two, so that structured buffer ranges can be aligned to their
+  // stride. Empty ranges get an offset but do not count as ranges.
+  constexpr auto Allocate(std::uint64_t const byte_count,
+                          std::uint64_t const alignment) -> std::uint64_t {
+    auto const offset{(byte_count_ + alignment - 1) / alignment * alignment};
+
+    if (byte_count != 0) {
+      padding_byte_count_ += offset - byte_count_;
+      byte_count_ = offset + byte_count;
+      ++range_count_;
+    }
+
+    return offset;
+  }
+
+  [[nodiscard]] constexpr auto GetByteCount() const -> std::uint64_t {
+    return byte_count_;
+  }
+
+  [[nodiscard]] constexpr auto GetPaddingByteCount() const -> std::uint64_t {
+    return padding_byte_count_;
+  }
+
+  [[nodiscard]] constexpr auto GetRangeCount() const -> std::uint64_t {
+    return range_count_;
+  }
+
+private:
+  std::uint64_t byte_count_{0};
+  std::uint64_t padding_byte_count_{0};
+  std::uint64_t range_count_{0};
+};
+
+// Layouts without ranges are not counted as buffers.
+[[nodiscard]] constexpr auto CalculateMegaBufferStats(
+  std::span<MegaBufferLayout const> const layouts) -> MegaBufferStats {
+  MegaBufferStats ret{0, 0, 0, 0};
+
+  for (auto const& layout : layouts) {
+    if (layout.GetRangeCount() != 0) {
+      ret.range_count += layout.GetRangeCount();
+      ++ret.buffer_count;
+      ret.byte_count += layout.GetByteCount();
+      ret.padding_byte_count += layout.GetPaddingByteCount();
+    }
+  }
+
+  return ret;
+}
+}
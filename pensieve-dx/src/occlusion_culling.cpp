@@ -0,0 +1,281 @@
+#include "occlusion_culling.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+namespace pensieve {
+namespace {
+// Edge function a * x + b * y + c that is positive inside the triangle.
+struct Edge {
+  float a;
+  float b;
+  float c;
+};
+
+[[nodiscard]] auto MakeEdge(Float3 const& p0, Float3 const& p1) -> Edge {
+  auto const a{p0[1] - p1[1]};
+  auto const b{p1[0] - p0[0]};
+  return Edge{a, b, -(a * p0[0] + b * p0[1])};
+}
+
+[[nodiscard]] auto TransformPoint(Float3X4 const& model_mtx,
+                                  Float4 const& pos) -> Float3 {
+  Float3 ret;
+
+  for (auto i{0}; i < 3; i++) {
+    ret[i] = model_mtx[i * 4] * pos[0] + model_mtx[i * 4 + 1] * pos[1] +
+             model_mtx[i * 4 + 2] * pos[2] + model_mtx[i * 4 + 3];
+  }
+
+  return ret;
+}
+}
+
+OcclusionBuffer::OcclusionBuffer() :
+  depth_(static_cast<std::size_t>(width_) * height_, 0.0f),
+  tile_min_depth_(static_cast<std::size_t>(tile_count_x_) * tile_count_y_,
+                  0.0f) {}
+
+auto OcclusionBuffer::Clear(
+  std::span<float const, 16> const view_proj_mtx) -> void {
+  std::ranges::fill(depth_, 0.0f);
+  std::ranges::copy(view_proj_mtx, view_proj_mtx_.begin());
+}
+
+auto OcclusionBuffer::RasterizeOccluder(
+  std::span<Float4 const> const positions,
+  std::span<std::uint32_t const> const triangle_indices,
+  Float3X4 const& model_mtx) -> void {
+  for (std::size_t i{0}; i + 2 < triangle_indices.size(); i += 3) {
+    std::array<Float3, 3> verts;
+    auto is_behind_near_plane{false};
+
+    for (auto j{0}; j < 3; j++) {
+      auto const [vert, is_behind]{
+        Project(TransformPoint(model_mtx, positions[triangle_indices[i + j]]))
+      };
+      verts[j] = vert;
+      is_behind_near_plane |= is_behind;
+    }
+
+    // Clipping is not worth it at this resolution, the triangle is dropped,
+    // which can only make the buffer occlude less.
+    if (!is_behind_near_plane) {
+      RasterizeTriangle(verts[0], verts[1], verts[2]);
+    }
+  }
+}
+
+auto OcclusionBuffer::BuildHierarchy() -> void {
+  for (auto ty{0}; ty < tile_count_y_; ty++) {
+    for (auto tx{0}; tx < tile_count_x_; tx++) {
+      auto min_depth{1.0f};
+
+      for (auto y{ty * tile_size_}; y < (ty + 1) * tile_size_; y++) {
+        auto const row{depth_.begin() + y * width_ + tx * tile_size_};
+        min_depth = std::min(min_depth, *std::min_element(row, row + tile_size_));
+      }
+
+      tile_min_depth_[ty * tile_count_x_ + tx] = min_depth;
+    }
+  }
+}
+
+auto OcclusionBuffer::IsVisible(Float3 const& center,
+                                Float3 const& extent) const -> bool {
+  auto min_x{std::numeric_limits<float>::max()};
+  auto min_y{std::numeric_limits<float>::max()};
+  auto max_x{std::numeric_limits<float>::lowest()};
+  auto max_y{std::numeric_limits<float>::lowest()};
+  auto max_depth{0.0f};
+
+  for (auto corner{0}; corner < 8; corner++) {
+    auto const [pos, is_behind_near_plane]{
+      Project(Float3{
+        center[0] + (corner & 1 ? extent[0] : -extent[0]),
+        center[1] + (corner & 2 ? extent[1] : -extent[1]),
+        center[2] + (corner & 4 ? extent[2] : -extent[2])
+      })
+    };
+
+    if (is_behind_near_plane) {
+      return true;
+    }
+
+    min_x = std::min(min_x, pos[0]);
+    min_y = std::min(min_y, pos[1]);
+    max_x = std::max(max_x, pos[0]);
+    max_y = std::max(max_y, pos[1]);
+    max_depth = std::max(max_depth, pos[2]);
+  }
+
+  // Off screen bounds are left to frustum culling.
+  if (max_x <= 0 || min_x >= width_ || max_y <= 0 || min_y >= height_) {
+    return true;
+  }
+
+  auto const x_begin{
+    std::clamp(static_cast<int>(std::floor(min_x)) - 1, 0, width_)
+  };
+  auto const x_end{
+    std::clamp(static_cast<int>(std::ceil(max_x)) + 1, 0, width_)
+  };
+  auto const y_begin{
+    std::clamp(static_cast<int>(std::floor(min_y)) - 1, 0, height_)
+  };
+  auto const y_end{
+    std::clamp(static_cast<int>(std::ceil(max_y)) + 1, 0, height_)
+  };
+
+  for (auto ty{y_begin / tile_size_}; ty <= (y_end - 1) / tile_size_; ty++) {
+    for (auto tx{x_begin / tile_size_}; tx <= (x_end - 1) / tile_size_; tx++) {
+      if (max_depth < tile_min_depth_[ty * tile_count_x_ + tx]) {
+        continue;
+      }
+
+      for (auto y{std::max(y_begin, ty * tile_size_)}; y < std::min(
+             y_end, (ty + 1) * tile_size_); y++) {
+        for (auto x{std::max(x_begin, tx * tile_size_)}; x < std::min(
+               x_end, (tx + 1) * tile_size_); x++) {
+          if (max_depth >= depth_[y * width_ + x]) {
+            return true;
+          }
+        }
+      }
+    }
+  }
+
+  return false;
+}
+
+auto OcclusionBuffer::GetDepth() const -> std::span<float const> {
+  return depth_;
+}
+
+auto OcclusionBuffer::Project(Float3 const& pos_ws) const -> std::pair<
+  Float3, bool> {
+  std::array<float, 4> clip;
+
+  for (auto i{0}; i < 4; i++) {
+    clip[i] = pos_ws[0] * view_proj_mtx_[i] + pos_ws[1] * view_proj_mtx_[4 + i]
+              + pos_ws[2] * view_proj_mtx_[8 + i] + view_proj_mtx_[12 + i];
+  }
+
+  // Depth is reversed, so points closer than the near plane have z > w.
+  if (clip[3] <= 0 || clip[2] > clip[3]) {
+    return {Float3{}, true};
+  }
+
+  return {
+    Float3{
+      (clip[0] / clip[3] * 0.5f + 0.5f) * width_,
+      (0.5f - clip[1] / clip[3] * 0.5f) * height_, clip[2] / clip[3]
+    },
+    false
+  };
+}
+
+auto OcclusionBuffer::RasterizeTriangle(Float3 const& v0, Float3 const& v1,
+                                        Float3 const& v2) -> void {
+  // Clockwise triangles have a positive area with y pointing down.
+  auto const area{
+    (v1[0] - v0[0]) * (v2[1] - v0[1]) - (v1[1] - v0[1]) * (v2[0] - v0[0])
+  };
+
+  if (!(area > 0)) {
+    return;
+  }
+
+  auto const x_begin{
+    std::clamp(static_cast<int>(std::floor(std::min({v0[0], v1[0], v2[0]}))), 0,
+               width_) / 8 * 8
+  };
+  auto const x_end{
+    std::clamp(static_cast<int>(std::ceil(std::max({v0[0], v1[0], v2[0]}))), 0,
+               width_)
+  };
+  auto const y_begin{
+    std::clamp(static_cast<int>(std::floor(std::min({v0[1], v1[1], v2[1]}))), 0,
+               height_)
+  };
+  auto const y_end{
+    std::clamp(static_cast<int>(std::ceil(std::max({v0[1], v1[1], v2[1]}))), 0,
+               height_)
+  };
+
+  std::array const edges{MakeEdge(v1, v2), MakeEdge(v2, v0), MakeEdge(v0, v1)};
+
+  // Depth interpolated with the barycentric weights given by the edges, moved
+  // to the farthest value within the pixel.
+  auto const dzdx{
+    (edges[0].a * v0[2] + edges[1].a * v1[2] + edges[2].a * v2[2]) / area
+  };
+  auto const dzdy{
+    (edges[0].b * v0[2] + edges[1].b * v1[2] + edges[2].b * v2[2]) / area
+  };
+  auto const z0{
+    (edges[0].c * v0[2] + edges[1].c * v1[2] + edges[2].c * v2[2]) / area -
+    0.5f * (std::abs(dzdx) + std::abs(dzdy))
+  };
+
+  for (auto y{y_begin}; y < y_end; y++) {
+    auto const py{static_cast<float>(y) + 0.5f};
+    auto x{x_begin};
+    auto* const row{depth_.data() + y * width_};
+
+#ifdef __AVX2__
+    auto const px_offsets{
+      _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f)
+    };
+    auto const zero{_mm256_setzero_ps()};
+
+    for (; x < x_end; x += 8) {
+      auto const px{
+        _mm256_add_ps(_mm256_set1_ps(static_cast<float>(x)), px_offsets)
+      };
+
+      auto mask{_mm256_castsi256_ps(_mm256_set1_epi32(-1))};
+
+      for (auto i{0}; i < 3; i++) {
+        auto const e{
+          _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(edges[i].a), px),
+                        _mm256_set1_ps(edges[i].b * py + edges[i].c))
+        };
+        mask = _mm256_and_ps(mask, _mm256_cmp_ps(e, zero, _CMP_GE_OQ));
+      }
+
+      if (_mm256_movemask_ps(mask) == 0) {
+        continue;
+      }
+
+      auto const z{
+        _mm256_max_ps(
+          _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(dzdx), px),
+                        _mm256_set1_ps(dzdy * py + z0)), zero)
+      };
+      auto const stored{_mm256_loadu_ps(row + x)};
+      _mm256_storeu_ps(
+        row + x, _mm256_blendv_ps(stored, _mm256_max_ps(stored, z), mask));
+    }
+#endif
+
+    for (; x < x_end; x++) {
+      auto const px{static_cast<float>(x) + 0.5f};
+      auto is_covered{true};
+
+      for (auto i{0}; i < 3; i++) {
+        is_covered &= edges[i].a * px + edges[i].b * py + edges[i].c >= 0;
+      }
+
+      if (is_covered) {
+        row[x] = std::max(row[x], std::max(dzdx * px + dzdy * py + z0, 0.0f));
+      }
+    }
+  }
+}
+}
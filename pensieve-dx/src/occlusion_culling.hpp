@@ -0,0 +1,70 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "scene_data.hpp"
+
+namespace pensieve {
+// CPU copy of a mesh small enough to be rasterized as an occluder.
+struct OccluderMesh {
+  std::vector<Float4> positions;
+  std::vector<std::uint32_t> triangle_indices;
+  std::vector<InstanceData> instances;
+};
+
+// Low resolution reversed depth buffer with a per tile minimum depth level.
+// Occluders write the farthest depth they reach within the pixels whose
+// centers they cover, and tests dilate the footprint of the bounds by a pixel
+// to make up for the partially covered pixels along occluder silhouettes.
+class OcclusionBuffer {
+public:
+  static auto constexpr width_{256};
+  static auto constexpr height_{128};
+  static auto constexpr tile_size_{8};
+
+  OcclusionBuffer();
+
+  // Clears the buffer and sets the row-major row vector view projection
+  // matrix used by later calls. Occluder triangles and test bounds that reach
+  // in front of the near plane are treated as not occluding and visible.
+  auto Clear(std::span<float const, 16> view_proj_mtx) -> void;
+
+  // Rasterizes the front faces of a clockwise wound triangle list.
+  auto RasterizeOccluder(std::span<Float4 const> positions,
+                         std::span<std::uint32_t const> triangle_indices,
+                         Float3X4 const& model_mtx) -> void;
+
+  // Must be called after rasterizing the occluders and before testing.
+  auto BuildHierarchy() -> void;
+
+  // Tests world space bounds given as center and half extents.
+  [[nodiscard]] auto IsVisible(Float3 const& center,
+                               Float3 const& extent) const -> bool;
+
+  // Row by row, e.g. for tests and debug views.
+  [[nodiscard]] auto GetDepth() const -> std::span<float const>;
+
+private:
+  static auto constexpr tile_count_x_{width_ / tile_size_};
+  static auto constexpr tile_count_y_{height_ / tile_size_};
+
+  static_assert(width_ % tile_size_ == 0 && height_ % tile_size_ == 0);
+  static_assert(tile_size_ % 8 == 0);
+
+  // Returns x, y in pixels, z / w and whether the point is behind the near
+  // plane.
+  [[nodiscard]] auto Project(Float3 const& pos_ws) const -> std::pair<
+    Float3, bool>;
+
+  auto RasterizeTriangle(Float3 const& v0, Float3 const& v1,
+                         Float3 const& v2) -> void;
+
+  std::vector<float> depth_;
+  std::vector<float> tile_min_depth_;
+  std::array<float, 16> view_proj_mtx_{};
+};
+}
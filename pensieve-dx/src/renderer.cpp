@@ -2,6 +2,7 @@
 
 #include <algorithm>
 //#include <bit>
+#include <chrono>
 #include <cmath>
 #include <cstddef>
 #include <cstdint>
@@ -9,6 +10,8 @@
 #include <filesystem>
 #include <format>
 #include <fstream>
+#include <functional>
+#include <limits>
 #include <ranges>
 #include <stdlib.h>
 #include <utility>
@@ -19,7 +22,16 @@
 #include <dxgidebug.h>
 #endif
 
+#include "bvh.hpp"
+#include "command_recorder.hpp"
+#include "d3d12_command_recorder.hpp"
+#include "dispatch_planner.hpp"
+#include "frustum_culling.hpp"
+#include "indirect_draw.hpp"
+#include "mega_buffer.hpp"
+#include "profiler.hpp"
 #include "shader_interop.hpp"
+#include "uploader.hpp"
 #include "util.hpp"
 
 using Microsoft::WRL::ComPtr;
@@ -30,7 +42,117 @@ __declspec(dllexport) extern char const* D3D12SDKPath{".\\D3D12\\"};
 }
 
 namespace pensieve {
-auto Renderer::Create(HWND const hwnd) -> std::expected<Renderer, std::string> {
+namespace {
+static_assert(sizeof(InstanceData) == sizeof(InstanceBufferData));
+static_assert(
+  sizeof(DrawParams) - offsetof(DrawParams, instances_per_group) == sizeof(
+    IndirectDrawConstants));
+static_assert(
+  offsetof(DrawParams, draw_record_idx) - offsetof(DrawParams,
+    instances_per_group) == offsetof(IndirectDrawConstants, draw_record_idx));
+static_assert(sizeof(DispatchMeshArguments) == sizeof(
+  D3D12_DISPATCH_MESH_ARGUMENTS));
+static_assert(
+  offsetof(DrawParams, inst_buf_idx) - offsetof(DrawParams, pos_buf_idx) ==
+  kGeometryStreamInstance * sizeof(UINT));
+static_assert(
+  offsetof(DrawParams, view_proj_mtx) ==
+  kDrawParamsViewProjMtxOffset * sizeof(UINT));
+static_assert(
+  offsetof(DrawParams, camera_pos) ==
+  kDrawParamsCameraPosOffset * sizeof(UINT));
+static_assert(
+  offsetof(DrawParams, draw_record_buf_idx) ==
+  kDrawParamsDrawRecordBufIdxOffset * sizeof(UINT));
+static_assert(
+  offsetof(DrawParams, pos_buf_idx) ==
+  kDrawParamsGeometryBufIdxOffset * sizeof(UINT));
+static_assert(sizeof(DrawParams) == kDrawParamsDwordCount * sizeof(UINT));
+
+auto constexpr kGeometryStreamStrides{
+  std::to_array<std::uint64_t>({
+    sizeof(DirectX::XMFLOAT4), sizeof(DirectX::XMFLOAT4),
+    sizeof(DirectX::XMFLOAT4), sizeof(DirectX::XMFLOAT2),
+    sizeof(std::uint32_t), sizeof(MeshletTriangleIndexData),
+    sizeof(MeshletData), sizeof(InstanceBufferData)
+  })
+};
+
+static_assert(kGeometryStreamStrides.size() == kGeometryStreamCount);
+
+// Absent streams have no elements.
+[[nodiscard]] auto GetGeometryStreamElementCounts(
+  MeshLayout const& mesh) -> std::array<std::size_t, kGeometryStreamCount> {
+  return {
+    mesh.vertex_count, mesh.vertex_count,
+    mesh.has_tangents ? mesh.vertex_count : 0,
+    mesh.has_uvs ? mesh.vertex_count : 0,
+    mesh.vertex_index_count / sizeof(std::uint32_t), mesh.triangle_index_count,
+    mesh.meshlet_count, mesh.instance_count
+  };
+}
+
+// The stream a mesh section is uploaded to.
+[[nodiscard]] auto GetGeometryStream(
+  SceneSectionType const type) -> std::size_t {
+  switch (type) {
+  case SceneSectionType::kPositions:
+    return kGeometryStreamPosition;
+  case SceneSectionType::kNormals:
+    return kGeometryStreamNormal;
+  case SceneSectionType::kTangents:
+    return kGeometryStreamTangent;
+  case SceneSectionType::kUvs:
+    return kGeometryStreamUv;
+  case SceneSectionType::kVertexIndices:
+    return kGeometryStreamVertexIndex;
+  case SceneSectionType::kTriangleIndices:
+    return kGeometryStreamPrimitiveIndex;
+  case SceneSectionType::kMeshlets:
+    return kGeometryStreamMeshlet;
+  default:
+    return kGeometryStreamInstance;
+  }
+}
+
+D3D12MA::ALLOCATION_DESC constexpr kUploadAllocDesc{
+  D3D12MA::ALLOCATION_FLAG_NONE, D3D12_HEAP_TYPE_UPLOAD, D3D12_HEAP_FLAG_NONE,
+  nullptr, nullptr
+};
+
+D3D12MA::ALLOCATION_DESC constexpr kDefaultAllocDesc{
+  D3D12MA::ALLOCATION_FLAG_NONE, D3D12_HEAP_TYPE_DEFAULT, D3D12_HEAP_FLAG_NONE,
+  nullptr, nullptr
+};
+
+[[nodiscard]] auto ToDxgiFormat(TextureFormat const format) -> DXGI_FORMAT {
+  switch (format) {
+  case TextureFormat::kBc1Unorm:
+    return DXGI_FORMAT_BC1_UNORM;
+  case TextureFormat::kBc2Unorm:
+    return DXGI_FORMAT_BC2_UNORM;
+  case TextureFormat::kBc3Unorm:
+    return DXGI_FORMAT_BC3_UNORM;
+  case TextureFormat::kBc4Unorm:
+    return DXGI_FORMAT_BC4_UNORM;
+  case TextureFormat::kBc5Unorm:
+    return DXGI_FORMAT_BC5_UNORM;
+  case TextureFormat::kBc7Unorm:
+    return DXGI_FORMAT_BC7_UNORM;
+  case TextureFormat::kR8Unorm:
+    return DXGI_FORMAT_R8_UNORM;
+  case TextureFormat::kR8G8Unorm:
+    return DXGI_FORMAT_R8G8_UNORM;
+  default:
+    return DXGI_FORMAT_R8G8B8A8_UNORM;
+  }
+}
+
+}
+
+auto Renderer::Create(HWND const hwnd, JobSystem& job_system,
+                      FrameTelemetry& telemetry) -> std::expected<
+  Renderer, std::string> {
 #ifndef NDEBUG
   ComPtr<ID3D12Debug6> debug;
   if (FAILED(D3D12GetDebugInterface(IID_PPV_ARGS(&debug)))) {
@@ -250,6 +372,41 @@ auto Renderer::Create(HWND const hwnd) -> std::expected<Renderer, std::string> {
     }
   }
 
+  // Every thread records at most one draw partition.
+  auto const draw_partition_count{
+    std::min<std::size_t>(job_system.GetWorkerCount() + 1,
+                          max_draw_partition_count_)
+  };
+  std::array<std::vector<ComPtr<ID3D12CommandAllocator>>,
+             max_frames_in_flight_> draw_cmd_allocs;
+  std::array<std::vector<ComPtr<ID3D12GraphicsCommandList7>>,
+             max_frames_in_flight_> draw_cmd_lists;
+
+  for (auto i{0}; i < max_frames_in_flight_; i++) {
+    draw_cmd_allocs[i].resize(draw_partition_count);
+    draw_cmd_lists[i].resize(draw_partition_count);
+
+    for (std::size_t j{0}; j < draw_partition_count; j++) {
+      if (FAILED(
+        device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_DIRECT,
+          IID_PPV_ARGS(&draw_cmd_allocs[i][j])))) {
+        return std::unexpected{
+          std::format("Failed to create draw command allocator {} of frame {}.",
+                      j, i)
+        };
+      }
+
+      if (FAILED(
+        device->CreateCommandList1(0, D3D12_COMMAND_LIST_TYPE_DIRECT,
+          D3D12_COMMAND_LIST_FLAG_NONE, IID_PPV_ARGS(&draw_cmd_lists[i][j])))) {
+        return std::unexpected{
+          std::format("Failed to create draw command list {} of frame {}.", j,
+                      i)
+        };
+      }
+    }
+  }
+
   UINT64 frame_fence_val{0};
   ComPtr<ID3D12Fence> frame_fence;
   if (FAILED(
@@ -352,6 +509,31 @@ auto Renderer::Create(HWND const hwnd) -> std::expected<Renderer, std::string> {
     return std::unexpected{"Failed to create pipeline state object."};
   }
 
+  std::array const draw_cmd_sig_args{
+    D3D12_INDIRECT_ARGUMENT_DESC{
+      .Type = D3D12_INDIRECT_ARGUMENT_TYPE_CONSTANT,
+      .Constant = {
+        0, offsetof(DrawParams, instances_per_group) / 4,
+        sizeof(IndirectDrawConstants) / 4
+      }
+    },
+    D3D12_INDIRECT_ARGUMENT_DESC{
+      .Type = D3D12_INDIRECT_ARGUMENT_TYPE_DISPATCH_MESH
+    }
+  };
+
+  D3D12_COMMAND_SIGNATURE_DESC const draw_cmd_sig_desc{
+    sizeof(IndirectDrawCommand), static_cast<UINT>(draw_cmd_sig_args.size()),
+    draw_cmd_sig_args.data(), 0
+  };
+
+  ComPtr<ID3D12CommandSignature> draw_cmd_sig;
+  if (FAILED(
+    device->CreateCommandSignature(&draw_cmd_sig_desc, root_sig.Get(),
+      IID_PPV_ARGS(&draw_cmd_sig)))) {
+    return std::unexpected{"Failed to create draw command signature."};
+  }
+
   D3D12MA::ALLOCATOR_DESC const mem_allocator_desc{
     D3D12MA::ALLOCATOR_FLAG_NONE, device.Get(), 0, nullptr, adapter.Get()
   };
@@ -361,497 +543,810 @@ auto Renderer::Create(HWND const hwnd) -> std::expected<Renderer, std::string> {
     return std::unexpected{"Failed to create memory allocator."};
   }
 
+  auto gpu_timestamps{
+    D3D12TimestampSource::Create(device.Get(), mem_allocator.Get(),
+                                 direct_queue.Get(), max_frames_in_flight_)
+  };
+
+  if (!gpu_timestamps) {
+    return std::unexpected{gpu_timestamps.error()};
+  }
+
   return Renderer{
     std::move(factory), std::move(device), std::move(direct_queue),
     std::move(swap_chain), std::move(swap_chain_buffers),
     std::move(depth_buffer), std::move(rtv_heap), std::move(dsv_heap),
     std::move(res_desc_heap), std::move(cmd_allocs), std::move(cmd_lists),
+    std::move(draw_cmd_allocs), std::move(draw_cmd_lists),
     std::move(frame_fence), std::move(root_sig), std::move(pso),
-    std::move(mem_allocator), swap_chain_flags, present_flags
+    std::move(draw_cmd_sig), std::move(mem_allocator),
+    std::move(*gpu_timestamps), job_system, telemetry, swap_chain_flags,
+    present_flags
   };
 }
 
-auto Renderer::CreateGpuScene(
-  SceneData const& scene_data) -> std::expected<GpuScene, std::string> {
-  // Make sure this is big enough to hold any single resource.
-  auto constexpr upload_buffer_size{1'000'000'000};
+auto Renderer::PrepareGpuMesh(MeshData const& mesh_data, GpuMesh& gpu_mesh,
+                              std::vector<MeshletData>& sorted_meshlets,
+                              DispatchOccupancy& occupancy) -> void {
+  PENSIEVE_PROFILE_ZONE("PrepareGpuMesh");
+
+  sorted_meshlets = mesh_data.meshlets;
+  SortMeshletsForPacking(sorted_meshlets, MESHLET_MAX_VERTS, MESHLET_MAX_PRIMS);
+  gpu_mesh.dispatch_chunks = PlanMeshletDispatches(
+    sorted_meshlets, MESHLET_MAX_VERTS, MESHLET_MAX_PRIMS);
+
+  occupancy = CalculateDispatchOccupancy(sorted_meshlets,
+                                         gpu_mesh.dispatch_chunks,
+                                         static_cast<std::uint32_t>(mesh_data.
+                                           instances.size()),
+                                         MESHLET_MAX_VERTS);
+
+  gpu_mesh.meshlet_count = static_cast<UINT>(mesh_data.meshlets.size());
+  gpu_mesh.mtl_idx = mesh_data.material_idx;
+  gpu_mesh.instance_count = static_cast<UINT>(mesh_data.instances.size());
+
+  gpu_mesh.instance_bounds = MakeInstanceCullingBounds(
+    CalculateAabb(mesh_data.positions), mesh_data.instances);
+
+  // Only the indices of meshes small enough to occlude are kept.
+  if (mesh_data.triangle_indices.empty() || mesh_data.triangle_indices.size() >
+      max_occluder_triangle_count_) {
+    return;
+  }
 
-  auto const res_desc_heap_cpu_start{
-    res_desc_heap_->GetCPUDescriptorHandleForHeapStart()
-  };
+  std::vector<std::uint32_t> vertex_indices(
+    mesh_data.vertex_indices.size() / sizeof(std::uint32_t));
+  std::memcpy(vertex_indices.data(), mesh_data.vertex_indices.data(),
+              vertex_indices.size() * sizeof(std::uint32_t));
 
-  auto const res_desc_inc{
-    device_->GetDescriptorHandleIncrementSize(
-      D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV)
-  };
+  std::vector<std::uint32_t> triangle_indices;
+  triangle_indices.reserve(mesh_data.triangle_indices.size() * 3);
+
+  for (auto const& meshlet : mesh_data.meshlets) {
+    for (auto i{meshlet.prim_offset}; i < meshlet.prim_offset + meshlet.
+         prim_count; i++) {
+      auto const& tri{mesh_data.triangle_indices[i]};
+
+      for (std::uint32_t const idx : {tri.idx0, tri.idx1, tri.idx2}) {
+        triangle_indices.emplace_back(
+          vertex_indices[meshlet.vert_offset + idx]);
+      }
+    }
+  }
+
+  gpu_mesh.occluder.emplace(mesh_data.positions, std::move(triangle_indices),
+                            mesh_data.instances);
+}
+
+// Creates the resources of a scene from its layout, then stages the geometry
+// and texels that only the GPU reads straight from the file. The arrays the
+// CPU culls and plans dispatches with are kept until their mesh is prepared.
+class Renderer::GpuSceneSink final : public SceneSink {
+public:
+  GpuSceneSink(Renderer& renderer, Uploader& uploader);
+
+  GpuSceneSink(GpuSceneSink const& other) = delete;
+  GpuSceneSink(GpuSceneSink&& other) = delete;
+
+  // Waits for the mesh preparation jobs, as they use the sink.
+  ~GpuSceneSink() override;
+
+  auto operator=(GpuSceneSink const& other) -> void = delete;
+  auto operator=(GpuSceneSink&& other) -> void = delete;
+
+  [[nodiscard]] auto Begin(
+    SceneLayout const& layout) -> std::expected<void, std::string> override;
+  [[nodiscard]] auto AcquireRows(
+    SceneSection const& section,
+    std::uint64_t first_row) -> std::expected<SceneSectionDestination,
+                                              std::string> override;
+  [[nodiscard]] auto CommitRows(
+    SceneSection const& section, std::uint64_t first_row,
+    SceneSectionDestination const& dst) -> std::expected<
+    void, std::string> override;
+  [[nodiscard]] auto EndMesh(
+    std::size_t mesh_idx) -> std::expected<void, std::string> override;
+  [[nodiscard]] auto Finish() -> std::expected<void, std::string> override;
+
+  [[nodiscard]] auto TakeGpuScene() -> GpuScene;
+
+private:
+  [[nodiscard]] auto CreateBuffer(UINT64 byte_count,
+                                  ComPtr<D3D12MA::Allocation>& buf) const ->
+    std::expected<void, std::string>;
+  [[nodiscard]] auto CreateBufferSrv(UINT element_count, UINT element_stride,
+                                     ID3D12Resource* buf,
+                                     UINT& srv_idx) -> std::expected<
+    void, std::string>;
+  [[nodiscard]] auto GetDescriptorHandle(
+    UINT idx) const -> D3D12_CPU_DESCRIPTOR_HANDLE;
+  // Whether the section is read into the CPU side mesh instead of staging
+  // memory.
+  [[nodiscard]] auto IsKeptOnCpu(SceneSection const& section) const -> bool;
+
+  Renderer* renderer_;
+  Uploader* uploader_;
+  GpuScene gpu_scene_;
+  std::vector<TextureLayout> texture_layouts_;
+  std::vector<MeshLayout> mesh_layouts_;
+  // Only the arrays PrepareGpuMesh reads, freed once the mesh is prepared.
+  std::vector<MeshData> cpu_meshes_;
+  std::vector<std::vector<MeshletData>> sorted_meshlets_;
+  std::vector<DispatchOccupancy> occupancies_;
+  JobCounter prepare_counter_;
+};
+
+Renderer::GpuSceneSink::GpuSceneSink(Renderer& renderer, Uploader& uploader) :
+  renderer_{&renderer}, uploader_{&uploader} {}
+
+Renderer::GpuSceneSink::~GpuSceneSink() {
+  renderer_->job_system_->Wait(prepare_counter_);
+}
 
-  auto const upload_buffer_desc{
-    CD3DX12_RESOURCE_DESC1::Buffer(upload_buffer_size)
+auto Renderer::GpuSceneSink::Begin(
+  SceneLayout const& layout) -> std::expected<void, std::string> {
+  texture_layouts_ = layout.textures;
+  mesh_layouts_ = layout.meshes;
+
+  gpu_scene_.textures.reserve(layout.textures.size());
+  gpu_scene_.materials.reserve(layout.materials.size());
+  gpu_scene_.meshes.reserve(layout.meshes.size());
+
+  // The views of the textures and of the materials each take one contiguous
+  // range, allocated with a single call instead of one per view.
+  auto const allocate_descriptor_range{
+    [this](std::size_t const count) -> std::expected<UINT, std::string> {
+      if (count == 0) {
+        return UINT{0};
+      }
+
+      return renderer_->AllocateResourceDescriptorRange(
+        static_cast<UINT>(count));
+    }
   };
 
-  D3D12MA::ALLOCATION_DESC constexpr upload_alloc_desc{
-    D3D12MA::ALLOCATION_FLAG_NONE, D3D12_HEAP_TYPE_UPLOAD, D3D12_HEAP_FLAG_NONE,
-    nullptr, nullptr
+  auto const first_tex_srv_idx{
+    allocate_descriptor_range(layout.textures.size())
   };
 
-  ComPtr<D3D12MA::Allocation> upload_buffer;
-  if (FAILED(
-    mem_allocator_->CreateResource3(&upload_alloc_desc, &upload_buffer_desc,
-      D3D12_BARRIER_LAYOUT_UNDEFINED, nullptr, 0, nullptr, &upload_buffer,
-      IID_NULL, nullptr))) {
-    return std::unexpected{"Failed to create GPU upload buffer."};
+  if (!first_tex_srv_idx) {
+    return std::unexpected{
+      std::format("Failed to allocate the texture SRVs: {}",
+                  first_tex_srv_idx.error())
+    };
   }
 
-  void* upload_buffer_ptr;
-  if (FAILED(
-    upload_buffer->GetResource()->Map(0, nullptr, &upload_buffer_ptr))) {
-    return std::unexpected{"Failed to map GPU upload buffer."};
-  }
+  auto const first_mtl_cbv_idx{
+    allocate_descriptor_range(layout.materials.size())
+  };
 
-  UINT64 upload_fence_val{0};
-  ComPtr<ID3D12Fence> upload_fence;
-  if (FAILED(
-    device_->CreateFence(upload_fence_val, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&
-      upload_fence)))) {
-    return std::unexpected{"Failed to create upload fence."};
+  if (!first_mtl_cbv_idx) {
+    return std::unexpected{
+      std::format("Failed to allocate the material CBVs: {}",
+                  first_mtl_cbv_idx.error())
+    };
   }
 
-  D3D12MA::ALLOCATION_DESC constexpr default_alloc_desc{
-    D3D12MA::ALLOCATION_FLAG_NONE, D3D12_HEAP_TYPE_DEFAULT,
-    D3D12_HEAP_FLAG_NONE, nullptr, nullptr
-  };
+  for (auto const& [idx, tex] : std::ranges::views::enumerate(
+         layout.textures)) {
+    auto& gpu_tex{gpu_scene_.textures.emplace_back()};
 
-  GpuScene gpu_scene;
-  gpu_scene.textures.reserve(scene_data.textures.size());
-  gpu_scene.materials.reserve(scene_data.materials.size());
-  gpu_scene.meshes.reserve(scene_data.meshes.size());
+    if (tex.mip_count == 0 || tex.mip_count > D3D12_REQ_MIP_LEVELS) {
+      return std::unexpected{
+        std::format("Texture {} has unsupported mip count {}.", idx,
+                    tex.mip_count)
+      };
+    }
 
-  for (auto const& [idx, img] : std::ranges::views::enumerate(
-         scene_data.textures)) {
-    auto& gpu_tex{gpu_scene.textures.emplace_back()};
     auto const tex_desc{
-      CD3DX12_RESOURCE_DESC1::Tex2D(DXGI_FORMAT_R8G8B8A8_UNORM, img.width,
-                                    img.height)
+      CD3DX12_RESOURCE_DESC1::Tex2D(ToDxgiFormat(tex.format), tex.width,
+                                    tex.height, 1,
+                                    static_cast<UINT16>(tex.mip_count))
     };
 
     if (FAILED(
-      mem_allocator_->CreateResource3(&default_alloc_desc, &tex_desc,
-        D3D12_BARRIER_LAYOUT_COPY_DEST, nullptr, 0, nullptr, &gpu_tex.res,
+      renderer_->mem_allocator_->CreateResource3(&kDefaultAllocDesc, &tex_desc,
+        D3D12_BARRIER_LAYOUT_COMMON, nullptr, 0, nullptr, &gpu_tex.res,
         IID_NULL, nullptr))) {
       return std::unexpected{
         std::format("Failed to create GPU texture {}.", idx)
       };
     }
 
-    std::memcpy(upload_buffer_ptr, img.bytes.get(), img.width * img.height * 4);
+    gpu_tex.srv_idx = *first_tex_srv_idx + static_cast<UINT>(idx);
 
-    if (FAILED(cmd_allocs_[frame_idx_]->Reset())) {
+    D3D12_SHADER_RESOURCE_VIEW_DESC const srv_desc{
+      .Format = tex_desc.Format, .ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D,
+      .Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING,
+      .Texture2D = {0, tex.mip_count, 0, 0.0f}
+    };
+
+    renderer_->device_->CreateShaderResourceView(
+      gpu_tex.res->GetResource(), &srv_desc,
+      GetDescriptorHandle(gpu_tex.srv_idx));
+  }
+
+  auto constexpr mtl_buffer_size{
+    std::max(NextMultipleOf<UINT64>(256, sizeof(Material)),
+             NextMultipleOf<UINT64>(256, sizeof(DrawParams)))
+  };
+
+  auto const get_srv_idx{
+    [this](std::optional<std::uint32_t> const& tex_idx) -> UINT {
+      return tex_idx
+               ? gpu_scene_.textures[*tex_idx].srv_idx
+               : INVALID_RESOURCE_IDX;
+    }
+  };
+
+  for (auto const& [idx, mtl_data] : std::ranges::views::enumerate(
+         layout.materials)) {
+    auto& gpu_mtl{gpu_scene_.materials.emplace_back()};
+
+    Material const mtl{
+      DirectX::XMFLOAT3{mtl_data.base_color.data()}, mtl_data.metallic,
+      mtl_data.roughness, DirectX::XMFLOAT3{mtl_data.emission_color.data()},
+      get_srv_idx(mtl_data.base_color_map_idx),
+      get_srv_idx(mtl_data.metallic_map_idx),
+      get_srv_idx(mtl_data.roughness_map_idx),
+      get_srv_idx(mtl_data.emission_map_idx),
+      get_srv_idx(mtl_data.normal_map_idx), mtl_data.metallic_map_channel,
+      mtl_data.roughness_map_channel
+    };
+
+    if (auto const exp{CreateBuffer(mtl_buffer_size, gpu_mtl.res)}; !exp) {
       return std::unexpected{
-        "Failed to reset command allocator for texture copy."
+        std::format("Failed to create material buffer {}: {}", idx, exp.error())
       };
     }
 
-    if (FAILED(
-      cmd_lists_[frame_idx_]->Reset(cmd_allocs_[frame_idx_].Get(), nullptr))) {
-      return std::unexpected{"Failed to reset command list for texture copy."};
+    if (auto const exp{
+      uploader_->UploadBuffer(gpu_mtl.res->GetResource(), 0,
+                              std::as_bytes(std::span{&mtl, 1}))
+    }; !exp) {
+      return std::unexpected{
+        std::format("Failed to upload material {}: {}", idx, exp.error())
+      };
     }
 
-    D3D12_SUBRESOURCE_DATA const tex_data{
-      img.bytes.get(), 4 * img.width, 4 * img.width * img.height
+    gpu_mtl.cbv_idx = *first_mtl_cbv_idx + static_cast<UINT>(idx);
+
+    D3D12_CONSTANT_BUFFER_VIEW_DESC const cbv_desc{
+      gpu_mtl.res->GetResource()->GetGPUVirtualAddress(),
+      static_cast<UINT>(mtl_buffer_size)
     };
 
-    UpdateSubresources<1>(cmd_lists_[frame_idx_].Get(),
-                          gpu_tex.res->GetResource(),
-                          upload_buffer->GetResource(), 0, 0, 1, &tex_data);
+    renderer_->device_->CreateConstantBufferView(
+      &cbv_desc, GetDescriptorHandle(gpu_mtl.cbv_idx));
+  }
 
-    D3D12_TEXTURE_BARRIER const barrier{
-      D3D12_BARRIER_SYNC_COPY, D3D12_BARRIER_SYNC_NONE,
-      D3D12_BARRIER_ACCESS_COPY_DEST, D3D12_BARRIER_ACCESS_NO_ACCESS,
-      D3D12_BARRIER_LAYOUT_COPY_DEST,
-      D3D12_BARRIER_LAYOUT_DIRECT_QUEUE_SHADER_RESOURCE,
-      gpu_tex.res->GetResource(), {0, 1, 0, 1, 0, 1},
-      D3D12_TEXTURE_BARRIER_FLAG_NONE
-    };
+  // Every mesh stream is a range of a buffer shared by all meshes.
+  std::array<MegaBufferLayout, kGeometryStreamCount> geometry_layouts;
 
-    D3D12_BARRIER_GROUP const barrier_group{
-      .Type = D3D12_BARRIER_TYPE_TEXTURE, .NumBarriers = 1,
-      .pTextureBarriers = &barrier
-    };
+  for (auto const& mesh_layout : layout.meshes) {
+    auto& gpu_mesh{gpu_scene_.meshes.emplace_back()};
+    auto const element_counts{GetGeometryStreamElementCounts(mesh_layout)};
+
+    for (std::size_t i{0}; i < kGeometryStreamCount; i++) {
+      gpu_mesh.geometry_bases[i] = static_cast<UINT>(geometry_layouts[i].
+        Allocate(element_counts[i] * kGeometryStreamStrides[i],
+                 kGeometryStreamStrides[i]) / kGeometryStreamStrides[i]);
+    }
 
-    cmd_lists_[frame_idx_]->Barrier(1, &barrier_group);
+    if (!mesh_layout.has_tangents) {
+      gpu_mesh.geometry_bases[kGeometryStreamTangent] = INVALID_GEOMETRY_BASE;
+    }
 
-    if (FAILED(cmd_lists_[frame_idx_]->Close())) {
-      return std::unexpected{"Failed to close command list for texture copy."};
+    if (!mesh_layout.has_uvs) {
+      gpu_mesh.geometry_bases[kGeometryStreamUv] = INVALID_GEOMETRY_BASE;
     }
+  }
 
-    direct_queue_->ExecuteCommandLists(
-      1, CommandListCast(cmd_lists_[frame_idx_].GetAddressOf()));
+  gpu_scene_.geometry_buffer_stats = CalculateMegaBufferStats(geometry_layouts);
 
-    ++upload_fence_val;
-    if (FAILED(direct_queue_->Signal(upload_fence.Get(), upload_fence_val))) {
-      return std::unexpected{"Failed to signal upload fence."};
+  for (std::size_t i{0}; i < kGeometryStreamCount; i++) {
+    gpu_scene_.geometry_buf_srv_indices[i] = INVALID_RESOURCE_IDX;
+
+    if (geometry_layouts[i].GetRangeCount() == 0) {
+      continue;
     }
 
-    if (FAILED(upload_fence->SetEventOnCompletion(upload_fence_val, nullptr))) {
-      return std::unexpected{"Failed to wait for upload fence."};
+    auto const element_count{
+      geometry_layouts[i].GetByteCount() / kGeometryStreamStrides[i]
+    };
+
+    if (element_count > std::numeric_limits<UINT>::max()) {
+      return std::unexpected{
+        std::format("Geometry stream {} has too many elements.", i)
+      };
     }
 
-    gpu_tex.srv_idx = AllocateResourceDescriptorIndex();
+    if (auto const exp{
+      CreateBuffer(geometry_layouts[i].GetByteCount(),
+                   gpu_scene_.geometry_bufs[i])
+    }; !exp) {
+      return std::unexpected{
+        std::format("Failed to create geometry buffer {}.", i)
+      };
+    }
 
-    D3D12_SHADER_RESOURCE_VIEW_DESC const srv_desc{
-      .Format = tex_desc.Format, .ViewDimension = D3D12_SRV_DIMENSION_TEXTURE2D,
-      .Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING,
-      .Texture2D = {0, 1, 0, 0.0f}
-    };
+    if (auto const exp{
+      CreateBufferSrv(static_cast<UINT>(element_count),
+                      static_cast<UINT>(kGeometryStreamStrides[i]),
+                      gpu_scene_.geometry_bufs[i]->GetResource(),
+                      gpu_scene_.geometry_buf_srv_indices[i])
+    }; !exp) {
+      return std::unexpected{
+        std::format("Failed to create geometry buffer {} SRV: {}", i,
+                    exp.error())
+      };
+    }
+  }
 
-    device_->CreateShaderResourceView(gpu_tex.res->GetResource(), &srv_desc,
-                                      CD3DX12_CPU_DESCRIPTOR_HANDLE{
-                                        res_desc_heap_cpu_start,
-                                        static_cast<INT>(gpu_tex.srv_idx),
-                                        res_desc_inc
-                                      });
-  }
-
-  auto const create_buffer_from_upload_data{
-    [this, &default_alloc_desc, &upload_buffer, &upload_fence_val, &upload_fence
-    ](std::size_t const buf_size,
-      ComPtr<D3D12MA::Allocation>& buf) -> std::expected<void, std::string> {
-      auto const buf_desc{CD3DX12_RESOURCE_DESC1::Buffer(buf_size)};
-
-      if FAILED(
-        mem_allocator_->CreateResource3(&default_alloc_desc, &buf_desc,
-          D3D12_BARRIER_LAYOUT_UNDEFINED, nullptr, 0, nullptr, &buf, IID_NULL,
-          nullptr)) {
-        return std::unexpected{"Failed to create buffer."};
-      }
+  cpu_meshes_.resize(layout.meshes.size());
+  sorted_meshlets_.resize(layout.meshes.size());
+  occupancies_.resize(layout.meshes.size());
 
-      if (FAILED(cmd_allocs_[frame_idx_]->Reset())) {
-        return std::unexpected{"Failed to reset command allocator."};
-      }
+  for (std::size_t i{0}; i < layout.meshes.size(); i++) {
+    cpu_meshes_[i].material_idx = layout.meshes[i].material_idx;
+  }
 
-      if (FAILED(
-        cmd_lists_[frame_idx_]->Reset(cmd_allocs_[frame_idx_].Get(), nullptr
-        ))) {
-        return std::unexpected{"Failed to reset command list."};
-      }
+  return {};
+}
 
-      cmd_lists_[frame_idx_]->CopyBufferRegion(buf->GetResource(), 0,
-                                               upload_buffer->GetResource(), 0,
-                                               buf_desc.Width);
+auto Renderer::GpuSceneSink::AcquireRows(SceneSection const& section,
+                                         std::uint64_t const first_row) ->
+  std::expected<SceneSectionDestination, std::string> {
+  // Rendering does not traverse the BVH.
+  if (section.type == SceneSectionType::kBvhNodes || section.type ==
+      SceneSectionType::kBvhInstanceRefs) {
+    return SceneSectionDestination{nullptr, 0, 0};
+  }
 
-      if (FAILED(cmd_lists_[frame_idx_]->Close())) {
-        return std::unexpected{"Failed to close command list."};
-      }
+  if (section.type == SceneSectionType::kTexels) {
+    auto const staged{
+      uploader_->StageTextureRows(
+        gpu_scene_.textures[section.item_idx].res->GetResource(), section.mip,
+        static_cast<UINT>(section.row_count - first_row))
+    };
 
-      direct_queue_->ExecuteCommandLists(
-        1, CommandListCast(cmd_lists_[frame_idx_].GetAddressOf()));
+    if (!staged) {
+      return std::unexpected{
+        std::format("Failed to stage texture {} mip {}: {}", section.item_idx,
+                    section.mip, staged.error())
+      };
+    }
 
-      ++upload_fence_val;
-      if (FAILED(direct_queue_->Signal(upload_fence.Get(), upload_fence_val))) {
-        return std::unexpected{"Failed to signal upload fence."};
-      }
+    return SceneSectionDestination{
+      staged->data, staged->row_count, staged->row_pitch
+    };
+  }
 
-      if (FAILED(
-        upload_fence->SetEventOnCompletion(upload_fence_val, nullptr))) {
-        return std::unexpected{"Failed to wait for upload fence."};
+  if (IsKeptOnCpu(section)) {
+    auto& mesh{cpu_meshes_[section.item_idx]};
+    auto const resize_as_bytes{
+      [&section](auto& vec) {
+        vec.resize(section.row_count * section.row_byte_count / sizeof(vec[0]));
+        return reinterpret_cast<std::byte*>(vec.data());
       }
+    };
 
-      return {};
+    std::byte* section_data;
+
+    switch (section.type) {
+    case SceneSectionType::kPositions:
+      section_data = resize_as_bytes(mesh.positions);
+      break;
+    case SceneSectionType::kMeshlets:
+      section_data = resize_as_bytes(mesh.meshlets);
+      break;
+    case SceneSectionType::kVertexIndices:
+      section_data = resize_as_bytes(mesh.vertex_indices);
+      break;
+    case SceneSectionType::kTriangleIndices:
+      section_data = resize_as_bytes(mesh.triangle_indices);
+      break;
+    default:
+      section_data = resize_as_bytes(mesh.instances);
+      break;
     }
-  };
 
-  auto constexpr mtl_buffer_size{
-    std::max(NextMultipleOf<UINT64>(256, sizeof(Material)),
-             NextMultipleOf<UINT64>(256, sizeof(DrawParams)))
-  };
+    return SceneSectionDestination{
+      section_data + first_row * section.row_byte_count,
+      section.row_count - first_row, section.row_byte_count
+    };
+  }
 
-  for (auto const& [idx, mtl_data] : std::ranges::views::enumerate(
-         scene_data.materials)) {
-    auto& gpu_mtl{gpu_scene.materials.emplace_back()};
+  auto const staged{
+    uploader_->StageBuffer((section.row_count - first_row) *
+                           section.row_byte_count, section.row_byte_count)
+  };
 
-    Material const mtl{
-      DirectX::XMFLOAT3{mtl_data.base_color.data()}, mtl_data.metallic,
-      mtl_data.roughness, DirectX::XMFLOAT3{mtl_data.emission_color.data()},
-      mtl_data.base_color_map_idx
-        ? gpu_scene.textures[*mtl_data.base_color_map_idx].srv_idx
-        : INVALID_RESOURCE_IDX,
-      mtl_data.metallic_map_idx
-        ? gpu_scene.textures[*mtl_data.metallic_map_idx].srv_idx
-        : INVALID_RESOURCE_IDX,
-      mtl_data.roughness_map_idx
-        ? gpu_scene.textures[*mtl_data.roughness_map_idx].srv_idx
-        : INVALID_RESOURCE_IDX,
-      mtl_data.emission_map_idx
-        ? gpu_scene.textures[*mtl_data.emission_map_idx].srv_idx
-        : INVALID_RESOURCE_IDX,
-      mtl_data.normal_map_idx
-        ? gpu_scene.textures[*mtl_data.normal_map_idx].srv_idx
-        : INVALID_RESOURCE_IDX
+  if (!staged) {
+    return std::unexpected{
+      std::format("Failed to stage mesh {} geometry: {}", section.item_idx,
+                  staged.error())
     };
-    std::memcpy(upload_buffer_ptr, &mtl, sizeof(mtl));
+  }
+
+  return SceneSectionDestination{
+    staged->data(), staged->size() / section.row_byte_count,
+    section.row_byte_count
+  };
+}
+
+auto Renderer::GpuSceneSink::CommitRows(SceneSection const& section,
+                                        std::uint64_t const first_row,
+                                        SceneSectionDestination const& dst) ->
+  std::expected<void, std::string> {
+  if (section.type == SceneSectionType::kTexels) {
+    auto const& gpu_tex{gpu_scene_.textures[section.item_idx]};
 
     if (auto const exp{
-      create_buffer_from_upload_data(mtl_buffer_size, gpu_mtl.res)
+      uploader_->CopyStagedTextureRows(
+        gpu_tex.res->GetResource(), texture_layouts_[section.item_idx].format,
+        section.mip, static_cast<UINT>(first_row),
+        {dst.data, static_cast<UINT>(dst.row_count), dst.row_pitch})
     }; !exp) {
       return std::unexpected{
-        std::format("Failed to create material buffer {}: {}", idx, exp.error())
+        std::format("Failed to upload texture {} mip {}: {}", section.item_idx,
+                    section.mip, exp.error())
       };
     }
 
-    gpu_mtl.cbv_idx = AllocateResourceDescriptorIndex();
-
-    D3D12_CONSTANT_BUFFER_VIEW_DESC const cbv_desc{
-      gpu_mtl.res->GetResource()->GetGPUVirtualAddress(),
-      static_cast<UINT>(mtl_buffer_size)
-    };
+    return {};
+  }
 
-    device_->CreateConstantBufferView(&cbv_desc, CD3DX12_CPU_DESCRIPTOR_HANDLE{
-                                        res_desc_heap_cpu_start,
-                                        static_cast<INT>(gpu_mtl.cbv_idx),
-                                        res_desc_inc
-                                      });
-  }
-
-  std::vector<std::vector<InstanceBufferData>> instance_transforms_per_mesh;
-  instance_transforms_per_mesh.resize(scene_data.meshes.size());
-
-  for (auto const& node : scene_data.nodes) {
-    for (auto const mesh_idx : node.mesh_indices) {
-      DirectX::XMFLOAT4X4 const model_mtx{node.transform.data()};
-      DirectX::XMFLOAT4X4 normal_mtx;
-      XMStoreFloat4x4(&normal_mtx,
-                      XMMatrixTranspose(
-                        XMMatrixInverse(nullptr, XMLoadFloat4x4(&model_mtx))));
-      instance_transforms_per_mesh[mesh_idx].
-        emplace_back(model_mtx, normal_mtx);
-    }
+  if (IsKeptOnCpu(section)) {
+    return {};
   }
 
-  for (std::size_t idx{0}; idx < scene_data.meshes.size(); idx++) {
-    auto const& mesh_data{scene_data.meshes[idx]};
-    auto& gpu_mesh{gpu_scene.meshes.emplace_back()};
-
-    auto const create_buffer_srv{
-      [this, res_desc_heap_cpu_start, res_desc_inc](UINT const element_count,
-                                                    UINT const element_stride,
-                                                    ID3D12Resource* const buf,
-                                                    UINT& srv_idx) {
-        srv_idx = AllocateResourceDescriptorIndex();
-
-        D3D12_SHADER_RESOURCE_VIEW_DESC const srv_desc{
-          .Format = DXGI_FORMAT_UNKNOWN,
-          .ViewDimension = D3D12_SRV_DIMENSION_BUFFER,
-          .Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING,
-          .Buffer = {
-            0, static_cast<UINT>(element_count),
-            static_cast<UINT>(element_stride), D3D12_BUFFER_SRV_FLAG_NONE
-          }
-        };
+  auto const stream{GetGeometryStream(section.type)};
 
-        device_->CreateShaderResourceView(buf, &srv_desc,
-                                          CD3DX12_CPU_DESCRIPTOR_HANDLE{
-                                            res_desc_heap_cpu_start,
-                                            static_cast<INT>(srv_idx),
-                                            res_desc_inc
-                                          });
-      }
+  if (auto const exp{
+    uploader_->CopyStagedBuffer(
+      gpu_scene_.geometry_bufs[stream]->GetResource(),
+      gpu_scene_.meshes[section.item_idx].geometry_bases[stream] *
+      kGeometryStreamStrides[stream] + first_row * section.row_byte_count,
+      std::span{dst.data, dst.row_count * section.row_byte_count})
+  }; !exp) {
+    return std::unexpected{
+      std::format("Failed to upload mesh {} geometry stream {}: {}",
+                  section.item_idx, stream, exp.error())
     };
+  }
 
-    {
-      auto const pos_count{mesh_data.positions.size()};
-      auto constexpr pos_stride{sizeof(DirectX::XMFLOAT4)};
-      auto const pos_buf_size{pos_count * pos_stride};
+  return {};
+}
 
-      std::memcpy(upload_buffer_ptr, mesh_data.positions.data(), pos_buf_size);
+auto Renderer::GpuSceneSink::EndMesh(
+  std::size_t const mesh_idx) -> std::expected<void, std::string> {
+  auto& mesh{cpu_meshes_[mesh_idx]};
+  auto const& gpu_mesh{gpu_scene_.meshes[mesh_idx]};
 
-      if (auto const exp{
-        create_buffer_from_upload_data(pos_buf_size, gpu_mesh.pos_buf)
-      }; !exp) {
-        return std::unexpected{
-          std::format("Failed to create mesh {} position buffer: {}", idx,
-                      exp.error())
-        };
-      }
+  // Kept indices are turned into occluders.
+  if (!mesh.triangle_indices.empty()) {
+    if (auto const exp{ValidateMeshIndices(mesh, mesh_idx)}; !exp) {
+      return exp;
+    }
+  }
 
-      create_buffer_srv(static_cast<UINT>(pos_count),
-                        static_cast<UINT>(pos_stride),
-                        gpu_mesh.pos_buf->GetResource(),
-                        gpu_mesh.pos_buf_srv_idx);
+  // The meshlets are uploaded once they are sorted.
+  std::array<std::span<std::byte const>, kGeometryStreamCount> cpu_streams;
+  cpu_streams[kGeometryStreamPosition] = std::as_bytes(std::span{
+    mesh.positions
+  });
+  cpu_streams[kGeometryStreamVertexIndex] = std::as_bytes(std::span{
+    mesh.vertex_indices
+  });
+  cpu_streams[kGeometryStreamPrimitiveIndex] = std::as_bytes(std::span{
+    mesh.triangle_indices
+  });
+  cpu_streams[kGeometryStreamInstance] = std::as_bytes(std::span{
+    mesh.instances
+  });
+
+  for (std::size_t stream{0}; stream < kGeometryStreamCount; stream++) {
+    auto const bytes{cpu_streams[stream]};
+
+    if (bytes.empty()) {
+      continue;
+    }
+
+    if (auto const exp{
+      uploader_->UploadBuffer(gpu_scene_.geometry_bufs[stream]->GetResource(),
+                              gpu_mesh.geometry_bases[stream] *
+                              kGeometryStreamStrides[stream], bytes)
+    }; !exp) {
+      return std::unexpected{
+        std::format("Failed to upload mesh {} geometry stream {}: {}",
+                    mesh_idx, stream, exp.error())
+      };
     }
+  }
+
+  renderer_->job_system_->Run([this, mesh_idx] {
+    PrepareGpuMesh(cpu_meshes_[mesh_idx], gpu_scene_.meshes[mesh_idx],
+                   sorted_meshlets_[mesh_idx], occupancies_[mesh_idx]);
+    cpu_meshes_[mesh_idx] = {};
+  }, &prepare_counter_);
+
+  return {};
+}
+
+auto Renderer::GpuSceneSink::Finish() -> std::expected<void, std::string> {
+  renderer_->job_system_->Wait(prepare_counter_);
 
-    {
-      auto const norm_count{mesh_data.normals.size()};
-      auto constexpr norm_stride{sizeof(DirectX::XMFLOAT4)};
-      auto const norm_buf_size{norm_count * norm_stride};
+  for (auto const& occupancy : occupancies_) {
+    gpu_scene_.dispatch_occupancy.used_vertex_slot_count += occupancy.
+      used_vertex_slot_count;
+    gpu_scene_.dispatch_occupancy.vertex_slot_count += occupancy.
+      vertex_slot_count;
+  }
 
-      std::memcpy(upload_buffer_ptr, mesh_data.normals.data(), norm_buf_size);
+  for (std::size_t idx{0}; idx < gpu_scene_.meshes.size(); idx++) {
+    auto& gpu_mesh{gpu_scene_.meshes[idx]};
 
+    if (auto const& meshlets{sorted_meshlets_[idx]}; !meshlets.empty()) {
       if (auto const exp{
-        create_buffer_from_upload_data(norm_buf_size, gpu_mesh.norm_buf)
+        uploader_->UploadBuffer(
+          gpu_scene_.geometry_bufs[kGeometryStreamMeshlet]->GetResource(),
+          gpu_mesh.geometry_bases[kGeometryStreamMeshlet] *
+          kGeometryStreamStrides[kGeometryStreamMeshlet],
+          std::as_bytes(std::span{meshlets}))
       }; !exp) {
         return std::unexpected{
-          std::format("Failed to create mesh {} normal buffer: {}", idx,
-                      exp.error())
+          std::format("Failed to upload mesh {} geometry stream {}: {}", idx,
+                      std::size_t{kGeometryStreamMeshlet}, exp.error())
         };
       }
-
-      create_buffer_srv(static_cast<UINT>(norm_count),
-                        static_cast<UINT>(norm_stride),
-                        gpu_mesh.norm_buf->GetResource(),
-                        gpu_mesh.norm_buf_srv_idx);
     }
 
-    if (mesh_data.tangents) {
-      auto const tan_count{mesh_data.tangents->size()};
-      auto constexpr tan_stride{sizeof(DirectX::XMFLOAT4)};
-      auto const tan_buf_size{tan_count * tan_stride};
+    sorted_meshlets_[idx] = {};
 
-      std::memcpy(upload_buffer_ptr, mesh_data.tangents->data(), tan_buf_size);
+    auto const instance_count{std::size_t{gpu_mesh.instance_count}};
 
+    auto const visible_inst_idx_buf_desc{
+      CD3DX12_RESOURCE_DESC1::Buffer(
+        std::max<std::size_t>(instance_count, 1) * sizeof(std::uint32_t))
+    };
 
-      if (auto const exp{
-        create_buffer_from_upload_data(tan_buf_size, gpu_mesh.tan_buf)
-      }; !exp) {
+    for (auto i{0}; i < max_frames_in_flight_; i++) {
+      auto& [buf, indices, srv_idx]{
+        gpu_mesh.visible_instance_lists.emplace_back()
+      };
+
+      if (FAILED(
+        renderer_->mem_allocator_->CreateResource3(&kUploadAllocDesc, &
+          visible_inst_idx_buf_desc, D3D12_BARRIER_LAYOUT_UNDEFINED, nullptr, 0,
+          nullptr, &buf, IID_NULL, nullptr))) {
         return std::unexpected{
-          std::format("Failed to create mesh {} tangent buffer: {}", idx,
-                      exp.error())
+          std::format("Failed to create mesh {} visible instance buffer.", idx)
         };
       }
 
-      create_buffer_srv(static_cast<UINT>(tan_count),
-                        static_cast<UINT>(tan_stride),
-                        gpu_mesh.tan_buf->GetResource(),
-                        gpu_mesh.tan_buf_srv_idx.emplace());
-    }
+      void* mapped;
+      if (FAILED(buf->GetResource()->Map(0, nullptr, &mapped))) {
+        return std::unexpected{
+          std::format("Failed to map mesh {} visible instance buffer.", idx)
+        };
+      }
 
-    if (mesh_data.uvs) {
-      auto const uv_count{mesh_data.uvs->size()};
-      auto constexpr uv_stride{sizeof(DirectX::XMFLOAT2)};
-      auto const uv_buf_size{uv_count * uv_stride};
-      std::memcpy(upload_buffer_ptr, mesh_data.uvs->data(), uv_buf_size);
+      indices = std::span{static_cast<std::uint32_t*>(mapped), instance_count};
 
       if (auto const exp{
-        create_buffer_from_upload_data(uv_buf_size, gpu_mesh.uv_buf.emplace())
+        CreateBufferSrv(static_cast<UINT>(std::max<std::size_t>(
+                          instance_count, 1)),
+                        static_cast<UINT>(sizeof(std::uint32_t)),
+                        buf->GetResource(), srv_idx)
       }; !exp) {
         return std::unexpected{
-          std::format("Failed to create mesh {} uv buffer: {}", idx,
+          std::format("Failed to create mesh {} visible instance SRV: {}", idx,
                       exp.error())
         };
       }
-
-      create_buffer_srv(static_cast<UINT>(uv_count),
-                        static_cast<UINT>(uv_stride),
-                        (*gpu_mesh.uv_buf)->GetResource(),
-                        gpu_mesh.uv_buf_srv_idx.emplace());
     }
+  }
 
-    {
-      {
-        auto const meshlet_count{mesh_data.meshlets.size()};
-        auto constexpr meshlet_stride{
-          sizeof(decltype(mesh_data.meshlets)::value_type)
-        };
-        auto const meshlet_buf_size{meshlet_count * meshlet_stride};
-
-        std::memcpy(upload_buffer_ptr, mesh_data.meshlets.data(),
-                    meshlet_buf_size);
-
-        if (auto const exp{
-          create_buffer_from_upload_data(meshlet_buf_size, gpu_mesh.meshlet_buf)
-        }; !exp) {
-          return std::unexpected{
-            std::format("Failed to create mesh {} meshlet buffer: {}", idx,
-                        exp.error())
-          };
-        }
-
-        create_buffer_srv(static_cast<UINT>(meshlet_count),
-                          static_cast<UINT>(meshlet_stride),
-                          gpu_mesh.meshlet_buf->GetResource(),
-                          gpu_mesh.meshlet_buf_srv_idx);
-      }
+  // The records of frame f are at [f * mesh count, (f + 1) * mesh count).
+  std::vector<DrawRecord> draw_records;
+  draw_records.reserve(max_frames_in_flight_ * gpu_scene_.meshes.size());
 
-      {
-        auto const vertex_idx_count{mesh_data.vertex_indices.size() / 4};
-        auto constexpr vertex_idx_stride{sizeof(std::uint32_t)};
-        auto const vertex_idx_buf_size{vertex_idx_count * vertex_idx_stride};
-
-        std::memcpy(upload_buffer_ptr, mesh_data.vertex_indices.data(),
-                    vertex_idx_buf_size);
-
-        if (auto const exp{
-          create_buffer_from_upload_data(vertex_idx_buf_size,
-                                         gpu_mesh.vertex_idx_buf)
-        }; !exp) {
-          return std::unexpected{
-            std::format("Failed to create mesh {} vertex index buffer: {}", idx,
-                        exp.error())
-          };
-        }
-
-        create_buffer_srv(static_cast<UINT>(vertex_idx_count),
-                          static_cast<UINT>(vertex_idx_stride),
-                          gpu_mesh.vertex_idx_buf->GetResource(),
-                          gpu_mesh.vertex_idx_buf_srv_idx);
-      }
+  for (auto i{0}; i < max_frames_in_flight_; i++) {
+    for (auto const& mesh : gpu_scene_.meshes) {
+      auto const& bases{mesh.geometry_bases};
+      draw_records.emplace_back(
+        bases[kGeometryStreamPosition], bases[kGeometryStreamNormal],
+        bases[kGeometryStreamTangent], bases[kGeometryStreamUv],
+        bases[kGeometryStreamVertexIndex], bases[kGeometryStreamPrimitiveIndex],
+        bases[kGeometryStreamMeshlet], bases[kGeometryStreamInstance],
+        gpu_scene_.materials[mesh.mtl_idx].cbv_idx,
+        mesh.visible_instance_lists[i].srv_idx);
+    }
+  }
 
-      {
-        auto const prim_idx_count{mesh_data.triangle_indices.size()};
-        auto constexpr prim_idx_stride{sizeof(MeshletTriangleIndexData)};
-        auto const prim_idx_buf_size{prim_idx_count * prim_idx_stride};
-
-        std::memcpy(upload_buffer_ptr, mesh_data.triangle_indices.data(),
-                    prim_idx_buf_size);
-
-        if (auto const exp{
-          create_buffer_from_upload_data(prim_idx_buf_size,
-                                         gpu_mesh.prim_idx_buf)
-        }; !exp) {
-          return std::unexpected{
-            std::format("Failed to create mesh {} primitive index buffer: {}",
-                        idx, exp.error())
-          };
-        }
-
-        create_buffer_srv(static_cast<UINT>(prim_idx_count),
-                          static_cast<UINT>(prim_idx_stride),
-                          gpu_mesh.prim_idx_buf->GetResource(),
-                          gpu_mesh.prim_idx_buf_srv_idx);
-      }
+  if (!draw_records.empty()) {
+    if (auto const exp{
+      CreateBuffer(draw_records.size() * sizeof(DrawRecord),
+                   gpu_scene_.draw_record_buf)
+    }; !exp) {
+      return std::unexpected{
+        std::format("Failed to create draw record buffer: {}", exp.error())
+      };
+    }
 
-      gpu_mesh.meshlet_count = static_cast<UINT>(mesh_data.meshlets.size());
+    if (auto const exp{
+      uploader_->UploadBuffer(gpu_scene_.draw_record_buf->GetResource(), 0,
+                              std::as_bytes(std::span{draw_records}))
+    }; !exp) {
+      return std::unexpected{
+        std::format("Failed to upload draw records: {}", exp.error())
+      };
     }
 
-    gpu_mesh.mtl_idx = mesh_data.material_idx;
+    if (auto const exp{
+      CreateBufferSrv(static_cast<UINT>(draw_records.size()),
+                      static_cast<UINT>(sizeof(DrawRecord)),
+                      gpu_scene_.draw_record_buf->GetResource(),
+                      gpu_scene_.draw_record_buf_srv_idx)
+    }; !exp) {
+      return std::unexpected{
+        std::format("Failed to create draw record SRV: {}", exp.error())
+      };
+    }
+  }
 
-    auto const instance_count{instance_transforms_per_mesh[idx].size()};
-    auto constexpr instance_data_stride{sizeof(InstanceBufferData)};
+  std::uint64_t max_draw_cmd_count{0};
 
-    std::memcpy(upload_buffer_ptr, instance_transforms_per_mesh[idx].data(),
-                instance_count * instance_data_stride);
+  for (auto const& mesh : gpu_scene_.meshes) {
+    max_draw_cmd_count += CalculateMaxIndirectDrawCommandCount(
+      mesh.dispatch_chunks, mesh.instance_count);
+  }
 
-    if (auto const exp{
-      create_buffer_from_upload_data(instance_count * instance_data_stride,
-                                     gpu_mesh.inst_buf)
-    }; !exp) {
-      return std::unexpected{exp.error()};
+  auto const indirect_draw_buf_desc{
+    CD3DX12_RESOURCE_DESC1::Buffer(
+      std::max<std::uint64_t>(max_draw_cmd_count, 1) * sizeof(
+        IndirectDrawCommand))
+  };
+
+  for (auto i{0}; i < max_frames_in_flight_; i++) {
+    auto& [buf, commands]{gpu_scene_.indirect_draw_buffers.emplace_back()};
+
+    if (FAILED(
+      renderer_->mem_allocator_->CreateResource3(&kUploadAllocDesc, &
+        indirect_draw_buf_desc, D3D12_BARRIER_LAYOUT_UNDEFINED, nullptr, 0,
+        nullptr, &buf, IID_NULL, nullptr))) {
+      return std::unexpected{
+        std::format("Failed to create indirect draw buffer {}.", i)
+      };
     }
 
-    create_buffer_srv(static_cast<UINT>(instance_count),
-                      static_cast<UINT>(instance_data_stride),
-                      gpu_mesh.inst_buf->GetResource(),
-                      gpu_mesh.inst_buf_srv_idx);
+    void* mapped;
+    if (FAILED(buf->GetResource()->Map(0, nullptr, &mapped))) {
+      return std::unexpected{
+        std::format("Failed to map indirect draw buffer {}.", i)
+      };
+    }
+
+    commands = std::span{
+      static_cast<IndirectDrawCommand*>(mapped),
+      static_cast<std::size_t>(max_draw_cmd_count)
+    };
+  }
+
+  if (auto const exp{uploader_->Finish()}; !exp) {
+    return std::unexpected{
+      std::format("Failed to finish scene upload: {}", exp.error())
+    };
+  }
+
+  return {};
+}
+
+auto Renderer::GpuSceneSink::TakeGpuScene() -> GpuScene {
+  return std::move(gpu_scene_);
+}
+
+auto Renderer::GpuSceneSink::CreateBuffer(
+  UINT64 const byte_count,
+  ComPtr<D3D12MA::Allocation>& buf) const -> std::expected<void, std::string> {
+  auto const buf_desc{CD3DX12_RESOURCE_DESC1::Buffer(byte_count)};
+
+  if FAILED(
+    renderer_->mem_allocator_->CreateResource3(&kDefaultAllocDesc, &buf_desc,
+      D3D12_BARRIER_LAYOUT_UNDEFINED, nullptr, 0, nullptr, &buf, IID_NULL,
+      nullptr)) {
+    return std::unexpected{"Failed to create buffer."};
+  }
+
+  return {};
+}
+
+auto Renderer::GpuSceneSink::CreateBufferSrv(UINT const element_count,
+                                             UINT const element_stride,
+                                             ID3D12Resource* const buf,
+                                             UINT& srv_idx) -> std::expected<
+  void, std::string> {
+  auto const idx{renderer_->AllocateResourceDescriptorIndex()};
+
+  if (!idx) {
+    return std::unexpected{idx.error()};
+  }
+
+  srv_idx = *idx;
+
+  D3D12_SHADER_RESOURCE_VIEW_DESC const srv_desc{
+    .Format = DXGI_FORMAT_UNKNOWN,
+    .ViewDimension = D3D12_SRV_DIMENSION_BUFFER,
+    .Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING,
+    .Buffer = {0, element_count, element_stride, D3D12_BUFFER_SRV_FLAG_NONE}
+  };
+
+  renderer_->device_->CreateShaderResourceView(buf, &srv_desc,
+                                               GetDescriptorHandle(srv_idx));
+  return {};
+}
+
+auto Renderer::GpuSceneSink::GetDescriptorHandle(
+  UINT const idx) const -> D3D12_CPU_DESCRIPTOR_HANDLE {
+  return CD3DX12_CPU_DESCRIPTOR_HANDLE{
+    renderer_->res_desc_heap_->GetCPUDescriptorHandleForHeapStart(),
+    static_cast<INT>(idx),
+    renderer_->device_->GetDescriptorHandleIncrementSize(
+      D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV)
+  };
+}
+
+auto Renderer::GpuSceneSink::IsKeptOnCpu(
+  SceneSection const& section) const -> bool {
+  switch (section.type) {
+  case SceneSectionType::kPositions:
+  case SceneSectionType::kMeshlets:
+  case SceneSectionType::kInstances:
+    return true;
+  case SceneSectionType::kVertexIndices:
+  case SceneSectionType::kTriangleIndices:
+    // Occluders are built from the indices of small meshes.
+    return mesh_layouts_[section.item_idx].triangle_index_count <=
+      max_occluder_triangle_count_;
+  default:
+    return false;
+  }
+}
+
+auto Renderer::CreateGpuScene(std::filesystem::path const& path,
+                              SceneLoadOptions const& options) -> std::expected<
+  GpuScene, std::string> {
+  PENSIEVE_PROFILE_ZONE("CreateGpuScene");
+
+  auto uploader{Uploader::Create(device_.Get(), mem_allocator_.Get())};
+
+  if (!uploader) {
+    return std::unexpected{uploader.error()};
+  }
+
+  GpuSceneSink sink{*this, *uploader};
 
-    gpu_mesh.instance_count = static_cast<UINT>(instance_count);
-    gpu_mesh.meshlets = mesh_data.meshlets;
+  if (auto const exp{StreamScene(path, sink, options)}; !exp) {
+    return std::unexpected{exp.error()};
   }
 
-  return gpu_scene;
+  return sink.TakeGpuScene();
 }
 
 auto Renderer::DrawFrame(GpuScene const& scene,
                          Camera const& cam) -> std::expected<
   void, std::string> {
+  PENSIEVE_PROFILE_ZONE("DrawFrame");
+
+  auto const record_begin{std::chrono::steady_clock::now()};
+
+  // The last frame that used this frame index has completed on the GPU.
+  if (frame_count_ >= max_frames_in_flight_) {
+    telemetry_->RecordGpuFrame(gpu_timestamps_,
+                               frame_count_ - max_frames_in_flight_);
+  }
+
   auto const back_buf_idx{swap_chain_->GetCurrentBackBufferIndex()};
   auto const back_buf_desc{swap_chain_buffers_[back_buf_idx]->GetDesc1()};
   auto const aspect_ratio{
@@ -900,6 +1395,8 @@ auto Renderer::DrawFrame(GpuScene const& scene,
     };
   }
 
+  gpu_timestamps_.BeginFrame(cmd_lists_[frame_idx_].Get(), frame_count_);
+
   D3D12_TEXTURE_BARRIER const rt_barrier{
       D3D12_BARRIER_SYNC_NONE, D3D12_BARRIER_SYNC_RENDER_TARGET,
       D3D12_BARRIER_ACCESS_NO_ACCESS, D3D12_BARRIER_ACCESS_RENDER_TARGET,
@@ -916,13 +1413,6 @@ auto Renderer::DrawFrame(GpuScene const& scene,
 
   cmd_lists_[frame_idx_]->Barrier(1, &rt_barrier_group);
 
-  cmd_lists_[frame_idx_]->OMSetRenderTargets(1, &rtv_cpu_handles_[back_buf_idx],
-                                             TRUE, &dsv_cpu_handle_);
-  cmd_lists_[frame_idx_]->SetDescriptorHeaps(1, res_desc_heap_.GetAddressOf());
-  cmd_lists_[frame_idx_]->SetGraphicsRootSignature(root_sig_.Get());
-  cmd_lists_[frame_idx_]->IASetPrimitiveTopology(
-    D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-
   CD3DX12_VIEWPORT const viewport{
     0.0f, 0.0f, static_cast<FLOAT>(back_buf_desc.Width),
     static_cast<FLOAT>(back_buf_desc.Height)
@@ -932,9 +1422,6 @@ auto Renderer::DrawFrame(GpuScene const& scene,
     static_cast<LONG>(back_buf_desc.Height)
   };
 
-  cmd_lists_[frame_idx_]->RSSetViewports(1, &viewport);
-  cmd_lists_[frame_idx_]->RSSetScissorRects(1, &scissor);
-
   cmd_lists_[frame_idx_]->ClearRenderTargetView(rtv_cpu_handles_[back_buf_idx],
                                                 std::array{
                                                   0.0f, 0.0f, 0.0f, 1.0f
@@ -943,100 +1430,105 @@ auto Renderer::DrawFrame(GpuScene const& scene,
   cmd_lists_[frame_idx_]->ClearDepthStencilView(
     dsv_cpu_handle_, D3D12_CLEAR_FLAG_DEPTH, 0.0f, 0, 0, nullptr);
 
-  cmd_lists_[frame_idx_]->SetGraphicsRoot32BitConstants(
-    0, 16, view_proj_mtx.m, offsetof(DrawParams, view_proj_mtx) / 4);
-  cmd_lists_[frame_idx_]->SetGraphicsRoot32BitConstants(
-    0, 3, &cam_pos.x, offsetof(DrawParams, camera_pos) / 4);
-
-  for (auto const& mesh : scene.meshes) {
-    cmd_lists_[frame_idx_]->SetGraphicsRoot32BitConstant(
-      0, mesh.pos_buf_srv_idx, offsetof(DrawParams, pos_buf_idx) / 4);
-    cmd_lists_[frame_idx_]->SetGraphicsRoot32BitConstant(
-      0, mesh.norm_buf_srv_idx, offsetof(DrawParams, norm_buf_idx) / 4);
-    cmd_lists_[frame_idx_]->SetGraphicsRoot32BitConstant(
-      0, mesh.tan_buf_srv_idx.value_or(INVALID_RESOURCE_IDX),
-      offsetof(DrawParams, tan_buf_idx) / 4);
-    cmd_lists_[frame_idx_]->SetGraphicsRoot32BitConstant(
-      0, mesh.uv_buf_srv_idx.value_or(INVALID_RESOURCE_IDX),
-      offsetof(DrawParams, uv_buf_idx) / 4);
-    cmd_lists_[frame_idx_]->SetGraphicsRoot32BitConstant(
-      0, mesh.vertex_idx_buf_srv_idx,
-      offsetof(DrawParams, vertex_idx_buf_idx) / 4);
-    cmd_lists_[frame_idx_]->SetGraphicsRoot32BitConstant(
-      0, mesh.prim_idx_buf_srv_idx, offsetof(DrawParams, prim_idx_buf_idx) / 4);
-    cmd_lists_[frame_idx_]->SetGraphicsRoot32BitConstant(
-      0, mesh.meshlet_buf_srv_idx, offsetof(DrawParams, meshlet_buf_idx) / 4);
-    cmd_lists_[frame_idx_]->SetGraphicsRoot32BitConstant(
-      0, scene.materials[mesh.mtl_idx].cbv_idx,
-      offsetof(DrawParams, mtl_buf_idx) / 4);
-    cmd_lists_[frame_idx_]->SetGraphicsRoot32BitConstant(
-      0, mesh.inst_buf_srv_idx, offsetof(DrawParams, inst_buf_idx) / 4);
-    cmd_lists_[frame_idx_]->SetGraphicsRoot32BitConstant(
-      0, mesh.meshlet_count, offsetof(DrawParams, meshlet_count) / 4);
-
-    std::size_t constexpr max_dispatch_thread_group_count{65535};
-
-    for (std::size_t meshlet_offset{0}; meshlet_offset < mesh.meshlet_count;
-         meshlet_offset += max_dispatch_thread_group_count) {
-      auto const meshlet_count{
-        std::min(mesh.meshlet_count - meshlet_offset,
-                 max_dispatch_thread_group_count)
-      };
-
-      cmd_lists_[frame_idx_]->SetGraphicsRoot32BitConstant(
-        0, static_cast<UINT>(meshlet_count),
-        offsetof(DrawParams, meshlet_count) / 4);
-      cmd_lists_[frame_idx_]->SetGraphicsRoot32BitConstant(
-        0, static_cast<UINT>(meshlet_offset),
-        offsetof(DrawParams, meshlet_offset) / 4);
+  if (FAILED(cmd_lists_[frame_idx_]->Close())) {
+    return std::unexpected{
+      std::format("Failed to close command list {}.", frame_idx_)
+    };
+  }
 
-      auto const& last_meshlet{
-        mesh.meshlets[meshlet_offset + meshlet_count - 1]
-      };
+  std::span<float const, 16> const view_proj_mtx_span{
+    &view_proj_mtx.m[0][0], 16
+  };
+  auto const frustum{ExtractFrustum(view_proj_mtx_span)};
+
+  visible_instance_indices_.resize(scene.meshes.size());
+  visible_instance_counts_.resize(scene.meshes.size());
+
+  job_system_->ParallelFor(scene.meshes.size(), 1,
+                           [this, &scene, &frustum](std::size_t const begin,
+                                                    std::size_t const end) {
+                             for (auto i{begin}; i < end; i++) {
+                               auto const& mesh{scene.meshes[i]};
+                               auto& indices{visible_instance_indices_[i]};
+                               indices.resize(mesh.instance_count);
+                               visible_instance_counts_[i] = CullInstances(
+                                 *job_system_, frustum, mesh.instance_bounds,
+                                 indices);
+                             }
+                           });
+
+  culling_stats_ = {0, 0, 0};
+
+  for (std::size_t i{0}; i < scene.meshes.size(); i++) {
+    culling_stats_.instance_count += scene.meshes[i].instance_count;
+    culling_stats_.frustum_visible_instance_count += visible_instance_counts_[
+      i];
+  }
 
-      auto const pack_count{
-        std::min(MESHLET_MAX_VERTS / last_meshlet.vert_count,
-                 MESHLET_MAX_PRIMS / last_meshlet.prim_count)
-      };
+  CullOccludedInstances(scene, cam_pos, view_proj_mtx_span);
 
-      auto const group_count_per_instance{
-        static_cast<float>(meshlet_count - 1) + 1.0f / static_cast<float>(
-          pack_count)
-      };
+  mesh_draw_sources_.clear();
 
-      auto const max_instance_count_per_batch{
-        static_cast<std::uint32_t>(static_cast<float>(
-          max_dispatch_thread_group_count) / group_count_per_instance)
-      };
+  for (std::size_t i{0}; i < scene.meshes.size(); i++) {
+    culling_stats_.occlusion_visible_instance_count += visible_instance_counts_
+      [i];
+    std::ranges::copy_n(visible_instance_indices_[i].begin(),
+                        visible_instance_counts_[i],
+                        scene.meshes[i].visible_instance_lists[frame_idx_].
+                        indices.begin());
+    mesh_draw_sources_.emplace_back(
+      scene.meshes[i].dispatch_chunks, visible_instance_counts_[i],
+      static_cast<std::uint32_t>(frame_idx_ * scene.meshes.size() + i));
+  }
 
-      auto const dispatch_count{
-        DivRoundUp(mesh.instance_count, max_instance_count_per_batch)
-      };
+  auto const& draw_cmd_allocs{draw_cmd_allocs_[frame_idx_]};
+  auto const& draw_cmd_lists{draw_cmd_lists_[frame_idx_]};
 
-      for (std::size_t i{0}; i < dispatch_count; i++) {
-        auto const batch_instance_offset{
-          static_cast<UINT>(i * max_instance_count_per_batch)
-        };
+  PartitionDraws(mesh_draw_sources_,
+                 static_cast<std::uint32_t>(draw_cmd_lists.size()),
+                 min_draw_partition_cmd_count_, draw_partitions_);
+  partition_draw_commands_.resize(draw_partitions_.size());
 
-        auto const batch_instance_count{
-          std::min(mesh.instance_count - batch_instance_offset,
-                   max_instance_count_per_batch)
-        };
+  for (std::size_t i{0}; i < draw_partitions_.size(); i++) {
+    if (FAILED(draw_cmd_allocs[i]->Reset())) {
+      return std::unexpected{
+        std::format("Failed to reset draw command allocator {} of frame {}.", i,
+                    frame_idx_)
+      };
+    }
 
-        cmd_lists_[frame_idx_]->SetGraphicsRoot32BitConstant(
-          0, batch_instance_offset, offsetof(DrawParams, instance_offset) / 4);
-        cmd_lists_[frame_idx_]->SetGraphicsRoot32BitConstant(
-          0, batch_instance_count, offsetof(DrawParams, instance_count) / 4);
+    if (FAILED(
+      draw_cmd_lists[i]->Reset(draw_cmd_allocs[i].Get(), pso_.Get()))) {
+      return std::unexpected{
+        std::format("Failed to reset draw command list {} of frame {}.", i,
+                    frame_idx_)
+      };
+    }
+  }
 
-        auto const group_count{
-          static_cast<std::uint32_t>(std::ceilf(
-            group_count_per_instance * batch_instance_count))
+  job_system_->ParallelFor(
+    draw_partitions_.size(), 1,
+    [this, &scene, &draw_cmd_lists, back_buf_idx, &viewport, &scissor,
+      view_proj_mtx_span, &cam_pos](std::size_t const begin,
+                                    std::size_t const end) {
+      for (auto i{begin}; i < end; i++) {
+        SetDrawState(draw_cmd_lists[i].Get(), back_buf_idx, viewport, scissor);
+
+        D3D12CommandRecorder recorder{
+          draw_cmd_lists[i].Get(), draw_cmd_sig_.Get(),
+          scene.indirect_draw_buffers[frame_idx_],
+          draw_partitions_[i].first_command
         };
 
-        cmd_lists_[frame_idx_]->DispatchMesh(group_count, 1, 1);
+        RecordDrawPartition(recorder, view_proj_mtx_span,
+                            std::span<float const, 3>{&cam_pos.x, 3},
+                            {
+                              scene.draw_record_buf_srv_idx,
+                              scene.geometry_buf_srv_indices
+                            }, mesh_draw_sources_, draw_partitions_[i],
+                            partition_draw_commands_[i]);
       }
-    }
-  }
+    });
 
   D3D12_TEXTURE_BARRIER const present_barrier{
     D3D12_BARRIER_SYNC_RENDER_TARGET, D3D12_BARRIER_SYNC_NONE,
@@ -1051,21 +1543,46 @@ auto Renderer::DrawFrame(GpuScene const& scene,
     .pTextureBarriers = &present_barrier
   };
 
-  cmd_lists_[frame_idx_]->Barrier(1, &present_barrier_group);
+  draw_cmd_lists[draw_partitions_.size() - 1]->Barrier(
+    1, &present_barrier_group);
+  gpu_timestamps_.EndFrame(draw_cmd_lists[draw_partitions_.size() - 1].Get(),
+                           frame_count_);
 
-  if (FAILED(cmd_lists_[frame_idx_]->Close())) {
-    return std::unexpected{
-      std::format("Failed to close command list {}.", frame_idx_)
-    };
+  // The partitions are submitted in mesh order after the clears.
+  std::vector<ID3D12CommandList*> submitted_cmd_lists{
+    cmd_lists_[frame_idx_].Get()
+  };
+
+  for (std::size_t i{0}; i < draw_partitions_.size(); i++) {
+    if (FAILED(draw_cmd_lists[i]->Close())) {
+      return std::unexpected{
+        std::format("Failed to close draw command list {} of frame {}.", i,
+                    frame_idx_)
+      };
+    }
+
+    submitted_cmd_lists.emplace_back(draw_cmd_lists[i].Get());
   }
 
+  auto const submit_begin{std::chrono::steady_clock::now()};
+  telemetry_->RecordStage(frame_count_, FrameStage::kRecord, record_begin,
+                          submit_begin);
+
   direct_queue_->ExecuteCommandLists(
-    1, CommandListCast(cmd_lists_[frame_idx_].GetAddressOf()));
+    static_cast<UINT>(submitted_cmd_lists.size()), submitted_cmd_lists.data());
+
+  auto const present_begin{std::chrono::steady_clock::now()};
+  telemetry_->RecordStage(frame_count_, FrameStage::kSubmit, submit_begin,
+                          present_begin);
 
   if (FAILED(swap_chain_->Present(0, present_flags_))) {
     return std::unexpected{"Failed to present."};
   }
 
+  auto const fence_wait_begin{std::chrono::steady_clock::now()};
+  telemetry_->RecordStage(frame_count_, FrameStage::kPresent, present_begin,
+                          fence_wait_begin);
+
   frame_idx_ = (frame_idx_ + 1) % max_frames_in_flight_;
 
   frame_fence_val_ += 1;
@@ -1079,6 +1596,10 @@ auto Renderer::DrawFrame(GpuScene const& scene,
     return std::unexpected{"Failed to wait for frame fence."};
   }
 
+  telemetry_->RecordStage(frame_count_, FrameStage::kFenceWait,
+                          fence_wait_begin, std::chrono::steady_clock::now());
+  ++frame_count_;
+
   return {};
 }
 
@@ -1154,19 +1675,31 @@ Renderer::Renderer(ComPtr<IDXGIFactory7> factory, ComPtr<ID3D12Device10> device,
                               max_frames_in_flight_> cmd_allocs,
                    std::array<ComPtr<ID3D12GraphicsCommandList7>,
                               max_frames_in_flight_> cmd_lists,
+                   std::array<std::vector<ComPtr<ID3D12CommandAllocator>>,
+                              max_frames_in_flight_> draw_cmd_allocs,
+                   std::array<std::vector<ComPtr<ID3D12GraphicsCommandList7>>,
+                              max_frames_in_flight_> draw_cmd_lists,
                    ComPtr<ID3D12Fence> frame_fence,
                    ComPtr<ID3D12RootSignature> root_sig,
                    ComPtr<ID3D12PipelineState> pso,
+                   ComPtr<ID3D12CommandSignature> draw_cmd_sig,
                    ComPtr<D3D12MA::Allocator> mem_allocator,
-                   UINT const swap_chain_flags, UINT const present_flags) :
+                   D3D12TimestampSource gpu_timestamps, JobSystem& job_system,
+                   FrameTelemetry& telemetry, UINT const swap_chain_flags,
+                   UINT const present_flags) :
   factory_{std::move(factory)}, device_{std::move(device)},
   direct_queue_{std::move(direct_queue)}, swap_chain_{std::move(swap_chain)},
   swap_chain_buffers_{std::move(swap_chain_buffers)},
   depth_buffer_{std::move(depth_buffer)}, rtv_heap_{std::move(rtv_heap)},
   dsv_heap_{std::move(dsv_heap)}, res_desc_heap_{std::move(res_desc_heap)},
   cmd_allocs_{std::move(cmd_allocs)}, cmd_lists_{std::move(cmd_lists)},
+  draw_cmd_allocs_{std::move(draw_cmd_allocs)},
+  draw_cmd_lists_{std::move(draw_cmd_lists)},
   frame_fence_{std::move(frame_fence)}, root_sig_{std::move(root_sig)},
-  pso_{std::move(pso)}, mem_allocator_{std::move(mem_allocator)},
+  pso_{std::move(pso)}, draw_cmd_sig_{std::move(draw_cmd_sig)},
+  mem_allocator_{std::move(mem_allocator)},
+  gpu_timestamps_{std::move(gpu_timestamps)}, job_system_{&job_system},
+  telemetry_{&telemetry},
   dsv_cpu_handle_{
     CD3DX12_CPU_DESCRIPTOR_HANDLE{
       dsv_heap_->GetCPUDescriptorHandleForHeapStart(), 0,
@@ -1187,15 +1720,99 @@ Renderer::Renderer(ComPtr<IDXGIFactory7> factory, ComPtr<ID3D12Device10> device,
     };
   }
 
-  res_desc_heap_free_indices_.resize(res_desc_heap_size_);
-  for (UINT i{0}; i < res_desc_heap_size_; i++) {
-    res_desc_heap_free_indices_[i] = i;
-  }
-
   CreateSwapChainRtvs();
   CreateDepthBufferDsv();
 }
 
+auto Renderer::GetCullingStats() const -> CullingStats {
+  return culling_stats_;
+}
+
+auto Renderer::CullOccludedInstances(GpuScene const& scene,
+                                     DirectX::XMFLOAT3 const& cam_pos,
+                                     std::span<float const, 16> const
+                                     view_proj_mtx) -> void {
+  PENSIEVE_PROFILE_ZONE("CullOccludedInstances");
+
+  struct OccluderCandidate {
+    float score;
+    std::uint32_t mesh_idx;
+    std::uint32_t instance_idx;
+  };
+
+  std::vector<OccluderCandidate> candidates;
+
+  for (std::uint32_t mesh_idx{0}; mesh_idx < scene.meshes.size(); mesh_idx++) {
+    auto const& mesh{scene.meshes[mesh_idx]};
+
+    if (!mesh.occluder) {
+      continue;
+    }
+
+    auto const& bounds{mesh.instance_bounds};
+
+    for (std::uint32_t i{0}; i < visible_instance_counts_[mesh_idx]; i++) {
+      auto const instance_idx{visible_instance_indices_[mesh_idx][i]};
+      auto const dx{bounds.center_x[instance_idx] - cam_pos.x};
+      auto const dy{bounds.center_y[instance_idx] - cam_pos.y};
+      auto const dz{bounds.center_z[instance_idx] - cam_pos.z};
+      auto const ex{bounds.extent_x[instance_idx]};
+      auto const ey{bounds.extent_y[instance_idx]};
+      auto const ez{bounds.extent_z[instance_idx]};
+
+      // Approximates the solid angle of the bounds.
+      candidates.emplace_back(
+        (ex * ex + ey * ey + ez * ez) / std::max(dx * dx + dy * dy + dz * dz,
+                                                 1e-6f), mesh_idx,
+        instance_idx);
+    }
+  }
+
+  auto const occluder_count{
+    std::min(candidates.size(), static_cast<std::size_t>(max_occluder_count_))
+  };
+
+  std::ranges::partial_sort(candidates, candidates.begin() + occluder_count,
+                            std::ranges::greater{},
+                            &OccluderCandidate::score);
+
+  occlusion_buffer_.Clear(view_proj_mtx);
+
+  for (std::size_t i{0}; i < occluder_count; i++) {
+    auto const& occluder{*scene.meshes[candidates[i].mesh_idx].occluder};
+    occlusion_buffer_.RasterizeOccluder(
+      occluder.positions, occluder.triangle_indices,
+      occluder.instances[candidates[i].instance_idx].model_mtx);
+  }
+
+  occlusion_buffer_.BuildHierarchy();
+
+  job_system_->ParallelFor(
+    scene.meshes.size(), 1,
+    [this, &scene](std::size_t const begin, std::size_t const end) {
+      for (auto mesh_idx{begin}; mesh_idx < end; mesh_idx++) {
+        auto const& bounds{scene.meshes[mesh_idx].instance_bounds};
+        auto& indices{visible_instance_indices_[mesh_idx]};
+        auto const first{indices.begin()};
+        auto const last{
+          std::remove_if(first, first + visible_instance_counts_[mesh_idx],
+                         [this, &bounds](std::uint32_t const idx) {
+                           return !occlusion_buffer_.IsVisible(
+                             Float3{
+                               bounds.center_x[idx], bounds.center_y[idx],
+                               bounds.center_z[idx]
+                             },
+                             Float3{
+                               bounds.extent_x[idx], bounds.extent_y[idx],
+                               bounds.extent_z[idx]
+                             });
+                         })
+        };
+        visible_instance_counts_[mesh_idx] = static_cast<UINT>(last - first);
+      }
+    });
+}
+
 auto Renderer::RetrieveSwapChainBuffers(IDXGISwapChain4* const swap_chain,
                                         std::span<
                                           ComPtr<ID3D12Resource2>,
@@ -1238,6 +1855,19 @@ auto Renderer::CreateDepthBuffer(ID3D12Device10* const device,
   return {};
 }
 
+auto Renderer::SetDrawState(ID3D12GraphicsCommandList7* const cmd_list,
+                            UINT const back_buf_idx,
+                            D3D12_VIEWPORT const& viewport,
+                            D3D12_RECT const& scissor) const -> void {
+  cmd_list->OMSetRenderTargets(1, &rtv_cpu_handles_[back_buf_idx], TRUE,
+                               &dsv_cpu_handle_);
+  cmd_list->SetDescriptorHeaps(1, res_desc_heap_.GetAddressOf());
+  cmd_list->SetGraphicsRootSignature(root_sig_.Get());
+  cmd_list->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+  cmd_list->RSSetViewports(1, &viewport);
+  cmd_list->RSSetScissorRects(1, &scissor);
+}
+
 auto Renderer::CreateSwapChainRtvs() const -> void {
   for (auto i{0}; i < swap_chain_buffer_count_; i++) {
     D3D12_RENDER_TARGET_VIEW_DESC constexpr rtv_desc{
@@ -1261,13 +1891,23 @@ auto Renderer::CreateDepthBufferDsv() const -> void {
                                   dsv_cpu_handle_);
 }
 
-auto Renderer::AllocateResourceDescriptorIndex() -> UINT {
-  auto const ret{res_desc_heap_free_indices_.back()};
-  res_desc_heap_free_indices_.pop_back();
-  return ret;
+auto Renderer::AllocateResourceDescriptorIndex() -> std::expected<
+  UINT, std::string> {
+  return AllocateResourceDescriptorRange(1);
+}
+
+auto Renderer::AllocateResourceDescriptorRange(
+  UINT const count) -> std::expected<UINT, std::string> {
+  if (auto const first{res_desc_allocator_.Allocate(count)}) {
+    return *first;
+  }
+
+  return std::unexpected{
+    std::format("No {} contiguous free resource descriptors.", count)
+  };
 }
 
 auto Renderer::FreeResourceDescriptorIndex(UINT const idx) -> void {
-  res_desc_heap_free_indices_.push_back(idx);
+  res_desc_allocator_.Free(idx);
 }
 }
@@ -1,9 +1,13 @@
 #pragma once
 
 #include <array>
+#include <cstddef>
+#include <cstdint>
 #include <expected>
+#include <filesystem>
 #include <span>
 #include <string>
+#include <vector>
 
 #define WIN32_LEAN_AND_MEAN
 #define NOMINMAX
@@ -14,17 +18,39 @@
 #include <wrl/client.h>
 
 #include "camera.hpp"
+#include "d3d12_timestamp_source.hpp"
+#include "descriptor_allocator.hpp"
+#include "draw_partitioning.hpp"
+#include "frame_telemetry.hpp"
 #include "scene_data.hpp"
 #include "gpu_scene.hpp"
+#include "indirect_draw.hpp"
+#include "job_system.hpp"
+#include "occlusion_culling.hpp"
+#include "scene_loading.hpp"
 
 namespace pensieve {
+struct CullingStats {
+  std::size_t instance_count;
+  std::size_t frustum_visible_instance_count;
+  std::size_t occlusion_visible_instance_count;
+};
+
 class Renderer {
 public:
-  [[nodiscard]] static auto Create(
-    HWND hwnd) -> std::expected<Renderer, std::string>;
-
-  [[nodiscard]] auto CreateGpuScene(
-    SceneData const& scene_data) -> std::expected<GpuScene, std::string>;
+  // The job system runs the CPU side scene preparation and culling, the
+  // telemetry receives the stage timings of every frame. Both must outlive the
+  // renderer.
+  [[nodiscard]] static auto Create(HWND hwnd, JobSystem& job_system,
+                                   FrameTelemetry& telemetry) -> std::expected<
+    Renderer, std::string>;
+
+  // Streams the scene file into staging memory, the scene is never fully
+  // loaded into CPU memory.
+  [[nodiscard]] auto CreateGpuScene(std::filesystem::path const& path,
+                                    SceneLoadOptions const& options =
+                                      kDefaultSceneLoadOptions) ->
+    std::expected<GpuScene, std::string>;
 
   [[nodiscard]] auto DrawFrame(GpuScene const& scene,
                                Camera const& cam) -> std::expected<
@@ -35,6 +61,9 @@ public:
 
   [[nodiscard]] auto ResizeRenderTargets() -> std::expected<void, std::string>;
 
+  // Instance counts of the last drawn frame.
+  [[nodiscard]] auto GetCullingStats() const -> CullingStats;
+
 private:
   static auto constexpr swap_chain_buffer_count_{2};
   static auto constexpr swap_chain_format_{DXGI_FORMAT_R8G8B8A8_UNORM};
@@ -42,6 +71,12 @@ private:
   static auto constexpr max_gpu_queued_frames_{1};
   static auto constexpr max_frames_in_flight_{max_gpu_queued_frames_ + 1};
   static auto constexpr res_desc_heap_size_{1'000'000};
+  static auto constexpr max_occluder_triangle_count_{4096};
+  static auto constexpr max_occluder_count_{64};
+  static auto constexpr max_draw_partition_count_{16};
+  static auto constexpr min_draw_partition_cmd_count_{2048};
+
+  class GpuSceneSink;
 
   Renderer(Microsoft::WRL::ComPtr<IDXGIFactory7> factory,
            Microsoft::WRL::ComPtr<ID3D12Device10> device,
@@ -57,11 +92,20 @@ private:
                       max_frames_in_flight_> cmd_allocs,
            std::array<Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList7>,
                       max_frames_in_flight_> cmd_lists,
+           std::array<std::vector<Microsoft::WRL::ComPtr<
+                        ID3D12CommandAllocator>>, max_frames_in_flight_>
+           draw_cmd_allocs,
+           std::array<std::vector<Microsoft::WRL::ComPtr<
+                        ID3D12GraphicsCommandList7>>, max_frames_in_flight_>
+           draw_cmd_lists,
            Microsoft::WRL::ComPtr<ID3D12Fence> frame_fence,
            Microsoft::WRL::ComPtr<ID3D12RootSignature> root_sig,
            Microsoft::WRL::ComPtr<ID3D12PipelineState> pso,
+           Microsoft::WRL::ComPtr<ID3D12CommandSignature> draw_cmd_sig,
            Microsoft::WRL::ComPtr<D3D12MA::Allocator> mem_allocator,
-           UINT swap_chain_flags, UINT present_flags);
+           D3D12TimestampSource gpu_timestamps, JobSystem& job_system,
+           FrameTelemetry& telemetry, UINT swap_chain_flags,
+           UINT present_flags);
 
   [[nodiscard]] static auto RetrieveSwapChainBuffers(
     IDXGISwapChain4* swap_chain,
@@ -74,10 +118,33 @@ private:
                                               unsigned height) -> std::expected<
     void, std::string>;
 
+  // Builds the parts of the GPU mesh that need no device access, so that it
+  // can run on any thread.
+  static auto PrepareGpuMesh(MeshData const& mesh_data, GpuMesh& gpu_mesh,
+                             std::vector<MeshletData>& sorted_meshlets,
+                             DispatchOccupancy& occupancy) -> void;
+
+  // Rasterizes the visible occluders covering the most of the screen, then
+  // removes the instances they hide from the visible lists.
+  auto CullOccludedInstances(GpuScene const& scene,
+                             DirectX::XMFLOAT3 const& cam_pos,
+                             std::span<float const, 16> view_proj_mtx) -> void;
+
+  // Binds the state the draws of a partition are recorded with.
+  auto SetDrawState(ID3D12GraphicsCommandList7* cmd_list, UINT back_buf_idx,
+                    D3D12_VIEWPORT const& viewport,
+                    D3D12_RECT const& scissor) const -> void;
+
   auto CreateSwapChainRtvs() const -> void;
   auto CreateDepthBufferDsv() const -> void;
 
-  [[nodiscard]] auto AllocateResourceDescriptorIndex() -> UINT;
+  [[nodiscard]] auto AllocateResourceDescriptorIndex() -> std::expected<
+    UINT, std::string>;
+  // Returns the first index of count contiguous descriptors, e.g. for a
+  // descriptor table.
+  [[nodiscard]] auto AllocateResourceDescriptorRange(
+    UINT count) -> std::expected<UINT, std::string>;
+  // Frees a single index or a whole range by its first index.
   auto FreeResourceDescriptorIndex(UINT idx) -> void;
 
   Microsoft::WRL::ComPtr<IDXGIFactory7> factory_;
@@ -97,15 +164,38 @@ private:
              max_frames_in_flight_> cmd_allocs_;
   std::array<Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList7>,
              max_frames_in_flight_> cmd_lists_;
+  // One per draw partition, the mesh draws are recorded into these in
+  // parallel and submitted after cmd_lists_.
+  std::array<std::vector<Microsoft::WRL::ComPtr<ID3D12CommandAllocator>>,
+             max_frames_in_flight_> draw_cmd_allocs_;
+  std::array<std::vector<Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList7>>,
+             max_frames_in_flight_> draw_cmd_lists_;
 
   Microsoft::WRL::ComPtr<ID3D12Fence> frame_fence_;
 
   Microsoft::WRL::ComPtr<ID3D12RootSignature> root_sig_;
   Microsoft::WRL::ComPtr<ID3D12PipelineState> pso_;
+  Microsoft::WRL::ComPtr<ID3D12CommandSignature> draw_cmd_sig_;
 
   Microsoft::WRL::ComPtr<D3D12MA::Allocator> mem_allocator_;
 
-  std::vector<UINT> res_desc_heap_free_indices_;
+  D3D12TimestampSource gpu_timestamps_;
+
+  JobSystem* job_system_;
+  FrameTelemetry* telemetry_;
+
+  DescriptorAllocator res_desc_allocator_{res_desc_heap_size_};
+
+  OcclusionBuffer occlusion_buffer_;
+  // Per mesh indices of the visible instances, only the first
+  // visible_instance_counts_ are valid.
+  std::vector<std::vector<std::uint32_t>> visible_instance_indices_;
+  std::vector<UINT> visible_instance_counts_;
+  CullingStats culling_stats_{};
+  std::vector<MeshDrawSource> mesh_draw_sources_;
+  std::vector<DrawPartition> draw_partitions_;
+  // Per partition command building space.
+  std::vector<std::vector<IndirectDrawCommand>> partition_draw_commands_;
 
   std::array<D3D12_CPU_DESCRIPTOR_HANDLE, swap_chain_buffer_count_>
   rtv_cpu_handles_;
@@ -114,7 +204,8 @@ private:
   UINT64 frame_fence_val_;
   UINT swap_chain_flags_;
   UINT present_flags_;
-  UINT next_free_res_desc_idx_{0};
   int frame_idx_{0};
+  // Frames drawn so far.
+  std::uint64_t frame_count_{0};
 };
 }
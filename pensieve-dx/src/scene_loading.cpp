@@ -1,32 +1,222 @@
 #include "scene_loading.hpp"
 
+#include <algorithm>
 #include <array>
-#include <complex.h>
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
 #include <format>
 #include <fstream>
+#include <limits>
 #include <memory>
+#include <span>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "file_reader.hpp"
+#include "profiler.hpp"
+#include "shaders/common.hlsli"
 
 namespace pensieve {
-auto LoadScene(
-  std::filesystem::path const& path) -> std::expected<SceneData, std::string> {
-  std::ifstream in{path, std::ios::binary | std::ios::in};
+namespace {
+// The pixel shader indexes a float4 sample with the metallic and roughness
+// map channels.
+auto constexpr kTextureChannelCount{4u};
+
+class StreamSource {
+public:
+  StreamSource(std::ifstream& in, std::uint64_t const size) :
+    in_{&in}, size_{size} {}
+
+  [[nodiscard]] auto Read(void* const dst,
+                          std::size_t const byte_count) -> bool {
+    in_->read(static_cast<char*>(dst),
+              static_cast<std::streamsize>(byte_count));
+
+    if (in_->gcount() != static_cast<std::streamsize>(byte_count)) {
+      return false;
+    }
 
-  if (!in.is_open()) {
-    return std::unexpected{
-      std::format("Failed to open file {}.", path.string())
-    };
+    offset_ += byte_count;
+    return true;
   }
 
-  SceneData scene_data;
+  [[nodiscard]] auto Seek(std::uint64_t const offset) -> bool {
+    if (offset > size_) {
+      return false;
+    }
+
+    // Seeking drops the buffered bytes.
+    if (offset == offset_) {
+      return true;
+    }
+
+    in_->seekg(static_cast<std::streamoff>(offset));
+    offset_ = offset;
+    return static_cast<bool>(*in_);
+  }
+
+  [[nodiscard]] auto GetOffset() const -> std::uint64_t {
+    return offset_;
+  }
+
+private:
+  std::ifstream* in_;
+  std::uint64_t size_;
+  std::uint64_t offset_{0};
+};
+
+// Reads from a file in memory. If a reader is given, the file is still
+// arriving and reads wait for the bytes they need, so parsing overlaps with
+// the I/O of the rest of the file.
+class MemorySource {
+public:
+  MemorySource(std::span<std::byte const> const bytes,
+               FileReader* const reader) :
+    bytes_{bytes}, reader_{reader},
+    ready_byte_count_{reader ? 0 : bytes.size()} {}
+
+  [[nodiscard]] auto Read(void* const dst,
+                          std::size_t const byte_count) -> bool {
+    if (byte_count > bytes_.size() - offset_) {
+      return false;
+    }
+
+    auto const end{offset_ + byte_count};
+    auto out{static_cast<std::byte*>(dst)};
+
+    // Copies what has arrived while waiting for the rest.
+    while (offset_ < end) {
+      if (offset_ >= ready_byte_count_) {
+        auto const ready{reader_->WaitForPrefix(offset_ + 1)};
+
+        if (!ready) {
+          error_ = ready.error();
+          return false;
+        }
+
+        ready_byte_count_ = static_cast<std::size_t>(*ready);
+      }
+
+      auto const copy_count{std::min(end, ready_byte_count_) - offset_};
+      std::memcpy(out, bytes_.data() + offset_, copy_count);
+      out += copy_count;
+      offset_ += copy_count;
+    }
+
+    return true;
+  }
+
+  [[nodiscard]] auto Seek(std::uint64_t const offset) -> bool {
+    if (offset > bytes_.size()) {
+      return false;
+    }
+
+    offset_ = static_cast<std::size_t>(offset);
+    return true;
+  }
+
+  [[nodiscard]] auto GetOffset() const -> std::uint64_t {
+    return offset_;
+  }
+
+  // The I/O error that failed a read, if any.
+  [[nodiscard]] auto GetError() const -> std::string const& {
+    return error_;
+  }
+
+private:
+  std::span<std::byte const> bytes_;
+  FileReader* reader_;
+  std::size_t ready_byte_count_;
+  std::size_t offset_{0};
+  std::string error_;
+};
+
+struct ScannedSection {
+  SceneSection section;
+  std::uint64_t file_offset;
+};
+
+struct ScannedScene {
+  SceneLayout layout;
+  // In file order. The instances are the last section of every mesh.
+  std::vector<ScannedSection> sections;
+};
+
+[[nodiscard]] auto FormatSectionName(
+  SceneSection const& section) -> std::string {
+  auto const mesh_array_name{
+    [&section] {
+      switch (section.type) {
+      case SceneSectionType::kPositions:
+        return "positions";
+      case SceneSectionType::kNormals:
+        return "normals";
+      case SceneSectionType::kTangents:
+        return "tangents";
+      case SceneSectionType::kUvs:
+        return "uvs";
+      case SceneSectionType::kMeshlets:
+        return "meshlets";
+      case SceneSectionType::kVertexIndices:
+        return "vertex indices";
+      case SceneSectionType::kTriangleIndices:
+        return "triangle indices";
+      default:
+        return "instances";
+      }
+    }
+  };
+
+  switch (section.type) {
+  case SceneSectionType::kTexels:
+    return std::format("texture {} mip {} texels", section.item_idx,
+                       section.mip);
+  case SceneSectionType::kBvhNodes:
+    return "BVH nodes";
+  case SceneSectionType::kBvhInstanceRefs:
+    return "BVH instance references";
+  default:
+    return std::format("mesh {} {}", section.item_idx, mesh_array_name());
+  }
+}
+
+// Reads everything but the arrays, which are skipped and recorded.
+template<typename Source>
+[[nodiscard]] auto ScanScene(
+  Source& in) -> std::expected<ScannedScene, std::string> {
+  ScannedScene scene;
+  auto& [textures, materials, meshes, bvh_node_count, bvh_instance_ref_count]{
+    scene.layout
+  };
+
+  auto const skip_section{
+    [&in, &scene](SceneSection const& section) -> std::expected<
+      void, std::string> {
+      scene.sections.emplace_back(section, in.GetOffset());
+
+      auto const is_overflowing{
+        section.row_byte_count != 0 && section.row_count > std::numeric_limits<
+          std::uint64_t>::max() / section.row_byte_count
+      };
+
+      if (is_overflowing || !in.Seek(
+        in.GetOffset() + section.row_byte_count * section.row_count)) {
+        return std::unexpected{
+          std::format("Failed to read {}.", FormatSectionName(section))
+        };
+      }
+
+      return {};
+    }
+  };
 
   auto constexpr header_length{9};
   std::array<char, header_length> header;
-  in.read(header.data(), header_length);
 
-  if (in.gcount() != header_length) {
+  if (!in.Read(header.data(), header_length)) {
     return std::unexpected{"Failed to read file header."};
   }
 
@@ -35,96 +225,103 @@ auto LoadScene(
   }
 
   std::size_t texture_count;
-  in.read(std::bit_cast<char*>(&texture_count), sizeof(texture_count));
 
-  if (in.gcount() != sizeof(texture_count)) {
+  if (!in.Read(&texture_count, sizeof(texture_count))) {
     return std::unexpected{"Failed to read texture count."};
   }
 
-  scene_data.textures.reserve(texture_count);
-
   for (std::size_t i{0}; i < texture_count; i++) {
-    auto& [width, height, bytes]{scene_data.textures.emplace_back()};
-
-    in.read(std::bit_cast<char*>(&width), sizeof(width));
+    auto& [width, height, mip_count, format]{textures.emplace_back()};
 
-    if (in.gcount() != sizeof(width)) {
+    if (!in.Read(&width, sizeof(width))) {
       return std::unexpected{
         std::format("Failed to read width of texture {}.", i)
       };
     }
 
-    in.read(std::bit_cast<char*>(&height), sizeof(height));
-
-    if (in.gcount() != sizeof(height)) {
+    if (!in.Read(&height, sizeof(height))) {
       return std::unexpected{
         std::format("Failed to read height of texture {}.", i)
       };
     }
 
-    auto const byte_count{4 * width * height};
-    bytes = std::make_unique_for_overwrite<std::uint8_t[]>(byte_count);
-    in.read(std::bit_cast<char*>(bytes.get()), byte_count);
+    if (!in.Read(&mip_count, sizeof(mip_count))) {
+      return std::unexpected{
+        std::format("Failed to read mip count of texture {}.", i)
+      };
+    }
+
+    if (!in.Read(&format, sizeof(format))) {
+      return std::unexpected{
+        std::format("Failed to read format of texture {}.", i)
+      };
+    }
+
+    if (std::to_underlying(format) >= kTextureFormatCount) {
+      return std::unexpected{
+        std::format("Texture {} has unknown format {}.", i,
+                    std::to_underlying(format))
+      };
+    }
 
-    if (in.gcount() != byte_count) {
+    // Mips past the 32nd would shift the extent by more than its width.
+    if (mip_count > 32) {
       return std::unexpected{
-        std::format("Failed to read texels of texture {}.", i)
+        std::format("Texture {} has invalid mip count {}.", i, mip_count)
+      };
+    }
+
+    for (std::uint32_t mip{0}; mip < mip_count; mip++) {
+      auto const [row_pitch, row_count]{
+        GetTextureMipLayout(format, width, height, mip)
       };
+
+      if (auto const exp{
+        skip_section({SceneSectionType::kTexels, i, mip, row_pitch, row_count})
+      }; !exp) {
+        return std::unexpected{exp.error()};
+      }
     }
   }
 
   std::size_t material_count;
-  in.read(std::bit_cast<char*>(&material_count), sizeof(material_count));
 
-  if (in.gcount() != sizeof(material_count)) {
+  if (!in.Read(&material_count, sizeof(material_count))) {
     return std::unexpected{"Failed to read material count."};
   }
 
-  scene_data.materials.reserve(material_count);
-
   for (std::size_t i{0}; i < material_count; i++) {
     auto& [base_color, metallic, roughness, emission_color, base_color_map_idx,
-      metallic_map_idx, roughness_map_idx, emission_map_idx, normal_map_idx]{
-      scene_data.materials.emplace_back()
-    };
-
-    in.read(std::bit_cast<char*>(&base_color), sizeof(base_color));
+      metallic_map_idx, roughness_map_idx, emission_map_idx, normal_map_idx,
+      metallic_map_channel, roughness_map_channel]{materials.emplace_back()};
 
-    if (in.gcount() != sizeof(base_color)) {
+    if (!in.Read(&base_color, sizeof(base_color))) {
       return std::unexpected{
         std::format("Failed to read material {} base color.", i)
       };
     }
 
-    in.read(std::bit_cast<char*>(&metallic), sizeof(metallic));
-
-    if (in.gcount() != sizeof(metallic)) {
+    if (!in.Read(&metallic, sizeof(metallic))) {
       return std::unexpected{
         std::format("Failed to read material {} metallic factor.", i)
       };
     }
 
-    in.read(std::bit_cast<char*>(&roughness), sizeof(roughness));
-
-    if (in.gcount() != sizeof(roughness)) {
+    if (!in.Read(&roughness, sizeof(roughness))) {
       return std::unexpected{
         std::format("Failed to read material {} roughness factor.", i)
       };
     }
 
-    in.read(std::bit_cast<char*>(&emission_color), sizeof(emission_color));
-
-    if (in.gcount() != sizeof(emission_color)) {
+    if (!in.Read(&emission_color, sizeof(emission_color))) {
       return std::unexpected{
         std::format("Failed to read material {} emission color.", i)
       };
     }
 
     int has_base_color_map;
-    in.read(std::bit_cast<char*>(&has_base_color_map),
-            sizeof(has_base_color_map));
 
-    if (in.gcount() != sizeof(has_base_color_map)) {
+    if (!in.Read(&has_base_color_map, sizeof(has_base_color_map))) {
       return std::unexpected{
         std::format("Failed to read material {} base color map availability.",
                     i)
@@ -132,10 +329,8 @@ auto LoadScene(
     }
 
     if (has_base_color_map) {
-      in.read(std::bit_cast<char*>(&base_color_map_idx.emplace()),
-              sizeof(decltype(base_color_map_idx)::value_type));
-
-      if (in.gcount() != sizeof(*base_color_map_idx)) {
+      if (!in.Read(&base_color_map_idx.emplace(),
+                   sizeof(decltype(base_color_map_idx)::value_type))) {
         return std::unexpected{
           std::format("Failed to read material {} base color map index.", i)
         };
@@ -143,19 +338,16 @@ auto LoadScene(
     }
 
     int has_metallic_map;
-    in.read(std::bit_cast<char*>(&has_metallic_map), sizeof(has_metallic_map));
 
-    if (in.gcount() != sizeof(has_metallic_map)) {
+    if (!in.Read(&has_metallic_map, sizeof(has_metallic_map))) {
       return std::unexpected{
         std::format("Failed to read material {} metallic map availability.", i)
       };
     }
 
     if (has_metallic_map) {
-      in.read(std::bit_cast<char*>(&metallic_map_idx.emplace()),
-              sizeof(decltype(metallic_map_idx)::value_type));
-
-      if (in.gcount() != sizeof(*metallic_map_idx)) {
+      if (!in.Read(&metallic_map_idx.emplace(),
+                   sizeof(decltype(metallic_map_idx)::value_type))) {
         return std::unexpected{
           std::format("Failed to read material {} metallic map index.", i)
         };
@@ -163,20 +355,16 @@ auto LoadScene(
     }
 
     int has_roughness_map;
-    in.read(std::bit_cast<char*>(&has_roughness_map),
-            sizeof(has_roughness_map));
 
-    if (in.gcount() != sizeof(has_roughness_map)) {
+    if (!in.Read(&has_roughness_map, sizeof(has_roughness_map))) {
       return std::unexpected{
         std::format("Failed to read material {} roughness map availability.", i)
       };
     }
 
     if (has_roughness_map) {
-      in.read(std::bit_cast<char*>(&roughness_map_idx.emplace()),
-              sizeof(decltype(roughness_map_idx)::value_type));
-
-      if (in.gcount() != sizeof(*roughness_map_idx)) {
+      if (!in.Read(&roughness_map_idx.emplace(),
+                   sizeof(decltype(roughness_map_idx)::value_type))) {
         return std::unexpected{
           std::format("Failed to read material {} roughness map index.", i)
         };
@@ -184,19 +372,16 @@ auto LoadScene(
     }
 
     int has_emission_map;
-    in.read(std::bit_cast<char*>(&has_emission_map), sizeof(has_emission_map));
 
-    if (in.gcount() != sizeof(has_emission_map)) {
+    if (!in.Read(&has_emission_map, sizeof(has_emission_map))) {
       return std::unexpected{
         std::format("Failed to read material {} emission map availability.", i)
       };
     }
 
     if (has_emission_map) {
-      in.read(std::bit_cast<char*>(&emission_map_idx.emplace()),
-              sizeof(decltype(emission_map_idx)));
-
-      if (in.gcount() != sizeof(*emission_map_idx)) {
+      if (!in.Read(&emission_map_idx.emplace(),
+                   sizeof(decltype(emission_map_idx)::value_type))) {
         return std::unexpected{
           std::format("Failed to read material {} emission map index.", i)
         };
@@ -204,231 +389,644 @@ auto LoadScene(
     }
 
     int has_normal_map;
-    in.read(std::bit_cast<char*>(&has_normal_map), sizeof(has_normal_map));
 
-    if (in.gcount() != sizeof(has_normal_map)) {
+    if (!in.Read(&has_normal_map, sizeof(has_normal_map))) {
       return std::unexpected{
         std::format("Failed to read material {} normal map availability.", i)
       };
     }
 
     if (has_normal_map) {
-      in.read(std::bit_cast<char*>(&normal_map_idx.emplace()),
-              sizeof(decltype(normal_map_idx)::value_type));
-
-      if (in.gcount() != sizeof(*normal_map_idx)) {
+      if (!in.Read(&normal_map_idx.emplace(),
+                   sizeof(decltype(normal_map_idx)::value_type))) {
         return std::unexpected{
           std::format("Failed to read material {} normal map index.", i)
         };
       }
     }
+
+    if (!in.Read(&metallic_map_channel, sizeof(metallic_map_channel))) {
+      return std::unexpected{
+        std::format("Failed to read material {} metallic map channel.", i)
+      };
+    }
+
+    if (metallic_map_channel >= kTextureChannelCount) {
+      return std::unexpected{
+        std::format("Material {} metallic map channel {} is out of range.", i,
+                    metallic_map_channel)
+      };
+    }
+
+    if (!in.Read(&roughness_map_channel, sizeof(roughness_map_channel))) {
+      return std::unexpected{
+        std::format("Failed to read material {} roughness map channel.", i)
+      };
+    }
+
+    if (roughness_map_channel >= kTextureChannelCount) {
+      return std::unexpected{
+        std::format("Material {} roughness map channel {} is out of range.", i,
+                    roughness_map_channel)
+      };
+    }
   }
 
   std::size_t mesh_count;
-  in.read(std::bit_cast<char*>(&mesh_count), sizeof(mesh_count));
 
-  if (in.gcount() != sizeof(mesh_count)) {
+  if (!in.Read(&mesh_count, sizeof(mesh_count))) {
     return std::unexpected{"Failed to read mesh count."};
   }
 
-  scene_data.meshes.reserve(mesh_count);
-
   for (std::size_t i{0}; i < mesh_count; i++) {
-    auto& [positions, normals, tangents, uvs, meshlets, vertex_indices,
-      triangle_indices, material_idx]{scene_data.meshes.emplace_back()};
+    auto& [vertex_count, has_tangents, has_uvs, meshlet_count,
+      vertex_index_count, triangle_index_count, material_idx, instance_count]{
+      meshes.emplace_back()
+    };
 
-    std::size_t vertex_count;
-    in.read(std::bit_cast<char*>(&vertex_count), sizeof(vertex_count));
+    auto const skip_mesh_section{
+      [i, &skip_section](SceneSectionType const type,
+                         std::uint64_t const row_byte_count,
+                         std::uint64_t const row_count) {
+        return skip_section({type, i, 0, row_byte_count, row_count});
+      }
+    };
 
-    if (in.gcount() != sizeof(vertex_count)) {
+    if (!in.Read(&vertex_count, sizeof(vertex_count))) {
       return std::unexpected{
         std::format("Failed to read mesh {} vertex count.", i)
       };
     }
 
-    positions.resize(vertex_count);
-    auto const pos_buf_byte_size{
-      static_cast<std::streamsize>(vertex_count * sizeof(Float4))
-    };
-    in.read(std::bit_cast<char*>(positions.data()), pos_buf_byte_size);
-
-    if (in.gcount() != pos_buf_byte_size) {
-      return std::unexpected{
-        std::format("Failed to read mesh {} positions.", i)
-      };
+    if (auto const exp{
+      skip_mesh_section(SceneSectionType::kPositions, sizeof(Float4),
+                        vertex_count)
+    }; !exp) {
+      return std::unexpected{exp.error()};
     }
 
-    normals.resize(vertex_count);
-    auto const norm_buf_byte_size{
-      static_cast<std::streamsize>(vertex_count * sizeof(Float4))
-    };
-    in.read(std::bit_cast<char*>(normals.data()), norm_buf_byte_size);
-
-    if (in.gcount() != norm_buf_byte_size) {
-      return std::unexpected{std::format("Failed to read mesh {} normals.", i)};
+    if (auto const exp{
+      skip_mesh_section(SceneSectionType::kNormals, sizeof(Float4),
+                        vertex_count)
+    }; !exp) {
+      return std::unexpected{exp.error()};
     }
 
-    int has_tangents;
-    in.read(std::bit_cast<char*>(&has_tangents), sizeof(has_tangents));
+    int has_tangents_int;
 
-    if (in.gcount() != sizeof(has_tangents)) {
+    if (!in.Read(&has_tangents_int, sizeof(has_tangents_int))) {
       return std::unexpected{
         std::format("Failed to read mesh {} tangent availability.", i)
       };
     }
 
-    if (has_tangents) {
-      tangents.emplace().resize(vertex_count);
-      auto const tan_buf_byte_size{
-        static_cast<std::streamsize>(vertex_count * sizeof(Float4))
-      };
-      in.read(std::bit_cast<char*>(tangents->data()), tan_buf_byte_size);
+    has_tangents = has_tangents_int != 0;
 
-      if (in.gcount() != tan_buf_byte_size) {
-        return std::unexpected{
-          std::format("Failed to read mesh {} tangents.", i)
-        };
+    if (has_tangents) {
+      if (auto const exp{
+        skip_mesh_section(SceneSectionType::kTangents, sizeof(Float4),
+                          vertex_count)
+      }; !exp) {
+        return std::unexpected{exp.error()};
       }
     }
 
-    int has_uvs;
-    in.read(std::bit_cast<char*>(&has_uvs), sizeof(has_uvs));
+    int has_uvs_int;
 
-    if (in.gcount() != sizeof(has_uvs)) {
+    if (!in.Read(&has_uvs_int, sizeof(has_uvs_int))) {
       return std::unexpected{
         std::format("Failed to read mesh {} uv availability.", i)
       };
     }
 
-    if (has_uvs) {
-      uvs.emplace().resize(vertex_count);
-      auto const uv_buf_byte_size{
-        static_cast<std::streamsize>(vertex_count * sizeof(Float2))
-      };
-      in.read(std::bit_cast<char*>(uvs->data()), uv_buf_byte_size);
+    has_uvs = has_uvs_int != 0;
 
-      if (in.gcount() != uv_buf_byte_size) {
-        return std::unexpected{std::format("Failed to read mesh {} uvs.", i)};
+    if (has_uvs) {
+      if (auto const exp{
+        skip_mesh_section(SceneSectionType::kUvs, sizeof(Float2), vertex_count)
+      }; !exp) {
+        return std::unexpected{exp.error()};
       }
     }
 
-    std::size_t meshlet_count;
-    in.read(std::bit_cast<char*>(&meshlet_count), sizeof(meshlet_count));
-
-    if (in.gcount() != sizeof(meshlet_count)) {
+    if (!in.Read(&meshlet_count, sizeof(meshlet_count))) {
       return std::unexpected{
         std::format("Failed to read mesh {} meshlet count.", i)
       };
     }
 
-    meshlets.resize(meshlet_count);
-    auto const meshlet_buf_size{
-      static_cast<std::streamsize>(meshlet_count * sizeof(MeshletData))
-    };
-    in.read(std::bit_cast<char*>(meshlets.data()), meshlet_buf_size);
-
-    if (in.gcount() != meshlet_buf_size) {
-      return std::unexpected{
-        std::format("Failed to read mesh {} meshlets.", i)
-      };
+    if (auto const exp{
+      skip_mesh_section(SceneSectionType::kMeshlets, sizeof(MeshletData),
+                        meshlet_count)
+    }; !exp) {
+      return std::unexpected{exp.error()};
     }
 
-    std::size_t vertex_index_count;
-    in.read(std::bit_cast<char*>(&vertex_index_count),
-            sizeof(vertex_index_count));
-
-    if (in.gcount() != sizeof(vertex_index_count)) {
+    if (!in.Read(&vertex_index_count, sizeof(vertex_index_count))) {
       return std::unexpected{
         std::format("Failed to read mesh {} vertex index count.", i)
       };
     }
 
-    vertex_indices.resize(vertex_index_count);
-    auto const vert_ind_buf_size{
-      static_cast<std::streamsize>(vertex_index_count * sizeof(std::uint8_t))
-    };
-    in.read(std::bit_cast<char*>(vertex_indices.data()), vert_ind_buf_size);
-
-    if (in.gcount() != vert_ind_buf_size) {
+    if (vertex_index_count % sizeof(std::uint32_t) != 0) {
       return std::unexpected{
-        std::format("Failed to read mesh {} vertex indices.", i)
+        std::format("Mesh {} vertex indices are not 32 bit.", i)
       };
     }
 
-    std::size_t triangle_index_count;
-    in.read(std::bit_cast<char*>(&triangle_index_count),
-            sizeof(triangle_index_count));
+    if (auto const exp{
+      skip_mesh_section(SceneSectionType::kVertexIndices, sizeof(std::uint8_t),
+                        vertex_index_count)
+    }; !exp) {
+      return std::unexpected{exp.error()};
+    }
 
-    if (in.gcount() != sizeof(triangle_index_count)) {
+    if (!in.Read(&triangle_index_count, sizeof(triangle_index_count))) {
       return std::unexpected{
         std::format("Failed to read mesh {} triangle index count.", i)
       };
     }
 
-    triangle_indices.resize(triangle_index_count);
-    auto const tri_ind_buf_size{
-      static_cast<std::streamsize>(triangle_index_count * sizeof(
-        MeshletTriangleIndexData))
-    };
-    in.read(std::bit_cast<char*>(triangle_indices.data()), tri_ind_buf_size);
+    if (auto const exp{
+      skip_mesh_section(SceneSectionType::kTriangleIndices,
+                        sizeof(MeshletTriangleIndexData), triangle_index_count)
+    }; !exp) {
+      return std::unexpected{exp.error()};
+    }
 
-    if (in.gcount() != tri_ind_buf_size) {
+    if (!in.Read(&material_idx, sizeof(material_idx))) {
       return std::unexpected{
-        std::format("Failed to read mesh {} triangle indices.", i)
+        std::format("Failed to read mesh {} material index.", i)
       };
     }
 
-    in.read(std::bit_cast<char*>(&material_idx), sizeof(material_idx));
-
-    if (in.gcount() != sizeof(material_idx)) {
+    if (!in.Read(&instance_count, sizeof(instance_count))) {
       return std::unexpected{
-        std::format("Failed to read mesh {} material index.", i)
+        std::format("Failed to read mesh {} instance count.", i)
       };
     }
+
+    if (auto const exp{
+      skip_mesh_section(SceneSectionType::kInstances, sizeof(InstanceData),
+                        instance_count)
+    }; !exp) {
+      return std::unexpected{exp.error()};
+    }
   }
 
-  std::size_t node_count;
-  in.read(std::bit_cast<char*>(&node_count), sizeof(node_count));
+  if (!in.Read(&bvh_node_count, sizeof(bvh_node_count))) {
+    return std::unexpected{"Failed to read BVH node count."};
+  }
 
-  if (in.gcount() != sizeof(node_count)) {
-    return std::unexpected{"Failed to read node count."};
+  if (auto const exp{
+    skip_section({SceneSectionType::kBvhNodes, 0, 0, sizeof(BvhNode),
+                  bvh_node_count})
+  }; !exp) {
+    return std::unexpected{exp.error()};
   }
 
-  scene_data.nodes.reserve(node_count);
+  if (!in.Read(&bvh_instance_ref_count, sizeof(bvh_instance_ref_count))) {
+    return std::unexpected{"Failed to read BVH instance reference count."};
+  }
 
-  for (std::size_t i{0}; i < node_count; i++) {
-    auto& [mesh_indices, transform]{scene_data.nodes.emplace_back()};
+  if (auto const exp{
+    skip_section({SceneSectionType::kBvhInstanceRefs, 0, 0,
+                  sizeof(BvhInstanceRef), bvh_instance_ref_count})
+  }; !exp) {
+    return std::unexpected{exp.error()};
+  }
 
-    std::size_t mesh_idx_count;
-    in.read(std::bit_cast<char*>(&mesh_idx_count), sizeof(mesh_idx_count));
+  return scene;
+}
 
-    if (in.gcount() != sizeof(mesh_idx_count)) {
+// Dispatch planning divides by the meshlet sizes and the mesh shader has
+// room for a fixed number of vertices and primitives per group. The index
+// ranges are checked here, as the meshlets come before the indices.
+[[nodiscard]] auto ValidateMeshlets(SceneSection const& section,
+                                    std::uint64_t const first_row,
+                                    SceneSectionDestination const& dst,
+                                    MeshLayout const& mesh_layout) ->
+  std::expected<void, std::string> {
+  for (std::uint64_t i{0}; i < dst.row_count; i++) {
+    MeshletData meshlet;
+    std::memcpy(&meshlet, dst.data + i * dst.row_pitch, sizeof(meshlet));
+
+    if (meshlet.vert_count == 0 || meshlet.vert_count > MESHLET_MAX_VERTS ||
+      meshlet.prim_count == 0 || meshlet.prim_count > MESHLET_MAX_PRIMS) {
       return std::unexpected{
-        std::format("Failed to read node {} mesh index count.", i)
+        std::format("Mesh {} meshlet {} exceeds the meshlet limits.",
+                    section.item_idx, first_row + i)
       };
     }
 
-    mesh_indices.resize(mesh_idx_count);
-    auto const mesh_idx_buf_size{
-      static_cast<std::streamsize>(mesh_idx_count * sizeof(unsigned))
+    if (std::uint64_t{meshlet.vert_offset} + meshlet.vert_count > mesh_layout.
+      vertex_index_count / sizeof(std::uint32_t) || std::uint64_t{
+        meshlet.prim_offset
+      } + meshlet.prim_count > mesh_layout.triangle_index_count) {
+      return std::unexpected{
+        std::format("Mesh {} meshlet {} references invalid indices.",
+                    section.item_idx, first_row + i)
+      };
+    }
+  }
+
+  return {};
+}
+
+// Reads the rows of every section into the memory the sink hands out.
+template<typename Source>
+[[nodiscard]] auto StreamSections(Source& in, SceneLayout const& layout,
+                                  std::span<ScannedSection const> const
+                                  sections,
+                                  SceneSink& sink) -> std::expected<
+  void, std::string> {
+  for (auto const& [section, file_offset] : sections) {
+    auto const read_error{
+      [&section] {
+        return std::unexpected{
+          std::format("Failed to read {}.", FormatSectionName(section))
+        };
+      }
     };
-    in.read(std::bit_cast<char*>(mesh_indices.data()), mesh_idx_buf_size);
 
-    if (in.gcount() != mesh_idx_buf_size) {
-      return std::unexpected{
-        std::format("Failed to read node {} mesh indices.", i)
+    if (!in.Seek(file_offset)) {
+      return read_error();
+    }
+
+    for (std::uint64_t row{0}; row < section.row_count;) {
+      auto const dst{sink.AcquireRows(section, row)};
+
+      if (!dst) {
+        return std::unexpected{dst.error()};
+      }
+
+      SceneSectionDestination const filled_dst{
+        dst->data, std::min(dst->row_count, section.row_count - row),
+        dst->row_pitch
       };
+
+      if (filled_dst.row_count == 0) {
+        break;
+      }
+
+      // Rows padded in the destination are read one by one.
+      if (filled_dst.row_pitch == section.row_byte_count) {
+        if (!in.Read(filled_dst.data, static_cast<std::size_t>(
+          filled_dst.row_count * section.row_byte_count))) {
+          return read_error();
+        }
+      } else {
+        for (std::uint64_t i{0}; i < filled_dst.row_count; i++) {
+          if (!in.Read(filled_dst.data + i * filled_dst.row_pitch,
+                       static_cast<std::size_t>(section.row_byte_count))) {
+            return read_error();
+          }
+        }
+      }
+
+      if (section.type == SceneSectionType::kMeshlets) {
+        if (auto const exp{
+          ValidateMeshlets(section, row, filled_dst,
+                           layout.meshes[section.item_idx])
+        }; !exp) {
+          return exp;
+        }
+      }
+
+      if (auto const exp{sink.CommitRows(section, row, filled_dst)}; !exp) {
+        return exp;
+      }
+
+      row += filled_dst.row_count;
+    }
+
+    if (section.type == SceneSectionType::kInstances) {
+      if (auto const exp{sink.EndMesh(section.item_idx)}; !exp) {
+        return exp;
+      }
     }
+  }
+
+  return sink.Finish();
+}
+
+template<typename Source>
+[[nodiscard]] auto StreamFromSource(Source& in,
+                                    SceneSink& sink) -> std::expected<
+  void, std::string> {
+  auto const scene{ScanScene(in)};
+
+  if (!scene) {
+    return std::unexpected{scene.error()};
+  }
+
+  if (auto const exp{sink.Begin(scene->layout)}; !exp) {
+    return exp;
+  }
+
+  return StreamSections(in, scene->layout, scene->sections, sink);
+}
+
+[[nodiscard]] auto StreamFromStream(std::filesystem::path const& path,
+                                    SceneSink& sink) -> std::expected<
+  void, std::string> {
+  std::ifstream in{path, std::ios::binary | std::ios::in | std::ios::ate};
+
+  if (!in.is_open()) {
+    return std::unexpected{
+      std::format("Failed to open file {}.", path.string())
+    };
+  }
+
+  auto const size{static_cast<std::uint64_t>(in.tellg())};
+  in.seekg(0);
+
+  StreamSource source{in, size};
+  return StreamFromSource(source, sink);
+}
+
+[[nodiscard]] auto StreamFromMapping(std::filesystem::path const& path,
+                                     SceneSink& sink) -> std::expected<
+  void, std::string> {
+  auto const file{MappedFile::Open(path)};
+
+  if (!file) {
+    return std::unexpected{file.error()};
+  }
+
+  MemorySource source{file->GetBytes(), nullptr};
+  return StreamFromSource(source, sink);
+}
+
+[[nodiscard]] auto StreamFromReader(std::filesystem::path const& path,
+                                    FileReadBackend const backend,
+                                    FileReadOptions const& options,
+                                    SceneSink& sink) -> std::expected<
+  void, std::string> {
+  auto const reader{OpenFileReader(path, backend, options)};
+
+  if (!reader) {
+    return std::unexpected{reader.error()};
+  }
+
+  auto const size{(*reader)->GetSize()};
+  auto const buffer{AllocateFileReadBuffer(size)};
+
+  if (auto const exp{
+    (*reader)->Start({buffer.get(), GetFileReadBufferSize(size)})
+  }; !exp) {
+    return std::unexpected{exp.error()};
+  }
+
+  MemorySource source{
+    {buffer.get(), static_cast<std::size_t>(size)}, reader->get()
+  };
+  auto exp{StreamFromSource(source, sink)};
+
+  if (!exp && !source.GetError().empty()) {
+    return std::unexpected{
+      std::format("Failed to read file {}: {}", path.string(),
+                  source.GetError())
+    };
+  }
+
+  return exp;
+}
 
-    in.read(std::bit_cast<char*>(&transform), sizeof(transform));
+// Traversal does no bounds checking, so the tree is validated here. Children
+// always follow their parents, which lets depths be propagated in one pass.
+[[nodiscard]] auto ValidateBvh(
+  SceneData const& scene_data) -> std::expected<void, std::string> {
+  auto const& [bvh_nodes, bvh_instance_refs]{scene_data.bvh};
+  std::vector<int> bvh_node_depths(bvh_nodes.size(), 0);
 
-    if (in.gcount() != sizeof(transform)) {
+  for (std::size_t i{0}; i < bvh_nodes.size(); i++) {
+    auto const& node{bvh_nodes[i]};
+
+    if (node.instance_count != 0) {
+      if (static_cast<std::size_t>(node.left_or_first) + node.instance_count >
+        bvh_instance_refs.size()) {
+        return std::unexpected{
+          std::format("BVH node {} references invalid instances.", i)
+        };
+      }
+    } else if (node.left_or_first <= i || static_cast<std::size_t>(node.
+      left_or_first) + 1 >= bvh_nodes.size()) {
       return std::unexpected{
-        std::format("Failed to read node {} transform.", i)
+        std::format("BVH node {} references invalid children.", i)
       };
+    } else if (bvh_node_depths[i] >= kBvhMaxDepth) {
+      return std::unexpected{std::format("BVH node {} is too deep.", i)};
+    } else {
+      for (auto const child_idx : {node.left_or_first, node.left_or_first + 1}) {
+        bvh_node_depths[child_idx] = std::max(bvh_node_depths[child_idx],
+                                              bvh_node_depths[i] + 1);
+      }
+    }
+  }
+
+  for (auto const& [mesh_idx, instance_idx] : bvh_instance_refs) {
+    if (mesh_idx >= scene_data.meshes.size() || instance_idx >= scene_data.
+        meshes[mesh_idx].instances.size()) {
+      return std::unexpected{"BVH references an invalid instance."};
+    }
+  }
+
+  return {};
+}
+}
+
+auto SceneDataSink::Begin(
+  SceneLayout const& layout) -> std::expected<void, std::string> {
+  scene_data_ = {};
+  scene_data_.textures.reserve(layout.textures.size());
+
+  for (auto const& [width, height, mip_count, format] : layout.textures) {
+    scene_data_.textures.emplace_back(
+      width, height, mip_count, format,
+      std::make_unique_for_overwrite<std::uint8_t[]>(
+        CalculateTextureByteCount(format, width, height, mip_count)));
+  }
+
+  scene_data_.materials = layout.materials;
+  scene_data_.meshes.reserve(layout.meshes.size());
+
+  for (auto const& mesh_layout : layout.meshes) {
+    auto& mesh{scene_data_.meshes.emplace_back()};
+    mesh.positions.resize(mesh_layout.vertex_count);
+    mesh.normals.resize(mesh_layout.vertex_count);
+
+    if (mesh_layout.has_tangents) {
+      mesh.tangents.emplace(mesh_layout.vertex_count);
+    }
+
+    if (mesh_layout.has_uvs) {
+      mesh.uvs.emplace(mesh_layout.vertex_count);
+    }
+
+    mesh.meshlets.resize(mesh_layout.meshlet_count);
+    mesh.vertex_indices.resize(mesh_layout.vertex_index_count);
+    mesh.triangle_indices.resize(mesh_layout.triangle_index_count);
+    mesh.material_idx = mesh_layout.material_idx;
+    mesh.instances.resize(mesh_layout.instance_count);
+  }
+
+  scene_data_.bvh.nodes.resize(layout.bvh_node_count);
+  scene_data_.bvh.instance_refs.resize(layout.bvh_instance_ref_count);
+  return {};
+}
+
+auto SceneDataSink::AcquireRows(SceneSection const& section,
+                                std::uint64_t const first_row) ->
+  std::expected<SceneSectionDestination, std::string> {
+  auto const as_bytes{
+    [](auto& vec) {
+      return reinterpret_cast<std::byte*>(vec.data());
+    }
+  };
+
+  std::byte* section_data;
+
+  switch (section.type) {
+  case SceneSectionType::kTexels: {
+    auto const& tex{scene_data_.textures[section.item_idx]};
+    section_data = reinterpret_cast<std::byte*>(tex.bytes.get()) +
+      CalculateTextureByteCount(tex.format, tex.width, tex.height, section.mip);
+    break;
+  }
+  case SceneSectionType::kPositions:
+    section_data = as_bytes(scene_data_.meshes[section.item_idx].positions);
+    break;
+  case SceneSectionType::kNormals:
+    section_data = as_bytes(scene_data_.meshes[section.item_idx].normals);
+    break;
+  case SceneSectionType::kTangents:
+    section_data = as_bytes(*scene_data_.meshes[section.item_idx].tangents);
+    break;
+  case SceneSectionType::kUvs:
+    section_data = as_bytes(*scene_data_.meshes[section.item_idx].uvs);
+    break;
+  case SceneSectionType::kMeshlets:
+    section_data = as_bytes(scene_data_.meshes[section.item_idx].meshlets);
+    break;
+  case SceneSectionType::kVertexIndices:
+    section_data = as_bytes(
+      scene_data_.meshes[section.item_idx].vertex_indices);
+    break;
+  case SceneSectionType::kTriangleIndices:
+    section_data = as_bytes(
+      scene_data_.meshes[section.item_idx].triangle_indices);
+    break;
+  case SceneSectionType::kInstances:
+    section_data = as_bytes(scene_data_.meshes[section.item_idx].instances);
+    break;
+  case SceneSectionType::kBvhNodes:
+    section_data = as_bytes(scene_data_.bvh.nodes);
+    break;
+  case SceneSectionType::kBvhInstanceRefs:
+    section_data = as_bytes(scene_data_.bvh.instance_refs);
+    break;
+  default:
+    return std::unexpected{"Unknown scene section."};
+  }
+
+  return SceneSectionDestination{
+    section_data + first_row * section.row_byte_count,
+    section.row_count - first_row, section.row_byte_count
+  };
+}
+
+auto SceneDataSink::CommitRows(
+  [[maybe_unused]] SceneSection const& section,
+  [[maybe_unused]] std::uint64_t const first_row,
+  [[maybe_unused]] SceneSectionDestination const& dst) -> std::expected<
+  void, std::string> {
+  return {};
+}
+
+auto SceneDataSink::EndMesh(
+  std::size_t const mesh_idx) -> std::expected<void, std::string> {
+  return ValidateMeshIndices(scene_data_.meshes[mesh_idx], mesh_idx);
+}
+
+auto SceneDataSink::Finish() -> std::expected<void, std::string> {
+  return ValidateBvh(scene_data_);
+}
+
+auto SceneDataSink::TakeSceneData() -> SceneData {
+  return std::move(scene_data_);
+}
+
+auto ValidateMeshIndices(MeshData const& mesh,
+                         std::size_t const mesh_idx) -> std::expected<
+  void, std::string> {
+  for (std::size_t i{0}; i < mesh.meshlets.size(); i++) {
+    auto const& meshlet{mesh.meshlets[i]};
+
+    for (auto j{meshlet.prim_offset}; j < meshlet.prim_offset + meshlet.
+         prim_count; j++) {
+      auto const& tri{mesh.triangle_indices[j]};
+
+      if (tri.idx0 >= meshlet.vert_count || tri.idx1 >= meshlet.vert_count ||
+        tri.idx2 >= meshlet.vert_count) {
+        return std::unexpected{
+          std::format("Mesh {} meshlet {} triangle {} is out of range.",
+                      mesh_idx, i, j - meshlet.prim_offset)
+        };
+      }
     }
+
+    for (auto j{meshlet.vert_offset}; j < meshlet.vert_offset + meshlet.
+         vert_count; j++) {
+      std::uint32_t vertex_idx;
+      std::memcpy(&vertex_idx,
+                  mesh.vertex_indices.data() + j * sizeof(std::uint32_t),
+                  sizeof(std::uint32_t));
+
+      if (vertex_idx >= mesh.positions.size()) {
+        return std::unexpected{
+          std::format("Mesh {} meshlet {} vertex {} is out of range.",
+                      mesh_idx, i, j - meshlet.vert_offset)
+        };
+      }
+    }
+  }
+
+  return {};
+}
+
+auto StreamScene(std::filesystem::path const& path, SceneSink& sink,
+                 SceneLoadOptions const& options) -> std::expected<
+  void, std::string> {
+  PENSIEVE_PROFILE_ZONE("StreamScene");
+
+  switch (options.backend) {
+  case SceneReadBackend::kStream:
+    return StreamFromStream(path, sink);
+  case SceneReadBackend::kMemoryMap:
+    return StreamFromMapping(path, sink);
+  case SceneReadBackend::kPread:
+    return StreamFromReader(path, FileReadBackend::kPread,
+                            options.read_options, sink);
+  case SceneReadBackend::kIoUring:
+    return StreamFromReader(path, FileReadBackend::kIoUring,
+                            options.read_options, sink);
+  }
+
+  return std::unexpected{"Unknown scene read backend."};
+}
+
+auto LoadScene(std::filesystem::path const& path,
+               SceneLoadOptions const& options) -> std::expected<
+  SceneData, std::string> {
+  PENSIEVE_PROFILE_ZONE("LoadScene");
+
+  SceneDataSink sink;
+
+  if (auto const exp{StreamScene(path, sink, options)}; !exp) {
+    return std::unexpected{exp.error()};
   }
 
-  return scene_data;
+  return sink.TakeSceneData();
 }
 }
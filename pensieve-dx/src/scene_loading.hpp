@@ -1,11 +1,176 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <expected>
 #include <filesystem>
 #include <string>
+#include <vector>
 
+#include "file_reader.hpp"
 #include "scene_data.hpp"
 
 namespace pensieve {
-[[nodiscard]] auto LoadScene(std::filesystem::path const& path) -> std::expected<SceneData, std::string>;
+enum class SceneReadBackend {
+  // Buffered std::ifstream reads.
+  kStream,
+  // Parses a memory mapping of the file. Only available on Linux.
+  kMemoryMap,
+  // Reads the file in chunks and parses the chunks that have arrived. Only
+  // available on Linux.
+  kPread,
+  kIoUring,
+};
+
+struct SceneLoadOptions {
+  SceneReadBackend backend;
+  // Used by the chunked backends.
+  FileReadOptions read_options;
+};
+
+// Reading through the stream is the fastest on warm caches, as the chunked
+// backends copy every byte twice. Use the benchmarks to pick per machine.
+inline constexpr SceneLoadOptions kDefaultSceneLoadOptions{
+  SceneReadBackend::kStream, kDefaultFileReadOptions
+};
+
+struct TextureLayout {
+  std::uint32_t width;
+  std::uint32_t height;
+  std::uint32_t mip_count;
+  TextureFormat format;
+};
+
+struct MeshLayout {
+  std::size_t vertex_count;
+  bool has_tangents;
+  bool has_uvs;
+  std::size_t meshlet_count;
+  // In bytes.
+  std::size_t vertex_index_count;
+  std::size_t triangle_index_count;
+  std::uint32_t material_idx;
+  std::size_t instance_count;
+};
+
+// Everything in a scene file but the contents of its arrays.
+struct SceneLayout {
+  std::vector<TextureLayout> textures;
+  std::vector<MaterialData> materials;
+  std::vector<MeshLayout> meshes;
+  std::size_t bvh_node_count;
+  std::size_t bvh_instance_ref_count;
+};
+
+enum class SceneSectionType {
+  kTexels,
+  kPositions,
+  kNormals,
+  kTangents,
+  kUvs,
+  kMeshlets,
+  kVertexIndices,
+  kTriangleIndices,
+  kInstances,
+  kBvhNodes,
+  kBvhInstanceRefs,
+};
+
+// An array of a scene file, made of rows that are tightly packed in the file.
+// Texture mips have rows of texels or blocks, every other array has a row per
+// element.
+struct SceneSection {
+  SceneSectionType type;
+  // The texture of texels, the mesh of mesh arrays, 0 for the BVH.
+  std::size_t item_idx;
+  // Of texels, 0 otherwise.
+  std::uint32_t mip;
+  std::uint64_t row_byte_count;
+  std::uint64_t row_count;
+};
+
+// Memory the rows of a section are read into. Rows are row_pitch bytes apart,
+// which is at least the row byte count of the section.
+struct SceneSectionDestination {
+  std::byte* data;
+  std::uint64_t row_count;
+  std::uint64_t row_pitch;
+};
+
+// Receives a scene straight from the file. The layout comes first, so the
+// sink can set up its storage, then the sections in file order. Their rows
+// are read directly into memory the sink hands out, e.g. staging memory, so
+// no intermediate copy of the scene is made.
+class SceneSink {
+public:
+  virtual ~SceneSink() = default;
+
+  [[nodiscard]] virtual auto Begin(
+    SceneLayout const& layout) -> std::expected<void, std::string> = 0;
+
+  // Returns memory for rows of the section starting at first_row. It may hold
+  // fewer rows than remain, the rest is asked for after the commit. No rows
+  // skip the rest of the section.
+  [[nodiscard]] virtual auto AcquireRows(
+    SceneSection const& section,
+    std::uint64_t first_row) -> std::expected<SceneSectionDestination,
+                                              std::string> = 0;
+
+  // The rows of the destination have been read.
+  [[nodiscard]] virtual auto CommitRows(
+    SceneSection const& section, std::uint64_t first_row,
+    SceneSectionDestination const& dst) -> std::expected<void, std::string> = 0;
+
+  // Every section of the mesh has been committed.
+  [[nodiscard]] virtual auto EndMesh(
+    std::size_t mesh_idx) -> std::expected<void, std::string> = 0;
+
+  [[nodiscard]] virtual auto Finish() -> std::expected<void, std::string> = 0;
+};
+
+// Materializes the scene in memory. Validates the indices and the BVH, as
+// their users on the CPU do no bounds checking.
+class SceneDataSink final : public SceneSink {
+public:
+  [[nodiscard]] auto Begin(
+    SceneLayout const& layout) -> std::expected<void, std::string> override;
+  [[nodiscard]] auto AcquireRows(
+    SceneSection const& section,
+    std::uint64_t first_row) -> std::expected<SceneSectionDestination,
+                                              std::string> override;
+  [[nodiscard]] auto CommitRows(
+    SceneSection const& section, std::uint64_t first_row,
+    SceneSectionDestination const& dst) -> std::expected<
+    void, std::string> override;
+  [[nodiscard]] auto EndMesh(
+    std::size_t mesh_idx) -> std::expected<void, std::string> override;
+  [[nodiscard]] auto Finish() -> std::expected<void, std::string> override;
+
+  [[nodiscard]] auto TakeSceneData() -> SceneData;
+
+private:
+  SceneData scene_data_;
+};
+
+// Checks that the triangles of every meshlet index its vertices and that its
+// vertex indices are within the vertex arrays, as the CPU side users of the
+// indices do no bounds checking. The meshlet index ranges must be within the
+// index arrays, which StreamScene checks before committing the meshlets.
+[[nodiscard]] auto ValidateMeshIndices(
+  MeshData const& mesh,
+  std::size_t mesh_idx) -> std::expected<void, std::string>;
+
+// Checks the whole file against the layout before the sink sees any of it,
+// so sinks never receive truncated scenes. The chunked backends read the
+// whole file into memory first, so streaming gains the most with the others.
+[[nodiscard]] auto StreamScene(std::filesystem::path const& path,
+                               SceneSink& sink,
+                               SceneLoadOptions const& options =
+                                 kDefaultSceneLoadOptions) -> std::expected<
+  void, std::string>;
+
+[[nodiscard]] auto LoadScene(std::filesystem::path const& path,
+                             SceneLoadOptions const& options =
+                               kDefaultSceneLoadOptions) -> std::expected<
+  SceneData, std::string>;
 }
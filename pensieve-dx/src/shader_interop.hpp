@@ -1,6 +1,11 @@
 #pragma once
 
+#include <cstddef>
+
+#include <DirectXMath.h>
+
 #define float4x4 DirectX::XMFLOAT4X4
+#define float3x4 DirectX::XMFLOAT3X4
 #define float3 DirectX::XMFLOAT3
 #define uint UINT
 #define row_major
@@ -8,5 +13,19 @@
 
 #include "shaders/material.hlsli"
 #include "shaders/draw_params.hlsli"
+#include "shaders/draw_record.hlsli"
 #include "shaders/common.hlsli"
 #include "shaders/instance_buffer.hlsli"
+
+namespace pensieve {
+// Structured buffer elements are tightly packed 4 byte values.
+static_assert(sizeof(DrawRecord) == 10 * sizeof(UINT));
+static_assert(offsetof(DrawRecord, mtl_buf_idx) == 8 * sizeof(UINT));
+static_assert(
+  offsetof(DrawRecord, visible_inst_idx_buf_idx) == 9 * sizeof(UINT));
+
+// Constant buffer fields must not straddle 16 byte boundaries.
+static_assert(offsetof(DrawParams, draw_record_buf_idx) == 19 * sizeof(UINT));
+static_assert(offsetof(DrawParams, pos_buf_idx) == 20 * sizeof(UINT));
+static_assert(offsetof(DrawParams, draw_record_idx) == 32 * sizeof(UINT));
+}
@@ -2,6 +2,7 @@
 #define COMMON_HLSLI
 
 #define INVALID_RESOURCE_IDX -1
+#define INVALID_GEOMETRY_BASE -1
 #define MESHLET_MAX_VERTS 128
 #define MESHLET_MAX_PRIMS 256
 
@@ -1,11 +1,13 @@
 #ifndef DRAW_PARAMS_HLSLI
 #define DRAW_PARAMS_HLSLI
 
+// The fields after draw_record_buf_idx are set per draw, see
+// IndirectDrawConstants.
 struct DrawParams {
-  uint meshlet_count;
-  uint meshlet_offset;
-  uint instance_count;
-  uint instance_offset;
+  row_major float4x4 view_proj_mtx;
+
+  float3 camera_pos;
+  uint draw_record_buf_idx;
 
   uint pos_buf_idx;
   uint norm_buf_idx;
@@ -15,12 +17,14 @@ struct DrawParams {
   uint vertex_idx_buf_idx;
   uint prim_idx_buf_idx;
   uint meshlet_buf_idx;
-  uint mtl_buf_idx;
-
-  float3 camera_pos;
   uint inst_buf_idx;
 
-  row_major float4x4 view_proj_mtx;
+  uint instances_per_group;
+  uint meshlet_offset;
+  uint instance_count;
+  uint instance_offset;
+
+  uint draw_record_idx;
 };
 
 #endif
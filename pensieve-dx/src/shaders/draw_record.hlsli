@@ -0,0 +1,19 @@
+#ifndef DRAW_RECORD_HLSLI
+#define DRAW_RECORD_HLSLI
+
+// Where the ranges of a mesh start in the geometry buffers, in elements, and
+// its descriptor indices in a frame in flight.
+struct DrawRecord {
+  uint pos_base;
+  uint norm_base;
+  uint tan_base;
+  uint uv_base;
+  uint vertex_idx_base;
+  uint prim_idx_base;
+  uint meshlet_base;
+  uint inst_base;
+  uint mtl_buf_idx;
+  uint visible_inst_idx_buf_idx;
+};
+
+#endif
@@ -2,8 +2,14 @@
 #define GLOBALS_HLSLI
 
 #include "draw_params.hlsli"
+#include "draw_record.hlsli"
 
 ConstantBuffer<DrawParams> g_draw_params : register(b0, space0);
 SamplerState g_sampler : register(s0, space0);
 
+DrawRecord LoadDrawRecord() {
+  const StructuredBuffer<DrawRecord> draw_records = ResourceDescriptorHeap[g_draw_params.draw_record_buf_idx];
+  return draw_records[g_draw_params.draw_record_idx];
+}
+
 #endif
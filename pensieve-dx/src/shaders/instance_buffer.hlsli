@@ -1,9 +1,24 @@
 #ifndef INSTANCE_BUFFER_HLSLI
 #define INSTANCE_BUFFER_HLSLI
 
+// Transposed affine transform, transforms column vectors with mul(mtx, v).
 struct InstanceBufferData {
-  row_major float4x4 model_mtx;
-  row_major float4x4 model_inv_transp_mtx;
+  row_major float3x4 model_mtx;
 };
 
+#ifndef __cplusplus
+// Returns the cofactor matrix of the linear part of the transform, which is
+// the inverse transpose scaled by the determinant. The sign of the
+// determinant is divided out so that mirroring transforms keep the normals
+// facing outwards. Transformed normals must be renormalized. Mirrored on the
+// CPU in instance_transform.hpp.
+float3x3 CalculateNormalMatrix(const float3x4 model_mtx) {
+  const float3 r0 = model_mtx[0].xyz;
+  const float3 r1 = model_mtx[1].xyz;
+  const float3 r2 = model_mtx[2].xyz;
+  const float3x3 cofactor_mtx = float3x3(cross(r1, r2), cross(r2, r0), cross(r0, r1));
+  return dot(r0, cofactor_mtx[0]) < 0 ? -cofactor_mtx : cofactor_mtx;
+}
+#endif
+
 #endif
\ No newline at end of file
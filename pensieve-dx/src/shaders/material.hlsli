@@ -11,6 +11,8 @@ struct Material {
   uint roughness_map_idx;
   uint emission_map_idx;
   uint normal_map_idx;
+  uint metallic_map_channel;
+  uint roughness_map_channel;
 };
 
 #endif
@@ -4,30 +4,31 @@
 #include "meshlet.hlsli"
 #include "ps_in.hlsli"
 
-PsIn CalculateVertex(const uint vertex_idx, const uint instance_idx) {
+PsIn CalculateVertex(const DrawRecord draw_record, const uint vertex_idx, const uint instance_idx) {
   const StructuredBuffer<float4> positions = ResourceDescriptorHeap[g_draw_params.pos_buf_idx];
-  const float4 position_os = positions[vertex_idx];
+  const float4 position_os = positions[draw_record.pos_base + vertex_idx];
 
   const StructuredBuffer<float4> normals = ResourceDescriptorHeap[g_draw_params.norm_buf_idx];
-  const float3 normal_os = normalize(normals[vertex_idx].xyz);
+  const float3 normal_os = normalize(normals[draw_record.norm_base + vertex_idx].xyz);
 
+  const StructuredBuffer<uint> visible_instance_indices = ResourceDescriptorHeap[draw_record.visible_inst_idx_buf_idx];
   const StructuredBuffer<InstanceBufferData> instance_data_buffer = ResourceDescriptorHeap[g_draw_params.inst_buf_idx];
-  const InstanceBufferData instance_data = instance_data_buffer[g_draw_params.instance_offset + instance_idx];
+  const InstanceBufferData instance_data = instance_data_buffer[draw_record.inst_base + visible_instance_indices[g_draw_params.instance_offset + instance_idx]];
     
-  const float4 position_ws = mul(position_os, instance_data.model_mtx);
-  const float4 position_cs = mul(position_ws, g_draw_params.view_proj_mtx);
-  const float3 normal_ws = normalize(mul(normal_os, (float3x3) instance_data.model_inv_transp_mtx));
+  const float3 position_ws = mul(instance_data.model_mtx, position_os);
+  const float4 position_cs = mul(float4(position_ws, 1), g_draw_params.view_proj_mtx);
+  const float3 normal_ws = normalize(mul(CalculateNormalMatrix(instance_data.model_mtx), normal_os));
 
   PsIn ps_in;
-  ps_in.position_ws = position_ws.xyz;
+  ps_in.position_ws = position_ws;
   ps_in.position_cs = position_cs;
   ps_in.normal_ws = normal_ws;
 
-  if (g_draw_params.tan_buf_idx != INVALID_RESOURCE_IDX) {
+  if (draw_record.tan_base != INVALID_GEOMETRY_BASE) {
     const StructuredBuffer<float4> tangents = ResourceDescriptorHeap[g_draw_params.tan_buf_idx];
-    const float3 tangent_os = normalize(tangents[vertex_idx].xyz);
+    const float3 tangent_os = normalize(tangents[draw_record.tan_base + vertex_idx].xyz);
 
-    float3 tangent_ws = normalize(mul(tangent_os, (float3x3) instance_data.model_mtx));
+    float3 tangent_ws = normalize(mul((float3x3) instance_data.model_mtx, tangent_os));
     tangent_ws = normalize(tangent_ws - dot(tangent_ws, normal_ws) * normal_ws);
     const float3 bitangent_ws = cross(normal_ws, tangent_ws);
     ps_in.tbn_mtx_ws = float3x3(tangent_ws, bitangent_ws, normal_ws);
@@ -35,9 +36,9 @@ PsIn CalculateVertex(const uint vertex_idx, const uint instance_idx) {
     ps_in.tbn_mtx_ws = 0;
   }
 
-  if (g_draw_params.uv_buf_idx != INVALID_RESOURCE_IDX) {
+  if (draw_record.uv_base != INVALID_GEOMETRY_BASE) {
     const StructuredBuffer<float2> uvs = ResourceDescriptorHeap[g_draw_params.uv_buf_idx];
-    ps_in.uv = uvs[vertex_idx];
+    ps_in.uv = uvs[draw_record.uv_base + vertex_idx];
   } else {
     ps_in.uv = float2(0, 0);
   }
@@ -55,39 +56,39 @@ void main(
   const uint gid : SV_GroupID,
   const uint gtid : SV_GroupThreadID,
   out vertices PsIn out_verts[MESHLET_MAX_VERTS],
-  out indices uint3 out_tris[MESHLET_MAX_PRIMS]) {
+  out indices uint3 out_tris[MESHLET_MAX_PRIMS],
+  out primitives PsPrimIn out_prims[MESHLET_MAX_PRIMS]) {
 
-  const uint meshlet_idx = gid / g_draw_params.instance_count;
-  const StructuredBuffer<Meshlet> meshlets = ResourceDescriptorHeap[g_draw_params.meshlet_buf_idx];
-  const Meshlet meshlet = meshlets[meshlet_idx + g_draw_params.meshlet_offset];
-
-  uint start_instance = gid % g_draw_params.instance_count;
-  uint instance_count = 1;
-
-  if (meshlet_idx == g_draw_params.meshlet_count - 1) {
-    const uint instances_per_group = min(MESHLET_MAX_VERTS / meshlet.vertex_count, MESHLET_MAX_PRIMS / meshlet.primitive_count);
+  const DrawRecord draw_record = LoadDrawRecord();
 
-    const uint unpacked_group_count = (g_draw_params.meshlet_count - 1) * g_draw_params.instance_count;
-    const uint packed_index = gid - unpacked_group_count;
+  // Every meshlet of the dispatch packs the same number of instances into a group.
+  const uint groups_per_meshlet = (g_draw_params.instance_count + g_draw_params.instances_per_group - 1) / g_draw_params.instances_per_group;
+  const uint meshlet_idx = gid / groups_per_meshlet;
+  const StructuredBuffer<Meshlet> meshlets = ResourceDescriptorHeap[g_draw_params.meshlet_buf_idx];
+  const Meshlet meshlet = meshlets[draw_record.meshlet_base + g_draw_params.meshlet_offset + meshlet_idx];
 
-    start_instance = packed_index * instances_per_group;
-    instance_count = min(g_draw_params.instance_count - start_instance, instances_per_group);
-  }
+  const uint start_instance = gid % groups_per_meshlet * g_draw_params.instances_per_group;
+  const uint instance_count = min(g_draw_params.instance_count - start_instance, g_draw_params.instances_per_group);
 
   const uint vert_count = meshlet.vertex_count * instance_count;
   const uint prim_count = meshlet.primitive_count * instance_count;
   
   SetMeshOutputCounts(vert_count, prim_count);
 
+  PsPrimIn prim;
+  prim.mtl_buf_idx = draw_record.mtl_buf_idx;
+  prim.flags = (draw_record.uv_base != INVALID_GEOMETRY_BASE ? PRIM_FLAG_HAS_UVS : 0) |
+               (draw_record.tan_base != INVALID_GEOMETRY_BASE ? PRIM_FLAG_HAS_TANGENTS : 0);
+
   if (gtid < vert_count) {
     const uint read_index = gtid % meshlet.vertex_count;
     const uint instance_id = gtid / meshlet.vertex_count;
 
     const StructuredBuffer<uint> vertex_indices = ResourceDescriptorHeap[g_draw_params.vertex_idx_buf_idx];
-    const uint vertex_index = vertex_indices[meshlet.vertex_offset + read_index];
+    const uint vertex_index = vertex_indices[draw_record.vertex_idx_base + meshlet.vertex_offset + read_index];
     const uint instance_index = start_instance + instance_id;
 
-    out_verts[gtid] = CalculateVertex(vertex_index, instance_index);
+    out_verts[gtid] = CalculateVertex(draw_record, vertex_index, instance_index);
   }
 
   for (uint i = 0; i < 2; i++) {
@@ -99,7 +100,8 @@ void main(
 
       const StructuredBuffer<uint> primitive_indices = ResourceDescriptorHeap[g_draw_params.prim_idx_buf_idx];
   
-      out_tris[primitive_id] = UnpackIndices(primitive_indices[meshlet.primitive_offset + read_index]) + (meshlet.vertex_count * instance_id);
+      out_tris[primitive_id] = UnpackIndices(primitive_indices[draw_record.prim_idx_base + meshlet.primitive_offset + read_index]) + (meshlet.vertex_count * instance_id);
+      out_prims[primitive_id] = prim;
     }
   }
 }
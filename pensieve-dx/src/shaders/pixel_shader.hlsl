@@ -26,8 +26,8 @@ float3 SchlickFresnel(const float v_dot_h, const float3 f0) {
   return f0 + (1 - f0) * pow(2, (-5.55473 * v_dot_h - 6.98316) - v_dot_h);
 }
 
-float4 main(const PsIn ps_in) : SV_Target {
-  const ConstantBuffer<Material> material = ResourceDescriptorHeap[g_draw_params.mtl_buf_idx];
+float4 main(const PsIn ps_in, const PsPrimIn prim_in) : SV_Target {
+  const ConstantBuffer<Material> material = ResourceDescriptorHeap[prim_in.mtl_buf_idx];
 
   float3 base_color = material.base_color;
   float metallic = material.metallic;
@@ -35,7 +35,7 @@ float4 main(const PsIn ps_in) : SV_Target {
   float3 emission = material.emission_color;
   float3 normal = normalize(ps_in.normal_ws);
 
-  if (g_draw_params.uv_buf_idx != INVALID_RESOURCE_IDX) {
+  if (prim_in.flags & PRIM_FLAG_HAS_UVS) {
     if (material.base_color_map_idx != INVALID_RESOURCE_IDX) {
       const Texture2D base_color_map = ResourceDescriptorHeap[material.base_color_map_idx];
       base_color *= pow(base_color_map.Sample(g_sampler, ps_in.uv).rgb, kGamma);
@@ -43,12 +43,12 @@ float4 main(const PsIn ps_in) : SV_Target {
 
     if (material.metallic_map_idx != INVALID_RESOURCE_IDX) {
       const Texture2D metallic_map = ResourceDescriptorHeap[material.metallic_map_idx];
-      metallic *= metallic_map.Sample(g_sampler, ps_in.uv).r;
+      metallic *= metallic_map.Sample(g_sampler, ps_in.uv)[material.metallic_map_channel];
     }
 
     if (material.roughness_map_idx != INVALID_RESOURCE_IDX) {
       const Texture2D roughness_map = ResourceDescriptorHeap[material.roughness_map_idx];
-      roughness *= roughness_map.Sample(g_sampler, ps_in.uv).r;
+      roughness *= roughness_map.Sample(g_sampler, ps_in.uv)[material.roughness_map_channel];
     }
 
     if (material.emission_map_idx != INVALID_RESOURCE_IDX) {
@@ -56,7 +56,7 @@ float4 main(const PsIn ps_in) : SV_Target {
       emission *= emission_map.Sample(g_sampler, ps_in.uv).rgb;
     }
 
-    if (material.normal_map_idx != INVALID_RESOURCE_IDX && g_draw_params.tan_buf_idx != INVALID_RESOURCE_IDX) {
+    if (material.normal_map_idx != INVALID_RESOURCE_IDX && (prim_in.flags & PRIM_FLAG_HAS_TANGENTS)) {
       const Texture2D normal_map = ResourceDescriptorHeap[material.normal_map_idx];
       normal = normal_map.Sample(g_sampler, ps_in.uv).rgb * 2 - 1;
       normal = normalize(mul(normalize(normal), ps_in.tbn_mtx_ws));
@@ -9,4 +9,14 @@ struct PsIn {
   float3x3 tbn_mtx_ws : TBN;
 };
 
+#define PRIM_FLAG_HAS_UVS 1
+#define PRIM_FLAG_HAS_TANGENTS 2
+
+// The per mesh values the pixel shader needs, written once per primitive so
+// that pixels do not load the draw record.
+struct PsPrimIn {
+  nointerpolation uint mtl_buf_idx : MATERIAL_BUFFER_INDEX;
+  nointerpolation uint flags : PRIMITIVE_FLAGS;
+};
+
 #endif
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+namespace pensieve {
+// A part of a larger copy that fits into the staging ring at once.
+struct UploadChunk {
+  std::uint64_t offset;
+  std::uint64_t byte_count;
+};
+
+// Splits a copy into chunks of at most max_chunk_byte_count bytes that start
+// at multiples of granularity, e.g. texture rows. The granularity must not be
+// larger than max_chunk_byte_count.
+[[nodiscard]] constexpr auto PlanUploadChunks(
+  std::uint64_t const byte_count, std::uint64_t const granularity,
+  std::uint64_t const max_chunk_byte_count) -> std::vector<UploadChunk> {
+  auto const chunk_byte_count{
+    max_chunk_byte_count / granularity * granularity
+  };
+  std::vector<UploadChunk> ret;
+
+  for (std::uint64_t offset{0}; offset < byte_count; offset +=
+       chunk_byte_count) {
+    ret.emplace_back(offset, std::min(chunk_byte_count, byte_count - offset));
+  }
+
+  return ret;
+}
+
+// Staging memory handed out in order and reclaimed in batches once the fence
+// value a batch was submitted with completes. Allocations never straddle the
+// end of the ring, the space skipped there is reclaimed with the batch.
+class StagingRing {
+public:
+  // The open batch counts as full once it reaches max_batch_byte_count, so
+  // that copies can start while the rest is still being staged.
+  constexpr StagingRing(std::uint64_t const capacity,
+                        std::uint64_t const max_batch_byte_count) :
+    capacity_{capacity}, max_batch_byte_count_{max_batch_byte_count} {}
+
+  // Returns the offset of the allocation or nothing if there is not enough
+  // free space. Allocations up to the capacity always fit into an empty ring.
+  [[nodiscard]] constexpr auto Allocate(std::uint64_t const byte_count,
+                                        std::uint64_t const alignment) ->
+    std::optional<std::uint64_t> {
+    if (used_byte_count_ == 0) {
+      head_ = 0;
+    }
+
+    auto offset{(head_ + alignment - 1) / alignment * alignment};
+
+    if (offset + byte_count > capacity_) {
+      offset = 0;
+    }
+
+    auto const consumed_byte_count{
+      (offset >= head_ ? offset - head_ : capacity_ - head_) + byte_count
+    };
+
+    if (used_byte_count_ + consumed_byte_count > capacity_) {
+      return std::nullopt;
+    }
+
+    head_ = offset + byte_count;
+    used_byte_count_ += consumed_byte_count;
+    open_batch_byte_count_ += consumed_byte_count;
+    return offset;
+  }
+
+  // Does nothing if the open batch is empty.
+  constexpr auto CloseBatch(std::uint64_t const fence_val) -> void {
+    if (open_batch_byte_count_ != 0) {
+      closed_batches_.emplace_back(fence_val, open_batch_byte_count_);
+      open_batch_byte_count_ = 0;
+    }
+  }
+
+  // Frees the closed batches whose fence value is not above the completed one.
+  constexpr auto Reclaim(std::uint64_t const completed_fence_val) -> void {
+    auto const it{
+      std::ranges::find_if(closed_batches_,
+                           [completed_fence_val](Batch const& batch) {
+                             return batch.fence_val > completed_fence_val;
+                           })
+    };
+
+    for (auto batch_it{closed_batches_.begin()}; batch_it != it; ++batch_it) {
+      used_byte_count_ -= batch_it->byte_count;
+    }
+
+    closed_batches_.erase(closed_batches_.begin(), it);
+  }
+
+  // The fence value to wait for to free space, if there is a closed batch.
+  [[nodiscard]] constexpr auto GetOldestFenceValue() const -> std::optional<
+    std::uint64_t> {
+    if (closed_batches_.empty()) {
+      return std::nullopt;
+    }
+
+    return closed_batches_.front().fence_val;
+  }
+
+  [[nodiscard]] constexpr auto IsBatchFull() const -> bool {
+    return open_batch_byte_count_ >= max_batch_byte_count_;
+  }
+
+  [[nodiscard]] constexpr auto GetOpenBatchByteCount() const -> std::uint64_t {
+    return open_batch_byte_count_;
+  }
+
+  [[nodiscard]] constexpr auto GetUsedByteCount() const -> std::uint64_t {
+    return used_byte_count_;
+  }
+
+  [[nodiscard]] constexpr auto GetCapacity() const -> std::uint64_t {
+    return capacity_;
+  }
+
+private:
+  struct Batch {
+    std::uint64_t fence_val;
+    std::uint64_t byte_count;
+  };
+
+  // Oldest first.
+  std::vector<Batch> closed_batches_;
+  std::uint64_t capacity_;
+  std::uint64_t max_batch_byte_count_;
+  std::uint64_t head_{0};
+  std::uint64_t used_byte_count_{0};
+  std::uint64_t open_batch_byte_count_{0};
+};
+}
@@ -0,0 +1,410 @@
+#include "uploader.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <format>
+#include <tuple>
+#include <utility>
+
+#include <d3dx12.h>
+
+using Microsoft::WRL::ComPtr;
+
+namespace pensieve {
+auto Uploader::Create(ID3D12Device10* const device,
+                      D3D12MA::Allocator* const mem_allocator) ->
+  std::expected<Uploader, std::string> {
+  D3D12_COMMAND_QUEUE_DESC constexpr copy_queue_desc{
+    D3D12_COMMAND_LIST_TYPE_COPY, D3D12_COMMAND_QUEUE_PRIORITY_NORMAL,
+    D3D12_COMMAND_QUEUE_FLAG_NONE, 0
+  };
+
+  ComPtr<ID3D12CommandQueue> copy_queue;
+  if (FAILED(
+    device->CreateCommandQueue(&copy_queue_desc, IID_PPV_ARGS(&copy_queue)))) {
+    return std::unexpected{"Failed to create copy command queue."};
+  }
+
+  std::array<ComPtr<ID3D12CommandAllocator>, cmd_alloc_count_> cmd_allocs;
+
+  for (auto i{0}; i < cmd_alloc_count_; i++) {
+    if (FAILED(
+      device->CreateCommandAllocator(D3D12_COMMAND_LIST_TYPE_COPY,
+        IID_PPV_ARGS(&cmd_allocs[i])))) {
+      return std::unexpected{
+        std::format("Failed to create copy command allocator {}.", i)
+      };
+    }
+  }
+
+  ComPtr<ID3D12GraphicsCommandList7> cmd_list;
+  if (FAILED(
+    device->CreateCommandList1(0, D3D12_COMMAND_LIST_TYPE_COPY,
+      D3D12_COMMAND_LIST_FLAG_NONE, IID_PPV_ARGS(&cmd_list)))) {
+    return std::unexpected{"Failed to create copy command list."};
+  }
+
+  ComPtr<ID3D12Fence> fence;
+  if (FAILED(
+    device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(&fence)))) {
+    return std::unexpected{"Failed to create upload fence."};
+  }
+
+  auto const ring_buf_desc{CD3DX12_RESOURCE_DESC1::Buffer(ring_capacity_)};
+
+  D3D12MA::ALLOCATION_DESC constexpr upload_alloc_desc{
+    D3D12MA::ALLOCATION_FLAG_NONE, D3D12_HEAP_TYPE_UPLOAD, D3D12_HEAP_FLAG_NONE,
+    nullptr, nullptr
+  };
+
+  ComPtr<D3D12MA::Allocation> ring_buf;
+  if (FAILED(
+    mem_allocator->CreateResource3(&upload_alloc_desc, &ring_buf_desc,
+      D3D12_BARRIER_LAYOUT_UNDEFINED, nullptr, 0, nullptr, &ring_buf, IID_NULL,
+      nullptr))) {
+    return std::unexpected{"Failed to create staging buffer."};
+  }
+
+  void* mapped;
+  if (FAILED(ring_buf->GetResource()->Map(0, nullptr, &mapped))) {
+    return std::unexpected{"Failed to map staging buffer."};
+  }
+
+  return Uploader{
+    device, std::move(copy_queue), std::move(cmd_allocs), std::move(cmd_list),
+    std::move(fence), std::move(ring_buf),
+    std::span{static_cast<std::uint8_t*>(mapped), ring_capacity_}
+  };
+}
+
+Uploader::~Uploader() {
+  if (fence_) {
+    std::ignore = WaitForFence(fence_val_);
+  }
+}
+
+auto Uploader::UploadBuffer(ID3D12Resource* const dst, UINT64 const dst_offset,
+                            std::span<std::byte const> const bytes) ->
+  std::expected<void, std::string> {
+  for (auto const& [offset, byte_count] : PlanUploadChunks(
+         bytes.size(), 1, max_batch_byte_count_)) {
+    auto const staging_offset{Allocate(byte_count, 16)};
+
+    if (!staging_offset) {
+      return std::unexpected{staging_offset.error()};
+    }
+
+    if (auto const exp{BeginRecording()}; !exp) {
+      return exp;
+    }
+
+    std::memcpy(ring_data_.data() + *staging_offset, bytes.data() + offset,
+                byte_count);
+    cmd_list_->CopyBufferRegion(dst, dst_offset + offset,
+                                ring_buf_->GetResource(), *staging_offset,
+                                byte_count);
+
+    if (auto const exp{SubmitIfBatchFull()}; !exp) {
+      return exp;
+    }
+  }
+
+  return {};
+}
+
+auto Uploader::UploadTexture(ID3D12Resource* const dst,
+                             TextureData const& tex) -> std::expected<
+  void, std::string> {
+  auto const dst_desc{dst->GetDesc()};
+  auto const block_height{IsBlockCompressed(tex.format) ? 4u : 1u};
+  std::size_t mip_offset{0};
+
+  for (UINT mip{0}; mip < tex.mip_count; mip++) {
+    auto const [row_pitch, row_count]{
+      GetTextureMipLayout(tex.format, tex.width, tex.height, mip)
+    };
+
+    D3D12_PLACED_SUBRESOURCE_FOOTPRINT mip_footprint;
+    device_->GetCopyableFootprints(&dst_desc, mip, 1, 0, &mip_footprint,
+                                   nullptr, nullptr, nullptr);
+
+    auto const staging_row_pitch{
+      UINT64{mip_footprint.Footprint.RowPitch}
+    };
+
+    if (staging_row_pitch > max_batch_byte_count_) {
+      return std::unexpected{
+        std::format("Mip {} rows do not fit into the staging buffer.", mip)
+      };
+    }
+
+    // Big mips are copied in chunks of whole rows.
+    for (auto const& [offset, byte_count] : PlanUploadChunks(
+           row_count * staging_row_pitch, staging_row_pitch,
+           max_batch_byte_count_)) {
+      auto const first_row{static_cast<UINT>(offset / staging_row_pitch)};
+      auto const chunk_row_count{
+        static_cast<UINT>(byte_count / staging_row_pitch)
+      };
+
+      auto const staging_offset{
+        Allocate(byte_count, D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT)
+      };
+
+      if (!staging_offset) {
+        return std::unexpected{staging_offset.error()};
+      }
+
+      if (auto const exp{BeginRecording()}; !exp) {
+        return exp;
+      }
+
+      for (UINT i{0}; i < chunk_row_count; i++) {
+        std::memcpy(ring_data_.data() + *staging_offset + i * staging_row_pitch,
+                    tex.bytes.get() + mip_offset + static_cast<std::size_t>(
+                      first_row + i) * row_pitch, row_pitch);
+      }
+
+      D3D12_PLACED_SUBRESOURCE_FOOTPRINT chunk_footprint{
+        *staging_offset, mip_footprint.Footprint
+      };
+      chunk_footprint.Footprint.Height = std::min(
+        chunk_row_count * block_height,
+        mip_footprint.Footprint.Height - first_row * block_height);
+
+      CD3DX12_TEXTURE_COPY_LOCATION const dst_loc{dst, mip};
+      CD3DX12_TEXTURE_COPY_LOCATION const src_loc{
+        ring_buf_->GetResource(), chunk_footprint
+      };
+
+      cmd_list_->CopyTextureRegion(&dst_loc, 0, first_row * block_height, 0,
+                                   &src_loc, nullptr);
+
+      if (auto const exp{SubmitIfBatchFull()}; !exp) {
+        return exp;
+      }
+    }
+
+    mip_offset += static_cast<std::size_t>(row_pitch) * row_count;
+  }
+
+  return {};
+}
+
+auto Uploader::StageBuffer(UINT64 const byte_count,
+                           UINT64 const granularity) -> std::expected<
+  std::span<std::byte>, std::string> {
+  auto const staged_byte_count{
+    std::min(byte_count, max_batch_byte_count_ / granularity * granularity)
+  };
+
+  if (staged_byte_count == 0) {
+    return std::unexpected{"Nothing to stage."};
+  }
+
+  auto const staging_offset{Allocate(staged_byte_count, 16)};
+
+  if (!staging_offset) {
+    return std::unexpected{staging_offset.error()};
+  }
+
+  return std::as_writable_bytes(
+    ring_data_.subspan(*staging_offset, staged_byte_count));
+}
+
+auto Uploader::CopyStagedBuffer(ID3D12Resource* const dst,
+                                UINT64 const dst_offset,
+                                std::span<std::byte const> const staged) ->
+  std::expected<void, std::string> {
+  if (auto const exp{BeginRecording()}; !exp) {
+    return exp;
+  }
+
+  cmd_list_->CopyBufferRegion(dst, dst_offset, ring_buf_->GetResource(),
+                              GetStagingOffset(staged.data()), staged.size());
+  return SubmitIfBatchFull();
+}
+
+auto Uploader::StageTextureRows(ID3D12Resource* const dst, UINT const mip,
+                                UINT const row_count) -> std::expected<
+  StagedTextureRows, std::string> {
+  auto const dst_desc{dst->GetDesc()};
+  D3D12_PLACED_SUBRESOURCE_FOOTPRINT mip_footprint;
+  device_->GetCopyableFootprints(&dst_desc, mip, 1, 0, &mip_footprint, nullptr,
+                                 nullptr, nullptr);
+
+  auto const staging_row_pitch{UINT64{mip_footprint.Footprint.RowPitch}};
+
+  if (staging_row_pitch > max_batch_byte_count_) {
+    return std::unexpected{
+      std::format("Mip {} rows do not fit into the staging buffer.", mip)
+    };
+  }
+
+  auto const staged_row_count{
+    std::min<UINT64>(row_count, max_batch_byte_count_ / staging_row_pitch)
+  };
+  auto const staging_offset{
+    Allocate(staged_row_count * staging_row_pitch,
+             D3D12_TEXTURE_DATA_PLACEMENT_ALIGNMENT)
+  };
+
+  if (!staging_offset) {
+    return std::unexpected{staging_offset.error()};
+  }
+
+  return StagedTextureRows{
+    reinterpret_cast<std::byte*>(ring_data_.data() + *staging_offset),
+    static_cast<UINT>(staged_row_count), staging_row_pitch
+  };
+}
+
+auto Uploader::CopyStagedTextureRows(ID3D12Resource* const dst,
+                                     TextureFormat const format, UINT const mip,
+                                     UINT const first_row,
+                                     StagedTextureRows const& staged) ->
+  std::expected<void, std::string> {
+  if (auto const exp{BeginRecording()}; !exp) {
+    return exp;
+  }
+
+  auto const dst_desc{dst->GetDesc()};
+  auto const block_height{IsBlockCompressed(format) ? 4u : 1u};
+  D3D12_PLACED_SUBRESOURCE_FOOTPRINT mip_footprint;
+  device_->GetCopyableFootprints(&dst_desc, mip, 1, 0, &mip_footprint, nullptr,
+                                 nullptr, nullptr);
+
+  D3D12_PLACED_SUBRESOURCE_FOOTPRINT chunk_footprint{
+    GetStagingOffset(staged.data), mip_footprint.Footprint
+  };
+  chunk_footprint.Footprint.Height = std::min(
+    staged.row_count * block_height,
+    mip_footprint.Footprint.Height - first_row * block_height);
+
+  CD3DX12_TEXTURE_COPY_LOCATION const dst_loc{dst, mip};
+  CD3DX12_TEXTURE_COPY_LOCATION const src_loc{
+    ring_buf_->GetResource(), chunk_footprint
+  };
+
+  cmd_list_->CopyTextureRegion(&dst_loc, 0, first_row * block_height, 0,
+                               &src_loc, nullptr);
+  return SubmitIfBatchFull();
+}
+
+auto Uploader::Finish() -> std::expected<void, std::string> {
+  if (auto const exp{Submit()}; !exp) {
+    return exp;
+  }
+
+  return WaitForFence(fence_val_);
+}
+
+Uploader::Uploader(ComPtr<ID3D12Device10> device,
+                   ComPtr<ID3D12CommandQueue> copy_queue,
+                   std::array<ComPtr<ID3D12CommandAllocator>, cmd_alloc_count_>
+                   cmd_allocs, ComPtr<ID3D12GraphicsCommandList7> cmd_list,
+                   ComPtr<ID3D12Fence> fence,
+                   ComPtr<D3D12MA::Allocation> ring_buf,
+                   std::span<std::uint8_t> const ring_data) :
+  device_{std::move(device)}, copy_queue_{std::move(copy_queue)},
+  cmd_allocs_{std::move(cmd_allocs)}, cmd_list_{std::move(cmd_list)},
+  fence_{std::move(fence)}, ring_buf_{std::move(ring_buf)},
+  ring_data_{ring_data} {}
+
+auto Uploader::Allocate(UINT64 const byte_count,
+                        UINT64 const alignment) -> std::expected<
+  UINT64, std::string> {
+  while (true) {
+    if (auto const offset{ring_.Allocate(byte_count, alignment)}) {
+      return *offset;
+    }
+
+    // Free space only comes from submitted batches.
+    if (ring_.GetOpenBatchByteCount() != 0) {
+      if (auto const exp{Submit()}; !exp) {
+        return std::unexpected{exp.error()};
+      }
+
+      continue;
+    }
+
+    auto const oldest_fence_val{ring_.GetOldestFenceValue()};
+
+    if (!oldest_fence_val) {
+      return std::unexpected{
+        std::format("{} bytes do not fit into the staging buffer.", byte_count)
+      };
+    }
+
+    if (auto const exp{WaitForFence(*oldest_fence_val)}; !exp) {
+      return std::unexpected{exp.error()};
+    }
+  }
+}
+
+auto Uploader::GetStagingOffset(std::byte const* const staged) const -> UINT64 {
+  return static_cast<UINT64>(
+    staged - reinterpret_cast<std::byte const*>(ring_data_.data()));
+}
+
+auto Uploader::BeginRecording() -> std::expected<void, std::string> {
+  if (is_recording_) {
+    return {};
+  }
+
+  if (auto const exp{WaitForFence(cmd_alloc_fence_vals_[cmd_alloc_idx_])};
+    !exp) {
+    return exp;
+  }
+
+  if (FAILED(cmd_allocs_[cmd_alloc_idx_]->Reset())) {
+    return std::unexpected{"Failed to reset copy command allocator."};
+  }
+
+  if (FAILED(cmd_list_->Reset(cmd_allocs_[cmd_alloc_idx_].Get(), nullptr))) {
+    return std::unexpected{"Failed to reset copy command list."};
+  }
+
+  is_recording_ = true;
+  return {};
+}
+
+auto Uploader::Submit() -> std::expected<void, std::string> {
+  if (!is_recording_) {
+    return {};
+  }
+
+  if (FAILED(cmd_list_->Close())) {
+    return std::unexpected{"Failed to close copy command list."};
+  }
+
+  copy_queue_->ExecuteCommandLists(
+    1, CommandListCast(cmd_list_.GetAddressOf()));
+
+  ++fence_val_;
+  if (FAILED(copy_queue_->Signal(fence_.Get(), fence_val_))) {
+    return std::unexpected{"Failed to signal upload fence."};
+  }
+
+  ring_.CloseBatch(fence_val_);
+  cmd_alloc_fence_vals_[cmd_alloc_idx_] = fence_val_;
+  cmd_alloc_idx_ = (cmd_alloc_idx_ + 1) % cmd_alloc_count_;
+  is_recording_ = false;
+  return {};
+}
+
+auto Uploader::SubmitIfBatchFull() -> std::expected<void, std::string> {
+  return ring_.IsBatchFull() ? Submit() : std::expected<void, std::string>{};
+}
+
+auto Uploader::WaitForFence(UINT64 const fence_val) -> std::expected<
+  void, std::string> {
+  if (fence_->GetCompletedValue() < fence_val && FAILED(
+    fence_->SetEventOnCompletion(fence_val, nullptr))) {
+    return std::unexpected{"Failed to wait for upload fence."};
+  }
+
+  ring_.Reclaim(fence_->GetCompletedValue());
+  return {};
+}
+}
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <span>
+#include <string>
+
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#include <d3d12.h>
+#include <D3D12MemAlloc.h>
+#include <wrl/client.h>
+
+#include "scene_data.hpp"
+#include "staging_ring.hpp"
+
+namespace pensieve {
+// Copies data to GPU resources on a copy queue. Data is staged in a
+// persistently mapped ring buffer and copies are submitted in batches, so
+// staging the next data overlaps with the copies of the previous batches.
+class Uploader {
+public:
+  [[nodiscard]] static auto Create(ID3D12Device10* device,
+                                   D3D12MA::Allocator* mem_allocator) ->
+    std::expected<Uploader, std::string>;
+
+  Uploader(Uploader const& other) = delete;
+  Uploader(Uploader&& other) noexcept = default;
+
+  // Waits for the submitted copies, as they might use the staging buffer.
+  ~Uploader();
+
+  auto operator=(Uploader const& other) -> void = delete;
+  auto operator=(Uploader&& other) -> void = delete;
+
+  // The bytes can be freed once this returns, the destination cannot be used
+  // before Finish.
+  [[nodiscard]] auto UploadBuffer(ID3D12Resource* dst, UINT64 dst_offset,
+                                  std::span<std::byte const> bytes) ->
+    std::expected<void, std::string>;
+
+  // Uploads every mip of a texture in the common layout, in which copy queues
+  // can write it and shaders can read it without barriers.
+  [[nodiscard]] auto UploadTexture(ID3D12Resource* dst,
+                                   TextureData const& tex) -> std::expected<
+    void, std::string>;
+
+  // Returns staging memory for the start of a buffer upload of byte_count
+  // bytes. It holds a multiple of granularity bytes, possibly fewer than
+  // byte_count. Fill it and pass it to CopyStagedBuffer before staging more,
+  // which lets data be written to staging memory without a copy in between.
+  [[nodiscard]] auto StageBuffer(UINT64 byte_count,
+                                 UINT64 granularity) -> std::expected<
+    std::span<std::byte>, std::string>;
+
+  [[nodiscard]] auto CopyStagedBuffer(ID3D12Resource* dst, UINT64 dst_offset,
+                                      std::span<std::byte const> staged) ->
+    std::expected<void, std::string>;
+
+  // Tightly packed rows of the format, row_pitch bytes apart.
+  struct StagedTextureRows {
+    std::byte* data;
+    UINT row_count;
+    UINT64 row_pitch;
+  };
+
+  // Returns staging memory for up to row_count rows of a mip starting at
+  // first_row. Rows are texel rows or block rows for block compressed
+  // formats. Fill it and pass it to CopyStagedTextureRows before staging more.
+  [[nodiscard]] auto StageTextureRows(ID3D12Resource* dst, UINT mip,
+                                      UINT row_count) -> std::expected<
+    StagedTextureRows, std::string>;
+
+  [[nodiscard]] auto CopyStagedTextureRows(ID3D12Resource* dst,
+                                           TextureFormat format, UINT mip,
+                                           UINT first_row,
+                                           StagedTextureRows const& staged) ->
+    std::expected<void, std::string>;
+
+  // Submits the remaining copies and waits for all of them to complete.
+  [[nodiscard]] auto Finish() -> std::expected<void, std::string>;
+
+private:
+  static auto constexpr ring_capacity_{UINT64{256} << 20};
+  static auto constexpr max_batch_byte_count_{UINT64{32} << 20};
+  static auto constexpr cmd_alloc_count_{4};
+
+  Uploader(Microsoft::WRL::ComPtr<ID3D12Device10> device,
+           Microsoft::WRL::ComPtr<ID3D12CommandQueue> copy_queue,
+           std::array<Microsoft::WRL::ComPtr<ID3D12CommandAllocator>,
+                      cmd_alloc_count_> cmd_allocs,
+           Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList7> cmd_list,
+           Microsoft::WRL::ComPtr<ID3D12Fence> fence,
+           Microsoft::WRL::ComPtr<D3D12MA::Allocation> ring_buf,
+           std::span<std::uint8_t> ring_data);
+
+  // Submits batches and waits for them as needed to make room.
+  [[nodiscard]] auto Allocate(UINT64 byte_count,
+                              UINT64 alignment) -> std::expected<
+    UINT64, std::string>;
+  [[nodiscard]] auto GetStagingOffset(
+    std::byte const* staged) const -> UINT64;
+  [[nodiscard]] auto BeginRecording() -> std::expected<void, std::string>;
+  // Does nothing if no copies were recorded since the last submission.
+  [[nodiscard]] auto Submit() -> std::expected<void, std::string>;
+  [[nodiscard]] auto SubmitIfBatchFull() -> std::expected<void, std::string>;
+  [[nodiscard]] auto WaitForFence(UINT64 fence_val) -> std::expected<
+    void, std::string>;
+
+  Microsoft::WRL::ComPtr<ID3D12Device10> device_;
+  Microsoft::WRL::ComPtr<ID3D12CommandQueue> copy_queue_;
+  std::array<Microsoft::WRL::ComPtr<ID3D12CommandAllocator>, cmd_alloc_count_>
+  cmd_allocs_;
+  Microsoft::WRL::ComPtr<ID3D12GraphicsCommandList7> cmd_list_;
+  Microsoft::WRL::ComPtr<ID3D12Fence> fence_;
+  Microsoft::WRL::ComPtr<D3D12MA::Allocation> ring_buf_;
+  std::span<std::uint8_t> ring_data_;
+
+  StagingRing ring_{ring_capacity_, max_batch_byte_count_};
+  // The fence values of the last batches recorded with each allocator.
+  std::array<UINT64, cmd_alloc_count_> cmd_alloc_fence_vals_{};
+  UINT64 fence_val_{0};
+  int cmd_alloc_idx_{0};
+  bool is_recording_{false};
+};
+}
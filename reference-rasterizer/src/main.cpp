@@ -0,0 +1,386 @@
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <expected>
+#include <filesystem>
+#include <format>
+#include <iostream>
+#include <numbers>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "job_system.hpp"
+#include "mesh_shader_emulator.hpp"
+#include "pfm.hpp"
+#include "scene_loading.hpp"
+#include "software_rasterizer.hpp"
+#include "shaders/common.hlsli"
+
+namespace pensieve {
+namespace {
+// Same as the camera of the viewer.
+auto constexpr kVerticalDegreesFov{60.0f};
+// Goldens are only compared against images of the same build, the tolerances
+// absorb compiler differences in floating point contraction.
+auto constexpr kDepthTolerance{1e-5f};
+auto constexpr kNormalTolerance{1e-3f};
+
+struct Options {
+  std::filesystem::path scene_path;
+  std::string output_prefix;
+  std::optional<std::string> golden_prefix;
+  int width{1280};
+  int height{720};
+};
+
+[[nodiscard]] auto ParseOptions(
+  std::span<char* const> const args) -> std::expected<Options, std::string> {
+  Options opts{args[1], args[2], std::nullopt};
+
+  for (std::size_t i{3}; i < args.size(); i++) {
+    std::string_view const arg{args[i]};
+
+    if (i + 1 >= args.size()) {
+      return std::unexpected{std::format("Missing value for {}.", arg)};
+    }
+
+    std::string_view const value{args[++i]};
+
+    if (arg == "--compare") {
+      opts.golden_prefix = std::string{value};
+    } else if (arg == "--size") {
+      auto const separator{value.find('x')};
+
+      if (separator == std::string_view::npos || std::from_chars(
+            value.data(), value.data() + separator, opts.width).ec !=
+          std::errc{} || std::from_chars(value.data() + separator + 1,
+                                         value.data() + value.size(),
+                                         opts.height).ec != std::errc{} ||
+          opts.width <= 0 || opts.height <= 0) {
+        return std::unexpected{std::format("Invalid size {}.", value)};
+      }
+    } else {
+      return std::unexpected{std::format("Unknown option {}.", arg)};
+    }
+  }
+
+  return opts;
+}
+
+[[nodiscard]] auto Multiply(std::span<float const, 16> const lhs,
+                            std::span<float const, 16> const rhs) ->
+  std::array<float, 16> {
+  std::array<float, 16> ret{};
+
+  for (auto i{0}; i < 4; i++) {
+    for (auto j{0}; j < 4; j++) {
+      for (auto k{0}; k < 4; k++) {
+        ret[i * 4 + j] += lhs[i * 4 + k] * rhs[k * 4 + j];
+      }
+    }
+  }
+
+  return ret;
+}
+
+// Looks at the scene bounds along +z like the viewer's camera does by default,
+// from far enough for them to fit into the view. Same conventions as the
+// renderer: row vectors, left handed and reversed depth.
+[[nodiscard]] auto CalculateViewProjMatrix(
+  SceneData const& scene, float const aspect_ratio) -> std::array<float, 16> {
+  auto const bounds{
+    scene.bvh.nodes.empty()
+      ? Aabb{Float3{-1, -1, -1}, Float3{1, 1, 1}}
+      : Aabb{scene.bvh.nodes[0].aabb_min, scene.bvh.nodes[0].aabb_max}
+  };
+
+  Float3 center;
+  auto radius_sq{0.0f};
+
+  for (auto i{0}; i < 3; i++) {
+    center[i] = (bounds.min[i] + bounds.max[i]) * 0.5f;
+    radius_sq += (bounds.max[i] - center[i]) * (bounds.max[i] - center[i]);
+  }
+
+  auto const radius{std::max(std::sqrt(radius_sq), 1e-3f)};
+  auto const half_fov{kVerticalDegreesFov * std::numbers::pi_v<float> / 360.0f};
+  auto const min_half_fov{
+    std::min(half_fov, std::atan(std::tan(half_fov) * aspect_ratio))
+  };
+  auto const distance{radius / std::sin(min_half_fov)};
+  auto const near_clip_plane{(distance - radius) * 0.5f};
+  auto const far_clip_plane{distance + radius * 2};
+
+  std::array<float, 16> view_mtx{
+    1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, -center[0], -center[1],
+    distance - center[2], 1
+  };
+
+  // XMMatrixPerspectiveFovLH with the clip planes swapped.
+  auto const height{1.0f / std::tan(half_fov)};
+  auto const range{near_clip_plane / (near_clip_plane - far_clip_plane)};
+  std::array<float, 16> const proj_mtx{
+    height / aspect_ratio, 0, 0, 0, 0, height, 0, 0, 0, 0, range, 1, 0, 0,
+    -range * far_clip_plane, 0
+  };
+
+  return Multiply(view_mtx, proj_mtx);
+}
+
+// What the groups of an indirect command produced.
+struct CommandOutput {
+  std::vector<ScreenTriangle> triangles;
+  TriangleSetupStats setup_stats;
+  std::uint64_t vertex_count;
+  std::optional<std::string> error;
+};
+
+[[nodiscard]] auto EmulateCommand(EmulatedMesh const& mesh,
+                                  IndirectDrawCommand const& command,
+                                  std::span<float const, 16> const
+                                  view_proj_mtx,
+                                  SoftwareRasterizer const& rasterizer) ->
+  CommandOutput {
+  CommandOutput ret{{}, {0, 0, 0, 0}, 0, std::nullopt};
+  EmulatedGroupOutput group_output;
+
+  for (std::uint32_t group_idx{0}; group_idx < command.dispatch.
+       thread_group_count_x; group_idx++) {
+    if (auto const exp{
+      EmulateMeshShaderGroup(mesh, command.constants, group_idx, view_proj_mtx,
+                             group_output)
+    }; !exp) {
+      ret.error = exp.error();
+      return ret;
+    }
+
+    ret.vertex_count += group_output.vertices.size();
+
+    auto const stats{
+      rasterizer.SetupTriangles(group_output.vertices, group_output.triangles,
+                                ret.triangles)
+    };
+    ret.setup_stats.input_triangle_count += stats.input_triangle_count;
+    ret.setup_stats.clipped_triangle_count += stats.clipped_triangle_count;
+    ret.setup_stats.culled_triangle_count += stats.culled_triangle_count;
+    ret.setup_stats.screen_triangle_count += stats.screen_triangle_count;
+  }
+
+  return ret;
+}
+
+// Returns the number of pixels with a channel outside the tolerance.
+[[nodiscard]] auto CompareImages(PfmImage const& img, PfmImage const& golden,
+                                 float const tolerance) -> std::expected<
+  std::uint64_t, std::string> {
+  if (img.width != golden.width || img.height != golden.height || img.
+    channel_count != golden.channel_count) {
+    return std::unexpected{
+      std::format("Golden is {}x{} with {} channels instead of {}x{} with {}.",
+                  golden.width, golden.height, golden.channel_count, img.width,
+                  img.height, img.channel_count)
+    };
+  }
+
+  std::uint64_t mismatch_count{0};
+
+  for (std::size_t i{0}; i < img.pixels.size(); i += img.channel_count) {
+    for (auto j{0}; j < img.channel_count; j++) {
+      if (!(std::abs(img.pixels[i + j] - golden.pixels[i + j]) <= tolerance)) {
+        ++mismatch_count;
+        break;
+      }
+    }
+  }
+
+  return mismatch_count;
+}
+}
+}
+
+auto main(int const argc, char** const argv) -> int {
+  if (argc < 3) {
+    std::cout << "Usage: reference-rasterizer <scene-file> <output-prefix> "
+      "[--size WxH] [--compare <golden-prefix>]\n";
+    return EXIT_SUCCESS;
+  }
+
+  auto const opts{pensieve::ParseOptions(std::span{argv, argv + argc})};
+
+  if (!opts) {
+    std::cerr << "Error: " << opts.error() << '\n';
+    return EXIT_FAILURE;
+  }
+
+  auto const scene{pensieve::LoadScene(opts->scene_path)};
+
+  if (!scene) {
+    std::cerr << "Error: " << scene.error() << '\n';
+    return EXIT_FAILURE;
+  }
+
+  auto const view_proj_mtx{
+    pensieve::CalculateViewProjMatrix(
+      *scene, static_cast<float>(opts->width) / static_cast<float>(opts->
+        height))
+  };
+
+  pensieve::JobSystem job_system;
+  pensieve::SoftwareRasterizer rasterizer{opts->width, opts->height};
+
+  auto const emulation_start{std::chrono::steady_clock::now()};
+
+  std::vector<pensieve::EmulatedMesh> meshes;
+  std::vector<std::pair<std::size_t, pensieve::IndirectDrawCommand>> commands;
+  std::uint64_t meshlet_count{0};
+  std::uint64_t group_count{0};
+
+  for (auto const& mesh_data : scene->meshes) {
+    meshes.emplace_back(pensieve::PrepareEmulatedMesh(mesh_data));
+    meshlet_count += mesh_data.meshlets.size();
+
+    for (auto const& command : pensieve::BuildEmulatedDrawCommands(
+           meshes.back())) {
+      commands.emplace_back(meshes.size() - 1, command);
+      group_count += command.dispatch.thread_group_count_x;
+    }
+  }
+
+  std::vector<pensieve::CommandOutput> outputs(commands.size());
+  job_system.ParallelFor(commands.size(), 1,
+                         [&meshes, &commands, &outputs, &view_proj_mtx,
+                           &rasterizer](std::size_t const begin,
+                                        std::size_t const end) {
+                           for (auto i{begin}; i < end; i++) {
+                             outputs[i] = pensieve::EmulateCommand(
+                               meshes[commands[i].first], commands[i].second,
+                               view_proj_mtx, rasterizer);
+                           }
+                         });
+
+  std::chrono::duration<double, std::milli> const emulation_time{
+    std::chrono::steady_clock::now() - emulation_start
+  };
+
+  std::vector<pensieve::ScreenTriangle> triangles;
+  pensieve::TriangleSetupStats setup_stats{0, 0, 0, 0};
+  std::uint64_t vertex_count{0};
+
+  for (auto const& output : outputs) {
+    if (output.error) {
+      std::cerr << "Error: " << *output.error << '\n';
+      return EXIT_FAILURE;
+    }
+
+    triangles.insert(triangles.end(), output.triangles.begin(),
+                     output.triangles.end());
+    vertex_count += output.vertex_count;
+    setup_stats.input_triangle_count += output.setup_stats.input_triangle_count;
+    setup_stats.clipped_triangle_count += output.setup_stats.
+      clipped_triangle_count;
+    setup_stats.culled_triangle_count += output.setup_stats.
+      culled_triangle_count;
+    setup_stats.screen_triangle_count += output.setup_stats.
+      screen_triangle_count;
+  }
+
+  std::cout << std::format(
+    "Emulated {} groups of {} dispatches over {} meshlets in {:.2f} ms.\n",
+    group_count, commands.size(), meshlet_count, emulation_time.count());
+  std::cout << std::format(
+    "Groups output {} vertices, filling {:.1f}% of their vertex slots, and {} "
+    "primitives.\n",
+    vertex_count, group_count == 0
+                    ? 0.0
+                    : 100.0 * static_cast<double>(vertex_count) / static_cast<
+                      double>(group_count * MESHLET_MAX_VERTS),
+    setup_stats.input_triangle_count);
+  std::cout << std::format(
+    "Clipped {} and culled {} primitives, set up {} screen triangles.\n",
+    setup_stats.clipped_triangle_count, setup_stats.culled_triangle_count,
+    setup_stats.screen_triangle_count);
+
+  auto const raster_start{std::chrono::steady_clock::now()};
+  rasterizer.Clear();
+  auto const pixel_count{rasterizer.Rasterize(job_system, triangles)};
+  std::chrono::duration<double, std::milli> const raster_time{
+    std::chrono::steady_clock::now() - raster_start
+  };
+
+  std::cout << std::format(
+    "Rasterized with {} pixels passing the depth test in {:.2f} ms.\n",
+    pixel_count, raster_time.count());
+
+  pensieve::PfmImage depth_img{
+    opts->width, opts->height, 1,
+    {rasterizer.GetDepth().begin(), rasterizer.GetDepth().end()}
+  };
+
+  pensieve::PfmImage normal_img{
+    opts->width, opts->height, 3,
+    std::vector<float>(depth_img.pixels.size() * 3)
+  };
+
+  for (std::size_t i{0}; i < depth_img.pixels.size(); i++) {
+    for (auto j{0}; j < 3; j++) {
+      normal_img.pixels[i * 3 + j] = rasterizer.GetNormal(j)[i];
+    }
+  }
+
+  std::array<std::pair<pensieve::PfmImage const*, float>, 2> const images{
+    std::pair{&depth_img, pensieve::kDepthTolerance},
+    std::pair{&normal_img, pensieve::kNormalTolerance}
+  };
+  std::array<std::string_view, 2> constexpr image_suffixes{
+    "_depth.pfm", "_normal.pfm"
+  };
+
+  auto is_matching{true};
+
+  for (std::size_t i{0}; i < images.size(); i++) {
+    auto const& [img, tolerance]{images[i]};
+
+    if (auto const exp{
+      WritePfm(opts->output_prefix + std::string{image_suffixes[i]}, *img)
+    }; !exp) {
+      std::cerr << "Error: " << exp.error() << '\n';
+      return EXIT_FAILURE;
+    }
+
+    if (!opts->golden_prefix) {
+      continue;
+    }
+
+    auto const golden_path{
+      *opts->golden_prefix + std::string{image_suffixes[i]}
+    };
+    auto const golden{pensieve::ReadPfm(golden_path)};
+
+    if (!golden) {
+      std::cerr << "Error: " << golden.error() << '\n';
+      return EXIT_FAILURE;
+    }
+
+    auto const mismatch_count{
+      pensieve::CompareImages(*img, *golden, tolerance)
+    };
+
+    if (!mismatch_count) {
+      std::cerr << "Error: " << mismatch_count.error() << '\n';
+      return EXIT_FAILURE;
+    }
+
+    std::cout << std::format("{} pixels differ from {}.\n", *mismatch_count,
+                             golden_path);
+    is_matching &= *mismatch_count == 0;
+  }
+
+  return is_matching ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,200 @@
+#include "mesh_shader_emulator.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <format>
+
+#include "instance_transform.hpp"
+#include "shaders/common.hlsli"
+
+namespace pensieve {
+namespace {
+[[nodiscard]] auto Normalize(Float3 const& vec) -> Float3 {
+  auto const len{std::sqrt(Dot(vec, vec))};
+  return Float3{vec[0] / len, vec[1] / len, vec[2] / len};
+}
+
+// Same as CalculateVertex in mesh_shader.hlsl without the attributes the
+// reference does not render.
+[[nodiscard]] auto CalculateVertex(Float4 const& position_os,
+                                   Float4 const& normal_os,
+                                   Float3X4 const& model_mtx,
+                                   std::span<float const, 16> const
+                                   view_proj_mtx) -> EmulatedVertex {
+  Float3 position_ws;
+
+  for (auto i{0}; i < 3; i++) {
+    position_ws[i] = model_mtx[i * 4] * position_os[0] + model_mtx[i * 4 + 1] *
+                     position_os[1] + model_mtx[i * 4 + 2] * position_os[2] +
+                     model_mtx[i * 4 + 3] * position_os[3];
+  }
+
+  EmulatedVertex ret;
+
+  for (auto i{0}; i < 4; i++) {
+    ret.position_cs[i] = position_ws[0] * view_proj_mtx[i] + position_ws[1] *
+                         view_proj_mtx[4 + i] + position_ws[2] * view_proj_mtx[
+                           8 + i] + view_proj_mtx[12 + i];
+  }
+
+  auto const normal_mtx{CalculateNormalMatrix(model_mtx)};
+  auto const normal{
+    Normalize(Float3{normal_os[0], normal_os[1], normal_os[2]})
+  };
+  ret.normal_ws = Normalize(Float3{
+    Dot(normal_mtx[0], normal), Dot(normal_mtx[1], normal),
+    Dot(normal_mtx[2], normal)
+  });
+
+  return ret;
+}
+}
+
+auto PrepareEmulatedMesh(MeshData const& mesh) -> EmulatedMesh {
+  auto meshlets{mesh.meshlets};
+  SortMeshletsForPacking(meshlets, MESHLET_MAX_VERTS, MESHLET_MAX_PRIMS);
+  auto dispatch_chunks{
+    PlanMeshletDispatches(meshlets, MESHLET_MAX_VERTS, MESHLET_MAX_PRIMS)
+  };
+  return EmulatedMesh{&mesh, std::move(meshlets), std::move(dispatch_chunks)};
+}
+
+auto BuildEmulatedDrawCommands(
+  EmulatedMesh const& mesh) -> std::vector<IndirectDrawCommand> {
+  std::vector<IndirectDrawCommand> commands;
+  AppendIndirectDrawCommands(0, mesh.dispatch_chunks,
+                             static_cast<std::uint32_t>(mesh.data->instances.
+                               size()), commands);
+  return commands;
+}
+
+auto EmulateMeshShaderGroup(EmulatedMesh const& mesh,
+                            IndirectDrawConstants const& constants,
+                            std::uint32_t const group_idx,
+                            std::span<float const, 16> const view_proj_mtx,
+                            EmulatedGroupOutput& output) -> std::expected<
+  void, std::string> {
+  output.vertices.clear();
+  output.triangles.clear();
+
+  if (constants.instances_per_group == 0) {
+    return std::unexpected{"Dispatch packs no instances into a group."};
+  }
+
+  auto const& data{*mesh.data};
+
+  auto const groups_per_meshlet{
+    (constants.instance_count + constants.instances_per_group - 1) / constants.
+    instances_per_group
+  };
+  auto const meshlet_idx{
+    constants.meshlet_offset + group_idx / groups_per_meshlet
+  };
+
+  if (meshlet_idx >= mesh.meshlets.size()) {
+    return std::unexpected{
+      std::format("Group {} reads meshlet {} of {}.", group_idx, meshlet_idx,
+                  mesh.meshlets.size())
+    };
+  }
+
+  auto const& meshlet{mesh.meshlets[meshlet_idx]};
+
+  auto const start_instance{
+    group_idx % groups_per_meshlet * constants.instances_per_group
+  };
+  auto const instance_count{
+    std::min(constants.instance_count - start_instance,
+             constants.instances_per_group)
+  };
+
+  auto const vert_count{meshlet.vert_count * instance_count};
+  auto const prim_count{meshlet.prim_count * instance_count};
+
+  if (vert_count > MESHLET_MAX_VERTS || prim_count > MESHLET_MAX_PRIMS) {
+    return std::unexpected{
+      std::format("Group {} outputs {} vertices and {} primitives.", group_idx,
+                  vert_count, prim_count)
+    };
+  }
+
+  output.vertices.resize(vert_count);
+  output.triangles.resize(prim_count);
+
+  // Each iteration is a thread of the group.
+  for (std::uint32_t gtid{0}; gtid < vert_count; gtid++) {
+    auto const read_index{gtid % meshlet.vert_count};
+    auto const instance_id{gtid / meshlet.vert_count};
+
+    auto const vertex_index_offset{
+      (static_cast<std::size_t>(meshlet.vert_offset) + read_index) * sizeof(
+        std::uint32_t)
+    };
+
+    if (vertex_index_offset + sizeof(std::uint32_t) > data.vertex_indices.
+      size()) {
+      return std::unexpected{
+        std::format("Group {} reads vertex index {} out of bounds.", group_idx,
+                    vertex_index_offset / sizeof(std::uint32_t))
+      };
+    }
+
+    std::uint32_t vertex_index;
+    std::memcpy(&vertex_index, data.vertex_indices.data() + vertex_index_offset,
+                sizeof(vertex_index));
+
+    auto const instance_index{
+      constants.instance_offset + start_instance + instance_id
+    };
+
+    if (vertex_index >= data.positions.size() || vertex_index >= data.normals.
+      size() || instance_index >= data.instances.size()) {
+      return std::unexpected{
+        std::format("Group {} reads vertex {} of instance {} out of bounds.",
+                    group_idx, vertex_index, instance_index)
+      };
+    }
+
+    output.vertices[gtid] = CalculateVertex(data.positions[vertex_index],
+                                            data.normals[vertex_index],
+                                            data.instances[instance_index].
+                                            model_mtx, view_proj_mtx);
+  }
+
+  for (std::uint32_t primitive_id{0}; primitive_id < prim_count;
+       primitive_id++) {
+    auto const read_index{primitive_id % meshlet.prim_count};
+    auto const instance_id{primitive_id / meshlet.prim_count};
+    auto const prim_index{
+      static_cast<std::size_t>(meshlet.prim_offset) + read_index
+    };
+
+    if (prim_index >= data.triangle_indices.size()) {
+      return std::unexpected{
+        std::format("Group {} reads primitive {} out of bounds.", group_idx,
+                    prim_index)
+      };
+    }
+
+    auto const& packed{data.triangle_indices[prim_index]};
+    auto const base{meshlet.vert_count * instance_id};
+    std::array<std::uint32_t, 3> const tri{
+      packed.idx0 + base, packed.idx1 + base, packed.idx2 + base
+    };
+
+    if (std::ranges::any_of(tri, [vert_count](std::uint32_t const idx) {
+      return idx >= vert_count;
+    })) {
+      return std::unexpected{
+        std::format("Group {} primitive {} references a missing vertex.",
+                    group_idx, primitive_id)
+      };
+    }
+
+    output.triangles[primitive_id] = tri;
+  }
+
+  return {};
+}
+}
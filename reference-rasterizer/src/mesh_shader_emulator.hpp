@@ -0,0 +1,48 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <expected>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "dispatch_planner.hpp"
+#include "indirect_draw.hpp"
+#include "scene_data.hpp"
+
+namespace pensieve {
+// The vertex attributes the reference renders.
+struct EmulatedVertex {
+  Float4 position_cs;
+  Float3 normal_ws;
+};
+
+// What a mesh shader group outputs. Triangles index the group's vertices.
+struct EmulatedGroupOutput {
+  std::vector<EmulatedVertex> vertices;
+  std::vector<std::array<std::uint32_t, 3>> triangles;
+};
+
+// A mesh with its meshlets sorted and planned the way CreateGpuScene does it.
+struct EmulatedMesh {
+  MeshData const* data;
+  std::vector<MeshletData> meshlets;
+  std::vector<MeshletDispatchChunk> dispatch_chunks;
+};
+
+[[nodiscard]] auto PrepareEmulatedMesh(MeshData const& mesh) -> EmulatedMesh;
+
+// Builds the indirect commands drawing every instance of the mesh, as if all
+// of them passed culling.
+[[nodiscard]] auto BuildEmulatedDrawCommands(
+  EmulatedMesh const& mesh) -> std::vector<IndirectDrawCommand>;
+
+// Port of main in mesh_shader.hlsl for one group of an indirect command.
+// Every instance is visible, so the visible instance list is the identity.
+// Fails if the group reads out of bounds or exceeds the output limits.
+[[nodiscard]] auto EmulateMeshShaderGroup(
+  EmulatedMesh const& mesh, IndirectDrawConstants const& constants,
+  std::uint32_t group_idx, std::span<float const, 16> view_proj_mtx,
+  EmulatedGroupOutput& output) -> std::expected<void, std::string>;
+}
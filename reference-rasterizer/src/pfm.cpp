@@ -0,0 +1,87 @@
+#include "pfm.hpp"
+
+#include <bit>
+#include <cstddef>
+#include <format>
+#include <fstream>
+
+namespace pensieve {
+static_assert(std::endian::native == std::endian::little);
+
+auto WritePfm(std::filesystem::path const& path,
+              PfmImage const& img) -> std::expected<void, std::string> {
+  std::ofstream out{path, std::ios::binary | std::ios::out | std::ios::trunc};
+
+  if (!out.is_open()) {
+    return std::unexpected{
+      std::format("Failed to open {} for writing.", path.string())
+    };
+  }
+
+  // A negative scale marks little endian data. Rows go bottom to top.
+  out << (img.channel_count == 3 ? "PF" : "Pf") << '\n' << img.width << ' ' <<
+    img.height << "\n-1.0\n";
+
+  auto const row_size{static_cast<std::size_t>(img.width) * img.channel_count};
+
+  for (auto y{img.height - 1}; y >= 0; y--) {
+    out.write(reinterpret_cast<char const*>(img.pixels.data() + y * row_size),
+              static_cast<std::streamsize>(row_size * sizeof(float)));
+  }
+
+  if (!out) {
+    return std::unexpected{std::format("Failed to write {}.", path.string())};
+  }
+
+  return {};
+}
+
+auto ReadPfm(
+  std::filesystem::path const& path) -> std::expected<PfmImage, std::string> {
+  std::ifstream in{path, std::ios::binary | std::ios::in};
+
+  if (!in.is_open()) {
+    return std::unexpected{
+      std::format("Failed to open {} for reading.", path.string())
+    };
+  }
+
+  std::string magic;
+  PfmImage img{0, 0, 0, {}};
+  float scale;
+  in >> magic >> img.width >> img.height >> scale;
+
+  // A single whitespace character separates the header from the data.
+  in.get();
+
+  if (!in || (magic != "PF" && magic != "Pf") || img.width <= 0 || img.height
+    <= 0) {
+    return std::unexpected{
+      std::format("{} is not a valid PFM file.", path.string())
+    };
+  }
+
+  if (scale >= 0) {
+    return std::unexpected{
+      std::format("{} stores big endian data.", path.string())
+    };
+  }
+
+  img.channel_count = magic == "PF" ? 3 : 1;
+  auto const row_size{static_cast<std::size_t>(img.width) * img.channel_count};
+  img.pixels.resize(row_size * img.height);
+
+  for (auto y{img.height - 1}; y >= 0; y--) {
+    in.read(reinterpret_cast<char*>(img.pixels.data() + y * row_size),
+            static_cast<std::streamsize>(row_size * sizeof(float)));
+  }
+
+  if (!in) {
+    return std::unexpected{
+      std::format("{} is truncated.", path.string())
+    };
+  }
+
+  return img;
+}
+}
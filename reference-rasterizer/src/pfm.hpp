@@ -0,0 +1,25 @@
+#pragma once
+
+#include <expected>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace pensieve {
+// Portable float map with 1 or 3 channels. Pixels are interleaved and rows
+// are stored top to bottom.
+struct PfmImage {
+  int width;
+  int height;
+  int channel_count;
+  std::vector<float> pixels;
+};
+
+[[nodiscard]] auto WritePfm(std::filesystem::path const& path,
+                            PfmImage const& img) -> std::expected<
+  void, std::string>;
+
+[[nodiscard]] auto ReadPfm(
+  std::filesystem::path const& path) -> std::expected<PfmImage, std::string>;
+}
@@ -0,0 +1,482 @@
+#include "software_rasterizer.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#include "util.hpp"
+
+namespace pensieve {
+namespace {
+// Edge function a * x + b * y + c that is positive inside the triangle. Shared
+// edges are always set up from the same end, so the two triangles evaluate
+// them to exactly opposite values and the fill rule gives each pixel on them
+// to exactly one of the triangles.
+struct Edge {
+  float a;
+  float b;
+  float c;
+  bool is_top_left;
+};
+
+[[nodiscard]] auto MakeEdge(Float3 const& p0, Float3 const& p1) -> Edge {
+  auto const is_swapped{
+    p1[0] < p0[0] || (p1[0] == p0[0] && p1[1] < p0[1])
+  };
+  auto const& from{is_swapped ? p1 : p0};
+  auto const& to{is_swapped ? p0 : p1};
+
+  auto a{from[1] - to[1]};
+  auto b{to[0] - from[0]};
+  auto c{-(a * from[0] + b * from[1])};
+
+  if (is_swapped) {
+    a = -a;
+    b = -b;
+    c = -c;
+  }
+
+  // Y points down, so the inside is below top edges and right of left edges.
+  return Edge{a, b, c, a > 0 || (a == 0 && b > 0)};
+}
+
+// An attribute interpolated linearly in screen space.
+struct AttributePlane {
+  float dx;
+  float dy;
+  float c;
+};
+
+[[nodiscard]] auto MakeAttributePlane(std::array<Edge, 3> const& edges,
+                                      float const area,
+                                      std::array<float, 3> const& values) ->
+  AttributePlane {
+  AttributePlane ret{0, 0, 0};
+
+  for (auto i{0}; i < 3; i++) {
+    ret.dx += edges[i].a * values[i];
+    ret.dy += edges[i].b * values[i];
+    ret.c += edges[i].c * values[i];
+  }
+
+  ret.dx /= area;
+  ret.dy /= area;
+  ret.c /= area;
+  return ret;
+}
+
+// Polygon left of clipping a triangle against two planes.
+struct ClipPolygon {
+  std::array<EmulatedVertex, 5> vertices;
+  int vertex_count;
+};
+
+[[nodiscard]] auto Lerp(EmulatedVertex const& from, EmulatedVertex const& to,
+                        float const t) -> EmulatedVertex {
+  EmulatedVertex ret;
+
+  for (auto i{0}; i < 4; i++) {
+    ret.position_cs[i] = from.position_cs[i] + (to.position_cs[i] - from.
+      position_cs[i]) * t;
+  }
+
+  for (auto i{0}; i < 3; i++) {
+    ret.normal_ws[i] = from.normal_ws[i] + (to.normal_ws[i] - from.normal_ws[i])
+                       * t;
+  }
+
+  return ret;
+}
+
+// Keeps the part of the polygon where the distance is not negative.
+template <typename DistanceFn>
+[[nodiscard]] auto ClipAgainstPlane(ClipPolygon const& polygon,
+                                    DistanceFn const& distance) ->
+  ClipPolygon {
+  ClipPolygon ret{{}, 0};
+
+  for (auto i{0}; i < polygon.vertex_count; i++) {
+    auto const& from{polygon.vertices[i]};
+    auto const& to{polygon.vertices[(i + 1) % polygon.vertex_count]};
+    auto const from_dist{distance(from)};
+    auto const to_dist{distance(to)};
+
+    if (from_dist >= 0) {
+      ret.vertices[ret.vertex_count++] = from;
+    }
+
+    if ((from_dist >= 0) != (to_dist >= 0)) {
+      ret.vertices[ret.vertex_count++] = Lerp(
+        from, to, from_dist / (from_dist - to_dist));
+    }
+  }
+
+  return ret;
+}
+
+struct ProjectedVertex {
+  Float3 position;
+  float inv_w;
+  Float3 normal_over_w;
+};
+
+[[nodiscard]] auto Project(EmulatedVertex const& vert, int const width,
+                           int const height) -> ProjectedVertex {
+  auto const inv_w{1.0f / vert.position_cs[3]};
+  return ProjectedVertex{
+    Float3{
+      (vert.position_cs[0] * inv_w * 0.5f + 0.5f) * static_cast<float>(width),
+      (0.5f - vert.position_cs[1] * inv_w * 0.5f) * static_cast<float>(height),
+      vert.position_cs[2] * inv_w
+    },
+    inv_w,
+    Float3{
+      vert.normal_ws[0] * inv_w, vert.normal_ws[1] * inv_w,
+      vert.normal_ws[2] * inv_w
+    }
+  };
+}
+}
+
+SoftwareRasterizer::SoftwareRasterizer(int const width, int const height) :
+  width_{width}, height_{height},
+  tile_count_x_{
+    static_cast<int>(DivRoundUp(static_cast<unsigned>(width),
+                                static_cast<unsigned>(tile_size_)))
+  },
+  tile_count_y_{
+    static_cast<int>(DivRoundUp(static_cast<unsigned>(height),
+                                static_cast<unsigned>(tile_size_)))
+  },
+  depth_(static_cast<std::size_t>(width) * height, 0.0f) {
+  for (auto& channel : normal_) {
+    channel.resize(depth_.size(), 0.0f);
+  }
+}
+
+auto SoftwareRasterizer::Clear() -> void {
+  std::ranges::fill(depth_, 0.0f);
+
+  for (auto& channel : normal_) {
+    std::ranges::fill(channel, 0.0f);
+  }
+}
+
+auto SoftwareRasterizer::SetupTriangles(
+  std::span<EmulatedVertex const> const vertices,
+  std::span<std::array<std::uint32_t, 3> const> const triangles,
+  std::vector<ScreenTriangle>& screen_triangles) const -> TriangleSetupStats {
+  TriangleSetupStats stats{triangles.size(), 0, 0, 0};
+
+  for (auto const& tri : triangles) {
+    ClipPolygon polygon{{}, 3};
+
+    for (auto i{0}; i < 3; i++) {
+      polygon.vertices[i] = vertices[tri[i]];
+    }
+
+    // Depth is reversed, so the near plane is at z = w and the far one at 0.
+    polygon = ClipAgainstPlane(polygon, [](EmulatedVertex const& vert) {
+      return vert.position_cs[3] - vert.position_cs[2];
+    });
+    polygon = ClipAgainstPlane(polygon, [](EmulatedVertex const& vert) {
+      return vert.position_cs[2];
+    });
+
+    if (polygon.vertex_count < 3) {
+      ++stats.clipped_triangle_count;
+      continue;
+    }
+
+    std::array<ProjectedVertex, 5> projected;
+
+    for (auto i{0}; i < polygon.vertex_count; i++) {
+      projected[i] = Project(polygon.vertices[i], width_, height_);
+    }
+
+    auto is_any_visible{false};
+
+    for (auto i{1}; i + 1 < polygon.vertex_count; i++) {
+      auto const& v0{projected[0]};
+      auto const& v1{projected[i]};
+      auto const& v2{projected[i + 1]};
+
+      // Clockwise triangles have a positive area with y pointing down.
+      auto const area{
+        (v1.position[0] - v0.position[0]) * (v2.position[1] - v0.position[1]) -
+        (v1.position[1] - v0.position[1]) * (v2.position[0] - v0.position[0])
+      };
+
+      if (!(area > 0)) {
+        continue;
+      }
+
+      std::array const bounds{
+        std::clamp(static_cast<int>(std::floor(std::min({
+                     v0.position[0], v1.position[0], v2.position[0]
+                   }))), 0, width_),
+        std::clamp(static_cast<int>(std::floor(std::min({
+                     v0.position[1], v1.position[1], v2.position[1]
+                   }))), 0, height_),
+        std::clamp(static_cast<int>(std::ceil(std::max({
+                     v0.position[0], v1.position[0], v2.position[0]
+                   }))), 0, width_),
+        std::clamp(static_cast<int>(std::ceil(std::max({
+                     v0.position[1], v1.position[1], v2.position[1]
+                   }))), 0, height_)
+      };
+
+      if (bounds[0] >= bounds[2] || bounds[1] >= bounds[3]) {
+        continue;
+      }
+
+      screen_triangles.emplace_back(
+        std::array{v0.position, v1.position, v2.position},
+        std::array{v0.inv_w, v1.inv_w, v2.inv_w},
+        std::array{v0.normal_over_w, v1.normal_over_w, v2.normal_over_w},
+        bounds);
+      ++stats.screen_triangle_count;
+      is_any_visible = true;
+    }
+
+    if (!is_any_visible) {
+      ++stats.culled_triangle_count;
+    }
+  }
+
+  return stats;
+}
+
+auto SoftwareRasterizer::Rasterize(JobSystem& job_system,
+                                   std::span<ScreenTriangle const> const
+                                   triangles) -> std::uint64_t {
+  // Binning is serial so that every tile sees its triangles in submission
+  // order.
+  std::vector<std::vector<std::uint32_t>> bins(
+    static_cast<std::size_t>(tile_count_x_) * tile_count_y_);
+
+  for (std::uint32_t i{0}; i < triangles.size(); i++) {
+    auto const& bounds{triangles[i].bounds};
+
+    for (auto ty{bounds[1] / tile_size_}; ty <= (bounds[3] - 1) / tile_size_;
+         ty++) {
+      for (auto tx{bounds[0] / tile_size_}; tx <= (bounds[2] - 1) / tile_size_;
+           tx++) {
+        bins[ty * tile_count_x_ + tx].emplace_back(i);
+      }
+    }
+  }
+
+  std::vector<std::uint64_t> tile_pixel_counts(bins.size());
+
+  job_system.ParallelFor(bins.size(), 1,
+                         [this, triangles, &bins, &tile_pixel_counts](
+                         std::size_t const begin, std::size_t const end) {
+                           for (auto i{begin}; i < end; i++) {
+                             auto const tile_idx{static_cast<int>(i)};
+                             tile_pixel_counts[i] = RasterizeTile(
+                               tile_idx % tile_count_x_,
+                               tile_idx / tile_count_x_, triangles, bins[i]);
+                           }
+                         });
+
+  std::uint64_t ret{0};
+
+  for (auto const count : tile_pixel_counts) {
+    ret += count;
+  }
+
+  return ret;
+}
+
+auto SoftwareRasterizer::GetWidth() const -> int {
+  return width_;
+}
+
+auto SoftwareRasterizer::GetHeight() const -> int {
+  return height_;
+}
+
+auto SoftwareRasterizer::GetDepth() const -> std::span<float const> {
+  return depth_;
+}
+
+auto SoftwareRasterizer::GetNormal(
+  int const channel) const -> std::span<float const> {
+  return normal_[channel];
+}
+
+auto SoftwareRasterizer::RasterizeTile(
+  int const tile_x, int const tile_y,
+  std::span<ScreenTriangle const> const triangles,
+  std::span<std::uint32_t const> const triangle_indices) -> std::uint64_t {
+  auto const tile_x_end{std::min((tile_x + 1) * tile_size_, width_)};
+  auto const tile_y_end{std::min((tile_y + 1) * tile_size_, height_)};
+  std::uint64_t pixel_count{0};
+
+  for (auto const tri_idx : triangle_indices) {
+    auto const& tri{triangles[tri_idx]};
+    auto const& [v0, v1, v2]{tri.positions};
+
+    // Tiles start at multiples of 8, so aligning down stays within the tile.
+    auto const x_begin{std::max(tri.bounds[0], tile_x * tile_size_) / 8 * 8};
+    auto const x_end{std::min(tri.bounds[2], tile_x_end)};
+    auto const y_begin{std::max(tri.bounds[1], tile_y * tile_size_)};
+    auto const y_end{std::min(tri.bounds[3], tile_y_end)};
+
+    std::array const edges{
+      MakeEdge(v1, v2), MakeEdge(v2, v0), MakeEdge(v0, v1)
+    };
+    auto const area{
+      (v1[0] - v0[0]) * (v2[1] - v0[1]) - (v1[1] - v0[1]) * (v2[0] - v0[0])
+    };
+
+    auto const depth_plane{
+      MakeAttributePlane(edges, area, std::array{v0[2], v1[2], v2[2]})
+    };
+    auto const inv_w_plane{MakeAttributePlane(edges, area, tri.inv_w)};
+    std::array<AttributePlane, 3> normal_planes;
+
+    for (auto i{0}; i < 3; i++) {
+      normal_planes[i] = MakeAttributePlane(edges, area, std::array{
+                                              tri.normals_over_w[0][i],
+                                              tri.normals_over_w[1][i],
+                                              tri.normals_over_w[2][i]
+                                            });
+    }
+
+    for (auto y{y_begin}; y < y_end; y++) {
+      auto const py{static_cast<float>(y) + 0.5f};
+      auto const row_offset{static_cast<std::size_t>(y) * width_};
+      auto* const depth_row{depth_.data() + row_offset};
+      std::array const normal_rows{
+        normal_[0].data() + row_offset, normal_[1].data() + row_offset,
+        normal_[2].data() + row_offset
+      };
+      auto x{x_begin};
+
+#ifdef __AVX2__
+      auto const px_offsets{
+        _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f)
+      };
+      auto const zero{_mm256_setzero_ps()};
+
+      auto const evaluate{
+        [py](AttributePlane const& plane, __m256 const px) {
+          return _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(plane.dx), px),
+                               _mm256_set1_ps(plane.dy * py + plane.c));
+        }
+      };
+
+      for (; x + 8 <= x_end; x += 8) {
+        auto const px{
+          _mm256_add_ps(_mm256_set1_ps(static_cast<float>(x)), px_offsets)
+        };
+
+        auto mask{_mm256_castsi256_ps(_mm256_set1_epi32(-1))};
+
+        for (auto const& edge : edges) {
+          auto const e{
+            evaluate(AttributePlane{edge.a, edge.b, edge.c}, px)
+          };
+          mask = _mm256_and_ps(mask, edge.is_top_left
+                                       ? _mm256_cmp_ps(e, zero, _CMP_GE_OQ)
+                                       : _mm256_cmp_ps(e, zero, _CMP_GT_OQ));
+        }
+
+        if (_mm256_movemask_ps(mask) == 0) {
+          continue;
+        }
+
+        auto const z{evaluate(depth_plane, px)};
+        auto const stored_z{_mm256_loadu_ps(depth_row + x)};
+        mask = _mm256_and_ps(mask, _mm256_cmp_ps(z, stored_z, _CMP_GT_OQ));
+
+        auto const mask_bits{_mm256_movemask_ps(mask)};
+
+        if (mask_bits == 0) {
+          continue;
+        }
+
+        pixel_count += std::popcount(static_cast<unsigned>(mask_bits));
+        _mm256_storeu_ps(depth_row + x, _mm256_blendv_ps(stored_z, z, mask));
+
+        auto const w{_mm256_div_ps(_mm256_set1_ps(1.0f),
+                                   evaluate(inv_w_plane, px))};
+        // Lanes of the normal components, as std::array drops the alignment
+        // attributes of __m256.
+        struct alignas(32) NormalLanes {
+          __m256 v;
+        };
+
+        std::array<NormalLanes, 3> normal;
+        auto len_sq{zero};
+
+        for (auto i{0}; i < 3; i++) {
+          normal[i].v = _mm256_mul_ps(evaluate(normal_planes[i], px), w);
+          len_sq = _mm256_add_ps(len_sq,
+                                 _mm256_mul_ps(normal[i].v, normal[i].v));
+        }
+
+        auto const inv_len{_mm256_div_ps(_mm256_set1_ps(1.0f),
+                                         _mm256_sqrt_ps(len_sq))};
+
+        for (auto i{0}; i < 3; i++) {
+          _mm256_storeu_ps(normal_rows[i] + x,
+                           _mm256_blendv_ps(
+                             _mm256_loadu_ps(normal_rows[i] + x),
+                             _mm256_mul_ps(normal[i].v, inv_len), mask));
+        }
+      }
+#endif
+
+      for (; x < x_end; x++) {
+        auto const px{static_cast<float>(x) + 0.5f};
+        auto is_covered{true};
+
+        for (auto const& edge : edges) {
+          auto const e{edge.a * px + (edge.b * py + edge.c)};
+          is_covered &= edge.is_top_left ? e >= 0 : e > 0;
+        }
+
+        auto const z{
+          depth_plane.dx * px + (depth_plane.dy * py + depth_plane.c)
+        };
+
+        if (!is_covered || !(z > depth_row[x])) {
+          continue;
+        }
+
+        ++pixel_count;
+        depth_row[x] = z;
+
+        auto const w{
+          1.0f / (inv_w_plane.dx * px + (inv_w_plane.dy * py + inv_w_plane.c))
+        };
+        Float3 normal;
+
+        for (auto i{0}; i < 3; i++) {
+          normal[i] = (normal_planes[i].dx * px + (normal_planes[i].dy * py +
+                                                   normal_planes[i].c)) * w;
+        }
+
+        auto const inv_len{
+          1.0f / std::sqrt(
+            normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[
+              2])
+        };
+
+        for (auto i{0}; i < 3; i++) {
+          normal_rows[i][x] = normal[i] * inv_len;
+        }
+      }
+    }
+  }
+
+  return pixel_count;
+}
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "job_system.hpp"
+#include "mesh_shader_emulator.hpp"
+#include "scene_data.hpp"
+
+namespace pensieve {
+// A triangle in pixel space. Normals are divided by w so that they can be
+// interpolated linearly in screen space.
+struct ScreenTriangle {
+  std::array<Float3, 3> positions;
+  std::array<float, 3> inv_w;
+  std::array<Float3, 3> normals_over_w;
+  std::array<int, 4> bounds;
+};
+
+struct TriangleSetupStats {
+  std::uint64_t input_triangle_count;
+  std::uint64_t clipped_triangle_count;
+  std::uint64_t culled_triangle_count;
+  std::uint64_t screen_triangle_count;
+};
+
+// Tile based rasterizer following the D3D12 rules the renderer relies on:
+// clockwise front faces, back face culling, the top left fill rule and
+// reversed depth with a greater depth test. Tiles are rasterized in
+// parallel, each one in submission order, so the result does not depend on
+// the thread count.
+class SoftwareRasterizer {
+public:
+  static auto constexpr tile_size_{64};
+
+  SoftwareRasterizer(int width, int height);
+
+  // Clears depth to 0 and normals to 0.
+  auto Clear() -> void;
+
+  // Clips the triangles against the near and far planes, culls back faces and
+  // off screen triangles and appends the rest. Safe to call concurrently.
+  [[nodiscard]] auto SetupTriangles(
+    std::span<EmulatedVertex const> vertices,
+    std::span<std::array<std::uint32_t, 3> const> triangles,
+    std::vector<ScreenTriangle>& screen_triangles) const -> TriangleSetupStats;
+
+  // Rasterizes the tiles on the job system. Returns the number of pixels that
+  // passed the depth test.
+  auto Rasterize(JobSystem& job_system,
+                 std::span<ScreenTriangle const> triangles) -> std::uint64_t;
+
+  [[nodiscard]] auto GetWidth() const -> int;
+  [[nodiscard]] auto GetHeight() const -> int;
+  // Rows are stored top to bottom.
+  [[nodiscard]] auto GetDepth() const -> std::span<float const>;
+  [[nodiscard]] auto GetNormal(int channel) const -> std::span<float const>;
+
+private:
+  [[nodiscard]] auto RasterizeTile(
+    int tile_x, int tile_y, std::span<ScreenTriangle const> triangles,
+    std::span<std::uint32_t const> triangle_indices) -> std::uint64_t;
+
+  int width_;
+  int height_;
+  int tile_count_x_;
+  int tile_count_y_;
+  std::vector<float> depth_;
+  std::array<std::vector<float>, 3> normal_;
+};
+}
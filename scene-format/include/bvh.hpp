@@ -0,0 +1,181 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <utility>
+
+#include "scene_data.hpp"
+
+namespace pensieve {
+// A point p is inside a plane (a, b, c, d) if a * p.x + b * p.y + c * p.z + d
+// is not negative. The planes are not normalized.
+struct Frustum {
+  std::array<Float4, 6> planes;
+};
+
+enum class FrustumTestResult {
+  kOutside,
+  kIntersecting,
+  kInside,
+};
+
+[[nodiscard]] constexpr auto CalculateAabb(
+  std::span<Float4 const> const positions) -> Aabb {
+  Aabb ret{
+    {
+      std::numeric_limits<float>::max(), std::numeric_limits<float>::max(),
+      std::numeric_limits<float>::max()
+    },
+    {
+      std::numeric_limits<float>::lowest(),
+      std::numeric_limits<float>::lowest(),
+      std::numeric_limits<float>::lowest()
+    }
+  };
+
+  for (auto const& pos : positions) {
+    for (auto i{0}; i < 3; i++) {
+      ret.min[i] = std::min(ret.min[i], pos[i]);
+      ret.max[i] = std::max(ret.max[i], pos[i]);
+    }
+  }
+
+  return ret;
+}
+
+// Returns the bounds of the transformed box, the model matrix is in the
+// layout of InstanceData.
+[[nodiscard]] inline auto TransformAabb(Aabb const& aabb,
+                                        Float3X4 const& model_mtx) -> Aabb {
+  Aabb ret;
+
+  for (auto i{0}; i < 3; i++) {
+    auto center{model_mtx[i * 4 + 3]};
+    auto extent{0.0f};
+
+    for (auto j{0}; j < 3; j++) {
+      center += model_mtx[i * 4 + j] * (aabb.min[j] + aabb.max[j]) * 0.5f;
+      extent += std::abs(model_mtx[i * 4 + j]) * (aabb.max[j] - aabb.min[j]) *
+        0.5f;
+    }
+
+    ret.min[i] = center - extent;
+    ret.max[i] = center + extent;
+  }
+
+  return ret;
+}
+
+// Extracts the clip planes of a row-major row vector view projection matrix
+// with a [0, 1] clip space depth range. Works for reversed depth too.
+[[nodiscard]] constexpr auto ExtractFrustum(
+  std::span<float const, 16> const view_proj_mtx) -> Frustum {
+  auto const column{
+    [view_proj_mtx](int const idx) {
+      return Float4{
+        view_proj_mtx[idx], view_proj_mtx[4 + idx], view_proj_mtx[8 + idx],
+        view_proj_mtx[12 + idx]
+      };
+    }
+  };
+
+  auto const add{
+    [](Float4 const& lhs, Float4 const& rhs, float const sign) {
+      return Float4{
+        lhs[0] + sign * rhs[0], lhs[1] + sign * rhs[1],
+        lhs[2] + sign * rhs[2], lhs[3] + sign * rhs[3]
+      };
+    }
+  };
+
+  auto const x{column(0)};
+  auto const y{column(1)};
+  auto const z{column(2)};
+  auto const w{column(3)};
+
+  return Frustum{
+    {
+      add(w, x, 1), add(w, x, -1), add(w, y, 1), add(w, y, -1), z,
+      add(w, z, -1)
+    }
+  };
+}
+
+[[nodiscard]] constexpr auto TestAabb(Frustum const& frustum,
+                                      Float3 const& aabb_min,
+                                      Float3 const& aabb_max) ->
+  FrustumTestResult {
+  auto ret{FrustumTestResult::kInside};
+
+  for (auto const& [a, b, c, d] : frustum.planes) {
+    // Corners furthest along and against the plane normal.
+    auto const far_dist{
+      a * (a >= 0 ? aabb_max[0] : aabb_min[0]) + b * (b >= 0
+        ? aabb_max[1]
+        : aabb_min[1]) + c * (c >= 0 ? aabb_max[2] : aabb_min[2]) + d
+    };
+
+    if (far_dist < 0) {
+      return FrustumTestResult::kOutside;
+    }
+
+    auto const near_dist{
+      a * (a >= 0 ? aabb_min[0] : aabb_max[0]) + b * (b >= 0
+        ? aabb_min[1]
+        : aabb_max[1]) + c * (c >= 0 ? aabb_min[2] : aabb_max[2]) + d
+    };
+
+    if (near_dist < 0) {
+      ret = FrustumTestResult::kIntersecting;
+    }
+  }
+
+  return ret;
+}
+
+// Invokes the callback with every instance reference of the leaves whose
+// bounds are not fully outside the frustum. The instances of a leaf are not
+// tested on their own, so some of them may be outside. Subtrees fully inside
+// the frustum are not tested any further.
+template<typename Callback>
+auto QueryBvh(BvhData const& bvh, Frustum const& frustum,
+              Callback&& callback) -> void {
+  if (bvh.nodes.empty()) {
+    return;
+  }
+
+  std::array<std::pair<std::uint32_t, bool>, kBvhMaxDepth + 1> stack;
+  std::size_t stack_size{0};
+  stack[stack_size++] = {0, false};
+
+  while (stack_size != 0) {
+    auto const [node_idx, is_inside]{stack[--stack_size]};
+    auto const& node{bvh.nodes[node_idx]};
+    auto is_node_inside{is_inside};
+
+    if (!is_node_inside) {
+      auto const result{TestAabb(frustum, node.aabb_min, node.aabb_max)};
+
+      if (result == FrustumTestResult::kOutside) {
+        continue;
+      }
+
+      is_node_inside = result == FrustumTestResult::kInside;
+    }
+
+    if (node.instance_count != 0) {
+      for (auto i{node.left_or_first}; i < node.left_or_first + node.
+           instance_count; i++) {
+        callback(bvh.instance_refs[i]);
+      }
+    } else {
+      stack[stack_size++] = {node.left_or_first + 1, is_node_inside};
+      stack[stack_size++] = {node.left_or_first, is_node_inside};
+    }
+  }
+}
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <array>
+#include <span>
+
+#include "scene_data.hpp"
+
+namespace pensieve {
+[[nodiscard]] constexpr auto Cross(Float3 const& lhs,
+                                   Float3 const& rhs) -> Float3 {
+  return Float3{
+    lhs[1] * rhs[2] - lhs[2] * rhs[1], lhs[2] * rhs[0] - lhs[0] * rhs[2],
+    lhs[0] * rhs[1] - lhs[1] * rhs[0]
+  };
+}
+
+[[nodiscard]] constexpr auto Dot(Float3 const& lhs,
+                                 Float3 const& rhs) -> float {
+  return lhs[0] * rhs[0] + lhs[1] * rhs[1] + lhs[2] * rhs[2];
+}
+
+// Packs a row-major row vector affine transform into the layout of
+// InstanceData, the transposed upper 4x3 part.
+[[nodiscard]] constexpr auto PackModelMatrix(
+  std::span<float const, 16> const mtx) -> Float3X4 {
+  Float3X4 ret;
+
+  for (auto i{0}; i < 3; i++) {
+    for (auto j{0}; j < 4; j++) {
+      ret[i * 4 + j] = mtx[j * 4 + i];
+    }
+  }
+
+  return ret;
+}
+
+// Same as CalculateNormalMatrix in instance_buffer.hlsli. Returns the rows of
+// the cofactor matrix of the linear part, the inverse transpose scaled by the
+// absolute determinant. Transformed normals must be renormalized.
+[[nodiscard]] constexpr auto CalculateNormalMatrix(
+  Float3X4 const& model_mtx) -> std::array<Float3, 3> {
+  Float3 const r0{model_mtx[0], model_mtx[1], model_mtx[2]};
+  Float3 const r1{model_mtx[4], model_mtx[5], model_mtx[6]};
+  Float3 const r2{model_mtx[8], model_mtx[9], model_mtx[10]};
+  std::array cofactor_mtx{Cross(r1, r2), Cross(r2, r0), Cross(r0, r1)};
+
+  if (Dot(r0, cofactor_mtx[0]) < 0) {
+    for (auto& row : cofactor_mtx) {
+      row = Float3{-row[0], -row[1], -row[2]};
+    }
+  }
+
+  return cofactor_mtx;
+}
+}
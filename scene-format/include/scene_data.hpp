@@ -1,6 +1,8 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
+#include <cstddef>
 #include <cstdint>
 #include <memory>
 #include <optional>
@@ -10,14 +12,106 @@ namespace pensieve {
 using Float2 = std::array<float, 2>;
 using Float3 = std::array<float, 3>;
 using Float4 = std::array<float, 4>;
-using Float4X4 = std::array<float, 16>;
+using Float3X4 = std::array<float, 12>;
 
+enum class TextureFormat : std::uint32_t {
+  kR8G8B8A8Unorm = 0,
+  kBc1Unorm = 1,
+  kBc2Unorm = 2,
+  kBc3Unorm = 3,
+  kBc4Unorm = 4,
+  kBc5Unorm = 5,
+  kBc7Unorm = 6,
+  kR8Unorm = 7,
+  kR8G8Unorm = 8,
+};
+
+auto constexpr kTextureFormatCount{9};
+
+// Mips are stored tightly packed one after the other, starting with the most
+// detailed one.
 struct TextureData {
   std::uint32_t width;
   std::uint32_t height;
+  std::uint32_t mip_count;
+  TextureFormat format;
   std::unique_ptr<std::uint8_t[]> bytes;
 };
 
+struct TextureMipLayout {
+  std::uint32_t row_pitch;
+  std::uint32_t row_count;
+};
+
+[[nodiscard]] constexpr auto IsBlockCompressed(
+  TextureFormat const format) -> bool {
+  switch (format) {
+  case TextureFormat::kBc1Unorm:
+  case TextureFormat::kBc2Unorm:
+  case TextureFormat::kBc3Unorm:
+  case TextureFormat::kBc4Unorm:
+  case TextureFormat::kBc5Unorm:
+  case TextureFormat::kBc7Unorm:
+    return true;
+  default:
+    return false;
+  }
+}
+
+// Bytes per 4x4 block for block compressed formats, bytes per texel otherwise.
+[[nodiscard]] constexpr auto GetTextureFormatElementSize(
+  TextureFormat const format) -> std::uint32_t {
+  switch (format) {
+  case TextureFormat::kBc1Unorm:
+  case TextureFormat::kBc4Unorm:
+    return 8;
+  case TextureFormat::kBc2Unorm:
+  case TextureFormat::kBc3Unorm:
+  case TextureFormat::kBc5Unorm:
+  case TextureFormat::kBc7Unorm:
+    return 16;
+  case TextureFormat::kR8Unorm:
+    return 1;
+  case TextureFormat::kR8G8Unorm:
+    return 2;
+  default:
+    return 4;
+  }
+}
+
+[[nodiscard]] constexpr auto GetTextureMipLayout(TextureFormat const format,
+                                                 std::uint32_t const width,
+                                                 std::uint32_t const height,
+                                                 std::uint32_t const mip) ->
+  TextureMipLayout {
+  auto const mip_width{std::max(width >> mip, 1u)};
+  auto const mip_height{std::max(height >> mip, 1u)};
+
+  if (IsBlockCompressed(format)) {
+    return {
+      (mip_width + 3) / 4 * GetTextureFormatElementSize(format),
+      (mip_height + 3) / 4
+    };
+  }
+
+  return {mip_width * GetTextureFormatElementSize(format), mip_height};
+}
+
+[[nodiscard]] constexpr auto CalculateTextureByteCount(
+  TextureFormat const format, std::uint32_t const width,
+  std::uint32_t const height, std::uint32_t const mip_count) -> std::size_t {
+  std::size_t byte_count{0};
+
+  for (std::uint32_t mip{0}; mip < mip_count; mip++) {
+    auto const [row_pitch, row_count]{
+      GetTextureMipLayout(format, width, height, mip)
+    };
+    byte_count += static_cast<std::size_t>(row_pitch) * row_count;
+  }
+
+  return byte_count;
+}
+
 struct MaterialData {
   Float3 base_color;
   float metallic;
@@ -28,6 +122,9 @@ struct MaterialData {
   std::optional<std::uint32_t> roughness_map_idx;
   std::optional<std::uint32_t> emission_map_idx;
   std::optional<std::uint32_t> normal_map_idx;
+  // Texture channels the metallic and roughness factors are read from.
+  std::uint32_t metallic_map_channel;
+  std::uint32_t roughness_map_channel;
 };
 
 struct MeshletData {
@@ -43,6 +140,13 @@ struct MeshletTriangleIndexData {
   std::uint32_t idx2 : 10;
 };
 
+// Affine transforms are stored as the transposed upper 4x3 part of the row
+// vector matrices so they can be uploaded as is. The normal matrix is rebuilt
+// from the model matrix when rendering.
+struct InstanceData {
+  Float3X4 model_mtx;
+};
+
 struct MeshData {
   std::vector<Float4> positions;
   std::vector<Float4> normals;
@@ -52,17 +156,44 @@ struct MeshData {
   std::vector<std::uint8_t> vertex_indices;
   std::vector<MeshletTriangleIndexData> triangle_indices;
   std::uint32_t material_idx;
+  std::vector<InstanceData> instances;
+};
+
+struct Aabb {
+  Float3 min;
+  Float3 max;
+};
+
+auto constexpr kBvhMaxDepth{64};
+
+// Two nodes share a cache line. Internal nodes have no instances and store
+// the index of their left child, the right child directly follows it. Leaves
+// store the offset of their instance references.
+struct alignas(32) BvhNode {
+  Float3 aabb_min;
+  std::uint32_t left_or_first;
+  Float3 aabb_max;
+  std::uint32_t instance_count;
+};
+
+static_assert(sizeof(BvhNode) == 32);
+
+struct BvhInstanceRef {
+  std::uint32_t mesh_idx;
+  std::uint32_t instance_idx;
 };
 
-struct NodeData {
-  std::vector<std::uint32_t> mesh_indices;
-  Float4X4 transform;
+// Built over the world space bounds of every instance of every mesh. The
+// root is the first node, and no path from it is longer than kBvhMaxDepth.
+struct BvhData {
+  std::vector<BvhNode> nodes;
+  std::vector<BvhInstanceRef> instance_refs;
 };
 
 struct SceneData {
   std::vector<TextureData> textures;
   std::vector<MaterialData> materials;
   std::vector<MeshData> meshes;
-  std::vector<NodeData> nodes;
+  BvhData bvh;
 };
 }
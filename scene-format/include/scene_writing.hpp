@@ -0,0 +1,11 @@
+#pragma once
+
+#include <fstream>
+
+#include "scene_data.hpp"
+
+namespace pensieve {
+// Writes the scene in the format LoadScene reads. The stream must be opened
+// in binary mode.
+auto WriteScene(std::ofstream& out, SceneData const& scene) -> void;
+}
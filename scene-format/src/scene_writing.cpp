@@ -0,0 +1,165 @@
+#include "scene_writing.hpp"
+
+#include <bit>
+#include <span>
+
+#include "profiler.hpp"
+
+namespace pensieve {
+auto WriteScene(std::ofstream& out, SceneData const& scene) -> void {
+  PENSIEVE_PROFILE_ZONE("WriteScene");
+
+  std::span constexpr header{"pensieve"};
+  out.write(header.data(), header.size());
+
+  auto const texture_count{scene.textures.size()};
+  out.write(std::bit_cast<char const*>(&texture_count), sizeof(texture_count));
+
+  for (auto const& tex : scene.textures) {
+    out.write(std::bit_cast<char const*>(&tex.width), sizeof(tex.width));
+    out.write(std::bit_cast<char const*>(&tex.height), sizeof(tex.height));
+    out.write(std::bit_cast<char const*>(&tex.mip_count),
+              sizeof(tex.mip_count));
+    out.write(std::bit_cast<char const*>(&tex.format), sizeof(tex.format));
+    out.write(std::bit_cast<char const*>(tex.bytes.get()),
+              static_cast<std::streamsize>(CalculateTextureByteCount(
+                tex.format, tex.width, tex.height, tex.mip_count)));
+  }
+
+  auto const material_count{scene.materials.size()};
+  out.write(std::bit_cast<char const*>(&material_count),
+            sizeof(material_count));
+
+  for (auto const& mtl : scene.materials) {
+    out.write(std::bit_cast<char const*>(&mtl.base_color),
+              sizeof(mtl.base_color));
+    out.write(std::bit_cast<char const*>(&mtl.metallic), sizeof(mtl.metallic));
+    out.write(std::bit_cast<char const*>(&mtl.roughness),
+              sizeof(mtl.roughness));
+    out.write(std::bit_cast<char const*>(&mtl.emission_color),
+              sizeof(mtl.emission_color));
+
+    int const has_base_color_map{mtl.base_color_map_idx.has_value()};
+    out.write(std::bit_cast<char const*>(&has_base_color_map),
+              sizeof(has_base_color_map));
+
+    if (has_base_color_map) {
+      out.write(std::bit_cast<char const*>(&*mtl.base_color_map_idx),
+                sizeof(*mtl.base_color_map_idx));
+    }
+
+    int const has_metallic_map{mtl.metallic_map_idx.has_value()};
+    out.write(std::bit_cast<char const*>(&has_metallic_map),
+              sizeof(has_metallic_map));
+
+    if (has_metallic_map) {
+      out.write(std::bit_cast<char const*>(&*mtl.metallic_map_idx),
+                sizeof(*mtl.metallic_map_idx));
+    }
+
+    int const has_roughness_map{mtl.roughness_map_idx.has_value()};
+    out.write(std::bit_cast<char const*>(&has_roughness_map),
+              sizeof(has_roughness_map));
+
+    if (has_roughness_map) {
+      out.write(std::bit_cast<char const*>(&*mtl.roughness_map_idx),
+                sizeof(*mtl.roughness_map_idx));
+    }
+
+    int const has_emission_map{mtl.emission_map_idx.has_value()};
+    out.write(std::bit_cast<char const*>(&has_emission_map),
+              sizeof(has_emission_map));
+
+    if (has_emission_map) {
+      out.write(std::bit_cast<char const*>(&*mtl.emission_map_idx),
+                sizeof(*mtl.emission_map_idx));
+    }
+
+    int const has_normal_map{mtl.normal_map_idx.has_value()};
+    out.write(std::bit_cast<char const*>(&has_normal_map),
+              sizeof(has_normal_map));
+
+    if (has_normal_map) {
+      out.write(std::bit_cast<char const*>(&*mtl.normal_map_idx),
+                sizeof(*mtl.normal_map_idx));
+    }
+
+    out.write(std::bit_cast<char const*>(&mtl.metallic_map_channel),
+              sizeof(mtl.metallic_map_channel));
+    out.write(std::bit_cast<char const*>(&mtl.roughness_map_channel),
+              sizeof(mtl.roughness_map_channel));
+  }
+
+  auto const mesh_count{scene.meshes.size()};
+  out.write(std::bit_cast<char const*>(&mesh_count), sizeof(mesh_count));
+
+  for (auto const& mesh : scene.meshes) {
+    auto const vertex_count{mesh.positions.size()};
+    out.write(std::bit_cast<char const*>(&vertex_count), sizeof(vertex_count));
+    out.write(std::bit_cast<char const*>(mesh.positions.data()),
+              vertex_count * sizeof(decltype(mesh.positions)::value_type));
+    out.write(std::bit_cast<char const*>(mesh.normals.data()),
+              vertex_count * sizeof(decltype(mesh.normals)::value_type));
+
+    int const has_tangents{mesh.tangents.has_value()};
+    out.write(std::bit_cast<char const*>(&has_tangents), sizeof(has_tangents));
+
+    if (has_tangents) {
+      out.write(std::bit_cast<char const*>(mesh.tangents->data()),
+                vertex_count * sizeof(decltype(mesh.tangents
+                )::value_type::value_type));
+    }
+
+    int const has_uvs{mesh.uvs.has_value()};
+    out.write(std::bit_cast<char const*>(&has_uvs), sizeof(has_uvs));
+
+    if (has_uvs) {
+      out.write(std::bit_cast<char const*>(mesh.uvs->data()),
+                vertex_count * sizeof(decltype(mesh.uvs
+                )::value_type::value_type));
+    }
+
+    auto const meshlet_count{mesh.meshlets.size()};
+    out.write(std::bit_cast<char const*>(&meshlet_count),
+              sizeof(meshlet_count));
+    out.write(std::bit_cast<char const*>(mesh.meshlets.data()),
+              meshlet_count * sizeof(decltype(mesh.meshlets)::value_type));
+
+    auto const vertex_index_count{mesh.vertex_indices.size()};
+    out.write(std::bit_cast<char const*>(&vertex_index_count),
+              sizeof(vertex_index_count));
+    out.write(std::bit_cast<char const*>(mesh.vertex_indices.data()),
+              vertex_index_count * sizeof(decltype(mesh.vertex_indices
+              )::value_type));
+
+    auto const triangle_index_count{mesh.triangle_indices.size()};
+    out.write(std::bit_cast<char const*>(&triangle_index_count),
+              sizeof(triangle_index_count));
+    out.write(std::bit_cast<char const*>(mesh.triangle_indices.data()),
+              triangle_index_count * sizeof(decltype(mesh.triangle_indices
+              )::value_type));
+
+    out.write(std::bit_cast<char const*>(&mesh.material_idx),
+              sizeof(mesh.material_idx));
+
+    auto const instance_count{mesh.instances.size()};
+    out.write(std::bit_cast<char const*>(&instance_count),
+              sizeof(instance_count));
+    out.write(std::bit_cast<char const*>(mesh.instances.data()),
+              instance_count * sizeof(decltype(mesh.instances)::value_type));
+  }
+
+  auto const bvh_node_count{scene.bvh.nodes.size()};
+  out.write(std::bit_cast<char const*>(&bvh_node_count),
+            sizeof(bvh_node_count));
+  out.write(std::bit_cast<char const*>(scene.bvh.nodes.data()),
+            bvh_node_count * sizeof(decltype(scene.bvh.nodes)::value_type));
+
+  auto const bvh_instance_ref_count{scene.bvh.instance_refs.size()};
+  out.write(std::bit_cast<char const*>(&bvh_instance_ref_count),
+            sizeof(bvh_instance_ref_count));
+  out.write(std::bit_cast<char const*>(scene.bvh.instance_refs.data()),
+            bvh_instance_ref_count * sizeof(decltype(scene.bvh.instance_refs
+            )::value_type));
+}
+}
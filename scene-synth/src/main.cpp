@@ -0,0 +1,229 @@
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <expected>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+
+#include "job_system.hpp"
+#include "profiler.hpp"
+#include "scene_data.hpp"
+#include "scene_synthesis.hpp"
+#include "scene_writing.hpp"
+
+namespace pensieve {
+namespace {
+struct Preset {
+  std::string_view name;
+  SceneSynthesisParams params;
+};
+
+// Scenes that stress one part of the pipeline each. Every count can be
+// overridden on the command line.
+auto constexpr kPresets{
+  std::array{
+    // Instancing, culling and the BVH, like the cubes screenshot.
+    Preset{"cubes", {1, 1'000'000, 1, 0.0f, false, 1, 0, 0, 1}},
+    // Per mesh overhead of loading, uploading and drawing.
+    Preset{"unique-meshes", {4096, 4096, 8, 0.0f, true, 64, 0, 0, 1}},
+    // Vertex and meshlet throughput of a single draw.
+    Preset{"huge-mesh", {1, 1, 512, 1.0f, false, 1, 0, 0, 1}},
+    // Texture decoding, upload and descriptor counts.
+    Preset{"materials", {1024, 16384, 4, 0.5f, true, 1024, 1024, 256, 1}},
+  }
+};
+
+struct Options {
+  SceneSynthesisParams params;
+  std::filesystem::path output_path;
+  std::optional<std::filesystem::path> profile_path;
+};
+
+template<typename T>
+[[nodiscard]] auto ParseNumber(std::string_view const arg,
+                               std::string_view const value) ->
+  std::expected<T, std::string> {
+  T ret;
+
+  if (auto const [ptr, ec]{
+    std::from_chars(value.data(), value.data() + value.size(), ret)
+  }; ec != std::errc{} || ptr != value.data() + value.size()) {
+    return std::unexpected{std::format("Invalid value {} for {}.", value, arg)};
+  }
+
+  return ret;
+}
+
+[[nodiscard]] auto ParseOptions(
+  std::span<char* const> const args) -> std::expected<Options, std::string> {
+  std::string_view const preset_name{args[1]};
+  auto const preset{
+    std::ranges::find(kPresets, preset_name, &Preset::name)
+  };
+
+  if (preset == kPresets.end()) {
+    return std::unexpected{std::format("Unknown preset {}.", preset_name)};
+  }
+
+  Options opts{preset->params, args[2], std::nullopt};
+
+  for (std::size_t i{3}; i < args.size(); i++) {
+    std::string_view const arg{args[i]};
+
+    if (i + 1 >= args.size()) {
+      return std::unexpected{std::format("Missing value for {}.", arg)};
+    }
+
+    std::string_view const value{args[++i]};
+
+    if (arg == "--profile") {
+      opts.profile_path = value;
+      continue;
+    }
+
+    if (arg == "--roundness") {
+      auto const roundness{ParseNumber<float>(arg, value)};
+
+      if (!roundness) {
+        return std::unexpected{roundness.error()};
+      }
+
+      opts.params.mesh_roundness = *roundness;
+      continue;
+    }
+
+    if (arg == "--seed") {
+      auto const seed{ParseNumber<std::uint64_t>(arg, value)};
+
+      if (!seed) {
+        return std::unexpected{seed.error()};
+      }
+
+      opts.params.seed = *seed;
+      continue;
+    }
+
+    std::array const count_options{
+      std::pair{"--meshes", &SceneSynthesisParams::mesh_count},
+      std::pair{"--instances", &SceneSynthesisParams::instance_count},
+      std::pair{"--resolution", &SceneSynthesisParams::mesh_resolution},
+      std::pair{"--materials", &SceneSynthesisParams::material_count},
+      std::pair{"--textures", &SceneSynthesisParams::texture_count},
+      std::pair{"--texture-size", &SceneSynthesisParams::texture_size},
+    };
+
+    auto const count_option{
+      std::ranges::find_if(count_options, [arg](auto const& option) {
+        return arg == option.first;
+      })
+    };
+
+    if (count_option == count_options.end()) {
+      return std::unexpected{std::format("Unknown option {}.", arg)};
+    }
+
+    auto const count{ParseNumber<std::uint32_t>(arg, value)};
+
+    if (!count) {
+      return std::unexpected{count.error()};
+    }
+
+    opts.params.*count_option->second = *count;
+  }
+
+  return opts;
+}
+}
+}
+
+auto main(int const argc, char** const argv) -> int {
+  if (argc < 3) {
+    std::cout << "Usage: scene-synth <preset> <destination-file> "
+      "[--meshes N] [--instances N] [--resolution N] [--roundness R] "
+      "[--materials N] [--textures N] [--texture-size N] [--seed N] "
+      "[--profile <trace-file>]\n"
+      "Presets: cubes, unique-meshes, huge-mesh, materials\n";
+    return EXIT_SUCCESS;
+  }
+
+  auto const opts{pensieve::ParseOptions(std::span{argv, argv + argc})};
+
+  if (!opts) {
+    std::cerr << "Error: " << opts.error() << '\n';
+    return EXIT_FAILURE;
+  }
+
+  pensieve::SetProfilerThreadName("Main thread");
+
+  auto const synthesis_start{std::chrono::steady_clock::now()};
+
+  pensieve::JobSystem job_system;
+  auto const scene{pensieve::SynthesizeScene(opts->params, job_system)};
+
+  if (!scene) {
+    std::cerr << "Error: " << scene.error() << '\n';
+    return EXIT_FAILURE;
+  }
+
+  std::chrono::duration<double, std::milli> const synthesis_time{
+    std::chrono::steady_clock::now() - synthesis_start
+  };
+
+  std::uint64_t vertex_count{0};
+  std::uint64_t triangle_count{0};
+  std::uint64_t meshlet_count{0};
+  std::uint64_t instance_count{0};
+
+  for (auto const& mesh : scene->meshes) {
+    vertex_count += mesh.positions.size();
+    triangle_count += mesh.triangle_indices.size();
+    meshlet_count += mesh.meshlets.size();
+    instance_count += mesh.instances.size();
+  }
+
+  std::cout << std::format(
+    "Synthesized {} meshes with {} vertices, {} triangles and {} meshlets, {} "
+    "instances, {} materials and {} textures in {:.2f} ms.\n",
+    scene->meshes.size(), vertex_count, triangle_count, meshlet_count,
+    instance_count, scene->materials.size(), scene->textures.size(),
+    synthesis_time.count());
+
+  std::ofstream out{
+    opts->output_path, std::ios::binary | std::ios::out | std::ios::trunc
+  };
+
+  if (!out.is_open()) {
+    std::cerr << "Failed to open output file.\n";
+    return EXIT_FAILURE;
+  }
+
+  WriteScene(out, *scene);
+
+  if (!out) {
+    std::cerr << "Failed to write output file.\n";
+    return EXIT_FAILURE;
+  }
+
+  if (opts->profile_path) {
+    std::cout << pensieve::FormatProfilerSummary();
+
+    if (auto const exp{pensieve::WriteProfilerTrace(*opts->profile_path)};
+      !exp) {
+      std::cerr << "Error: " << exp.error() << '\n';
+      return EXIT_FAILURE;
+    }
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,399 @@
+#include "scene_synthesis.hpp"
+
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <format>
+#include <memory>
+#include <numbers>
+#include <optional>
+#include <utility>
+
+#include "bvh_builder.hpp"
+#include "profiler.hpp"
+
+namespace pensieve {
+namespace {
+// Seeds of the independent random streams.
+enum class RandomStream : std::uint64_t {
+  kMesh = 1,
+  kMaterial = 2,
+  kTexture = 3,
+  kInstance = 4,
+};
+
+// SplitMix64. Standard distributions differ between standard libraries, so
+// all random values are derived from the raw bits here.
+class Random {
+public:
+  Random(std::uint64_t const seed, RandomStream const stream,
+         std::uint64_t const idx) :
+    state_{
+      seed ^ (static_cast<std::uint64_t>(stream) << 56) ^ idx *
+      0xD1B54A32D192ED03ull
+    } {}
+
+  auto Next() -> std::uint64_t {
+    state_ += 0x9E3779B97F4A7C15ull;
+    auto z{state_};
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+  }
+
+  // Uniform in [0, 1).
+  auto NextFloat() -> float {
+    return static_cast<float>(Next() >> 40) / static_cast<float>(1 << 24);
+  }
+
+  auto NextFloat(float const min, float const max) -> float {
+    return min + (max - min) * NextFloat();
+  }
+
+  // Uniform in [0, bound).
+  auto NextBelow(std::uint32_t const bound) -> std::uint32_t {
+    return static_cast<std::uint32_t>((Next() >> 32) * bound >> 32);
+  }
+
+private:
+  std::uint64_t state_;
+};
+
+[[nodiscard]] auto Normalize(Float3 const& v) -> Float3 {
+  auto const len{std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2])};
+  return {v[0] / len, v[1] / len, v[2] / len};
+}
+
+[[nodiscard]] auto Cross(Float3 const& lhs, Float3 const& rhs) -> Float3 {
+  return {
+    lhs[1] * rhs[2] - lhs[2] * rhs[1], lhs[2] * rhs[0] - lhs[0] * rhs[2],
+    lhs[0] * rhs[1] - lhs[1] * rhs[0]
+  };
+}
+
+struct CubeFace {
+  Float3 normal;
+  Float3 u_axis;
+  Float3 v_axis;
+};
+
+// The u axis crossed with the v axis is the outward normal, so the grid
+// triangles are front facing from outside.
+auto constexpr kCubeFaces{
+  std::array{
+    CubeFace{{1, 0, 0}, {0, 1, 0}, {0, 0, 1}},
+    CubeFace{{-1, 0, 0}, {0, 0, 1}, {0, 1, 0}},
+    CubeFace{{0, 1, 0}, {0, 0, 1}, {1, 0, 0}},
+    CubeFace{{0, -1, 0}, {1, 0, 0}, {0, 0, 1}},
+    CubeFace{{0, 0, 1}, {1, 0, 0}, {0, 1, 0}},
+    CubeFace{{0, 0, -1}, {0, 1, 0}, {1, 0, 0}},
+  }
+};
+
+// Maps face coordinates in [0, 1] to the surface, between the cube and the
+// sphere that touch the unit cube's faces.
+[[nodiscard]] auto MapToSurface(CubeFace const& face, float const u,
+                                float const v,
+                                float const roundness) -> Float3 {
+  Float3 cube_pos;
+
+  for (auto i{0}; i < 3; i++) {
+    cube_pos[i] = 0.5f * (face.normal[i] + (2 * u - 1) * face.u_axis[i] + (2 *
+      v - 1) * face.v_axis[i]);
+  }
+
+  auto const sphere_pos{Normalize(cube_pos)};
+  Float3 ret;
+
+  for (auto i{0}; i < 3; i++) {
+    ret[i] = cube_pos[i] + roundness * (0.5f * sphere_pos[i] - cube_pos[i]);
+  }
+
+  return ret;
+}
+
+[[nodiscard]] auto SynthesizeMesh(std::uint32_t const resolution,
+                                  float const roundness,
+                                  std::uint32_t const material_idx) ->
+  MeshData {
+  PENSIEVE_PROFILE_ZONE("SynthesizeMesh");
+
+  auto const row_vertex_count{resolution + 1};
+  auto const face_vertex_count{row_vertex_count * row_vertex_count};
+  auto const vertex_count{face_vertex_count * kCubeFaces.size()};
+  // Offset of the finite differences in face coordinates.
+  auto const delta{0.25f / static_cast<float>(resolution)};
+
+  MeshData mesh;
+  mesh.positions.reserve(vertex_count);
+  mesh.normals.reserve(vertex_count);
+  mesh.tangents.emplace().reserve(vertex_count);
+  mesh.uvs.emplace().reserve(vertex_count);
+  mesh.material_idx = material_idx;
+
+  std::vector<std::uint32_t> vertex_indices;
+
+  for (auto const& face : kCubeFaces) {
+    auto const first_vertex{static_cast<std::uint32_t>(mesh.positions.size())};
+
+    for (std::uint32_t y{0}; y < row_vertex_count; y++) {
+      for (std::uint32_t x{0}; x < row_vertex_count; x++) {
+        auto const u{static_cast<float>(x) / static_cast<float>(resolution)};
+        auto const v{static_cast<float>(y) / static_cast<float>(resolution)};
+        auto const pos{MapToSurface(face, u, v, roundness)};
+
+        auto const u_min{MapToSurface(face, u - delta, v, roundness)};
+        auto const u_max{MapToSurface(face, u + delta, v, roundness)};
+        auto const v_min{MapToSurface(face, u, v - delta, roundness)};
+        auto const v_max{MapToSurface(face, u, v + delta, roundness)};
+        auto const tangent{
+          Normalize({
+            u_max[0] - u_min[0], u_max[1] - u_min[1], u_max[2] - u_min[2]
+          })
+        };
+        auto const normal{
+          Normalize(Cross(tangent, {
+                            v_max[0] - v_min[0], v_max[1] - v_min[1],
+                            v_max[2] - v_min[2]
+                          }))
+        };
+
+        mesh.positions.emplace_back(Float4{pos[0], pos[1], pos[2], 1.0f});
+        mesh.normals.emplace_back(
+          Float4{normal[0], normal[1], normal[2], 0.0f});
+        mesh.tangents->emplace_back(
+          Float4{tangent[0], tangent[1], tangent[2], 0.0f});
+        mesh.uvs->emplace_back(Float2{u, v});
+      }
+    }
+
+    AppendGridMeshlets(resolution, first_vertex, mesh.meshlets,
+                       vertex_indices, mesh.triangle_indices);
+  }
+
+  mesh.vertex_indices.resize(vertex_indices.size() * sizeof(std::uint32_t));
+  std::memcpy(mesh.vertex_indices.data(), vertex_indices.data(),
+              mesh.vertex_indices.size());
+
+  return mesh;
+}
+
+// A checkerboard of two colors, with every mip filtered from the previous
+// one.
+[[nodiscard]] auto SynthesizeTexture(std::uint32_t const size,
+                                     Random& random) -> TextureData {
+  PENSIEVE_PROFILE_ZONE("SynthesizeTexture");
+
+  auto const mip_count{static_cast<std::uint32_t>(std::bit_width(size))};
+  TextureData tex{
+    size, size, mip_count, TextureFormat::kR8G8B8A8Unorm,
+    std::make_unique_for_overwrite<std::uint8_t[]>(
+      CalculateTextureByteCount(TextureFormat::kR8G8B8A8Unorm, size, size,
+                                mip_count))
+  };
+
+  std::array<std::array<std::uint8_t, 4>, 2> colors;
+
+  for (auto& color : colors) {
+    for (auto i{0}; i < 3; i++) {
+      color[i] = static_cast<std::uint8_t>(random.NextBelow(256));
+    }
+
+    color[3] = 255;
+  }
+
+  auto const cell_size{std::max(size / 8, 1u)};
+  auto* texels{tex.bytes.get()};
+
+  for (std::uint32_t y{0}; y < size; y++) {
+    for (std::uint32_t x{0}; x < size; x++) {
+      std::memcpy(texels + (y * size + x) * 4,
+                  colors[(x / cell_size + y / cell_size) % 2].data(), 4);
+    }
+  }
+
+  for (std::uint32_t mip{1}; mip < mip_count; mip++) {
+    auto const src_size{std::max(size >> (mip - 1), 1u)};
+    auto const dst_size{std::max(size >> mip, 1u)};
+    auto const* const src{texels};
+    auto* const dst{texels + src_size * src_size * 4};
+
+    for (std::uint32_t y{0}; y < dst_size; y++) {
+      for (std::uint32_t x{0}; x < dst_size; x++) {
+        for (std::uint32_t c{0}; c < 4; c++) {
+          auto const texel{
+            [src, src_size, c](std::uint32_t const sx, std::uint32_t const sy) {
+              return static_cast<std::uint32_t>(src[(sy * src_size + sx) * 4 +
+                c]);
+            }
+          };
+          dst[(y * dst_size + x) * 4 + c] = static_cast<std::uint8_t>(
+            (texel(2 * x, 2 * y) + texel(2 * x + 1, 2 * y) + texel(
+              2 * x, 2 * y + 1) + texel(2 * x + 1, 2 * y + 1) + 2) / 4);
+        }
+      }
+    }
+
+    texels = dst;
+  }
+
+  return tex;
+}
+
+[[nodiscard]] auto SynthesizeMaterial(std::optional<std::uint32_t> const
+                                      base_color_map_idx,
+                                      Random& random) -> MaterialData {
+  return MaterialData{
+    {random.NextFloat(0.2f, 1.0f), random.NextFloat(0.2f, 1.0f),
+     random.NextFloat(0.2f, 1.0f)},
+    random.NextBelow(4) == 0 ? 1.0f : 0.0f, random.NextFloat(0.2f, 1.0f),
+    {0.0f, 0.0f, 0.0f}, base_color_map_idx, std::nullopt, std::nullopt,
+    std::nullopt, std::nullopt, 0, 0
+  };
+}
+
+// A random rotation from a uniformly distributed unit quaternion, uniformly
+// scaled and stored as the transposed 4x3 part of the row vector matrix.
+[[nodiscard]] auto SynthesizeInstance(Float3 const& translation,
+                                      Random& random) -> InstanceData {
+  auto const u0{random.NextFloat()};
+  auto const angle1{2 * std::numbers::pi_v<float> * random.NextFloat()};
+  auto const angle2{2 * std::numbers::pi_v<float> * random.NextFloat()};
+  auto const r1{std::sqrt(1 - u0)};
+  auto const r2{std::sqrt(u0)};
+  auto const x{r1 * std::sin(angle1)};
+  auto const y{r1 * std::cos(angle1)};
+  auto const z{r2 * std::sin(angle2)};
+  auto const w{r2 * std::cos(angle2)};
+  auto const scale{random.NextFloat(0.5f, 1.0f)};
+
+  return InstanceData{
+    {
+      scale * (1 - 2 * (y * y + z * z)), scale * 2 * (x * y - z * w),
+      scale * 2 * (x * z + y * w), translation[0],
+      scale * 2 * (x * y + z * w), scale * (1 - 2 * (x * x + z * z)),
+      scale * 2 * (y * z - x * w), translation[1],
+      scale * 2 * (x * z - y * w), scale * 2 * (y * z + x * w),
+      scale * (1 - 2 * (x * x + y * y)), translation[2]
+    }
+  };
+}
+}
+
+auto SynthesizeScene(SceneSynthesisParams const& params,
+                     JobSystem& job_system) -> std::expected<
+  SceneData, std::string> {
+  PENSIEVE_PROFILE_ZONE("SynthesizeScene");
+
+  if (params.mesh_count == 0 || params.material_count == 0 ||
+      params.mesh_resolution == 0) {
+    return std::unexpected{
+      "Mesh count, material count and resolution must be positive."
+    };
+  }
+
+  if (params.instance_count < params.mesh_count) {
+    return std::unexpected{
+      std::format("{} instances cannot cover {} meshes.",
+                  params.instance_count, params.mesh_count)
+    };
+  }
+
+  // The D3D12 limit of 2D textures.
+  if (params.texture_count != 0 && (params.texture_size == 0 || params.
+    texture_size > 16384)) {
+    return std::unexpected{"Texture size must be between 1 and 16384."};
+  }
+
+  SceneData scene;
+
+  scene.textures.resize(params.texture_count);
+  JobCounter tex_counter;
+
+  for (std::uint32_t i{0}; i < params.texture_count; i++) {
+    job_system.Run([&params, &scene, i] {
+      Random random{params.seed, RandomStream::kTexture, i};
+      scene.textures[i] = SynthesizeTexture(params.texture_size, random);
+    }, &tex_counter);
+  }
+
+  scene.materials.reserve(params.material_count);
+
+  for (std::uint32_t i{0}; i < params.material_count; i++) {
+    Random random{params.seed, RandomStream::kMaterial, i};
+    scene.materials.emplace_back(SynthesizeMaterial(
+      params.texture_count == 0
+        ? std::nullopt
+        : std::optional{i % params.texture_count}, random));
+  }
+
+  scene.meshes.resize(params.mesh_count);
+  job_system.ParallelFor(params.mesh_count, 1,
+                         [&params, &scene](std::size_t const begin,
+                                           std::size_t const end) {
+                           for (auto i{begin}; i < end; i++) {
+                             Random random{
+                               params.seed, RandomStream::kMesh, i
+                             };
+                             auto resolution{params.mesh_resolution};
+                             auto roundness{params.mesh_roundness};
+
+                             if (params.vary_meshes) {
+                               resolution = 1 + random.NextBelow(resolution);
+                               roundness = random.NextFloat();
+                             }
+
+                             scene.meshes[i] = SynthesizeMesh(
+                               resolution, roundness,
+                               static_cast<std::uint32_t>(i % params.
+                                 material_count));
+                           }
+                         });
+
+  // Instances take the lattice cells in a shuffled order, so the instances
+  // of every mesh spread over the whole scene.
+  auto const cells_per_axis{
+    static_cast<std::uint32_t>(std::ceil(
+      std::cbrt(static_cast<double>(params.instance_count))))
+  };
+  auto constexpr cell_size{2.0f};
+  auto const lattice_center{
+    0.5f * cell_size * static_cast<float>(cells_per_axis - 1)
+  };
+
+  std::vector<std::uint32_t> cells(params.instance_count);
+  Random instance_random{params.seed, RandomStream::kInstance, 0};
+
+  for (std::uint32_t i{0}; i < params.instance_count; i++) {
+    auto const j{instance_random.NextBelow(i + 1)};
+    cells[i] = cells[j];
+    cells[j] = i;
+  }
+
+  for (auto& mesh : scene.meshes) {
+    mesh.instances.reserve(params.instance_count / params.mesh_count + 1);
+  }
+
+  for (std::uint32_t i{0}; i < params.instance_count; i++) {
+    auto const cell{cells[i]};
+    Float3 translation;
+    auto cell_coord{cell};
+
+    for (auto& coord : translation) {
+      coord = cell_size * static_cast<float>(cell_coord % cells_per_axis) -
+              lattice_center + instance_random.NextFloat(-0.25f, 0.25f);
+      cell_coord /= cells_per_axis;
+    }
+
+    scene.meshes[i % params.mesh_count].instances.emplace_back(
+      SynthesizeInstance(translation, instance_random));
+  }
+
+  scene.bvh = BuildBvh(scene);
+  job_system.Wait(tex_counter);
+
+  return scene;
+}
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <expected>
+#include <string>
+#include <vector>
+
+#include "job_system.hpp"
+#include "scene_data.hpp"
+
+namespace pensieve {
+// Every mesh is a cube whose faces are grids of quads, pulled towards a
+// sphere by its roundness. Instances are scattered over a cubic lattice in a
+// seeded order, so the same parameters always produce the same file.
+struct SceneSynthesisParams {
+  std::uint32_t mesh_count;
+  // Assigned to the meshes in turn, so every mesh needs at least one.
+  std::uint32_t instance_count;
+  // Quads along each edge of a cube face.
+  std::uint32_t mesh_resolution;
+  // 0 is a cube and 1 a sphere.
+  float mesh_roundness;
+  // Lets every mesh pick its own resolution up to the given one and its own
+  // roundness, so that no two meshes share geometry.
+  bool vary_meshes;
+  std::uint32_t material_count;
+  // RGBA8 textures with full mip chains, used as base color maps.
+  std::uint32_t texture_count;
+  std::uint32_t texture_size;
+  std::uint64_t seed;
+};
+
+[[nodiscard]] auto SynthesizeScene(SceneSynthesisParams const& params,
+                                   JobSystem& job_system) -> std::expected<
+  SceneData, std::string>;
+
+// Quads along each edge of the square tiles that cube faces are split into,
+// the largest tile that fits the meshlet limits of the renderer.
+auto constexpr kGridMeshletTileSize{10u};
+
+// Splits a grid of resolution x resolution quads, whose vertices are stored
+// row by row starting at first_vertex, into one meshlet per tile. Triangles
+// wind clockwise when the grid's u axis crossed with its v axis points
+// towards the viewer.
+constexpr auto AppendGridMeshlets(std::uint32_t const resolution,
+                                  std::uint32_t const first_vertex,
+                                  std::vector<MeshletData>& meshlets,
+                                  std::vector<std::uint32_t>& vertex_indices,
+                                  std::vector<MeshletTriangleIndexData>&
+                                  triangle_indices) -> void {
+  auto const row_vertex_count{resolution + 1};
+
+  for (std::uint32_t tile_v{0}; tile_v < resolution;
+       tile_v += kGridMeshletTileSize) {
+    for (std::uint32_t tile_u{0}; tile_u < resolution;
+         tile_u += kGridMeshletTileSize) {
+      auto const quad_count_u{
+        std::min(kGridMeshletTileSize, resolution - tile_u)
+      };
+      auto const quad_count_v{
+        std::min(kGridMeshletTileSize, resolution - tile_v)
+      };
+      auto const tile_row_vertex_count{quad_count_u + 1};
+
+      auto const vert_offset{static_cast<std::uint32_t>(vertex_indices.size())};
+      auto const prim_offset{
+        static_cast<std::uint32_t>(triangle_indices.size())
+      };
+
+      for (auto v{tile_v}; v <= tile_v + quad_count_v; v++) {
+        for (auto u{tile_u}; u <= tile_u + quad_count_u; u++) {
+          vertex_indices.emplace_back(first_vertex + v * row_vertex_count + u);
+        }
+      }
+
+      for (std::uint32_t v{0}; v < quad_count_v; v++) {
+        for (std::uint32_t u{0}; u < quad_count_u; u++) {
+          auto const idx00{v * tile_row_vertex_count + u};
+          auto const idx10{idx00 + 1};
+          auto const idx01{idx00 + tile_row_vertex_count};
+          auto const idx11{idx01 + 1};
+          triangle_indices.emplace_back(
+            MeshletTriangleIndexData{idx00, idx10, idx11});
+          triangle_indices.emplace_back(
+            MeshletTriangleIndexData{idx00, idx11, idx01});
+        }
+      }
+
+      meshlets.emplace_back(
+        static_cast<std::uint32_t>(vertex_indices.size()) - vert_offset,
+        vert_offset,
+        static_cast<std::uint32_t>(triangle_indices.size()) - prim_offset,
+        prim_offset);
+    }
+  }
+}
+}
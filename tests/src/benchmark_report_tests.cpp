@@ -0,0 +1,65 @@
+#include <cstddef>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "benchmark_report.hpp"
+
+namespace pensieve {
+namespace {
+TEST(BenchmarkReportTest, FlagsRegressions) {
+  std::vector<BenchmarkResult> const baseline{
+    BenchmarkResult{"slower", "GB/s", 10.0, 1.0, 1.0, 1},
+    BenchmarkResult{"noise", "GB/s", 10.0, 1.0, 1.0, 1},
+    BenchmarkResult{"faster", "GB/s", 10.0, 1.0, 1.0, 1},
+    BenchmarkResult{"removed", "GB/s", 10.0, 1.0, 1.0, 1},
+  };
+  std::vector<BenchmarkResult> const current{
+    BenchmarkResult{"added", "GB/s", 1.0, 1.0, 1.0, 1},
+    BenchmarkResult{"faster", "GB/s", 20.0, 1.0, 1.0, 1},
+    BenchmarkResult{"noise", "GB/s", 9.6, 1.0, 1.0, 1},
+    BenchmarkResult{"slower", "GB/s", 8.0, 1.0, 1.0, 1},
+  };
+
+  auto const comparisons{CompareBenchmarkResults(baseline, current, 5.0)};
+  ASSERT_EQ(comparisons.size(), 5);
+  EXPECT_TRUE(comparisons[0].is_regression);
+  EXPECT_FALSE(comparisons[1].is_regression);
+  EXPECT_FALSE(comparisons[2].is_regression);
+  ASSERT_TRUE(comparisons[2].change_percent);
+  EXPECT_GT(*comparisons[2].change_percent, 99.0);
+  EXPECT_FALSE(comparisons[3].is_regression);
+  EXPECT_FALSE(comparisons[3].current_throughput);
+  EXPECT_EQ(comparisons[4].name, "added");
+  EXPECT_FALSE(comparisons[4].baseline_throughput);
+}
+
+TEST(BenchmarkReportTest, ReadsWrittenReport) {
+  std::vector<BenchmarkResult> const results{
+    BenchmarkResult{"Load \"quoted\"", "GB/s", 1.25, 2.5, 2.0, 5},
+    BenchmarkResult{"Build", "Minstances/s", 300.0, 0.125, 0.1, 10},
+  };
+
+  auto const path{
+    std::filesystem::temp_directory_path() / "pensieve_report_test.json"
+  };
+  ASSERT_TRUE(WriteBenchmarkReport(path, results));
+  auto const read{ReadBenchmarkReport(path)};
+  std::filesystem::remove(path);
+
+  ASSERT_TRUE(read) << read.error();
+  ASSERT_EQ(read->size(), results.size());
+
+  for (std::size_t i{0}; i < results.size(); i++) {
+    EXPECT_EQ((*read)[i].name, results[i].name);
+    EXPECT_EQ((*read)[i].unit, results[i].unit);
+    EXPECT_DOUBLE_EQ((*read)[i].throughput, results[i].throughput);
+    EXPECT_DOUBLE_EQ((*read)[i].median_ms, results[i].median_ms);
+    EXPECT_DOUBLE_EQ((*read)[i].min_ms, results[i].min_ms);
+    EXPECT_EQ((*read)[i].repetition_count, results[i].repetition_count);
+  }
+}
+}
+}
@@ -0,0 +1,152 @@
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "bvh.hpp"
+#include "bvh_builder.hpp"
+#include "job_system.hpp"
+#include "scene_data.hpp"
+#include "scene_synthesis.hpp"
+
+namespace pensieve {
+namespace {
+using InstanceKey = std::pair<std::uint32_t, std::uint32_t>;
+
+// Compares QueryBvh against testing the bounds of every instance on planes
+// through the scene in random directions.
+TEST(BvhTest, QueryMatchesBruteForce) {
+  JobSystem job_system{1};
+  auto const scene{
+    SynthesizeScene(SceneSynthesisParams{3, 20000, 1, 0.5f, true, 1, 0, 0, 5},
+                    job_system)
+  };
+  ASSERT_TRUE(scene.has_value()) << scene.error();
+
+  std::vector<Aabb> mesh_bounds;
+
+  for (auto const& mesh : scene->meshes) {
+    mesh_bounds.emplace_back(CalculateAabb(mesh.positions));
+  }
+
+  // The leaf of every instance reference.
+  std::vector<std::uint32_t> ref_leaves(scene->bvh.instance_refs.size());
+
+  for (std::uint32_t i{0}; i < scene->bvh.nodes.size(); i++) {
+    auto const& node{scene->bvh.nodes[i]};
+
+    for (auto j{node.left_or_first};
+         node.instance_count != 0 && j < node.left_or_first + node.
+         instance_count; j++) {
+      ref_leaves[j] = i;
+    }
+  }
+
+  std::mt19937 random{11};
+  std::normal_distribution<float> direction;
+  std::uniform_real_distribution<float> offset{-10.0f, 30.0f};
+  // Frustums that contain some but not all of the instances.
+  auto partial_count{0};
+
+  for (auto frustum_idx{0}; frustum_idx < 200; frustum_idx++) {
+    Frustum frustum;
+
+    for (auto& plane : frustum.planes) {
+      plane = Float4{direction(random), direction(random), direction(random),
+                     0.0f};
+      auto const len{
+        std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] *
+                  plane[2])
+      };
+      plane = Float4{
+        plane[0] / len, plane[1] / len, plane[2] / len, offset(random)
+      };
+    }
+
+    std::set<InstanceKey> expected;
+
+    for (std::uint32_t mesh_idx{0}; mesh_idx < scene->meshes.size();
+         mesh_idx++) {
+      auto const& instances{scene->meshes[mesh_idx].instances};
+
+      for (std::uint32_t i{0}; i < instances.size(); i++) {
+        auto const bounds{
+          TransformAabb(mesh_bounds[mesh_idx], instances[i].model_mtx)
+        };
+
+        if (TestAabb(frustum, bounds.min, bounds.max) !=
+          FrustumTestResult::kOutside) {
+          expected.emplace(mesh_idx, i);
+        }
+      }
+    }
+
+    std::set<InstanceKey> queried;
+    auto const* const first_ref{scene->bvh.instance_refs.data()};
+
+    QueryBvh(scene->bvh, frustum, [&](BvhInstanceRef const& ref) {
+      EXPECT_TRUE(queried.emplace(ref.mesh_idx, ref.instance_idx).second);
+
+      // Whole leaves are returned, so instances outside the frustum must come
+      // from a leaf that is not.
+      auto const& leaf{scene->bvh.nodes[ref_leaves[&ref - first_ref]]};
+      EXPECT_NE(TestAabb(frustum, leaf.aabb_min, leaf.aabb_max),
+                FrustumTestResult::kOutside);
+    });
+
+    for (auto const& key : expected) {
+      EXPECT_TRUE(queried.contains(key));
+    }
+
+    if (!expected.empty() && expected.size() != scene->bvh.instance_refs.
+      size()) {
+      ++partial_count;
+    }
+  }
+
+  EXPECT_GT(partial_count, 50);
+}
+
+TEST(BvhTest, QueryReturnsEveryInstanceOnceInsideFrustum) {
+  JobSystem job_system{1};
+  auto const scene{
+    SynthesizeScene(SceneSynthesisParams{2, 5000, 1, 0.0f, false, 1, 0, 0, 3},
+                    job_system)
+  };
+  ASSERT_TRUE(scene.has_value()) << scene.error();
+
+  Frustum frustum;
+
+  for (auto& plane : frustum.planes) {
+    plane = Float4{0, 0, 0, 1};
+  }
+
+  std::set<InstanceKey> queried;
+  QueryBvh(scene->bvh, frustum, [&queried](BvhInstanceRef const& ref) {
+    EXPECT_TRUE(queried.emplace(ref.mesh_idx, ref.instance_idx).second);
+  });
+
+  EXPECT_EQ(queried.size(), 5000u);
+}
+
+TEST(BvhTest, QueryOfEmptyBvhReturnsNothing) {
+  auto const bvh{BuildBvh(SceneData{})};
+  Frustum frustum;
+
+  for (auto& plane : frustum.planes) {
+    plane = Float4{0, 0, 0, 1};
+  }
+
+  auto ref_count{0};
+  QueryBvh(bvh, frustum, [&ref_count](BvhInstanceRef const&) {
+    ++ref_count;
+  });
+
+  EXPECT_EQ(ref_count, 0);
+}
+}
+}
@@ -0,0 +1,83 @@
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "command_recorder.hpp"
+#include "dispatch_planner.hpp"
+#include "indirect_draw.hpp"
+#include "mega_buffer.hpp"
+
+namespace pensieve {
+namespace {
+// Records a frame of two meshes headlessly and checks that every dispatch
+// sees the frame wide bindings next to its own per draw constants.
+TEST(CommandRecorderTest, RecordsSceneDraws) {
+  std::array<MeshletDispatchChunk, 2> const chunks{
+    MeshletDispatchChunk{0, 2, 3, CalculateMaxInstanceCountPerDispatch(2, 3)},
+    MeshletDispatchChunk{2, 3, 1, 4}
+  };
+
+  std::vector<IndirectDrawCommand> commands;
+  AppendIndirectDrawCommands(2, chunks, 10, commands);
+  AppendIndirectDrawCommands(3, chunks, 1, commands);
+
+  std::array<float, 16> view_proj_mtx{};
+  view_proj_mtx[0] = 2.0f;
+  std::array const camera_pos{1.0f, -2.0f, 3.0f};
+  SceneDrawBindings const bindings{7, {10, 11, 12, 13, 14, 15, 16, 17}};
+
+  RecordingCommandRecorder recorder;
+  RecordSceneDraws(recorder, view_proj_mtx, camera_pos, bindings, commands);
+
+  auto const dispatches{recorder.GetDispatches()};
+  auto const stats{recorder.GetStats()};
+  ASSERT_EQ(dispatches.size(), commands.size());
+  EXPECT_EQ(stats.command_count, 5);
+  EXPECT_EQ(stats.dispatch_count, commands.size());
+  EXPECT_EQ(stats.argument_byte_count,
+            commands.size() * sizeof(IndirectDrawCommand));
+
+  std::uint64_t thread_group_count{0};
+
+  for (std::size_t i{0}; i < dispatches.size(); i++) {
+    auto const& [draw_params, args]{dispatches[i]};
+    auto const& [constants, command_args]{commands[i]};
+    EXPECT_EQ(draw_params[kDrawParamsViewProjMtxOffset],
+              std::bit_cast<std::uint32_t>(2.0f));
+    EXPECT_EQ(draw_params[kDrawParamsCameraPosOffset + 1],
+              std::bit_cast<std::uint32_t>(-2.0f));
+    EXPECT_EQ(draw_params[kDrawParamsDrawRecordBufIdxOffset], 7);
+    EXPECT_EQ(
+      draw_params[kDrawParamsGeometryBufIdxOffset + kGeometryStreamInstance],
+      17);
+    EXPECT_EQ(draw_params[kDrawParamsDwordCount - 1],
+              constants.draw_record_idx);
+    EXPECT_EQ(draw_params[kDrawParamsDwordCount - 2],
+              constants.instance_offset);
+    EXPECT_EQ(args.thread_group_count_x, command_args.thread_group_count_x);
+    thread_group_count += args.thread_group_count_x;
+  }
+
+  EXPECT_EQ(stats.thread_group_count, thread_group_count);
+}
+
+// Without commands only the frame wide fields are set.
+TEST(CommandRecorderTest, SkipsBindingsWithoutCommands) {
+  std::array<float, 16> const view_proj_mtx{};
+  std::array const camera_pos{0.0f, 0.0f, 0.0f};
+  SceneDrawBindings const bindings{7, {10, 11, 12, 13, 14, 15, 16, 17}};
+
+  RecordingCommandRecorder recorder;
+  RecordSceneDraws(recorder, view_proj_mtx, camera_pos, bindings, {});
+  EXPECT_TRUE(recorder.GetDispatches().empty());
+  EXPECT_EQ(recorder.GetStats().command_count, 2);
+
+  recorder.Reset();
+  EXPECT_EQ(recorder.GetStats().command_count, 0);
+}
+}
+}
@@ -0,0 +1,161 @@
+#include <cstdint>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "descriptor_allocator.hpp"
+
+namespace pensieve {
+namespace {
+// Linear congruential generator, so failures reproduce on every platform.
+class Random {
+public:
+  explicit Random(std::uint32_t const seed) : state_{seed} {}
+
+  [[nodiscard]] auto Next() -> std::uint32_t {
+    state_ = state_ * 1664525u + 1013904223u;
+    return state_ >> 8;
+  }
+
+private:
+  std::uint32_t state_;
+};
+
+// Checks a pseudo random sequence of allocations and frees against a
+// reference bitmap and that freeing everything merges the ranges back.
+auto ExpectIndexRangeAllocatorExact(std::uint32_t const capacity,
+                                    std::uint32_t const step_count,
+                                    std::uint32_t const max_count) -> void {
+  IndexRangeAllocator allocator{capacity};
+  std::vector<bool> is_used(capacity);
+  std::uint32_t used_count{0};
+  std::vector<std::pair<std::uint32_t, std::uint32_t>> allocations;
+  Random random{12345};
+
+  for (std::uint32_t i{0}; i < step_count; i++) {
+    if (allocations.empty() || random.Next() % 3 != 0) {
+      auto const count{
+        random.Next() % (random.Next() % 4 == 0 ? max_count : 6) + 1
+      };
+
+      if (auto const first{allocator.Allocate(count)}) {
+        for (auto j{*first}; j < *first + count; j++) {
+          ASSERT_LT(j, capacity);
+          ASSERT_FALSE(is_used[j]) << "index " << j << " of step " << i;
+          is_used[j] = true;
+        }
+
+        used_count += count;
+        allocations.emplace_back(*first, count);
+      }
+    } else {
+      auto const idx{random.Next() % allocations.size()};
+      auto const [first, count]{allocations[idx]};
+      allocations[idx] = allocations.back();
+      allocations.pop_back();
+      allocator.Free(first);
+
+      for (auto j{first}; j < first + count; j++) {
+        is_used[j] = false;
+      }
+
+      used_count -= count;
+    }
+
+    ASSERT_EQ(allocator.GetFreeCount(), capacity - used_count);
+  }
+
+  for (auto const& [first, count] : allocations) {
+    allocator.Free(first);
+  }
+
+  EXPECT_EQ(allocator.GetFreeCount(), capacity);
+  EXPECT_EQ(allocator.GetFreeRangeCount(), 1);
+  EXPECT_EQ(allocator.Allocate(capacity), 0u);
+}
+
+TEST(IndexRangeAllocatorTest, ChurnMatchesBitmap) {
+  ExpectIndexRangeAllocatorExact(300, 2000, 70);
+}
+
+// Enough indices for the larger size classes.
+TEST(IndexRangeAllocatorTest, LargeChurnMatchesBitmap) {
+  ExpectIndexRangeAllocatorExact(1'000'000, 200'000, 5000);
+}
+
+// A request fails only if no free range is large enough.
+TEST(IndexRangeAllocatorTest, FindsFit) {
+  IndexRangeAllocator allocator{100};
+
+  auto const a{allocator.Allocate(20)};
+  auto const b{allocator.Allocate(30)};
+  auto const c{allocator.Allocate(50)};
+  EXPECT_EQ(a, 0u);
+  EXPECT_EQ(b, 20u);
+  EXPECT_EQ(c, 50u);
+  EXPECT_FALSE(allocator.Allocate(1));
+
+  allocator.Free(*a);
+  allocator.Free(*c);
+
+  // Free ranges of 20 and 50 indices that are not adjacent.
+  EXPECT_EQ(allocator.GetFreeRangeCount(), 2);
+  EXPECT_FALSE(allocator.Allocate(51));
+  EXPECT_EQ(allocator.Allocate(35), 50u);
+  EXPECT_EQ(allocator.Allocate(20), 0u);
+  EXPECT_EQ(allocator.Allocate(15), 85u);
+  EXPECT_EQ(allocator.GetFreeCount(), 0);
+  EXPECT_FALSE(allocator.Allocate(0));
+  EXPECT_EQ(IndexRangeAllocator{0}.GetFreeRangeCount(), 0);
+}
+
+// Ranges allocated concurrently never overlap.
+TEST(DescriptorAllocatorTest, ConcurrentRangesAreDisjoint) {
+  auto constexpr capacity{1u << 16};
+  auto constexpr thread_count{4u};
+
+  DescriptorAllocator allocator{capacity};
+  std::vector<std::vector<std::pair<std::uint32_t, std::uint32_t>>> kept(
+    thread_count);
+  std::vector<std::thread> threads;
+
+  for (std::uint32_t i{0}; i < thread_count; i++) {
+    threads.emplace_back([&allocator, &allocations = kept[i], i] {
+      Random random{i + 1};
+
+      for (auto step{0}; step < 20'000; step++) {
+        if (allocations.empty() || random.Next() % 2 == 0) {
+          auto const count{random.Next() % 8 + 1};
+
+          if (auto const first{allocator.Allocate(count)}) {
+            allocations.emplace_back(*first, count);
+          }
+        } else {
+          auto const idx{random.Next() % allocations.size()};
+          allocator.Free(allocations[idx].first);
+          allocations[idx] = allocations.back();
+          allocations.pop_back();
+        }
+      }
+    });
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  std::vector<bool> is_used(capacity);
+
+  for (auto const& allocations : kept) {
+    for (auto const& [first, count] : allocations) {
+      for (auto j{first}; j < first + count; j++) {
+        ASSERT_FALSE(is_used[j]) << "index " << j;
+        is_used[j] = true;
+      }
+    }
+  }
+}
+}
+}
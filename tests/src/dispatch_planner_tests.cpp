@@ -0,0 +1,205 @@
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <tuple>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "dispatch_planner.hpp"
+#include "scene_data.hpp"
+
+namespace pensieve {
+namespace {
+auto constexpr kMaxVertsPerGroup{128u};
+auto constexpr kMaxPrimsPerGroup{256u};
+
+// Replays the dispatches of every chunk the way the mesh shader maps groups
+// to meshlets and instances, and checks that every meshlet of every instance
+// is drawn exactly once by groups within the limits.
+auto ExpectPlanCoversInstances(std::span<MeshletData const> const meshlets,
+                               std::span<MeshletDispatchChunk const> const
+                               chunks,
+                               std::uint32_t const instance_count) -> void {
+  std::vector<std::uint8_t> coverage(meshlets.size() * instance_count);
+
+  for (auto const& chunk : chunks) {
+    ASSERT_GT(chunk.instances_per_group, 0);
+    ASSERT_LE(chunk.meshlet_count, kMaxDispatchGroupCount);
+
+    for (std::uint32_t i{0}; i < GetDispatchCount(chunk, instance_count); i++) {
+      auto const [instance_offset, dispatch_instance_count, group_count]{
+        PlanInstanceDispatch(chunk, instance_count, i)
+      };
+      ASSERT_GT(group_count, 0);
+      ASSERT_LE(group_count, kMaxDispatchGroupCount);
+
+      for (std::uint32_t group_idx{0}; group_idx < group_count; group_idx++) {
+        auto const [meshlet_idx, start_instance, group_instance_count]{
+          MapGroupToInstances(chunk, dispatch_instance_count, group_idx)
+        };
+        ASSERT_LT(meshlet_idx, chunk.meshlet_count);
+        ASSERT_GT(group_instance_count, 0);
+        ASSERT_LE(group_instance_count, chunk.instances_per_group);
+
+        auto const& meshlet{meshlets[chunk.meshlet_offset + meshlet_idx]};
+        ASSERT_LE(meshlet.vert_count * group_instance_count, kMaxVertsPerGroup);
+        ASSERT_LE(meshlet.prim_count * group_instance_count, kMaxPrimsPerGroup);
+
+        for (auto j{start_instance}; j < start_instance + group_instance_count;
+             j++) {
+          ++coverage[static_cast<std::size_t>(chunk.meshlet_offset +
+            meshlet_idx) * instance_count + instance_offset + j];
+        }
+      }
+    }
+  }
+
+  for (std::size_t i{0}; i < coverage.size(); i++) {
+    ASSERT_EQ(coverage[i], 1) << "meshlet " << i / instance_count <<
+      ", instance " << i % instance_count;
+  }
+}
+
+// Uniform meshlets packing the given number of instances into a group.
+auto ExpectUniformCoverage(std::uint32_t const meshlet_count,
+                           std::uint32_t const instances_per_group,
+                           std::uint32_t const instance_count) -> void {
+  SCOPED_TRACE(testing::Message() << meshlet_count << " meshlets, " <<
+    instances_per_group << " instances per group, " << instance_count <<
+    " instances");
+
+  std::vector const meshlets(meshlet_count, MeshletData{
+                               kMaxVertsPerGroup / instances_per_group, 0, 1, 0
+                             });
+  MeshletDispatchChunk const chunk{
+    0, meshlet_count, instances_per_group,
+    CalculateMaxInstanceCountPerDispatch(meshlet_count, instances_per_group)
+  };
+  ExpectPlanCoversInstances(meshlets, std::span{&chunk, 1}, instance_count);
+}
+
+TEST(DispatchPlannerTest, SmallDispatchesCoverInstances) {
+  for (std::uint32_t meshlet_count{1}; meshlet_count <= 3; meshlet_count++) {
+    for (auto const instances_per_group : {1u, 2u, 3u, 5u, 12u}) {
+      for (std::uint32_t instance_count{1}; instance_count <= 12;
+           instance_count++) {
+        ExpectUniformCoverage(meshlet_count, instances_per_group,
+                              instance_count);
+      }
+    }
+  }
+}
+
+// Enough groups to split the instances over several dispatches.
+TEST(DispatchPlannerTest, SplitDispatchesCoverInstances) {
+  for (auto const& [meshlet_count, instances_per_group, instance_count] : {
+         std::tuple{1u, 1u, 200'000u}, std::tuple{300u, 2u, 1000u},
+         std::tuple{7u, 64u, 100'000u}, std::tuple{65'535u, 1u, 3u},
+         std::tuple{4095u, 3u, 97u}
+       }) {
+    ExpectUniformCoverage(meshlet_count, instances_per_group, instance_count);
+  }
+}
+
+TEST(DispatchPlannerTest, MixedMeshPlanCoversInstances) {
+  std::vector meshlets{
+    MeshletData{24, 0, 12, 0}, MeshletData{128, 0, 100, 0},
+    MeshletData{3, 0, 1, 0}, MeshletData{64, 0, 64, 0},
+    MeshletData{24, 0, 12, 0}, MeshletData{128, 0, 256, 0}
+  };
+
+  SortMeshletsForPacking(meshlets, kMaxVertsPerGroup, kMaxPrimsPerGroup);
+  auto const chunks{
+    PlanMeshletDispatches(meshlets, kMaxVertsPerGroup, kMaxPrimsPerGroup)
+  };
+
+  for (auto const& chunk : chunks) {
+    for (auto i{chunk.meshlet_offset};
+         i < chunk.meshlet_offset + chunk.meshlet_count; i++) {
+      EXPECT_EQ(GetInstancesPerGroup(meshlets[i], kMaxVertsPerGroup,
+                                     kMaxPrimsPerGroup),
+                chunk.instances_per_group);
+    }
+  }
+
+  for (std::uint32_t instance_count{1}; instance_count <= 10;
+       instance_count++) {
+    SCOPED_TRACE(instance_count);
+    ExpectPlanCoversInstances(meshlets, chunks, instance_count);
+  }
+}
+
+// Meshlets of random sizes within the limits, more of them packing a single
+// instance than fit into one dispatch.
+TEST(DispatchPlannerTest, LargeMixedMeshPlanCoversInstances) {
+  std::vector<MeshletData> meshlets;
+  std::uint32_t rng{12345};
+
+  auto const next{
+    [&rng](std::uint32_t const bound) {
+      rng = rng * 1664525u + 1013904223u;
+      return (rng >> 8) % bound;
+    }
+  };
+
+  for (std::uint32_t i{0}; i < 20'000; i++) {
+    meshlets.emplace_back(next(kMaxVertsPerGroup) + 1, 0,
+                          next(kMaxPrimsPerGroup) + 1, 0);
+  }
+
+  meshlets.insert(meshlets.end(), 70'000, MeshletData{kMaxVertsPerGroup, 0,
+                    kMaxPrimsPerGroup, 0});
+
+  SortMeshletsForPacking(meshlets, kMaxVertsPerGroup, kMaxPrimsPerGroup);
+  auto const chunks{
+    PlanMeshletDispatches(meshlets, kMaxVertsPerGroup, kMaxPrimsPerGroup)
+  };
+
+  std::uint32_t meshlet_end{0};
+
+  for (auto const& chunk : chunks) {
+    EXPECT_EQ(chunk.meshlet_offset, meshlet_end);
+    meshlet_end += chunk.meshlet_count;
+  }
+
+  EXPECT_EQ(meshlet_end, meshlets.size());
+  EXPECT_GT(chunks.size(), 2);
+
+  for (auto const instance_count : {1u, 7u, 33u}) {
+    SCOPED_TRACE(instance_count);
+    ExpectPlanCoversInstances(meshlets, chunks, instance_count);
+  }
+}
+
+TEST(DispatchPlannerTest, MaxInstanceCountsAreTight) {
+  for (auto const meshlet_count : {
+         1u, 2u, 3u, 7u, 255u, 4095u, 32768u, 65534u, kMaxDispatchGroupCount
+       }) {
+    for (auto const instances_per_group : {1u, 2u, 3u, 5u, 64u, 127u, 128u}) {
+      auto const instance_count{
+        CalculateMaxInstanceCountPerDispatch(meshlet_count,
+                                             instances_per_group)
+      };
+      EXPECT_GT(instance_count, 0);
+      EXPECT_LE(CalculateDispatchGroupCount(meshlet_count, instances_per_group,
+                                            instance_count),
+                kMaxDispatchGroupCount);
+      EXPECT_GT(CalculateDispatchGroupCount(meshlet_count, instances_per_group,
+                                            instance_count + 1),
+                kMaxDispatchGroupCount);
+    }
+  }
+}
+
+// Meshlets at the limits still pack one instance into a group.
+TEST(DispatchPlannerTest, MeshletsAtLimitsPackInstances) {
+  EXPECT_EQ(GetInstancesPerGroup(MeshletData{128, 0, 256, 0},
+                                 kMaxVertsPerGroup, kMaxPrimsPerGroup), 1);
+  EXPECT_EQ(GetInstancesPerGroup(MeshletData{1, 0, 1, 0}, kMaxVertsPerGroup,
+                                 kMaxPrimsPerGroup), 128);
+  EXPECT_EQ(GetInstancesPerGroup(MeshletData{3, 0, 100, 0},
+                                 kMaxVertsPerGroup, kMaxPrimsPerGroup), 2);
+}
+}
+}
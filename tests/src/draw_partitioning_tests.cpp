@@ -0,0 +1,103 @@
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "command_recorder.hpp"
+#include "dispatch_planner.hpp"
+#include "draw_partitioning.hpp"
+#include "indirect_draw.hpp"
+
+namespace pensieve {
+namespace {
+// Records a frame split into partitions into separate mock recorders and
+// checks that the partitions cover the meshes in order with balanced dispatch
+// counts, and that concatenating them replays the dispatches of a single
+// recorder.
+TEST(DrawPartitioningTest, PartitionsReplaySingleRecorder) {
+  std::array<MeshletDispatchChunk, 2> const chunks{
+    MeshletDispatchChunk{0, 2, 3, CalculateMaxInstanceCountPerDispatch(2, 3)},
+    MeshletDispatchChunk{2, 3, 1, 4}
+  };
+
+  // The fourth mesh outweighs the others and the fifth has nothing visible.
+  std::vector<MeshDrawSource> meshes;
+
+  for (auto const instance_count : {3u, 9u, 1u, 60u, 0u, 12u, 5u, 7u}) {
+    meshes.emplace_back(chunks, instance_count,
+                        static_cast<std::uint32_t>(meshes.size()));
+  }
+
+  std::array<float, 16> view_proj_mtx{};
+  view_proj_mtx[5] = 3.0f;
+  std::array const camera_pos{0.5f, 1.0f, -4.0f};
+  SceneDrawBindings const bindings{2, {3, 4, 5, 6, 7, 8, 9, 10}};
+
+  std::vector<DrawPartition> partitions;
+  std::vector<IndirectDrawCommand> commands;
+  PartitionDraws(meshes, 1, 1, partitions);
+  ASSERT_EQ(partitions.size(), 1);
+  ASSERT_EQ(partitions[0].mesh_count, meshes.size());
+
+  RecordingCommandRecorder single_recorder;
+  RecordDrawPartition(single_recorder, view_proj_mtx, camera_pos, bindings,
+                      meshes, partitions[0], commands);
+  auto const total_command_count{partitions[0].command_count};
+  auto const expected{single_recorder.GetDispatches()};
+  ASSERT_EQ(expected.size(), total_command_count);
+
+  // Boundaries are placed at the first mesh reaching the share, so no
+  // partition exceeds its share by more than the largest mesh.
+  auto const largest_mesh_command_count{
+    CalculateMaxIndirectDrawCommandCount(chunks, 60)
+  };
+
+  for (std::uint32_t max_partition_count{1}; max_partition_count <= 6;
+       max_partition_count++) {
+    SCOPED_TRACE(max_partition_count);
+    PartitionDraws(meshes, max_partition_count, 4, partitions);
+    ASSERT_FALSE(partitions.empty());
+    ASSERT_LE(partitions.size(), max_partition_count);
+
+    auto const partition_count{static_cast<std::uint32_t>(partitions.size())};
+    auto const share{
+      (total_command_count + partition_count - 1) / partition_count
+    };
+    std::uint32_t next_mesh{0};
+    std::uint32_t next_command{0};
+    std::vector<RecordingCommandRecorder::RecordedDispatch> dispatches;
+
+    for (auto const& partition : partitions) {
+      EXPECT_EQ(partition.first_mesh, next_mesh);
+      EXPECT_EQ(partition.first_command, next_command);
+      EXPECT_LE(partition.command_count, share + largest_mesh_command_count);
+
+      if (&partition != &partitions.back()) {
+        EXPECT_GE(partition.command_count, 4);
+      }
+
+      next_mesh += partition.mesh_count;
+      next_command += partition.command_count;
+
+      RecordingCommandRecorder recorder;
+      RecordDrawPartition(recorder, view_proj_mtx, camera_pos, bindings,
+                          meshes, partition, commands);
+      EXPECT_EQ(recorder.GetDispatches().size(), partition.command_count);
+      dispatches.insert(dispatches.end(), recorder.GetDispatches().begin(),
+                        recorder.GetDispatches().end());
+    }
+
+    EXPECT_EQ(next_mesh, meshes.size());
+    ASSERT_EQ(dispatches.size(), expected.size());
+
+    for (std::size_t i{0}; i < dispatches.size(); i++) {
+      EXPECT_EQ(dispatches[i].draw_params, expected[i].draw_params);
+      EXPECT_EQ(dispatches[i].args.thread_group_count_x,
+                expected[i].args.thread_group_count_x);
+    }
+  }
+}
+}
+}
@@ -0,0 +1,93 @@
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+#include <gtest/gtest.h>
+
+#include "file_reader.hpp"
+
+namespace pensieve {
+namespace {
+class FileReaderTest : public testing::TestWithParam<FileReadBackend> {
+protected:
+  auto TearDown() -> void override {
+    std::filesystem::remove(path_);
+  }
+
+  std::filesystem::path path_{
+    std::filesystem::temp_directory_path() / "pensieve_file_reader_test.bin"
+  };
+};
+
+INSTANTIATE_TEST_SUITE_P(Backends, FileReaderTest,
+                         testing::Values(FileReadBackend::kPread,
+                                         FileReadBackend::kIoUring),
+                         [](auto const& info) {
+                           return std::string{
+                             info.param == FileReadBackend::kPread
+                               ? "Pread"
+                               : "IoUring"
+                           };
+                         });
+
+// Direct I/O needs aligned chunks and a reader needs a read in flight.
+TEST_P(FileReaderTest, RejectsInvalidOptions) {
+  std::ofstream{path_, std::ios::binary | std::ios::out} << "pensieve";
+  auto constexpr alignment{static_cast<std::uint32_t>(kFileReadAlignment)};
+
+  for (auto const& options : {
+         FileReadOptions{0, 32, false}, FileReadOptions{1000, 32, false},
+         FileReadOptions{alignment + 512, 32, true},
+         FileReadOptions{alignment, 0, false}
+       }) {
+    EXPECT_FALSE(OpenFileReader(path_, GetParam(), options)) << options.
+      chunk_size << " byte chunks, queue depth " << options.queue_depth;
+  }
+}
+
+#ifdef __linux__
+// Files that end inside a chunk, on a chunk boundary and are empty, read
+// with and without direct I/O.
+TEST_P(FileReaderTest, ReadsWholeFile) {
+  auto constexpr alignment{static_cast<std::uint32_t>(kFileReadAlignment)};
+
+  for (auto const size : {
+         std::size_t{0}, std::size_t{1}, kFileReadAlignment,
+         5 * kFileReadAlignment + 123
+       }) {
+    std::string bytes(size, '\0');
+
+    for (std::size_t i{0}; i < size; i++) {
+      bytes[i] = static_cast<char>(i * 31 + i / 256);
+    }
+
+    std::ofstream{path_, std::ios::binary | std::ios::out} << bytes;
+
+    for (auto const& options : {
+           FileReadOptions{alignment, 1, false},
+           FileReadOptions{alignment, 32, true},
+           FileReadOptions{2 * alignment, 2, false}
+         }) {
+      auto const reader{OpenFileReader(path_, GetParam(), options)};
+      ASSERT_TRUE(reader) << reader.error();
+      ASSERT_EQ((*reader)->GetSize(), size);
+
+      auto const buffer{AllocateFileReadBuffer(size)};
+      ASSERT_TRUE((*reader)->Start({
+        buffer.get(), GetFileReadBufferSize(size)
+      }));
+
+      auto const ready_count{(*reader)->WaitForPrefix(size)};
+      ASSERT_TRUE(ready_count) << ready_count.error();
+      ASSERT_EQ(*ready_count, size);
+      EXPECT_EQ(std::string(reinterpret_cast<char const*>(buffer.get()), size),
+                bytes) << size << " bytes, queue depth " << options.
+        queue_depth << (options.direct_io ? ", direct I/O" : "");
+    }
+  }
+}
+#endif
+}
+}
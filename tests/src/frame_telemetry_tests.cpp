@@ -0,0 +1,132 @@
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "frame_telemetry.hpp"
+
+namespace pensieve {
+namespace {
+using std::chrono::nanoseconds;
+
+// Every field is derived from the frame index, so a sample mixing two pushes
+// is detectable.
+[[nodiscard]] auto MakeSample(std::uint64_t const frame_idx) ->
+  FrameStageSample {
+  return FrameStageSample{
+    frame_idx, static_cast<FrameStage>(frame_idx % kFrameStageCount),
+    std::chrono::steady_clock::time_point{
+      std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        nanoseconds{static_cast<std::int64_t>(3 * frame_idx)})
+    },
+    nanoseconds{static_cast<std::int64_t>(7 * frame_idx)}
+  };
+}
+
+[[nodiscard]] auto IsSampleIntact(FrameStageSample const& sample) -> bool {
+  auto const expected{MakeSample(sample.frame_idx)};
+  return sample.stage == expected.stage && sample.begin == expected.begin &&
+    sample.duration == expected.duration;
+}
+
+TEST(FrameTelemetryTest, PercentilesAreNearestRank) {
+  // Shuffled 1 to 100.
+  std::vector<nanoseconds> durations;
+
+  for (std::int64_t i{0}; i < 100; i++) {
+    durations.emplace_back(i * 37 % 100 + 1);
+  }
+
+  auto const stats{CalculatePercentiles(durations)};
+  EXPECT_EQ(stats.sample_count, 100);
+  EXPECT_EQ(stats.p50, nanoseconds{50});
+  EXPECT_EQ(stats.p95, nanoseconds{95});
+  EXPECT_EQ(stats.p99, nanoseconds{99});
+
+  // Few samples round up to the next rank.
+  std::array few{nanoseconds{30}, nanoseconds{10}, nanoseconds{20}};
+  auto const few_stats{CalculatePercentiles(few)};
+  EXPECT_EQ(few_stats.p50, nanoseconds{20});
+  EXPECT_EQ(few_stats.p95, nanoseconds{30});
+  EXPECT_EQ(few_stats.p99, nanoseconds{30});
+
+  std::array single{nanoseconds{7}};
+  auto const single_stats{CalculatePercentiles(single)};
+  EXPECT_EQ(single_stats.p50, nanoseconds{7});
+  EXPECT_EQ(single_stats.p99, nanoseconds{7});
+  EXPECT_EQ(CalculatePercentiles({}).sample_count, 0);
+}
+
+TEST(FrameTelemetryTest, SampleRingKeepsNewestSamples) {
+  FrameStageSampleRing ring{4};
+
+  for (std::uint64_t i{0}; i < 10; i++) {
+    ring.Push(MakeSample(i));
+  }
+
+  std::vector<FrameStageSample> samples;
+  ring.CopySamples(samples);
+  ASSERT_EQ(samples.size(), 4);
+
+  for (std::uint64_t i{0}; i < 4; i++) {
+    EXPECT_EQ(samples[i].frame_idx, 6 + i);
+    EXPECT_TRUE(IsSampleIntact(samples[i]));
+  }
+}
+
+// A reader copying while the producer keeps overwriting a small ring must
+// only see whole samples, oldest first.
+TEST(FrameTelemetryTest, SampleRingCopiesNoTornSamples) {
+  auto constexpr capacity{8u};
+  auto constexpr push_count{1u << 20};
+
+  FrameStageSampleRing ring{capacity};
+  std::atomic_bool is_done{false};
+
+  std::thread producer{
+    [&ring, &is_done] {
+      for (std::uint64_t i{0}; i < push_count; i++) {
+        ring.Push(MakeSample(i));
+      }
+
+      is_done.store(true, std::memory_order_release);
+    }
+  };
+
+  std::vector<FrameStageSample> samples;
+  std::uint64_t copy_count{0};
+  std::uint64_t torn_count{0};
+  std::uint64_t unordered_count{0};
+
+  while (!is_done.load(std::memory_order_acquire)) {
+    samples.clear();
+    ring.CopySamples(samples);
+    ++copy_count;
+
+    for (std::size_t i{0}; i < samples.size(); i++) {
+      torn_count += IsSampleIntact(samples[i]) ? 0 : 1;
+      unordered_count += i != 0 && samples[i].frame_idx <= samples[i - 1].
+                         frame_idx ? 1 : 0;
+    }
+
+    EXPECT_LE(samples.size(), capacity);
+  }
+
+  producer.join();
+
+  EXPECT_GT(copy_count, 0);
+  EXPECT_EQ(torn_count, 0);
+  EXPECT_EQ(unordered_count, 0);
+
+  samples.clear();
+  ring.CopySamples(samples);
+  ASSERT_EQ(samples.size(), capacity);
+  EXPECT_EQ(samples.back().frame_idx, push_count - 1);
+}
+}
+}
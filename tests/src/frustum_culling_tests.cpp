@@ -0,0 +1,127 @@
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "bvh.hpp"
+#include "frustum_culling.hpp"
+#include "job_system.hpp"
+#include "scene_data.hpp"
+
+namespace pensieve {
+namespace {
+// Distance below which the SIMD and scalar sums may disagree on the side.
+auto constexpr kPlaneTolerance{1e-3f};
+
+enum class ReferenceResult {
+  kOutside,
+  kVisible,
+  // Touches a plane within the tolerance.
+  kAmbiguous,
+};
+
+[[nodiscard]] auto CullScalar(Frustum const& frustum,
+                              InstanceCullingBounds const& bounds,
+                              std::size_t const idx) -> ReferenceResult {
+  auto ret{ReferenceResult::kVisible};
+
+  for (auto const& [a, b, c, d] : frustum.planes) {
+    auto const max_dist{
+      a * bounds.center_x[idx] + b * bounds.center_y[idx] + c * bounds.
+      center_z[idx] + d + std::abs(a) * bounds.extent_x[idx] + std::abs(b) *
+      bounds.extent_y[idx] + std::abs(c) * bounds.extent_z[idx]
+    };
+
+    if (max_dist < -kPlaneTolerance) {
+      return ReferenceResult::kOutside;
+    }
+
+    if (max_dist <= kPlaneTolerance) {
+      ret = ReferenceResult::kAmbiguous;
+    }
+  }
+
+  return ret;
+}
+
+class CullInstancesTest : public testing::TestWithParam<std::uint32_t> {};
+
+// Compares against a scalar loop on random boxes and frustums. The counts
+// cover partial SIMD batches and lists that are split between threads.
+TEST_P(CullInstancesTest, MatchesScalarReference) {
+  auto const instance_count{GetParam()};
+  JobSystem job_system{3};
+  std::mt19937 random{instance_count};
+  std::uniform_real_distribution<float> center{-50.0f, 50.0f};
+  std::uniform_real_distribution<float> extent{0.0f, 3.0f};
+
+  InstanceCullingBounds bounds;
+
+  for (std::uint32_t i{0}; i < instance_count; i++) {
+    bounds.center_x.emplace_back(center(random));
+    bounds.center_y.emplace_back(center(random));
+    bounds.center_z.emplace_back(center(random));
+    bounds.extent_x.emplace_back(extent(random));
+    bounds.extent_y.emplace_back(extent(random));
+    bounds.extent_z.emplace_back(extent(random));
+  }
+
+  std::normal_distribution<float> direction;
+  std::uniform_real_distribution<float> offset{-10.0f, 60.0f};
+  std::vector<std::uint32_t> visible_indices(instance_count);
+
+  for (auto frustum_idx{0}; frustum_idx < 20; frustum_idx++) {
+    Frustum frustum;
+
+    for (auto& plane : frustum.planes) {
+      plane = Float4{direction(random), direction(random), direction(random),
+                     0.0f};
+      auto const len{
+        std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] *
+                  plane[2])
+      };
+      plane = Float4{
+        plane[0] / len, plane[1] / len, plane[2] / len, offset(random)
+      };
+    }
+
+    auto const visible_count{
+      CullInstances(job_system, frustum, bounds, visible_indices)
+    };
+    ASSERT_LE(visible_count, instance_count);
+
+    std::uint32_t visible_idx{0};
+
+    for (std::uint32_t i{0}; i < instance_count; i++) {
+      auto const is_culled_visible{
+        visible_idx < visible_count && visible_indices[visible_idx] == i
+      };
+
+      if (is_culled_visible) {
+        ++visible_idx;
+      }
+
+      switch (CullScalar(frustum, bounds, i)) {
+      case ReferenceResult::kOutside:
+        EXPECT_FALSE(is_culled_visible) << "Instance " << i;
+        break;
+      case ReferenceResult::kVisible:
+        EXPECT_TRUE(is_culled_visible) << "Instance " << i;
+        break;
+      case ReferenceResult::kAmbiguous:
+        break;
+      }
+    }
+
+    // Every index was matched in increasing order.
+    EXPECT_EQ(visible_idx, visible_count);
+  }
+}
+
+INSTANTIATE_TEST_SUITE_P(InstanceCounts, CullInstancesTest,
+                         testing::Values(0u, 7u, 8u, 1001u, 16384u, 16385u,
+                                         100003u));
+}
+}
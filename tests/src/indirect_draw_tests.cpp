@@ -0,0 +1,73 @@
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "dispatch_planner.hpp"
+#include "indirect_draw.hpp"
+
+namespace pensieve {
+namespace {
+// Replays the commands built for two meshes the way the mesh shader reads
+// them and checks that every meshlet of every visible instance is drawn
+// exactly once with the draw record of its own mesh.
+TEST(IndirectDrawTest, DrawsEveryMeshletInstanceOnce) {
+  auto constexpr max_instance_count{10u};
+  auto constexpr meshlet_count{5u};
+
+  // The second chunk has a lowered instance limit to split it into several
+  // dispatches.
+  std::array<MeshletDispatchChunk, 2> const chunks{
+    MeshletDispatchChunk{0, 2, 3, CalculateMaxInstanceCountPerDispatch(2, 3)},
+    MeshletDispatchChunk{2, 3, 1, 4}
+  };
+
+  for (std::uint32_t instance_count{0}; instance_count <= max_instance_count;
+       instance_count++) {
+    std::array<std::uint32_t, 2 * meshlet_count * max_instance_count>
+      coverage{};
+    std::vector<IndirectDrawCommand> commands;
+
+    for (std::uint32_t mesh_idx{0}; mesh_idx < 2; mesh_idx++) {
+      AppendIndirectDrawCommands(mesh_idx, chunks, instance_count, commands);
+    }
+
+    ASSERT_EQ(commands.size(),
+              2 * CalculateMaxIndirectDrawCommandCount(chunks, instance_count));
+
+    for (auto const& [constants, dispatch] : commands) {
+      ASSERT_LT(constants.draw_record_idx, 2);
+      ASSERT_GT(dispatch.thread_group_count_x, 0);
+      ASSERT_LE(dispatch.thread_group_count_x, kMaxDispatchGroupCount);
+      ASSERT_EQ(dispatch.thread_group_count_y, 1);
+      ASSERT_EQ(dispatch.thread_group_count_z, 1);
+
+      MeshletDispatchChunk const chunk{
+        constants.meshlet_offset, 0, constants.instances_per_group, 0
+      };
+
+      for (std::uint32_t group_idx{0}; group_idx < dispatch.
+           thread_group_count_x; group_idx++) {
+        auto const [meshlet_idx, start_instance, group_instance_count]{
+          MapGroupToInstances(chunk, constants.instance_count, group_idx)
+        };
+
+        for (auto j{start_instance}; j < start_instance + group_instance_count;
+             j++) {
+          ++coverage[(constants.draw_record_idx * meshlet_count + constants.
+            meshlet_offset + meshlet_idx) * max_instance_count + constants.
+            instance_offset + j];
+        }
+      }
+    }
+
+    for (std::size_t i{0}; i < coverage.size(); i++) {
+      EXPECT_EQ(coverage[i], i % max_instance_count < instance_count ? 1 : 0)
+        << "instance count " << instance_count << ", slot " << i;
+    }
+  }
+}
+}
+}
@@ -0,0 +1,161 @@
+#include <array>
+#include <cmath>
+#include <random>
+#include <utility>
+
+#include <gtest/gtest.h>
+
+#include "instance_transform.hpp"
+
+namespace pensieve {
+namespace {
+using Double3X3 = std::array<std::array<double, 3>, 3>;
+
+// Gauss-Jordan elimination with partial pivoting, independent of the
+// cofactor formula under test.
+[[nodiscard]] auto InvertTranspose(Float3X4 const& model_mtx) -> Double3X3 {
+  Double3X3 mtx;
+  Double3X3 inv{{{1, 0, 0}, {0, 1, 0}, {0, 0, 1}}};
+
+  for (auto i{0}; i < 3; i++) {
+    for (auto j{0}; j < 3; j++) {
+      mtx[i][j] = model_mtx[i * 4 + j];
+    }
+  }
+
+  for (auto col{0}; col < 3; col++) {
+    auto pivot{col};
+
+    for (auto row{col + 1}; row < 3; row++) {
+      if (std::abs(mtx[row][col]) > std::abs(mtx[pivot][col])) {
+        pivot = row;
+      }
+    }
+
+    std::swap(mtx[col], mtx[pivot]);
+    std::swap(inv[col], inv[pivot]);
+
+    auto const scale{1 / mtx[col][col]};
+
+    for (auto j{0}; j < 3; j++) {
+      mtx[col][j] *= scale;
+      inv[col][j] *= scale;
+    }
+
+    for (auto row{0}; row < 3; row++) {
+      if (row == col) {
+        continue;
+      }
+
+      auto const factor{mtx[row][col]};
+
+      for (auto j{0}; j < 3; j++) {
+        mtx[row][j] -= factor * mtx[col][j];
+        inv[row][j] -= factor * inv[col][j];
+      }
+    }
+  }
+
+  Double3X3 ret;
+
+  for (auto i{0}; i < 3; i++) {
+    for (auto j{0}; j < 3; j++) {
+      ret[i][j] = inv[j][i];
+    }
+  }
+
+  return ret;
+}
+
+// Checks that the normal matrix transforms normals into the direction of the
+// inverse transpose of the model matrix.
+auto ExpectNormalsMatchInverseTranspose(Float3X4 const& model_mtx) -> void {
+  auto const normal_mtx{CalculateNormalMatrix(model_mtx)};
+  auto const ref_mtx{InvertTranspose(model_mtx)};
+
+  for (auto const& normal : {
+         Float3{1, 0, 0}, Float3{0, 1, 0}, Float3{0, 0, 1},
+         Float3{0.57735f, 0.57735f, 0.57735f}, Float3{-0.6f, 0.0f, 0.8f}
+       }) {
+    std::array<double, 3> ref{};
+    std::array<double, 3> reconstructed{};
+
+    for (auto i{0}; i < 3; i++) {
+      for (auto j{0}; j < 3; j++) {
+        ref[i] += ref_mtx[i][j] * normal[j];
+        reconstructed[i] += normal_mtx[i][j] * normal[j];
+      }
+    }
+
+    auto const dot{
+      (ref[0] * reconstructed[0] + ref[1] * reconstructed[1] + ref[2] *
+        reconstructed[2]) / std::sqrt(
+        (ref[0] * ref[0] + ref[1] * ref[1] + ref[2] * ref[2]) * (
+          reconstructed[0] * reconstructed[0] + reconstructed[1] *
+          reconstructed[1] + reconstructed[2] * reconstructed[2]))
+    };
+    EXPECT_GT(dot, 1 - 1e-4);
+  }
+}
+
+TEST(InstanceTransformTest, PacksTransposedUpperPart) {
+  std::array<float, 16> mtx;
+
+  for (auto i{0}; i < 16; i++) {
+    mtx[i] = static_cast<float>(i);
+  }
+
+  EXPECT_EQ(PackModelMatrix(mtx),
+            (Float3X4{0, 4, 8, 12, 1, 5, 9, 13, 2, 6, 10, 14}));
+}
+
+TEST(InstanceTransformTest, NormalMatrixOfRotationIsRotation) {
+  Float3X4 const model_mtx{0, -1, 0, 5, 1, 0, 0, -2, 0, 0, 1, 7};
+  auto const normal_mtx{CalculateNormalMatrix(model_mtx)};
+
+  for (auto i{0}; i < 3; i++) {
+    for (auto j{0}; j < 3; j++) {
+      EXPECT_FLOAT_EQ(normal_mtx[i][j], model_mtx[i * 4 + j]);
+    }
+  }
+}
+
+TEST(InstanceTransformTest, NormalMatrixMatchesNonUniformScaleAndShear) {
+  ExpectNormalsMatchInverseTranspose({4, 0, 0, 1, 0, 0.5f, 0, 2, 0, 0, 2, 3});
+  ExpectNormalsMatchInverseTranspose({1, 3, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0});
+}
+
+// Mirroring flips the determinant, the normals must still face outwards.
+TEST(InstanceTransformTest, NormalMatrixKeepsMirroredNormalsOutwards) {
+  ExpectNormalsMatchInverseTranspose({-1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0});
+  ExpectNormalsMatchInverseTranspose({2, 0, 0, 0, 0, -3, 0, 0, 0, 0, -0.5f, 0});
+}
+
+TEST(InstanceTransformTest, NormalMatrixMatchesRandomTransforms) {
+  std::mt19937 random{7};
+  std::uniform_real_distribution<float> element{-4.0f, 4.0f};
+  auto tested_count{0};
+
+  while (tested_count < 1000) {
+    Float3X4 model_mtx;
+
+    for (auto& value : model_mtx) {
+      value = element(random);
+    }
+
+    auto const normal_mtx{CalculateNormalMatrix(model_mtx)};
+    auto const det{
+      Dot(Float3{model_mtx[0], model_mtx[1], model_mtx[2]}, normal_mtx[0])
+    };
+
+    // Nearly singular transforms amplify the float error of both sides.
+    if (std::abs(det) < 1.0f) {
+      continue;
+    }
+
+    ExpectNormalsMatchInverseTranspose(model_mtx);
+    ++tested_count;
+  }
+}
+}
+}
@@ -0,0 +1,237 @@
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "job_system.hpp"
+
+namespace pensieve {
+namespace {
+auto constexpr kWorkerCount{3u};
+// Long enough for any test to finish, so that a lost job fails instead of
+// hanging.
+auto constexpr kTimeout{std::chrono::seconds{10}};
+
+struct ParallelForParams {
+  std::size_t count;
+  std::size_t grain_size;
+};
+
+class ParallelForTest : public testing::TestWithParam<ParallelForParams> {};
+
+TEST_P(ParallelForTest, CoversEveryIndexOnce) {
+  auto const [count, grain_size]{GetParam()};
+  JobSystem job_system{kWorkerCount};
+  std::vector<std::atomic<std::uint32_t>> visit_counts(count);
+
+  job_system.ParallelFor(count, grain_size,
+                         [&](std::size_t const begin, std::size_t const end) {
+                           EXPECT_LE(end - begin,
+                                     std::max<std::size_t>(grain_size, 1));
+
+                           for (auto i{begin}; i < end; i++) {
+                             visit_counts[i].fetch_add(1);
+                           }
+                         });
+
+  for (std::size_t i{0}; i < count; i++) {
+    EXPECT_EQ(visit_counts[i].load(), 1) << "Index " << i;
+  }
+}
+
+INSTANTIATE_TEST_SUITE_P(Ranges, ParallelForTest,
+                         testing::Values(ParallelForParams{0, 1},
+                                         ParallelForParams{1, 1},
+                                         ParallelForParams{1000, 0},
+                                         ParallelForParams{1000, 1},
+                                         ParallelForParams{1000, 7},
+                                         ParallelForParams{1000, 1000},
+                                         ParallelForParams{100003, 64}));
+
+// A job queues children on its worker's deque and does not run them itself,
+// so they only finish if the other workers steal them.
+TEST(JobSystemTest, OtherWorkersStealQueuedJobs) {
+  JobSystem job_system{kWorkerCount};
+  JobCounter parent_counter;
+  JobCounter child_counter;
+  std::mutex thread_ids_mutex;
+  std::set<std::thread::id> thread_ids;
+  std::thread::id parent_thread_id;
+  auto is_stolen{false};
+
+  job_system.Run([&] {
+    parent_thread_id = std::this_thread::get_id();
+
+    for (auto i{0}; i < 1000; i++) {
+      job_system.Run([&] {
+        std::scoped_lock const lock{thread_ids_mutex};
+        thread_ids.emplace(std::this_thread::get_id());
+      }, &child_counter);
+    }
+
+    auto const deadline{std::chrono::steady_clock::now() + kTimeout};
+
+    while (!child_counter.IsDone() && std::chrono::steady_clock::now() <
+      deadline) {
+      std::this_thread::yield();
+    }
+
+    is_stolen = child_counter.IsDone();
+  }, &parent_counter);
+
+  job_system.Wait(parent_counter);
+  // The waiting thread may also have run some of them.
+  job_system.Wait(child_counter);
+  EXPECT_TRUE(is_stolen);
+  EXPECT_FALSE(thread_ids.contains(parent_thread_id));
+}
+
+// Every job of the chain depends on the previous one, so they must run in
+// order even though they are queued from whichever thread finished the
+// previous job.
+TEST(JobSystemTest, RunsDependencyChainsInOrder) {
+  JobSystem job_system{kWorkerCount};
+  auto constexpr chain_count{8};
+  auto constexpr chain_length{2000};
+  std::vector<std::vector<int>> orders(chain_count);
+  JobCounter counter;
+
+  for (auto chain{0}; chain < chain_count; chain++) {
+    JobHandle previous;
+
+    for (auto i{0}; i < chain_length; i++) {
+      previous = job_system.Run([&orders, chain, i] {
+        orders[chain].emplace_back(i);
+      }, &counter, std::span{&previous, 1});
+    }
+  }
+
+  job_system.Wait(counter);
+
+  for (auto const& order : orders) {
+    ASSERT_EQ(order.size(), chain_length);
+
+    for (auto i{0}; i < chain_length; i++) {
+      EXPECT_EQ(order[i], i);
+    }
+  }
+}
+
+// A join job depends on many jobs, some of which finish before it is run.
+TEST(JobSystemTest, WaitsForEveryDependency) {
+  JobSystem job_system{kWorkerCount};
+
+  for (auto iteration{0}; iteration < 200; iteration++) {
+    std::atomic<std::uint32_t> finished_count{0};
+    std::vector<JobHandle> dependencies;
+
+    for (auto i{0}; i < 32; i++) {
+      dependencies.emplace_back(job_system.Run([&finished_count] {
+        finished_count.fetch_add(1);
+      }));
+    }
+
+    JobCounter counter;
+    std::uint32_t seen_count{0};
+    job_system.Run([&] {
+      seen_count = finished_count.load();
+    }, &counter, dependencies);
+    job_system.Wait(counter);
+    EXPECT_EQ(seen_count, 32);
+  }
+}
+
+TEST(JobSystemTest, NestsParallelForWaits) {
+  JobSystem job_system{kWorkerCount};
+
+  for (auto iteration{0}; iteration < 20; iteration++) {
+    std::atomic<std::uint64_t> sum{0};
+
+    job_system.ParallelFor(64, 1, [&](std::size_t const outer_begin,
+                                      std::size_t const outer_end) {
+      for (auto i{outer_begin}; i < outer_end; i++) {
+        job_system.ParallelFor(64, 3, [&](std::size_t const begin,
+                                          std::size_t const end) {
+          for (auto j{begin}; j < end; j++) {
+            job_system.ParallelFor(8, 1, [&](std::size_t const inner_begin,
+                                             std::size_t const inner_end) {
+              sum.fetch_add(inner_end - inner_begin);
+            });
+          }
+        });
+      }
+    });
+
+    EXPECT_EQ(sum.load(), 64 * 64 * 8);
+  }
+}
+
+// Threads that are not workers queue jobs at the same time as the workers.
+TEST(JobSystemTest, RunsJobsQueuedFromManyThreads) {
+  JobSystem job_system{kWorkerCount};
+  std::atomic<std::uint32_t> run_count{0};
+  std::vector<std::thread> threads;
+
+  for (auto i{0}; i < 4; i++) {
+    threads.emplace_back([&job_system, &run_count] {
+      for (auto iteration{0}; iteration < 100; iteration++) {
+        JobCounter counter;
+
+        for (auto j{0}; j < 50; j++) {
+          job_system.Run([&job_system, &run_count, &counter] {
+            run_count.fetch_add(1);
+            job_system.Run([&run_count] {
+              run_count.fetch_add(1);
+            }, &counter);
+          }, &counter);
+        }
+
+        job_system.Wait(counter);
+      }
+    });
+  }
+
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  EXPECT_EQ(run_count.load(), 4 * 100 * 50 * 2);
+}
+
+// Workers go to sleep between the bursts and must wake up for the next one.
+TEST(JobSystemTest, WakesSleepingWorkers) {
+  JobSystem job_system{kWorkerCount};
+
+  for (auto burst{0}; burst < 20; burst++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds{1});
+
+    JobCounter parent_counter;
+    JobCounter child_counter;
+    auto is_done{false};
+
+    // Only a woken worker can run the child while the parent spins.
+    job_system.Run([&] {
+      job_system.Run([] {}, &child_counter);
+      auto const deadline{std::chrono::steady_clock::now() + kTimeout};
+
+      while (!child_counter.IsDone() && std::chrono::steady_clock::now() <
+        deadline) {
+        std::this_thread::yield();
+      }
+
+      is_done = child_counter.IsDone();
+    }, &parent_counter);
+
+    job_system.Wait(parent_counter);
+    job_system.Wait(child_counter);
+    ASSERT_TRUE(is_done) << "Burst " << burst;
+  }
+}
+}
+}
@@ -0,0 +1,50 @@
+#include <array>
+#include <cstdint>
+
+#include <gtest/gtest.h>
+
+#include "mega_buffer.hpp"
+
+namespace pensieve {
+namespace {
+// Ranges of mixed sizes and alignments are aligned, do not overlap and are
+// only separated by the reported padding.
+TEST(MegaBufferTest, LayoutIsTight) {
+  struct Range {
+    std::uint64_t byte_count;
+    std::uint64_t alignment;
+  };
+
+  std::array constexpr ranges{
+    Range{16, 16}, Range{8, 8}, Range{48, 48}, Range{0, 256}, Range{4, 4},
+    Range{100, 48}, Range{12, 16}, Range{256, 256}, Range{1, 1}, Range{24, 12}
+  };
+
+  MegaBufferLayout layout;
+  std::uint64_t end{0};
+  std::uint64_t padding_byte_count{0};
+
+  for (auto const& [byte_count, alignment] : ranges) {
+    auto const offset{layout.Allocate(byte_count, alignment)};
+    EXPECT_EQ(offset % alignment, 0);
+    EXPECT_GE(offset, end);
+
+    if (byte_count != 0) {
+      EXPECT_LT(offset - end, alignment);
+      padding_byte_count += offset - end;
+      end = offset + byte_count;
+    }
+  }
+
+  EXPECT_EQ(layout.GetByteCount(), end);
+  EXPECT_EQ(layout.GetPaddingByteCount(), padding_byte_count);
+
+  std::array const layouts{layout, MegaBufferLayout{}};
+  auto const stats{CalculateMegaBufferStats(layouts)};
+  EXPECT_EQ(stats.range_count, ranges.size() - 1);
+  EXPECT_EQ(stats.buffer_count, 1);
+  EXPECT_EQ(stats.byte_count, end);
+  EXPECT_EQ(stats.padding_byte_count, padding_byte_count);
+}
+}
+}
@@ -0,0 +1,227 @@
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "occlusion_culling.hpp"
+#include "scene_data.hpp"
+
+namespace pensieve {
+namespace {
+auto constexpr kWidth{static_cast<float>(OcclusionBuffer::width_)};
+auto constexpr kHeight{static_cast<float>(OcclusionBuffer::height_)};
+
+// Clip space is world space, so the tests place everything in pixels.
+std::array<float, 16> constexpr kIdentityViewProjMtx{
+  1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1
+};
+Float3X4 constexpr kIdentityModelMtx{1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0};
+
+[[nodiscard]] auto ToWorld(Float3 const& pixel) -> Float4 {
+  return Float4{
+    pixel[0] / kWidth * 2 - 1, 1 - pixel[1] / kHeight * 2, pixel[2], 1
+  };
+}
+
+auto RasterizePixelTriangle(OcclusionBuffer& buffer,
+                            std::array<Float3, 3> const& verts) -> void {
+  std::array const positions{
+    ToWorld(verts[0]), ToWorld(verts[1]), ToWorld(verts[2])
+  };
+  std::array<std::uint32_t, 3> constexpr indices{0, 1, 2};
+  buffer.RasterizeOccluder(positions, indices, kIdentityModelMtx);
+}
+
+// Whether the box spanning the pixel rectangle and depth range is visible.
+[[nodiscard]] auto IsPixelBoxVisible(OcclusionBuffer const& buffer,
+                                     float const min_x, float const max_x,
+                                     float const min_y, float const max_y,
+                                     float const min_z, float const max_z) ->
+  bool {
+  auto const min{ToWorld(Float3{min_x, max_y, min_z})};
+  auto const max{ToWorld(Float3{max_x, min_y, max_z})};
+  return buffer.IsVisible(
+    Float3{(min[0] + max[0]) / 2, (min[1] + max[1]) / 2, (min[2] + max[2]) / 2},
+    Float3{(max[0] - min[0]) / 2, (max[1] - min[1]) / 2, (max[2] - min[2]) / 2});
+}
+
+// Covers the pixels left of x = 100 at depth 0.5. The tile from 96 to 104 is
+// only partially covered.
+[[nodiscard]] auto MakeLeftOccludedBuffer() -> OcclusionBuffer {
+  OcclusionBuffer buffer;
+  buffer.Clear(kIdentityViewProjMtx);
+  RasterizePixelTriangle(buffer, {
+                           Float3{0, 0, 0.5f}, Float3{100, 0, 0.5f},
+                           Float3{100, kHeight, 0.5f}
+                         });
+  RasterizePixelTriangle(buffer, {
+                           Float3{0, 0, 0.5f}, Float3{100, kHeight, 0.5f},
+                           Float3{0, kHeight, 0.5f}
+                         });
+  buffer.BuildHierarchy();
+  return buffer;
+}
+
+// Vertices on a quarter pixel grid and power of two depths keep every edge
+// function and depth exact, so the SIMD rows must match a scalar loop bit for
+// bit, including back faces, edges through pixel centers and triangles
+// leaving the screen.
+TEST(OcclusionBufferTest, CoverageMatchesScalarReference) {
+  std::mt19937 random{3};
+  std::uniform_int_distribution<int> quarter_x{-80, 4 * 280};
+  std::uniform_int_distribution<int> quarter_y{-80, 4 * 150};
+  std::uniform_int_distribution<int> depth_exponent{0, 3};
+
+  OcclusionBuffer buffer;
+  buffer.Clear(kIdentityViewProjMtx);
+  std::vector<float> expected(OcclusionBuffer::width_ * OcclusionBuffer::height_,
+                              0.0f);
+
+  for (auto tri_idx{0}; tri_idx < 300; tri_idx++) {
+    auto const z{1.0f / static_cast<float>(1 << depth_exponent(random))};
+    std::array<Float3, 3> verts;
+
+    for (auto& vert : verts) {
+      vert = Float3{
+        static_cast<float>(quarter_x(random)) / 4,
+        static_cast<float>(quarter_y(random)) / 4, z
+      };
+    }
+
+    RasterizePixelTriangle(buffer, verts);
+
+    auto const area{
+      (verts[1][0] - verts[0][0]) * (verts[2][1] - verts[0][1]) - (verts[1][1]
+        - verts[0][1]) * (verts[2][0] - verts[0][0])
+    };
+
+    if (!(area > 0)) {
+      continue;
+    }
+
+    for (auto y{0}; y < OcclusionBuffer::height_; y++) {
+      for (auto x{0}; x < OcclusionBuffer::width_; x++) {
+        auto is_covered{true};
+
+        for (auto i{0}; i < 3; i++) {
+          auto const& p0{verts[(i + 1) % 3]};
+          auto const& p1{verts[(i + 2) % 3]};
+          auto const a{p0[1] - p1[1]};
+          auto const b{p1[0] - p0[0]};
+          is_covered &= a * (static_cast<float>(x) + 0.5f - p0[0]) + b * (
+            static_cast<float>(y) + 0.5f - p0[1]) >= 0;
+        }
+
+        if (is_covered) {
+          auto& depth{expected[y * OcclusionBuffer::width_ + x]};
+          depth = std::max(depth, z);
+        }
+      }
+    }
+  }
+
+  auto const depth{buffer.GetDepth()};
+  ASSERT_EQ(depth.size(), expected.size());
+
+  for (std::size_t i{0}; i < expected.size(); i++) {
+    EXPECT_EQ(depth[i], expected[i]) << "Pixel " << i % OcclusionBuffer::width_
+      << ", " << i / OcclusionBuffer::width_;
+  }
+}
+
+// Every pixel keeps the farthest depth the triangle's plane reaches within it.
+TEST(OcclusionBufferTest, SlopedDepthIsConservative) {
+  OcclusionBuffer buffer;
+  buffer.Clear(kIdentityViewProjMtx);
+  std::array const verts{
+    Float3{3.3f, 2.1f, 0.9f}, Float3{250.7f, 20.2f, 0.2f},
+    Float3{40.1f, 125.6f, 0.5f}
+  };
+  RasterizePixelTriangle(buffer, verts);
+
+  // The plane z = dzdx * x + dzdy * y + z0 through the vertices.
+  auto const ux{verts[1][0] - verts[0][0]};
+  auto const uy{verts[1][1] - verts[0][1]};
+  auto const uz{verts[1][2] - verts[0][2]};
+  auto const vx{verts[2][0] - verts[0][0]};
+  auto const vy{verts[2][1] - verts[0][1]};
+  auto const vz{verts[2][2] - verts[0][2]};
+  auto const det{ux * vy - uy * vx};
+  auto const dzdx{(uz * vy - uy * vz) / det};
+  auto const dzdy{(ux * vz - uz * vx) / det};
+  auto const z0{verts[0][2] - dzdx * verts[0][0] - dzdy * verts[0][1]};
+
+  auto const depth{buffer.GetDepth()};
+  auto covered_count{0};
+
+  for (auto y{0}; y < OcclusionBuffer::height_; y++) {
+    for (auto x{0}; x < OcclusionBuffer::width_; x++) {
+      auto const stored{depth[y * OcclusionBuffer::width_ + x]};
+
+      if (stored == 0) {
+        continue;
+      }
+
+      ++covered_count;
+      auto farthest{1.0f};
+
+      for (auto const corner_x : {x, x + 1}) {
+        for (auto const corner_y : {y, y + 1}) {
+          farthest = std::min(farthest,
+                              dzdx * static_cast<float>(corner_x) + dzdy *
+                              static_cast<float>(corner_y) + z0);
+        }
+      }
+
+      EXPECT_LE(stored, farthest + 1e-5f) << "Pixel " << x << ", " << y;
+    }
+  }
+
+  EXPECT_GT(covered_count, 1000);
+}
+
+TEST(OcclusionBufferTest, HidesBoundsBehindOccluder) {
+  auto const buffer{MakeLeftOccludedBuffer()};
+  EXPECT_FALSE(IsPixelBoxVisible(buffer, 40, 60, 40, 60, 0.1f, 0.3f));
+  // In front of the occluder.
+  EXPECT_TRUE(IsPixelBoxVisible(buffer, 40, 60, 40, 60, 0.6f, 0.7f));
+  // Reaches past the occluder's edge.
+  EXPECT_TRUE(IsPixelBoxVisible(buffer, 90, 110, 40, 60, 0.1f, 0.3f));
+  EXPECT_TRUE(IsPixelBoxVisible(buffer, 150, 160, 40, 60, 0.1f, 0.3f));
+  // Off screen bounds are left to frustum culling.
+  EXPECT_TRUE(IsPixelBoxVisible(buffer, -40, -20, 40, 60, 0.1f, 0.3f));
+}
+
+// The tile from 96 to 104 has an uncovered pixel, so its minimum depth
+// cannot hide anything and the pixels decide. Tests dilate the footprint by
+// a pixel on every side.
+TEST(OcclusionBufferTest, FallsBackToPixelsInPartiallyCoveredTiles) {
+  auto const buffer{MakeLeftOccludedBuffer()};
+  EXPECT_FALSE(IsPixelBoxVisible(buffer, 97.2f, 98.8f, 40, 60, 0.1f, 0.3f));
+  EXPECT_TRUE(IsPixelBoxVisible(buffer, 97.2f, 99.2f, 40, 60, 0.1f, 0.3f));
+}
+
+// Reversed depth puts points closer than the near plane at z > w.
+TEST(OcclusionBufferTest, DropsOccludersInFrontOfNearPlane) {
+  for (auto const near_z : {1.0f, 1.5f}) {
+    OcclusionBuffer buffer;
+    buffer.Clear(kIdentityViewProjMtx);
+    RasterizePixelTriangle(buffer, {
+                             Float3{0, 0, 0.5f}, Float3{kWidth, 0, near_z},
+                             Float3{0, kHeight, 0.5f}
+                           });
+    buffer.BuildHierarchy();
+    EXPECT_EQ(IsPixelBoxVisible(buffer, 10, 20, 10, 20, 0.1f, 0.2f),
+              near_z > 1.0f) << "Near vertex depth " << near_z;
+  }
+}
+
+TEST(OcclusionBufferTest, TreatsBoundsInFrontOfNearPlaneAsVisible) {
+  auto const buffer{MakeLeftOccludedBuffer()};
+  EXPECT_TRUE(IsPixelBoxVisible(buffer, 40, 60, 40, 60, 0.1f, 1.2f));
+}
+}
+}
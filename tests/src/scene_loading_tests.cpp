@@ -0,0 +1,401 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <expected>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iterator>
+#include <numeric>
+#include <optional>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "file_reader.hpp"
+#include "job_system.hpp"
+#include "scene_data.hpp"
+#include "scene_loading.hpp"
+#include "scene_synthesis.hpp"
+#include "scene_writing.hpp"
+
+namespace pensieve {
+namespace {
+// A single instanced triangle, the smallest scene that loads.
+[[nodiscard]] auto MakeTriangleScene() -> SceneData {
+  SceneData scene;
+  scene.materials.emplace_back(Float3{1.0f, 1.0f, 1.0f}, 0.0f, 1.0f,
+                               Float3{0.0f, 0.0f, 0.0f});
+
+  auto& mesh{scene.meshes.emplace_back()};
+  mesh.positions = {
+    Float4{0.0f, 0.0f, 0.0f, 1.0f}, Float4{1.0f, 0.0f, 0.0f, 1.0f},
+    Float4{0.0f, 1.0f, 0.0f, 1.0f}
+  };
+  mesh.normals.assign(3, Float4{0.0f, 0.0f, 1.0f, 0.0f});
+  mesh.meshlets = {MeshletData{3, 0, 1, 0}};
+
+  for (std::uint32_t i{0}; i < 3; i++) {
+    for (std::uint32_t byte{0}; byte < sizeof(i); byte++) {
+      mesh.vertex_indices.emplace_back(byte == 0 ? i : 0);
+    }
+  }
+
+  mesh.triangle_indices = {MeshletTriangleIndexData{0, 1, 2}};
+  mesh.material_idx = 0;
+  mesh.instances = {
+    InstanceData{{1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0}}
+  };
+
+  scene.bvh.nodes = {
+    BvhNode{{0.0f, 0.0f, 0.0f}, 0, {1.0f, 1.0f, 0.0f}, 1}
+  };
+  scene.bvh.instance_refs = {BvhInstanceRef{0, 0}};
+  return scene;
+}
+
+// Several meshes with textures, large enough to span many 4 KiB chunks.
+[[nodiscard]] auto MakeTexturedScene() -> SceneData {
+  JobSystem job_system{1};
+  auto scene{
+    SynthesizeScene(SceneSynthesisParams{4, 8, 12, 0.5f, true, 2, 2, 64, 1},
+                    job_system)
+  };
+  EXPECT_TRUE(scene) << scene.error();
+  return scene ? std::move(*scene) : SceneData{};
+}
+
+[[nodiscard]] auto ReadFileBytes(
+  std::filesystem::path const& path) -> std::string {
+  std::ifstream in{path, std::ios::binary | std::ios::in};
+  return {std::istreambuf_iterator<char>{in}, std::istreambuf_iterator<char>{}};
+}
+
+auto WriteSceneFile(std::filesystem::path const& path,
+                    SceneData const& scene) -> void {
+  std::ofstream out{path, std::ios::binary | std::ios::out};
+  WriteScene(out, scene);
+}
+
+// Hands out at most a few rows at a time with padding between them, like the
+// GPU sinks do with staging memory, and copies the committed rows into a
+// SceneDataSink. Gives no rows for sections of the skipped type.
+class PaddedRowSink final : public SceneSink {
+public:
+  explicit PaddedRowSink(
+    std::optional<SceneSectionType> const skipped_type = std::nullopt) :
+    skipped_type_{skipped_type} {}
+
+  [[nodiscard]] auto Begin(
+    SceneLayout const& layout) -> std::expected<void, std::string> override {
+    return data_sink_.Begin(layout);
+  }
+
+  [[nodiscard]] auto AcquireRows(
+    SceneSection const& section,
+    [[maybe_unused]] std::uint64_t const first_row) -> std::expected<
+    SceneSectionDestination, std::string> override {
+    auto const row_pitch{section.row_byte_count + kRowPadding};
+
+    if (section.type == skipped_type_) {
+      return SceneSectionDestination{nullptr, 0, row_pitch};
+    }
+
+    // Claims more rows than remain at the end of the section.
+    rows_.assign(static_cast<std::size_t>(kMaxRowCount * row_pitch),
+                 std::byte{0xCD});
+    return SceneSectionDestination{rows_.data(), kMaxRowCount, row_pitch};
+  }
+
+  [[nodiscard]] auto CommitRows(SceneSection const& section,
+                                std::uint64_t const first_row,
+                                SceneSectionDestination const& dst) ->
+    std::expected<void, std::string> override {
+    EXPECT_LE(first_row + dst.row_count, section.row_count);
+
+    if (section.type == SceneSectionType::kMeshlets) {
+      committed_meshlet_count_ += dst.row_count;
+    }
+
+    auto const data_dst{data_sink_.AcquireRows(section, first_row)};
+
+    if (!data_dst) {
+      return std::unexpected{data_dst.error()};
+    }
+
+    for (std::uint64_t i{0}; i < dst.row_count; i++) {
+      std::memcpy(data_dst->data + i * data_dst->row_pitch,
+                  dst.data + i * dst.row_pitch,
+                  static_cast<std::size_t>(section.row_byte_count));
+    }
+
+    return data_sink_.CommitRows(section, first_row, SceneSectionDestination{
+                                   data_dst->data, dst.row_count,
+                                   data_dst->row_pitch
+                                 });
+  }
+
+  [[nodiscard]] auto EndMesh(
+    std::size_t const mesh_idx) -> std::expected<void, std::string> override {
+    ended_mesh_indices_.emplace_back(mesh_idx);
+    return data_sink_.EndMesh(mesh_idx);
+  }
+
+  [[nodiscard]] auto Finish() -> std::expected<void, std::string> override {
+    return data_sink_.Finish();
+  }
+
+  [[nodiscard]] auto TakeSceneData() -> SceneData {
+    return data_sink_.TakeSceneData();
+  }
+
+  [[nodiscard]] auto GetCommittedMeshletCount() const -> std::uint64_t {
+    return committed_meshlet_count_;
+  }
+
+  [[nodiscard]] auto GetEndedMeshIndices() const -> std::vector<
+    std::size_t> const& {
+    return ended_mesh_indices_;
+  }
+
+private:
+  static auto constexpr kMaxRowCount{std::uint64_t{3}};
+  // Odd, so that padded rows are not aligned.
+  static auto constexpr kRowPadding{std::uint64_t{13}};
+
+  SceneDataSink data_sink_;
+  std::optional<SceneSectionType> skipped_type_;
+  std::vector<std::byte> rows_;
+  std::uint64_t committed_meshlet_count_{0};
+  std::vector<std::size_t> ended_mesh_indices_;
+};
+
+struct SceneLoadingParams {
+  std::string name;
+  SceneLoadOptions options;
+};
+
+auto PrintTo(SceneLoadingParams const& params, std::ostream* const os) -> void {
+  *os << params.name;
+}
+
+// Every backend, and the chunked ones with small chunks, a single read in
+// flight or many, and with and without direct I/O.
+[[nodiscard]] auto MakeSceneLoadingParams() -> std::vector<SceneLoadingParams> {
+  std::vector<SceneLoadingParams> params{
+    {"Stream", kDefaultSceneLoadOptions}
+  };
+
+#ifdef __linux__
+  params.emplace_back("MemoryMap",
+                      SceneLoadOptions{
+                        SceneReadBackend::kMemoryMap, kDefaultFileReadOptions
+                      });
+
+  for (auto const& [backend, backend_name] : {
+         std::pair{SceneReadBackend::kPread, "Pread"},
+         std::pair{SceneReadBackend::kIoUring, "IoUring"}
+       }) {
+    params.emplace_back(backend_name,
+                        SceneLoadOptions{backend, kDefaultFileReadOptions});
+
+    for (auto const queue_depth : {1u, 32u}) {
+      for (auto const direct_io : {false, true}) {
+        params.emplace_back(
+          std::format("{}Depth{}{}", backend_name, queue_depth,
+                      direct_io ? "Direct" : ""),
+          SceneLoadOptions{
+            backend,
+            FileReadOptions{
+              static_cast<std::uint32_t>(kFileReadAlignment), queue_depth,
+              direct_io
+            }
+          });
+      }
+    }
+  }
+#endif
+
+  return params;
+}
+
+class SceneLoadingTest : public testing::TestWithParam<SceneLoadingParams> {
+protected:
+  auto TearDown() -> void override {
+    std::filesystem::remove(path_);
+    std::filesystem::remove(rewritten_path_);
+  }
+
+  [[nodiscard]] auto WriteAndLoad(
+    SceneData const& scene) const -> std::expected<SceneData, std::string> {
+    WriteSceneFile(path_, scene);
+    return LoadScene(path_, GetParam().options);
+  }
+
+  [[nodiscard]] auto Rewrite(SceneData const& scene) const -> std::string {
+    WriteSceneFile(rewritten_path_, scene);
+    return ReadFileBytes(rewritten_path_);
+  }
+
+  std::filesystem::path path_{
+    std::filesystem::temp_directory_path() / "pensieve_loading_test.pensieve"
+  };
+  // Loaded scenes are written back here to compare them with the original.
+  std::filesystem::path rewritten_path_{
+    std::filesystem::temp_directory_path() /
+    "pensieve_loading_test_rewritten.pensieve"
+  };
+};
+
+INSTANTIATE_TEST_SUITE_P(Backends, SceneLoadingTest,
+                         testing::ValuesIn(MakeSceneLoadingParams()),
+                         [](auto const& info) {
+                           return info.param.name;
+                         });
+
+TEST_P(SceneLoadingTest, LoadsTriangle) {
+  auto const scene{WriteAndLoad(MakeTriangleScene())};
+  ASSERT_TRUE(scene) << scene.error();
+  ASSERT_EQ(scene->meshes.size(), 1);
+  EXPECT_EQ(scene->meshes[0].meshlets.size(), 1);
+  EXPECT_EQ(scene->meshes[0].vertex_indices.size(), 3 * sizeof(std::uint32_t));
+}
+
+// Writing the loaded scene back reproduces the file byte for byte.
+TEST_P(SceneLoadingTest, RoundTripsTexturedScene) {
+  auto const scene{WriteAndLoad(MakeTexturedScene())};
+  ASSERT_TRUE(scene) << scene.error();
+  WriteSceneFile(rewritten_path_, *scene);
+
+  auto const bytes{ReadFileBytes(path_)};
+  ASSERT_GT(bytes.size(), 16 * kFileReadAlignment);
+  EXPECT_TRUE(bytes == ReadFileBytes(rewritten_path_));
+}
+
+// Cuts inside the header, the first chunk, the data and the last byte.
+TEST_P(SceneLoadingTest, RejectsTruncatedFile) {
+  WriteSceneFile(path_, MakeTexturedScene());
+  auto const size{std::filesystem::file_size(path_)};
+
+  for (auto const truncated_size : {
+         std::uintmax_t{0}, std::uintmax_t{8},
+         std::uintmax_t{kFileReadAlignment - 1},
+         std::uintmax_t{kFileReadAlignment + 1}, size / 2, size - 1
+       }) {
+    WriteSceneFile(path_, MakeTexturedScene());
+    std::filesystem::resize_file(path_, truncated_size);
+    EXPECT_FALSE(LoadScene(path_, GetParam().options)) << truncated_size <<
+      " of " << size << " bytes";
+  }
+}
+
+TEST_P(SceneLoadingTest, RejectsMaterialChannelsOutsideRgba) {
+  auto scene{MakeTriangleScene()};
+  scene.materials[0].metallic_map_channel = 3;
+  scene.materials[0].roughness_map_channel = 2;
+  EXPECT_TRUE(WriteAndLoad(scene));
+
+  scene.materials[0].metallic_map_channel = 4;
+  EXPECT_FALSE(WriteAndLoad(scene));
+
+  scene.materials[0].metallic_map_channel = 0;
+  scene.materials[0].roughness_map_channel = 0xFFFFFFFF;
+  EXPECT_FALSE(WriteAndLoad(scene));
+}
+
+// Dispatch planning divides by the meshlet sizes and groups have room for
+// 128 vertices and 256 primitives.
+TEST_P(SceneLoadingTest, RejectsMeshletsOutsideLimits) {
+  for (auto const& meshlet : {
+         MeshletData{0, 0, 1, 0}, MeshletData{3, 0, 0, 0},
+         MeshletData{129, 0, 1, 0}, MeshletData{3, 0, 257, 0}
+       }) {
+    auto scene{MakeTriangleScene()};
+    scene.meshes[0].meshlets[0] = meshlet;
+    EXPECT_FALSE(WriteAndLoad(scene)) << meshlet.vert_count << " vertices, "
+      << meshlet.prim_count << " primitives";
+  }
+}
+
+// The occluders and the reference rasterizer index the arrays unchecked.
+TEST_P(SceneLoadingTest, RejectsMeshletsOutsideIndexArrays) {
+  for (auto const& meshlet : {
+         MeshletData{3, 1, 1, 0}, MeshletData{3, 0, 1, 1},
+         MeshletData{3, 0xFFFFFFFF, 1, 0}, MeshletData{3, 0, 1, 0xFFFFFFFF}
+       }) {
+    auto scene{MakeTriangleScene()};
+    scene.meshes[0].meshlets[0] = meshlet;
+    EXPECT_FALSE(WriteAndLoad(scene)) << "Vertex offset " << meshlet.
+      vert_offset << ", primitive offset " << meshlet.prim_offset;
+  }
+}
+
+TEST_P(SceneLoadingTest, RejectsIndicesOutsideMeshletOrMesh) {
+  auto scene{MakeTriangleScene()};
+  scene.meshes[0].triangle_indices[0].idx2 = 3;
+  EXPECT_FALSE(WriteAndLoad(scene));
+
+  scene = MakeTriangleScene();
+  scene.meshes[0].vertex_indices[2 * sizeof(std::uint32_t)] = 3;
+  EXPECT_FALSE(WriteAndLoad(scene));
+
+  scene = MakeTriangleScene();
+  scene.meshes[0].vertex_indices.emplace_back(0);
+  EXPECT_FALSE(WriteAndLoad(scene));
+}
+
+// The rows reach a sink that takes a few padded rows at a time the same as
+// they reach one that takes whole sections.
+TEST_P(SceneLoadingTest, StreamsPaddedRows) {
+  auto const loaded_scene{WriteAndLoad(MakeTexturedScene())};
+  ASSERT_TRUE(loaded_scene) << loaded_scene.error();
+
+  PaddedRowSink sink;
+  auto const exp{StreamScene(path_, sink, GetParam().options)};
+  ASSERT_TRUE(exp) << exp.error();
+
+  std::vector<std::size_t> mesh_indices(loaded_scene->meshes.size());
+  std::iota(mesh_indices.begin(), mesh_indices.end(), std::size_t{0});
+  EXPECT_EQ(sink.GetEndedMeshIndices(), mesh_indices);
+  EXPECT_TRUE(Rewrite(sink.TakeSceneData()) == Rewrite(*loaded_scene));
+}
+
+// The sections after a skipped one are still read from their own offsets.
+TEST_P(SceneLoadingTest, SkipsSectionsGivenNoRows) {
+  auto loaded_scene{WriteAndLoad(MakeTexturedScene())};
+  ASSERT_TRUE(loaded_scene) << loaded_scene.error();
+  ASSERT_FALSE(loaded_scene->textures.empty());
+
+  PaddedRowSink sink{SceneSectionType::kTexels};
+  auto const exp{StreamScene(path_, sink, GetParam().options)};
+  ASSERT_TRUE(exp) << exp.error();
+  auto streamed_scene{sink.TakeSceneData()};
+
+  // The skipped texels were never written.
+  for (auto* const scene : {&*loaded_scene, &streamed_scene}) {
+    for (auto const& tex : scene->textures) {
+      std::memset(tex.bytes.get(), 0,
+                  CalculateTextureByteCount(tex.format, tex.width, tex.height,
+                                            tex.mip_count));
+    }
+  }
+
+  EXPECT_TRUE(Rewrite(streamed_scene) == Rewrite(*loaded_scene));
+}
+
+// Sinks such as the GPU upload never see meshlets outside the index arrays.
+TEST_P(SceneLoadingTest, RejectsMeshletsBeforeCommittingThem) {
+  auto scene{MakeTriangleScene()};
+  scene.meshes[0].meshlets[0] = MeshletData{3, 1, 1, 0};
+  WriteSceneFile(path_, scene);
+
+  PaddedRowSink sink;
+  EXPECT_FALSE(StreamScene(path_, sink, GetParam().options));
+  EXPECT_EQ(sink.GetCommittedMeshletCount(), 0);
+  EXPECT_TRUE(sink.GetEndedMeshIndices().empty());
+}
+}
+}
@@ -0,0 +1,62 @@
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#include "scene_data.hpp"
+#include "scene_synthesis.hpp"
+
+namespace pensieve {
+namespace {
+class GridMeshletTest : public testing::TestWithParam<std::uint32_t> {};
+
+// Every quad of the grid is covered by two triangles of meshlets within the
+// limits of the renderer's mesh shader, and every vertex is referenced.
+TEST_P(GridMeshletTest, CoversGrid) {
+  auto const resolution{GetParam()};
+  auto constexpr first_vertex{7u};
+
+  std::vector<MeshletData> meshlets;
+  std::vector<std::uint32_t> vertex_indices;
+  std::vector<MeshletTriangleIndexData> triangle_indices;
+  AppendGridMeshlets(resolution, first_vertex, meshlets, vertex_indices,
+                     triangle_indices);
+
+  std::vector<bool> is_vertex_used((resolution + 1) * (resolution + 1));
+  std::uint32_t triangle_count{0};
+
+  for (auto const& meshlet : meshlets) {
+    ASSERT_LE(meshlet.vert_count, 128);
+    ASSERT_LE(meshlet.prim_count, 256);
+
+    for (auto i{meshlet.prim_offset};
+         i < meshlet.prim_offset + meshlet.prim_count; i++) {
+      auto const& tri{triangle_indices[i]};
+
+      for (auto const idx : std::array{
+             static_cast<std::uint32_t>(tri.idx0),
+             static_cast<std::uint32_t>(tri.idx1),
+             static_cast<std::uint32_t>(tri.idx2)
+           }) {
+        ASSERT_LT(idx, meshlet.vert_count);
+        is_vertex_used[vertex_indices[meshlet.vert_offset + idx] -
+          first_vertex] = true;
+      }
+    }
+
+    triangle_count += meshlet.prim_count;
+  }
+
+  EXPECT_EQ(triangle_count, 2 * resolution * resolution);
+
+  for (std::size_t i{0}; i < is_vertex_used.size(); i++) {
+    EXPECT_TRUE(is_vertex_used[i]) << "vertex " << i;
+  }
+}
+
+INSTANTIATE_TEST_SUITE_P(Resolutions, GridMeshletTest,
+                         testing::Values(1u, kGridMeshletTileSize, 23u));
+}
+}
@@ -0,0 +1,99 @@
+#include <cstdint>
+
+#include <gtest/gtest.h>
+
+#include "staging_ring.hpp"
+
+namespace pensieve {
+namespace {
+// Chunks cover the copy without gaps, start at multiples of the granularity
+// and fit into the given size.
+auto ExpectUploadChunksExact(std::uint64_t const byte_count,
+                             std::uint64_t const granularity,
+                             std::uint64_t const max_chunk_byte_count) -> void {
+  std::uint64_t end{0};
+
+  for (auto const& [offset, chunk_byte_count] : PlanUploadChunks(
+         byte_count, granularity, max_chunk_byte_count)) {
+    EXPECT_EQ(offset, end);
+    EXPECT_EQ(offset % granularity, 0);
+    EXPECT_GT(chunk_byte_count, 0);
+    EXPECT_LE(chunk_byte_count, max_chunk_byte_count);
+    end = offset + chunk_byte_count;
+  }
+
+  EXPECT_EQ(end, byte_count);
+}
+
+// Allocations that do not fit before the end of the ring wrap around to the
+// start once the batches there are reclaimed.
+TEST(StagingRingTest, WrapsAround) {
+  StagingRing ring{100, 100};
+  EXPECT_EQ(ring.Allocate(40, 1), 0);
+  EXPECT_EQ(ring.Allocate(40, 1), 40);
+  ring.CloseBatch(1);
+
+  // Neither the end nor the start has room for 30 bytes.
+  EXPECT_FALSE(ring.Allocate(30, 1));
+  EXPECT_EQ(ring.GetOpenBatchByteCount(), 0);
+
+  ring.Reclaim(1);
+  EXPECT_EQ(ring.GetUsedByteCount(), 0);
+  EXPECT_EQ(ring.Allocate(10, 1), 0);
+  EXPECT_EQ(ring.Allocate(50, 1), 10);
+  ring.CloseBatch(2);
+
+  // Skips the 40 bytes at the end of the ring.
+  EXPECT_FALSE(ring.Allocate(70, 1));
+  EXPECT_EQ(ring.Allocate(30, 1), 60);
+  EXPECT_FALSE(ring.Allocate(16, 16));
+  EXPECT_EQ(ring.GetUsedByteCount(), 90);
+  ring.CloseBatch(3);
+  ring.Reclaim(2);
+  EXPECT_EQ(ring.GetUsedByteCount(), 30);
+  EXPECT_EQ(ring.Allocate(40, 16), 0);
+
+  // The skipped bytes at the end are freed with the batch that skipped them.
+  ring.CloseBatch(4);
+  ring.Reclaim(4);
+  EXPECT_EQ(ring.GetUsedByteCount(), 0);
+  EXPECT_FALSE(ring.GetOldestFenceValue());
+}
+
+// Batches are reclaimed oldest first and only once their fence completes.
+TEST(StagingRingTest, ReclaimsInOrder) {
+  StagingRing ring{64, 16};
+  EXPECT_EQ(ring.Allocate(8, 4), 0);
+  EXPECT_FALSE(ring.IsBatchFull());
+  EXPECT_EQ(ring.Allocate(8, 4), 8);
+  EXPECT_TRUE(ring.IsBatchFull());
+  ring.CloseBatch(5);
+  ring.CloseBatch(6);
+  EXPECT_EQ(ring.Allocate(20, 8), 16);
+  ring.CloseBatch(7);
+  EXPECT_EQ(ring.GetOldestFenceValue(), 5);
+
+  ring.Reclaim(4);
+  EXPECT_EQ(ring.GetUsedByteCount(), 36);
+
+  ring.Reclaim(6);
+  EXPECT_EQ(ring.GetUsedByteCount(), 20);
+  EXPECT_EQ(ring.GetOldestFenceValue(), 7);
+
+  ring.Reclaim(7);
+  EXPECT_EQ(ring.GetUsedByteCount(), 0);
+  EXPECT_EQ(ring.Allocate(64, 64), 0);
+}
+
+TEST(StagingRingTest, ChunksOversizeUploads) {
+  ExpectUploadChunksExact(0, 1, 10);
+  ExpectUploadChunksExact(10, 1, 10);
+  ExpectUploadChunksExact(11, 1, 10);
+  ExpectUploadChunksExact(1000, 1, 7);
+  ExpectUploadChunksExact(96, 16, 40);
+  ExpectUploadChunksExact(100, 16, 40);
+  ExpectUploadChunksExact(100, 40, 40);
+  EXPECT_EQ(PlanUploadChunks(100, 16, 40).size(), 4);
+}
+}
+}